@@ -93,6 +93,20 @@ imFile* imFileOpen(const char* file_name, int *error);
  * \ingroup file */
 imFile* imFileOpenAs(const char* file_name, const char* format, int *error);
 
+/** Closes the current file and opens another file for reading, reusing the same handle. \n
+ * When the new file has the same format the driver, the line buffer and the attribute table 
+ * are reused, which avoids most of the setup cost when reading many small files in sequence.
+ * Some drivers (like JPEG) also reuse their third party library structures. \n
+ * Returns the same handle if the new file has the same format, or a new handle 
+ * if it has a different format. If an error occurs returns NULL.
+ * In any case the given handle must not be used anymore, 
+ * except if it is the one returned. See also \ref imErrorCodes. \n
+ * In Lua the same imFile object is updated, and it is marked as closed if an error occurs.
+ *
+ * \verbatim ifile:Reopen(file_name: string) -> error: number [in Lua 5] \endverbatim
+ * \ingroup file */
+imFile* imFileReopen(imFile* ifile, const char* file_name, int *error);
+
 /** Creates a new file for writing using a specific format. If the file exists will be replaced. \n
  * It will only initialize the format driver and create the file, no data is actually written.
  * See also \ref imErrorCodes and \ref format.
@@ -123,6 +137,8 @@ void* imFileHandle(imFile* ifile, int index);
  * image_count is the number of images in a stack or 
  * the number of frames in a video/animation or the depth of a volume data. \n
  * compression and image_count can be NULL. \n
+ * Some formats (like TIFF) count the images only when image_count is requested, 
+ * so the FileImageCount attribute of an image loaded from the file may not be defined. \n
  * These information are also available as attributes:
  * \verbatim FileFormat (string) \endverbatim
  * \verbatim FileCompression (string) \endverbatim
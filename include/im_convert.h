@@ -150,6 +150,35 @@ int imConvertRGB2MapCounter(int width, int height,
                             unsigned char *map, long *palette, int *palette_count, 
                             int counter);
 
+/** \brief Color Quantizer Context (Private).
+ * \ingroup cnvutil */
+typedef struct _imQuantContext imQuantContext;
+
+/** Creates a context for the median cut color quantizer. \n
+ * It holds the histogram, the inverse color map and the error buffers used by the conversion, 
+ * so they are not allocated at each call. A context must not be used by more than one conversion at the same time, 
+ * but different contexts can be used concurrently.
+ * Returns NULL if failed.
+ * \ingroup cnvutil */
+imQuantContext* imQuantContextCreate(void);
+
+/** Destroys the color quantizer context.
+ * \ingroup cnvutil */
+void imQuantContextDestroy(imQuantContext* ctx);
+
+/** Converts a RGB bitmap into a map bitmap using the median cut algorithm and Floyd-Steinberg dithering. \n
+ * If reuse_palette is zero, the palette is computed from the image, 
+ * palette_count is the maximum number of colors and returns the number of colors found. \n
+ * If reuse_palette is non zero, the given palette is used and no histogram is computed. 
+ * When the palette is the same used in the previous conversion with this context 
+ * the inverse color map is not recomputed, useful for several frames that share the same palette. \n
+ * Returns IM_ERR_NONE, IM_ERR_MEM, IM_ERR_DATA or IM_ERR_COUNTER.
+ * \ingroup cnvutil */
+int imConvertRGB2MapContext(imQuantContext* ctx, int width, int height, 
+                            unsigned char *red, unsigned char *green, unsigned char *blue, 
+                            unsigned char *map, long *palette, int *palette_count, 
+                            int reuse_palette, int counter);
+
 
 #if defined(__cplusplus)
 }
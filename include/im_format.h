@@ -30,7 +30,7 @@ public:
 
   /* Pure Virtual Methods. Every driver must implement all the following methods. */
 
-  virtual int Open(const char* file_name) = 0; // Must initialize compression and image_count
+  virtual int Open(const char* file_name) = 0; // Must initialize compression and image_count (or -1 if counted later)
   virtual int New(const char* file_name) = 0;
   virtual void Close() = 0;
   virtual void* Handle(int index) = 0;
@@ -38,6 +38,13 @@ public:
   virtual int ReadImageData(void* data) = 0;
   virtual int WriteImageInfo() = 0;            // Should update compression
   virtual int WriteImageData(void* data) = 0;  // Must update image_count
+
+  /* Virtual Methods with a default implementation. */
+
+  virtual int Reopen(const char* file_name)    // Must behave as Close+Open, 
+  { Close(); return Open(file_name); }         // but may reuse internal structures
+  virtual int ReadImageCount()                 // Called when image_count is -1, must return the number of images
+  { return this->image_count; }
 };
 
 /** \brief Image File Format Descriptor Class (SDK Use Only) 
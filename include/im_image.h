@@ -335,6 +335,66 @@ void imImageMakeGray(imImage *image);
 
 
 
+/** \defgroup imgpool imImage Pool
+ *
+ * \par
+ *  A pool of image buffers to be reused by temporary images of the same size and type. \n
+ *  Images are keyed by width, height, color_mode (color space and alpha) and data_type. 
+ *  Released images are kept up to a maximum memory size, the least recently released 
+ *  images are destroyed first when this limit is exceeded. \n
+ *  All functions are thread safe, so the same pool can be shared by several threads.
+ * \par
+ * See \ref im_image.h
+ * \ingroup imagerep */
+
+/** \brief imImage Pool Structure (Private).
+ * \ingroup imgpool */
+typedef struct _imImagePool imImagePool;
+
+/** Creates a new image pool. \n
+ * max_mbytes is the maximum memory size in megabytes of the released images kept by the pool. 
+ * If 0 released images are always destroyed. \n
+ * If use_huge_pages is non zero large buffers are allocated aligned to 2 Mb 
+ * and the system is advised to back them with huge pages (only in Linux for now).
+ * \ingroup imgpool */
+imImagePool* imImagePoolCreate(int max_mbytes, int use_huge_pages);
+
+/** Destroys the pool and all the released images it holds. \n
+ * Images acquired from the pool and not released yet must be destroyed using \ref imImageDestroy.
+ * \ingroup imgpool */
+void imImagePoolDestroy(imImagePool* pool);
+
+/** Returns an image from the pool, or creates a new one if none is available. \n
+ * color_mode can include the IM_ALPHA flag. \n
+ * Contents of a reused image are undefined, its attributes are removed and its palette is reset.
+ * Returns NULL if failed.
+ * \ingroup imgpool */
+imImage* imImagePoolAcquire(imImagePool* pool, int width, int height, int color_mode, int data_type);
+
+/** Returns an image to the pool. \n
+ * The image must not be used after this call. It can be an image not acquired from the pool, 
+ * as long as its buffer was allocated by \ref imImageCreate. 
+ * If it does not fit in the maximum memory size it is destroyed.
+ * \ingroup imgpool */
+void imImagePoolRelease(imImagePool* pool, imImage* image);
+
+/** Changes the maximum memory size, destroying released images if necessary.
+ * \ingroup imgpool */
+void imImagePoolSetMaxSize(imImagePool* pool, int max_mbytes);
+
+/** Destroys all the released images held by the pool.
+ * \ingroup imgpool */
+void imImagePoolClear(imImagePool* pool);
+
+/** Returns the pool statistics. \n
+ * hits and misses are the number of acquires that reused an image or that created a new image. 
+ * count and mbytes are the number and the memory size of the released images currently held by the pool. \n
+ * Any of the parameters can be NULL.
+ * \ingroup imgpool */
+void imImagePoolStats(imImagePool* pool, int *hits, int *misses, int *count, double *mbytes);
+
+
+
 /** \defgroup imgfile imImage Storage
  *
  * \par
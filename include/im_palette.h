@@ -55,6 +55,7 @@ long* imPaletteDuplicate(const long* palette, int count);
 /** Searches for the nearest color on the table and returns the color index if successful. 
  * It looks in all palette entries and finds the minimum euclidian square distance. 
  * If the color matches the given color it returns immediately.
+ * For several searches in the same palette use \ref imPaletteIndexCreate.
  * See also \ref colorutl.
  *
  * \verbatim im.PaletteFindNearest(pal: imPalette, color: lightuserdata) -> index: number [in Lua 5] \endverbatim
@@ -70,6 +71,52 @@ int imPaletteFindNearest(const long *palette, int palette_count, long color);
  * \ingroup palette */
 int imPaletteFindColor(const long *palette, int palette_count, long color, unsigned char tol);
 
+/** \brief Palette Index Structure (Private).
+ * \ingroup palette */
+typedef struct _imPaletteIndex imPaletteIndex;
+
+/** Creates a lookup structure to search for the nearest color of a palette. \n
+ * The RGB space is divided in boxes and for each box only the palette entries 
+ * that can be the nearest color are stored. Searches are much faster than \ref imPaletteFindNearest
+ * and return the same result. The palette is copied so it can be changed or released after this call. \n
+ * The index is not changed after creation, so it can be used by several threads at the same time.
+ * Returns NULL if failed.
+ * \ingroup palette */
+imPaletteIndex* imPaletteIndexCreate(const long* palette, int palette_count);
+
+/** Destroys the palette index.
+ * \ingroup palette */
+void imPaletteIndexDestroy(imPaletteIndex* pindex);
+
+/** Searches for the nearest color on the palette index. Same as \ref imPaletteFindNearest.
+ * \ingroup palette */
+int imPaletteIndexFindNearest(const imPaletteIndex* pindex, long color);
+
+/** Dither options for \ref imPaletteIndexMap.
+ * \ingroup palette */
+enum imPaletteDither {
+  IM_PALETTE_DITHER_NONE,      /**< nearest color only */
+  IM_PALETTE_DITHER_ORDERED,   /**< 8x8 Bayer ordered dither, amplitude based on the palette size */
+  IM_PALETTE_DITHER_DIFFUSION, /**< Floyd-Steinberg error diffusion, serpentine scan */
+  IM_PALETTE_DITHER_BLUENOISE  /**< 64x64 blue noise ordered dither, amplitude based on the palette size */
+};
+
+/** Maps the RGB planes into palette indices using the palette index. \n
+ * count=width*height for each plane. dither is a \ref imPaletteDither value. \n
+ * Returns zero if failed to allocate memory. See also \ref imProcessQuantizeRGBPalette.
+ * \ingroup palette */
+int imPaletteIndexMap(const imPaletteIndex* pindex, int width, int height, 
+                      const unsigned char* red, const unsigned char* green, const unsigned char* blue, 
+                      unsigned char* map, int dither);
+
+/** Returns the threshold matrix used by the ordered dither options. \n
+ * dither can be IM_PALETTE_DITHER_ORDERED (8x8 Bayer matrix) or IM_PALETTE_DITHER_BLUENOISE (64x64 blue noise matrix). 
+ * The matrix has size*size elements with values from 0 to size*size-1, each value occurs only once. 
+ * The matrices are constant tables, so they can be used by several threads at the same time. \n
+ * Returns NULL for the other options.
+ * \ingroup palette */
+const int* imPaletteDitherMatrix(int dither, int *size);
+
 /** Creates a palette of gray scale values.
  * The colors are arranged from black to white.
  *
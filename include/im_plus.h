@@ -586,6 +586,8 @@ namespace im
 
     bool Failed() const {
       return im_file == 0; }
+    void Reopen(const char* file_name, int &error) {
+      im_file = imFileReopen(im_file, file_name, &error); }
 
 
     /* attributes or metadata */
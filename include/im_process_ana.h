@@ -69,6 +69,33 @@ int imCalcGrayHistogram(const imImage* image, unsigned long* histo, int cumulati
  * \ingroup stats */
 int imCalcHistogram(const imImage* image, unsigned long* histo, int plane, int cumulative);
 
+/** Calculates the histograms of the red, green and blue planes of an image in a single pass. \n
+ * Image must be (IM_BYTE, IM_SHORT or IM_USHORT)/IM_RGB. \n
+ * The histo array must have 3*hcount positions, where hcount is 256 or 65536 (see \ref imHistogramCount). 
+ * The red histogram starts at 0, the green at hcount and the blue at 2*hcount. \n
+ * When cumulative is different from zero it calculates the cumulative histograms.
+ * Returns zero if the counter aborted.
+ *
+ * \verbatim im.CalcRGBHistogram(image: imImage, cumulative: boolean) -> counter: boolean, red_histo: table of numbers, green_histo: table of numbers, blue_histo: table of numbers [in Lua 5] \endverbatim
+ * The returned tables are zero indexed.
+ * \ingroup stats */
+int imCalcRGBHistogram(const imImage* image, unsigned long* histo, int cumulative);
+
+/** Calculates the histogram of each tile of an image plane. \n
+ * Image can be IM_BYTE, IM_SHORT or IM_USHORT. \n
+ * The image is divided in tiles_x*tiles_y tiles, where tiles_x=(width+tile_width-1)/tile_width
+ * and tiles_y=(height+tile_height-1)/tile_height. Tiles at the right and top borders can be smaller. \n
+ * The histo array must have tiles_x*tiles_y*hcount positions, where hcount is 256 or 65536 (see \ref imHistogramCount). 
+ * The histogram of the tile (tx,ty) starts at histo[(ty*tiles_x + tx)*hcount]. \n
+ * Useful for local (CLAHE like) histogram equalization. \n
+ * When cumulative is different from zero it calculates the cumulative histograms.
+ * Returns zero if the counter aborted or if tile_width or tile_height are not positive.
+ *
+ * \verbatim im.CalcHistogramTiles(image: imImage, plane: number, tile_width: number, tile_height: number, cumulative: boolean) -> counter: boolean, histo: table of tables of numbers [in Lua 5] \endverbatim
+ * The returned table contains one histogram for each tile, all zero indexed.
+ * \ingroup stats */
+int imCalcHistogramTiles(const imImage* image, int plane, int tile_width, int tile_height, unsigned long* histo, int cumulative);
+
 /** Calculates the histogram of a IM_BYTE data. \n
  * Histogram is always 256 positions long. \n
  * When cumulative is different from zero it calculates the cumulative histogram.
@@ -132,6 +159,9 @@ typedef struct _imStats
 /** Calculates the statistics about the image data. \n
  * There is one stats for each depth plane. For ex: stats[0]=red stats, stats[0]=green stats, ... \n
  * Supports all data types except complex. \n
+ * All the values are computed in a single pass over the data. 
+ * The standard deviation is computed from partial means combined in pairs, 
+ * so it does not suffer from the cancelation of the sum of squares method. \n
  * Returns zero if the counter aborted.
  *
  * \verbatim im.CalcImageStatistics(image: imImage) -> counter: boolean, stats: table [in Lua 5] \endverbatim
@@ -142,6 +172,28 @@ typedef struct _imStats
  * \ingroup stats */
 int imCalcImageStatistics(const imImage* image, imStats* stats);
 
+/** Same as \ref imCalcImageStatistics but only the pixels where the mask is not zero are used. \n
+ * The mask must be an IM_BINARY image with the same size of the image. 
+ * If there are no pixels in the mask all the fields are zero. \n
+ * Returns zero if the counter aborted.
+ *
+ * \verbatim im.CalcImageStatisticsMask(image: imImage, mask_image: imImage) -> counter: boolean, stats: table [in Lua 5] \endverbatim
+ * \ingroup stats */
+int imCalcImageStatisticsMask(const imImage* image, const imImage* mask_image, imStats* stats);
+
+/** Calculates the statistics of each tile of the image. \n
+ * The image is divided in tiles_x*tiles_y tiles, where tiles_x=(width+tile_width-1)/tile_width
+ * and tiles_y=(height+tile_height-1)/tile_height. Tiles at the right and top borders can be smaller. \n
+ * The stats array must have tiles_x*tiles_y*depth elements. 
+ * The stats of plane d of the tile (tx,ty) is at stats[(ty*tiles_x + tx)*depth + d]. \n
+ * The mask is optional and can be NULL, see \ref imCalcImageStatisticsMask. \n
+ * Returns zero if the counter aborted.
+ *
+ * \verbatim im.CalcImageStatisticsTiles(image: imImage, mask_image: imImage, tile_width: number, tile_height: number) -> counter: boolean, stats: table [in Lua 5] \endverbatim
+ * Table contains one entry for each tile starting at 0, each entry is the same as the table returned by im.CalcImageStatistics.
+ * \ingroup stats */
+int imCalcImageStatisticsTiles(const imImage* image, const imImage* mask_image, int tile_width, int tile_height, imStats* stats);
+
 /** Calculates the statistics about the image histogram data.\n
  * There is one stats for each depth plane. For ex: stats[0]=red stats, stats[0]=green stats, ... \n
  * Only IM_BYTE, IM_SHORT and IM_USHORT images are supported.
@@ -259,6 +311,72 @@ int imAnalyzeMeasureHoles(const imImage* image, int connect, int region_count, i
  * \ingroup analyze */
 int imAnalyzeMeasurePerimeter(const imImage* image, double* perim, int region_count);
 
+/** Moment index in the \ref imRegionMeasures moment arrays. \n
+ * IM_Mpq is the moment of order p in x and order q in y.
+ * \ingroup analyze */
+enum imMomentIndex {
+  IM_M00, IM_M10, IM_M01, 
+  IM_M20, IM_M11, IM_M02, 
+  IM_M30, IM_M21, IM_M12, IM_M03,
+  IM_MOMENT_COUNT
+};
+
+/** \brief Region Measures Structure
+ * \par
+ * All the measures computed by \ref imAnalyzeMeasureRegions. 
+ * Each array has region_count elements, the measures of the region i are at index i-1 of each array.
+ * \ingroup analyze */
+typedef struct _imRegionMeasures
+{
+  int region_count;          /**< Number of regions */
+
+  int* area;                 /**< Number of pixels */
+  double* cx;                /**< Centroid */
+  double* cy;                /**< Centroid */
+  int* xmin;                 /**< Bounding box */
+  int* ymin;                 /**< Bounding box */
+  int* xmax;                 /**< Bounding box */
+  int* ymax;                 /**< Bounding box */
+
+  double* moment[IM_MOMENT_COUNT];          /**< Raw moments up to order 3, see \ref imMomentIndex */
+  double* central_moment[IM_MOMENT_COUNT];  /**< Central moments up to order 3, see \ref imMomentIndex */
+
+  double* major_angle;       /**< Angle of the major principal axis in degrees [0,180), same as the major slope of \ref imAnalyzeMeasurePrincipalAxis */
+  double* major_length;      /**< Major axis length, same as \ref imAnalyzeMeasurePrincipalAxis */
+  double* minor_length;      /**< Minor axis length, same as \ref imAnalyzeMeasurePrincipalAxis */
+
+  double* perimeter;         /**< Same as \ref imAnalyzeMeasurePerimeter */
+  double* mean;              /**< Mean intensity of the gray image, or zero if the gray image is not used */
+} imRegionMeasures;
+
+/** Creates a measures structure for the given number of regions.
+ * \ingroup analyze */
+imRegionMeasures* imRegionMeasuresCreate(int region_count);
+
+/** Destroys the measures structure.
+ * \ingroup analyze */
+void imRegionMeasuresDestroy(imRegionMeasures* measures);
+
+/** Measure area, centroid, bounding box, raw and central moments up to order 3, principal axes, 
+ * perimeter and mean intensity of all regions in a single pass. 
+ * A second pass over the perimeter points computes the principal axes lengths and selects the major axis, 
+ * also in parallel with per-thread extents. Holes are not included. \n
+ * Source image is IM_GRAY/IM_USHORT type (the result of \ref imAnalyzeFindRegions). \n
+ * gray_image is optional and can be NULL, if not it must have the same size of the image, 
+ * can be any data type except complex and only its first plane is used for the mean intensity. \n
+ * Each thread accumulates the sums of its lines in private buffers, that are merged at the end. 
+ * Moments are accumulated relative to a point of the region and combined exactly, 
+ * so central moments do not suffer from the cancelation of the raw moments. \n
+ * Regions with area zero have all the measures set to zero. \n
+ * Returns zero if the counter aborted.
+ *
+ * \verbatim im.AnalyzeMeasureRegions(image: imImage, [gray_image: imImage], [region_count: number]) -> counter: boolean, measures: table [in Lua 5] \endverbatim
+ * The measures table contains the fields area, cx, cy, xmin, ymin, xmax, ymax, major_angle, major_length, minor_length, perimeter and mean, 
+ * and also moment and central_moment that contain the fields m00, m10, m01, m20, m11, m02, m30, m21, m12 and m03. 
+ * Each field is a zero indexed table of numbers.
+ * \ingroup analyze */
+int imAnalyzeMeasureRegions(const imImage* image, const imImage* gray_image, imRegionMeasures* measures);
+
 /** Isolates the perimeter line of gray integer images. Background is defined as being black (0). \n
  * It just checks if at least one of the 4 connected neighbors is non zero. Image borders are extended with zeros.
  * Returns zero if the counter aborted.
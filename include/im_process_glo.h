@@ -32,16 +32,34 @@ extern "C" {
  * theta = "0 .. 179", rho = "-hg_height/2 .. hg_height/2" .\n
  * Where rho is the perpendicular distance from the center of the image and theta the angle with the normal.
  * So do not confuse theta with the line angle, they are perpendicular. \n
+ * The sine and cosine tables are computed once for each hg_width and kept until the program ends. \n
  * Returns zero if the counter aborted. \n
  * Inspired from ideas in XITE, Copyright 1991, Blab, UiO \n
  * http://www.ifi.uio.no/~blab/Software/Xite/  \n
- * Not using OpenMP when enabled.
+ * Uses OpenMP when enabled, each thread accumulates in its own map, so the result is the same with or without OpenMP.
  *
  * \verbatim im.ProcessHoughLines(src_image: imImage, dst_image: imImage) -> counter: boolean [in Lua 5] \endverbatim
  * \verbatim im.ProcessHoughLinesNew(image: imImage) -> counter: boolean, new_image: imImage [in Lua 5] \endverbatim
  * \ingroup transform */
 int imProcessHoughLines(const imImage* src_image, imImage* dst_image);
 
+/** Hough Lines Transform using the gradient orientation. \n
+ * Same as \ref imProcessHoughLines, but each pixel votes only for the angles 
+ * in the interval "theta-theta_delta .. theta+theta_delta", where theta is the normal of the edge at the pixel. 
+ * It is much faster and produces less spurious peaks. \n
+ * The edge normal is the gradient direction computed with a 3x3 Sobel operator over the gray image, 
+ * that must be IM_GRAY, IM_BYTE and with the same size of the source image. 
+ * If gray_image is NULL the gradient is computed over the source image itself. 
+ * Pixels with no gradient vote for all angles. \n
+ * theta_delta is in the same units of the target width (degrees for hg_width=180). \n
+ * Returns zero if the counter aborted. \n
+ * Uses OpenMP when enabled.
+ *
+ * \verbatim im.ProcessHoughLinesGradient(src_image: imImage, gray_image: imImage, dst_image: imImage, theta_delta: number) -> counter: boolean [in Lua 5] \endverbatim
+ * \verbatim im.ProcessHoughLinesGradientNew(image: imImage, gray_image: imImage, theta_delta: number) -> counter: boolean, new_image: imImage [in Lua 5] \endverbatim
+ * \ingroup transform */
+int imProcessHoughLinesGradient(const imImage* src_image, const imImage* gray_image, imImage* dst_image, int theta_delta);
+
 /** Draw detected hough lines. \n
  * The source and target images can be IM_MAP, IM_GRAY or IM_RGB, with data type IM_BYTE. \n
  * Can be done in-place. \n
@@ -195,6 +213,22 @@ int imProcessOpenMPSetMinCount(int min_count);
 int imProcessOpenMPSetNumThreads(int count);
 
 
+
+/** \defgroup procpool Temporary Image Pool
+ * \par
+ * Some processing functions need temporary images of the same size of the source image,
+ * like the compound morphology and convolution operations. 
+ * They are obtained from an internal \ref imgpool so they can be reused between calls.
+ * See \ref im_process_glo.h
+ * \ingroup process */
+
+/** Returns the image pool used internally for temporary images. \n
+ * By default its maximum size is 0, so temporary images are always destroyed. 
+ * Use \ref imImagePoolSetMaxSize to enable reuse, 
+ * and \ref imImagePoolStats to inspect its usage. It must not be destroyed.
+ * \ingroup procpool */
+imImagePool* imProcessImagePool(void);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -108,6 +108,7 @@ void imProcessCalcRotateSize(int width, int height, int *new_width, int *new_hei
 /** Rotates the image using the given interpolation order (see \ref imProcessResize). \n
  * Images must be of the same type. The target size can be calculated using \ref imProcessCalcRotateSize to fit the new image size, 
  * or can be any size, including the original size. The rotation is relative to the center of the image. \n
+ * Implemented using \ref imProcessWarpAffine. \n
  * Returns zero if the counter aborted.
  *
  * \verbatim im.ProcessRotate(src_image: imImage, dst_image: imImage, cos0: number, sin0: number[, order]: number) -> counter: boolean [in Lua 5] \endverbatim
@@ -125,9 +126,45 @@ int imProcessRotate(const imImage* src_image, imImage* dst_image, double cos0, d
  * \ingroup geom */
 int imProcessRotateRef(const imImage* src_image, imImage* dst_image, double cos0, double sin0, int x, int y, int to_origin, int order);
 
+/** Warps the image using an affine transformation and the given interpolation order (see \ref imProcessResize). \n
+ * The matrix maps target coordinates to source coordinates (inverse mapping), it has 6 elements: \n
+ * "xs = m[0]*x + m[1]*y + m[2]" and "ys = m[3]*x + m[4]*y + m[5]" \n
+ * where pixel centers are at integer coordinates. 
+ * Target pixels that map outside the source image are not changed. \n
+ * Images must be of the same type. Target can have any size. \n
+ * Uses fixed point bilinear interpolation for integer data types. \n
+ * Returns zero if the counter aborted.
+ *
+ * \verbatim im.ProcessWarpAffine(src_image: imImage, dst_image: imImage, matrix: table of number[, order]: number) -> counter: boolean [in Lua 5] \endverbatim
+ * \verbatim im.ProcessWarpAffineNew(image: imImage, matrix: table of number[, order]: number) -> counter: boolean, new_image: imImage [in Lua 5] \endverbatim
+ * \ingroup geom */
+int imProcessWarpAffine(const imImage* src_image, imImage* dst_image, const double* matrix, int order);
+
+/** Warps the image using a perspective transformation (homography) and the given interpolation order (see \ref imProcessResize). \n
+ * The matrix maps target coordinates to source coordinates (inverse mapping), it has 9 elements: \n
+ * "w = m[6]*x + m[7]*y + m[8]", "xs = (m[0]*x + m[1]*y + m[2])/w" and "ys = (m[3]*x + m[4]*y + m[5])/w" \n
+ * See \ref imProcessWarpAffine for other details.
+ *
+ * \verbatim im.ProcessWarpPerspective(src_image: imImage, dst_image: imImage, matrix: table of number[, order]: number) -> counter: boolean [in Lua 5] \endverbatim
+ * \verbatim im.ProcessWarpPerspectiveNew(image: imImage, matrix: table of number[, order]: number) -> counter: boolean, new_image: imImage [in Lua 5] \endverbatim
+ * \ingroup geom */
+int imProcessWarpPerspective(const imImage* src_image, imImage* dst_image, const double* matrix, int order);
+
+/** Warps the image using a lookup map and the given interpolation order (see \ref imProcessResize). \n
+ * The maps are IM_GRAY, IM_FLOAT images with the same size of the target image. 
+ * They contain the source coordinates of each target pixel, where pixel centers are at integer coordinates. \n
+ * Returns zero if the maps do not match this type and size, or if the counter aborted. \n
+ * See \ref imProcessWarpAffine for other details.
+ *
+ * \verbatim im.ProcessRemap(src_image: imImage, map_x_image: imImage, map_y_image: imImage, dst_image: imImage[, order]: number) -> counter: boolean [in Lua 5] \endverbatim
+ * \ingroup geom */
+int imProcessRemap(const imImage* src_image, const imImage* map_x_image, const imImage* map_y_image, imImage* dst_image, int order);
+
 /** Rotates the image in 90 degrees counterclockwise or clockwise. Swap columns by lines. \n
  * Images must be of the same type. Target width and height must be source height and width. \n
- * Direction can be clockwise (1) or counter clockwise (-1).
+ * Direction can be clockwise (1) or counter clockwise (-1). \n
+ * The image is processed in tiles, so large images do not thrash the cache. \n
+ * Can be done in-place if the image is square.
  * Returns zero if the counter aborted.
  *
  * \verbatim im.ProcessRotate90(src_image: imImage, dst_image: imImage, dir_clockwise: boolean) -> counter: boolean [in Lua 5] \endverbatim
@@ -136,7 +173,8 @@ int imProcessRotateRef(const imImage* src_image, imImage* dst_image, double cos0
 int imProcessRotate90(const imImage* src_image, imImage* dst_image, int dir_clockwise);
 
 /** Rotates the image in 180 degrees. Swap columns and swap lines. \n
- * Images must be of the same type and size.
+ * Images must be of the same type and size. \n
+ * Can be done in-place.
  * Returns zero if the counter aborted.
  *
  * \verbatim im.ProcessRotate180(src_image: imImage, dst_image: imImage) -> counter: boolean [in Lua 5] \endverbatim
@@ -401,7 +439,9 @@ int imProcessRankMinConvolve(const imImage* src_image, imImage* dst_image, int k
 
 /** Threshold using a rank convolution with a range contrast function. \n
  * Supports all integer IM_GRAY images as source, and IM_BINARY as target. \n
- * Local variable threshold by the method of Bernsen. \n
+ * Local variable threshold by the method of Bernsen. 
+ * The local minimum and maximum are computed with separable running extremes, 
+ * the cost per pixel does not depend on the kernel size. \n
  * Extracted from XITE, Copyright 1991, Blab, UiO \n
  * http://www.ifi.uio.no/~blab/Software/Xite/
 \verbatim
@@ -419,13 +459,51 @@ int imProcessRangeContrastThreshold(const imImage* src_image, imImage* dst_image
 
 /** Threshold using a rank convolution with a local max function.  \n
  * Returns zero if the counter aborted. \n
- * Supports all integer IM_GRAY images as source, and IM_BINARY as target.
+ * Supports all integer IM_GRAY images as source, and IM_BINARY as target. 
+ * The local maximum is computed with separable running extremes, 
+ * the cost per pixel does not depend on the kernel size.
  *
  * \verbatim im.ProcessLocalMaxThreshold(src_image: imImage, dst_image: imImage, kernel_size: number, min_level: number) -> counter: boolean [in Lua 5] \endverbatim
  * \verbatim im.ProcessLocalMaxThresholdNew(image: imImage, kernel_size: number, min_level: number) -> counter: boolean, new_image: imImage [in Lua 5] \endverbatim
  * \ingroup threshold */
 int imProcessLocalMaxThreshold(const imImage* src_image, imImage* dst_image, int kernel_size, int min_level);
 
+/** Local adaptive threshold by the method of Niblack. \n
+ * The threshold is mean + k * stddev, computed in a kernel_size x kernel_size window 
+ * (clipped at the borders) centered in the pixel. 
+ * Pixels greater than the threshold are set to 1, so dark text in a light background is 0. 
+ * Usual values for k are around -0.2 for dark text. \n
+ * Mean and standard deviation come from running sums of the values and their squares 
+ * (an integral image computed line by line, with 64 bits integers for IM_BYTE, IM_SHORT and IM_USHORT), 
+ * so the cost per pixel does not depend on the kernel size. Lines are processed in parallel bands. \n
+ * Supports all non complex IM_GRAY images as source, and IM_BINARY as target. \n
+ * Returns zero if the counter aborted or if failed to allocate memory.
+ *
+ * \verbatim im.ProcessNiblackThreshold(src_image: imImage, dst_image: imImage, kernel_size: number, k: number) -> counter: boolean [in Lua 5] \endverbatim
+ * \verbatim im.ProcessNiblackThresholdNew(image: imImage, kernel_size: number, k: number) -> counter: boolean, new_image: imImage [in Lua 5] \endverbatim
+ * \ingroup threshold */
+int imProcessNiblackThreshold(const imImage* src_image, imImage* dst_image, int kernel_size, double k);
+
+/** Local adaptive threshold by the method of Sauvola. \n
+ * The threshold is mean * (1 + k * (stddev / range - 1)), computed in a kernel_size x kernel_size window. 
+ * range is the dynamic range of the standard deviation, usually 128 for IM_BYTE images, and k is usually from 0.2 to 0.5. \n
+ * Same output, window and computation of \ref imProcessNiblackThreshold.
+ *
+ * \verbatim im.ProcessSauvolaThreshold(src_image: imImage, dst_image: imImage, kernel_size: number, k: number, range: number) -> counter: boolean [in Lua 5] \endverbatim
+ * \verbatim im.ProcessSauvolaThresholdNew(image: imImage, kernel_size: number, k: number, range: number) -> counter: boolean, new_image: imImage [in Lua 5] \endverbatim
+ * \ingroup threshold */
+int imProcessSauvolaThreshold(const imImage* src_image, imImage* dst_image, int kernel_size, double k, double range);
+
+/** Local adaptive threshold by the method of Bradley and Roth. \n
+ * The threshold is mean * (1 - percent/100), computed in a kernel_size x kernel_size window. 
+ * percent is usually 15. \n
+ * Same output, window and computation of \ref imProcessNiblackThreshold.
+ *
+ * \verbatim im.ProcessBradleyThreshold(src_image: imImage, dst_image: imImage, kernel_size: number, percent: number) -> counter: boolean [in Lua 5] \endverbatim
+ * \verbatim im.ProcessBradleyThresholdNew(image: imImage, kernel_size: number, percent: number) -> counter: boolean, new_image: imImage [in Lua 5] \endverbatim
+ * \ingroup threshold */
+int imProcessBradleyThreshold(const imImage* src_image, imImage* dst_image, int kernel_size, double percent);
+
 
 
 /** \defgroup convolve Convolution Operations
@@ -574,8 +652,11 @@ int imProcessZeroCrossing(const imImage* src_image, imImage* dst_image);
 
 /** First part of the Canny edge detector. Includes the gaussian filtering and the nonmax suppression. \n
  * After using this you could apply a Hysteresis Threshold, see \ref imProcessHysteresisThreshold. \n
- * Image must be IM_BYTE/IM_GRAY. \n
- * Returns zero if the counter aborted.
+ * Image must be IM_BYTE/IM_GRAY. Pixels that are not edges are set to zero. \n
+ * The image is processed line by line in parallel bands, 
+ * the convolution keeps only a few lines, and it can be called from several threads at once. 
+ * The magnitude of the local maxima is kept as float until the scale of all the bands is known. \n
+ * Returns zero if the counter aborted or if there is not enough memory.
  * Implementation from the book:
  \verbatim
     J. R. Parker
@@ -588,6 +669,17 @@ int imProcessZeroCrossing(const imImage* src_image, imImage* dst_image);
  * \ingroup convolve */
 int imProcessCanny(const imImage* src_image, imImage* dst_image, double stddev);
 
+/** Canny edge detector followed by an Hysteresis Threshold, in the same pipeline. \n
+ * The same as \ref imProcessCanny followed by \ref imProcessHysteresisThreshold, 
+ * but without an intermediate magnitude image. \n
+ * Source image must be IM_BYTE/IM_GRAY, target image must be IM_BINARY. \n
+ * Returns zero if the counter aborted or if there is not enough memory.
+ *
+ * \verbatim im.ProcessCannyHysteresis(src_image: imImage, dst_image: imImage, stddev: number, low_thres: number, high_thres: number)-> counter: boolean [in Lua 5] \endverbatim
+ * \verbatim im.ProcessCannyHysteresisNew(image: imImage, stddev: number, low_thres: number, high_thres: number) -> counter: boolean, new_image: imImage [in Lua 5] \endverbatim
+ * \ingroup convolve */
+int imProcessCannyHysteresis(const imImage* src_image, imImage* dst_image, double stddev, int low_thres, int high_thres);
+
 /** Calculates the kernel size given the standard deviation. \n
  * If sdtdev is negative its magnitude will be used as the kernel size.
  *
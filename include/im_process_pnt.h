@@ -44,6 +44,19 @@ typedef int (*imUnaryPointOpFunc)(double src_value, double *dst_value, double* p
  * \ingroup point */
 int imProcessUnaryPointOp(const imImage* src_image, imImage* dst_image, imUnaryPointOpFunc func, double* params, void* userdata, const char* op_name);
 
+/** Same as \ref imProcessUnaryPointOp but the function is evaluated only once for each possible source value,
+ * the results are stored in a lookup table that is then applied to all the pixels. \n
+ * Source data type must be IM_BYTE (256 calls per plane) or IM_USHORT (65536 calls per plane), 
+ * for other data types it simply calls \ref imProcessUnaryPointOp. \n
+ * The function must not depend on the pixel position, it is called with x=-1 and y=-1, 
+ * but d is still the plane index. The function is called sequentially, 
+ * only the table is applied in parallel, so in Lua it is much faster than the regular version.
+ *
+ * \verbatim im.ProcessUnaryPointLutOp(src_image: imImage, dst_image: imImage, func: function, params: table, [op_name: string]) -> counter: boolean [in Lua 5] \endverbatim
+ * \verbatim im.ProcessUnaryPointLutOpNew(image: imImage, func: function, params: table, [op_name: string]) -> counter: boolean, new_image: imImage [in Lua 5] \endverbatim
+ * \ingroup point */
+int imProcessUnaryPointLutOp(const imImage* src_image, imImage* dst_image, imUnaryPointOpFunc func, double* params, void* userdata, const char* op_name);
+
 /** Custom unary point color function. \n
  * Data will be set only if the returned value is non zero.
  * It is called (width * height).\n
@@ -71,6 +84,17 @@ typedef int (*imUnaryPointColorOpFunc)(const double* src_value, double *dst_valu
  * \ingroup point */
 int imProcessUnaryPointColorOp(const imImage* src_image, imImage* dst_image, imUnaryPointColorOpFunc func, double* params, void* userdata, const char* op_name);
 
+/** Same as \ref imProcessUnaryPointColorOp but the function is evaluated only once for each possible source value,
+ * the results are stored in a lookup table that is then applied to all the pixels. \n
+ * Source must have a single plane (for instance, a gray image to be converted to a pseudo color RGB image), 
+ * and its data type must be IM_BYTE or IM_USHORT, otherwise it simply calls \ref imProcessUnaryPointColorOp. \n
+ * The function must not depend on the pixel position, it is called with x=-1 and y=-1.
+ *
+ * \verbatim im.ProcessUnaryPointColorLutOp(src_image: imImage, dst_image: imImage, func: function, params: table, [op_name: string]) -> counter: boolean [in Lua 5] \endverbatim
+ * \verbatim im.ProcessUnaryPointColorLutOpNew(image: imImage, func: function, params: table, [op_name: string]) -> counter: boolean, new_image: imImage [in Lua 5] \endverbatim
+ * \ingroup point */
+int imProcessUnaryPointColorLutOp(const imImage* src_image, imImage* dst_image, imUnaryPointColorOpFunc func, double* params, void* userdata, const char* op_name);
+
 /** Custom multiple point function. \n
  * Source values are copies, so they can be changed inside the function without affecting the original image. \n
  * Data will be set only if the returned value is non zero.
@@ -195,6 +219,8 @@ enum imBinaryOp {
  * If source is complex, target complex must be the same data type (imcfloat-imcfloat or imcdouble-imcdouble only). \n
  * If target is integer then it must have equal or more precision than the source. \n
  * If target is byte, then the result is cropped to 0-255.
+ * If source and target are ushort, then the result is cropped to 0-65535. \n
+ * Byte->byte and ushort->ushort add, sub, diff, min and max use saturating SIMD instructions when available. \n
  * Alpha channel is not included.
  *
  * \verbatim im.ProcessArithmeticOp(src_image1: imImage, src_image2: imImage, dst_image: imImage, op: number) [in Lua 5] \endverbatim
@@ -212,6 +238,7 @@ void imProcessArithmeticOp(const imImage* src_image1, const imImage* src_image2,
  * The constant value is type casted to an appropriate type before the operation. \n
  * If source is complex, target complex must be the same data type (imcfloat-imcfloat or imcdouble-imcdouble only). \n
  * If target is byte, then the result is cropped to 0-255.
+ * If source and target are ushort, then the result is cropped to 0-65535.
  *
  * \verbatim im.ProcessArithmeticConstOp(src_image: imImage, src_const: number, dst_image: imImage, op: number) [in Lua 5] \endverbatim
  * \verbatim im.ProcessArithmeticConstOpNew(image: imImage, src_const: number, op: number) -> new_image: imImage [in Lua 5] \endverbatim
@@ -220,7 +247,8 @@ void imProcessArithmeticConstOp(const imImage* src_image, double src_const, imIm
 
 /** Blend two images using an alpha value = [a * alpha + b * (1 - alpha)]. \n
  * Can be done in-place, images must match. \n
- * alpha value must be in the interval [0.0 - 1.0].
+ * alpha value must be in the interval [0.0 - 1.0]. \n
+ * For byte and ushort images alpha is converted to a fixed point weight and the result is rounded.
  *
  * \verbatim im.ProcessBlendConst(src_image1: imImage, src_image2: imImage, dst_image: imImage, alpha: number) [in Lua 5] \endverbatim
  * \verbatim im.ProcessBlendConstNew(image1: imImage, image2: imImage, alpha: number) -> new_image: imImage [in Lua 5] \endverbatim
@@ -231,7 +259,8 @@ void imProcessBlendConst(const imImage* src_image1, const imImage* src_image2, i
  * Can be done in-place, images must match. \n
  * alpha_image must have the same data type except for complex images that must be real, 
  * and color_space must be IM_GRAY.
- * Maximum alpha values are based in \ref imColorMax. Minimum is always 0.
+ * Maximum alpha values are based in \ref imColorMax. Minimum is always 0. \n
+ * For byte and ushort images the result is rounded.
  * \verbatim im.ProcessBlend(src_image1: imImage, src_image2: imImage, alpha_image: imImage, dst_image: imImage) [in Lua 5] \endverbatim
  * \verbatim im.ProcessBlendNew(image1: imImage, image2: imImage, alpha_image: imImage) -> new_image: imImage [in Lua 5] \endverbatim
  * \ingroup arithm */
@@ -281,7 +310,8 @@ void imProcessMultipleStdDev(const imImage** src_image_list, int src_image_count
 
 /** Calculates the median of multiple images. \n
  * Images must match size and type. Complex is not supported.\n
- * Uses \ref imProcessMultiPointOp internally.
+ * Uses \ref imProcessStackMedian internally. Returns zero if the counter aborted, if there is not enough memory 
+ * or if an image does not match the first one.
  *
  * \verbatim im.ProcessMultipleMedian(src_image_list: table of imImage, dst_image: imImage) -> counter: boolean [in Lua 5] \endverbatim
  * \verbatim im.ProcessMultipleMedianNew(src_image_list: table of imImage) -> counter: boolean, new_image: imImage [in Lua 5] \endverbatim
@@ -289,8 +319,13 @@ void imProcessMultipleStdDev(const imImage** src_image_list, int src_image_count
 int imProcessMultipleMedian(const imImage** src_image_list, int src_image_count, imImage* dst_image);
 
 /** Calculates the auto-covariance of an image with the mean of a set of images. \n
- * Images must match. Returns zero if the counter aborted. \n
+ * Source and mean images must match. Returns zero if the counter aborted. \n
  * Target is IM_FLOAT, except if source is IM_DOUBLE.
+ * The lag (0,0) is at the origin of the target, only positive lags are computed. \n
+ * Target can be smaller than the source, then only the lags up to the target size are computed. 
+ * Returns zero if the target is larger than the source. \n
+ * Large images use zero padded FFTs (Wiener-Khinchin theorem), 
+ * small images or small lag windows use the direct sum. The FFT does not depend on the im_fftw library.
  * Returns zero if the counter aborted.
  *
  * \verbatim im.ProcessAutoCovariance(src_image: imImage, mean_image: imImage, dst_image: imImage) -> counter: boolean [in Lua 5] \endverbatim
@@ -298,6 +333,22 @@ int imProcessMultipleMedian(const imImage** src_image_list, int src_image_count,
  * \ingroup arithm */
 int imProcessAutoCovariance(const imImage* src_image, const imImage* mean_image, imImage* dst_image);
 
+/** Calculates the normalized cross correlation of an image with a template (template matching). \n
+ * The template must be smaller than the image, must have the same number of planes, 
+ * and can have any data type except complex. Source can be any data type except complex. \n
+ * Target has the same size of the source and it is IM_FLOAT, except if source is IM_DOUBLE. 
+ * Each target pixel is the correlation coefficient [-1,1] of the template centered at the pixel 
+ * with the image under it. Pixels where the template does not fit inside the image, 
+ * or where the image is constant under the template, are set to zero. \n
+ * Large templates use zero padded FFTs, small templates use the direct sum. 
+ * Window variances use integral images. The FFT does not depend on the im_fftw library.
+ * Returns zero if the counter aborted.
+ *
+ * \verbatim im.ProcessNormalizedCrossCorrelation(src_image: imImage, templ_image: imImage, dst_image: imImage) -> counter: boolean [in Lua 5] \endverbatim
+ * \verbatim im.ProcessNormalizedCrossCorrelationNew(src_image: imImage, templ_image: imImage) -> counter: boolean, new_image: imImage [in Lua 5] \endverbatim
+ * \ingroup arithm */
+int imProcessNormalizedCrossCorrelation(const imImage* src_image, const imImage* templ_image, imImage* dst_image);
+
 /** Multiplies the conjugate of one complex image with another complex image. \n
  * Images must match size. Conj(img1) * img2 \n
  * Can be done in-place.
@@ -309,7 +360,8 @@ void imProcessMultiplyConj(const imImage* src_image1, const imImage* src_image2,
 
 /** Subtracts a background image using a tolerance. \n
  * If different is less than the tolerance background is detected and assigned to 0.\
- * Else keeps the original image or show the difference. 
+ * Else keeps the original image or show the difference. \n
+ * Byte and ushort images use SIMD instructions when available.
  *
  * \verbatim im.ProcessBackSub(src_image1: imImage, src_image2: imImage, dst_image: imImage, tol: number, show_diff: boolean) [in Lua 5] \endverbatim
  * \verbatim im.ProcessBackSubNew(src_image1: imImage, src_image2: imImage, tol: number, show_diff: boolean) -> new_image: imImage [in Lua 5] \endverbatim
@@ -325,12 +377,17 @@ void imProcessBackSub(const imImage* src_image1, imImage* src_image2, imImage* d
  * \ingroup process */
 
 /** Converts a RGB image to a MAP image using uniform quantization. \n
- * with an optional 8x8 ordered dither. The RGB image must have data type IM_BYTE.
- *
- * \verbatim im.ProcessQuantizeRGBUniform(src_image: imImage, dst_image: imImage, do_dither: boolean) [in Lua 5] \endverbatim
- * \verbatim im.ProcessQuantizeRGBUniformNew(src_image: imImage, do_dither: boolean) -> new_image: imImage [in Lua 5] \endverbatim
+ * with an optional dither. The RGB image must have data type IM_BYTE. \n
+ * dither is a \ref imPaletteDither value: 
+ * 0 (IM_PALETTE_DITHER_NONE) or 1 (IM_PALETTE_DITHER_ORDERED, 8x8 ordered dither) as before, 
+ * IM_PALETTE_DITHER_DIFFUSION for Floyd-Steinberg error diffusion (raster scan, wavefront parallel when OpenMP is enabled) 
+ * and IM_PALETTE_DITHER_BLUENOISE for a 64x64 blue noise ordered dither. 
+ * If the last two fail to allocate memory the 8x8 ordered dither is used.
+ *
+ * \verbatim im.ProcessQuantizeRGBUniform(src_image: imImage, dst_image: imImage, dither: boolean or number) [in Lua 5] \endverbatim
+ * \verbatim im.ProcessQuantizeRGBUniformNew(src_image: imImage, dither: boolean or number) -> new_image: imImage [in Lua 5] \endverbatim
  * \ingroup quantize */
-void imProcessQuantizeRGBUniform(const imImage* src_image, imImage* dst_image, int do_dither);
+void imProcessQuantizeRGBUniform(const imImage* src_image, imImage* dst_image, int dither);
 
 /** Converts a RGB image to a MAP image using median cut quantization. \n
 * The RGB image must have data type IM_BYTE.
@@ -340,6 +397,16 @@ void imProcessQuantizeRGBUniform(const imImage* src_image, imImage* dst_image, i
 * \ingroup quantize */
 void imProcessQuantizeRGBMedianCut(const imImage* image, imImage* NewImage);
 
+/** Converts a RGB image to a MAP image using the palette already set in the destination image. \n
+ * The RGB image must have data type IM_BYTE. Each pixel is mapped to the nearest palette color 
+ * using \ref imPaletteIndexMap, dither is a \ref imPaletteDither value. \n
+ * Bands of lines are mapped in parallel when OpenMP is enabled, except for IM_PALETTE_DITHER_DIFFUSION. \n
+ * Returns zero if failed to allocate memory or if the counter aborted.
+ *
+ * \verbatim im.ProcessQuantizeRGBPalette(src_image: imImage, dst_image: imImage, dither: boolean or number) -> counter: boolean [in Lua 5] \endverbatim
+ * \ingroup quantize */
+int imProcessQuantizeRGBPalette(const imImage* src_image, imImage* dst_image, int dither);
+
 /** Quantizes a gray scale image in less that 256 grays using uniform quantization. \n
  * Both images should be IM_BYTE/IM_GRAY, the target can be IM_MAP. Can be done in-place. \n
  * The result is in the 0-255 range, except when target is IM_MAP that is in the 0-(grays-1) range.
@@ -415,6 +482,19 @@ void imProcessSplitYChroma(const imImage* src_image, imImage* y_image, imImage*
  * \ingroup colorproc */
 void imProcessSplitHSI(const imImage* src_image, imImage* h_image, imImage* s_image, imImage* i_image);
 
+/** Same as \ref imProcessSplitHSI, but computed in single precision. \n
+ * Uses the same HSI definition, but atan2, sin and cos are replaced by polynomials 
+ * and the saturation scale is computed without trigonometric functions. 
+ * Compared to the exact conversion the hue error is less than 0.001 degrees, 
+ * and the saturation and intensity errors are less than 1e-5. 
+ * Results near the limits of a hue interval or of a byte quantization step may differ. 
+ * The same approximation is used by all the HSI "Fast" functions.
+ *
+ * \verbatim im.ProcessSplitHSIFast(src_image: imImage, h_image: imImage, s_image: imImage, i_image: imImage) [in Lua 5] \endverbatim
+ * \verbatim im.ProcessSplitHSIFastNew(src_image: imImage) -> h_image: imImage, s_image: imImage, i_image: imImage [in Lua 5] \endverbatim
+ * \ingroup colorproc */
+void imProcessSplitHSIFast(const imImage* src_image, imImage* h_image, imImage* s_image, imImage* i_image);
+
 /** Merge HSI planes into a RGB image. \n
  * Source images must be IM_GRAY+IM_FLOAT/IM_DOUBLE. Target image can be IM_RGB+IM_BYTE or IM_RGB+IM_FLOAT/IM_DOUBLE only. \n
  * Source and target must have the same size. See \ref hsi for a definition of the color conversion.
@@ -424,6 +504,13 @@ void imProcessSplitHSI(const imImage* src_image, imImage* h_image, imImage* s_im
  * \ingroup colorproc */
 void imProcessMergeHSI(const imImage* h_image, const imImage* s_image, const imImage* i_image, imImage* dst_image);
 
+/** Same as \ref imProcessMergeHSI, but computed in single precision, see \ref imProcessSplitHSIFast.
+ *
+ * \verbatim im.ProcessMergeHSIFast(h_image: imImage, s_image: imImage, i_image: imImage, dst_image: imImage) [in Lua 5] \endverbatim
+ * \verbatim im.ProcessMergeHSIFastNew(h_image: imImage, s_image: imImage, i_image: imImage) -> dst_image: imImage [in Lua 5] \endverbatim
+ * \ingroup colorproc */
+void imProcessMergeHSIFast(const imImage* h_image, const imImage* s_image, const imImage* i_image, imImage* dst_image);
+
 /** Split a multicomponent image into separate components, including alpha.\n
  * Target images must be IM_GRAY. Size and data types must be all the same.\n
  * The number of target images must match the depth of the source image, including alpha.
@@ -499,6 +586,14 @@ void imProcessFixBGR(const imImage* src_image, imImage* dst_image);
 * \ingroup colorproc */
 void imProcessSelectHue(const imImage* src_image, imImage* dst_image, double hue_start, double hue_end);
 
+/** Same as \ref imProcessSelectHue, but the hue is computed in single precision, see \ref imProcessSplitHSIFast. \n
+* Uses SSE2 for IM_BYTE and IM_FLOAT images when available.
+*
+* \verbatim im.ProcessSelectHueFast(src_image: imImage, dst_image: imImage, hue_start, hue_end: number) [in Lua 5] \endverbatim
+* \verbatim im.ProcessSelectHueFastNew(src_image: imImage, hue_start, hue_end: number) -> new_image: imImage [in Lua 5] \endverbatim
+* \ingroup colorproc */
+void imProcessSelectHueFast(const imImage* src_image, imImage* dst_image, double hue_start, double hue_end);
+
 
 /** \defgroup logic Logical Arithmetic Operations 
  * \par
@@ -586,6 +681,19 @@ int imProcessRenderOp(imImage* image, imRenderFunc func, const char* render_name
  * \ingroup render */
 int imProcessRenderCondOp(imImage* image, imRenderCondFunc func, const char* render_name, double* params);
 
+/** Sets the seed used by the noise render functions. \n
+ * The noise is generated by a counter based generator, 
+ * the value of each pixel depends only on the seed, on the pixel position 
+ * and on how many noise renders were called since the seed was set.
+ * So the result is the same for any number of threads. \n
+ * If not set, the seed is initialized from the current time at the first noise render. \n
+ * The call counter is updated atomically, so noise renders can run in several threads at the same time. 
+ * A render that runs while the seed is changed can use either the old or the new seed.
+ *
+ * \verbatim im.ProcessRenderRandomSeed(seed: number) [in Lua 5] \endverbatim
+ * \ingroup render */
+void imProcessRenderRandomSeed(unsigned int seed);
+
 /** Render speckle noise on existing data. Can be done in-place.
  *
  * \verbatim im.ProcessRenderAddSpeckleNoise(src_image: imImage, dst_image: imImage, percent: number) -> counter: boolean [in Lua 5] \endverbatim
@@ -687,12 +795,41 @@ int imProcessRenderChessboard(imImage* image, int x_space, int y_space);
 
 /** Render a color or gray flood fill. \n
  * If image has the IM_RGB color space, then replace_color must have 3 components. \n
- * If image has the IM_GRAY color space, then replace_color must have 1 component.
+ * If image has the IM_GRAY color space, then replace_color must have 1 component. \n
+ * Fills the 4 neighbors connected pixels that are different from replace_color and whose distance to the start pixel 
+ * is less than tolerance (euclidean distance for RGB images). The start pixel is always filled. \n
+ * Uses a scanline algorithm, see \ref imProcessRenderFloodFillSeeds.
  *
  * \verbatim im.ProcessRenderFloodFill(image: imImage, start_x, start_y: number, replace_color: table of 3 numbers, tolerance: number)  [in Lua 5] \endverbatim
  * \ingroup render */
 void imProcessRenderFloodFill(imImage* image, int start_x, int start_y, double* replace_color, double tolerance);
 
+/** Flood fill result, see \ref imProcessRenderFloodFillSeeds.
+ * \ingroup render */
+typedef struct _imFloodFillResult 
+{
+  int area;        /**< number of filled pixels, 0 if the seed was skipped */
+  int xmin, ymin;  /**< bounding box of the filled pixels, all 0 if the seed was skipped */
+  int xmax, ymax;
+} imFloodFillResult;
+
+/** Render a flood fill for each seed, in order, with the same replace color. \n
+ * The same as calling \ref imProcessRenderFloodFill for each seed, 
+ * but also returns the filled area and bounding box of each seed in results (can be NULL, or must have seed_count elements). 
+ * Seeds outside the image or already with the replace color (for instance filled by a previous seed) are skipped. \n
+ * For RGB images tol_space can be IM_RGB, the euclidean distance of the RGB values, 
+ * or IM_LAB, the CIE76 delta E of the CIE L*a*b* values (L* from 0 to 100, a* and b* in the usual CIE scale), only for IM_BYTE and IM_USHORT images, 
+ * for the other data types IM_RGB is used. For gray images it is ignored. \n
+ * The fill is a scanline fill: the runs of pixels in each line are filled at once, and the stack stores only 
+ * one seed for each run in the neighbor lines, so large uniform regions need a small stack. 
+ * The stack is allocated once and reused for all the seeds. \n
+ * Returns the total filled area, or -1 if failed to allocate memory.
+ *
+ * \verbatim im.ProcessRenderFloodFillSeeds(image: imImage, seed_x: table of numbers, seed_y: table of numbers, replace_color: table of 3 numbers, tolerance: number, [tol_space: number]) -> area: number, results: table  [in Lua 5] \endverbatim
+ * In Lua each result is a table with the fields area, xmin, ymin, xmax and ymax. tol_space default is im.RGB. When area is -1 results is nil.
+ * \ingroup render */
+int imProcessRenderFloodFillSeeds(imImage* image, int seed_count, const int* seed_x, const int* seed_y, double* replace_color, double tolerance, int tol_space, imFloodFillResult* results);
+
 
 
 
@@ -793,6 +930,13 @@ double imProcessCalcAutoGamma(const imImage* image);
  * \ingroup tonegamut */
 void imProcessShiftHSI(const imImage* src_image, imImage* dst_image, double h_shift, double s_shift, double i_shift);
 
+/** Same as \ref imProcessShiftHSI, but the HSI conversions are computed in single precision, see \ref imProcessSplitHSIFast.
+ *
+ * \verbatim im.ProcessShiftHSIFast(src_image: imImage, dst_image: imImage, h_shift, s_shift, i_shift: number) [in Lua 5] \endverbatim
+ * \verbatim im.ProcessShiftHSIFastNew(src_image: imImage, h_shift, s_shift, i_shift: number) -> new_image: imImage [in Lua 5] \endverbatim
+ * \ingroup tonegamut */
+void imProcessShiftHSIFast(const imImage* src_image, imImage* dst_image, double h_shift, double s_shift, double i_shift);
+
 /** Apply a shift to the components in normalized space 0-1. \n
 * Supports all data types except complex. \n
 * shift is between -1.0 and 1.0 \n
@@ -882,6 +1026,24 @@ int imProcessUniformErrThreshold(const imImage* src_image, imImage* dst_image);
  * \ingroup threshold */
 void imProcessDiffusionErrThreshold(const imImage* src_image, imImage* dst_image, int level);
 
+/** Apply a dithering on each image channel using the given \ref imPaletteDither method. \n
+ * It can be applied on any IM_BYTE images. It will "threshold" each channel individually, so
+ * source and target must be of the same depth. The target values are 0 and 1 when depth is 1, or 0 and 255 otherwise. \n
+ * IM_PALETTE_DITHER_DIFFUSION uses a Floyd-Steinberg error diffusion with a raster scan, 
+ * pixels are set when they are greater than level (128 for an unbiased result). 
+ * When OpenMP is enabled lines are processed in parallel as a wavefront, 
+ * each line starts when the previous line is a few pixels ahead, with the same result of the sequential scan. \n
+ * IM_PALETTE_DITHER_ORDERED (8x8 Bayer) and IM_PALETTE_DITHER_BLUENOISE (64x64 blue noise) 
+ * use the matrix from \ref imPaletteDitherMatrix, with thresholds shifted by level-128 and clamped to 0-255. 
+ * They are processed independently for each pixel. \n
+ * IM_PALETTE_DITHER_NONE is a simple threshold at level. \n
+ * Returns zero if the counter aborted or if failed to allocate memory.
+ *
+ * \verbatim im.ProcessDitherThreshold(src_image: imImage, dst_image: imImage, level: number, dither: number) -> counter: boolean [in Lua 5] \endverbatim
+ * \verbatim im.ProcessDitherThresholdNew(src_image: imImage, level: number, dither: number) -> counter: boolean, new_image: imImage [in Lua 5] \endverbatim
+ * \ingroup threshold */
+int imProcessDitherThreshold(const imImage* src_image, imImage* dst_image, int level, int dither);
+
 /** Calculates the threshold level for manual threshold using a percentage of pixels
  * that should stay bellow the threshold. \n
  * Image data type can be IM_BYTE, IM_SHORT or IM_USHORT. \n
@@ -1014,6 +1176,158 @@ void imProcessNormDiffRatio(const imImage* image1, const imImage* image2, imImag
 void imProcessAbnormalHyperionCorrection(const imImage* src_image, imImage* dst_image, int threshold_consecutive, int threshold_percent, imImage* image_abnormal);
 
 
+/** \defgroup pipeline Point Operations Pipeline
+ * \par
+ * Records a chain of point operations and executes them in a single pass over the image, 
+ * without intermediate images. The image is processed in small blocks, 
+ * each block goes through all the operations while it is in the cache. Uses OpenMP when enabled.
+ * \par
+ * Values are computed in double precision. There are no intermediate conversions, 
+ * so results can be slightly different from the same sequence of individual functions. 
+ * Use \ref imProcessPipelineConvertDataType to round and crop values between operations. 
+ * The final result is converted to the destination data type, rounded and cropped for integer types.
+ * \par
+ * Images are referenced until the pipeline is executed, they are not copied. 
+ * complex is not supported. If an operation can not be added (invalid images or parameters) 
+ * \ref imProcessPipelineExecute will fail.
+ * \par
+ * See \ref im_process_pnt.h
+ * \ingroup process */
+
+/** \brief Pipeline Structure (Private).
+ * \ingroup pipeline */
+typedef struct _imProcessPipeline imProcessPipeline;
+
+/** Creates a pipeline for the given source image.
+ * \ingroup pipeline */
+imProcessPipeline* imProcessPipelineCreate(const imImage* src_image);
+
+/** Destroys the pipeline. Images are not destroyed.
+ * \ingroup pipeline */
+void imProcessPipelineDestroy(imProcessPipeline* pipeline);
+
+/** Adds a binary arithmetic operation with another image, see \ref imProcessArithmeticOp. \n
+ * The image must have the same size, depth and alpha of the source image, but can have a different data type.
+ * \ingroup pipeline */
+void imProcessPipelineArithmeticOp(imProcessPipeline* pipeline, const imImage* src_image2, int op);
+
+/** Adds a binary arithmetic operation with a constant, see \ref imProcessArithmeticConstOp.
+ * \ingroup pipeline */
+void imProcessPipelineArithmeticConstOp(imProcessPipeline* pipeline, double src_const, int op);
+
+/** Adds a unary arithmetic operation, see \ref imProcessUnArithmeticOp. IM_UN_CONJ and IM_UN_CPXNORM are not supported.
+ * \ingroup pipeline */
+void imProcessPipelineUnArithmeticOp(imProcessPipeline* pipeline, int op);
+
+/** Adds a tone gamut operation, see \ref imProcessToneGamut. \n
+ * If IM_GAMUT_MINMAX is not used, min and max are computed from the pipeline source image (when executed), 
+ * so it must be the first operation of the pipeline, if not \ref imProcessPipelineExecute will fail. 
+ * After other operations use IM_GAMUT_MINMAX with the min and max of the values at that point.
+ * \ingroup pipeline */
+void imProcessPipelineToneGamut(imProcessPipeline* pipeline, int op, double* params);
+
+/** Adds a manual threshold, see \ref imProcessThreshold. \n
+ * threshold = a <= level ? 0: value
+ * \ingroup pipeline */
+void imProcessPipelineThreshold(imProcessPipeline* pipeline, double level, int value);
+
+/** Adds a bitwise operation with another image, see \ref imProcessBitwiseOp. \n
+ * Values and the other image must be integer at this point, 
+ * operations are done in the source data type or in the last data type used in \ref imProcessPipelineConvertDataType.
+ * \ingroup pipeline */
+void imProcessPipelineBitwiseOp(imProcessPipeline* pipeline, const imImage* src_image2, int op);
+
+/** Adds a bitwise not, see \ref imProcessBitwiseNot. Same restrictions of \ref imProcessPipelineBitwiseOp.
+ * \ingroup pipeline */
+void imProcessPipelineBitwiseNot(imProcessPipeline* pipeline);
+
+/** Adds a conversion of the values to the given data type. 
+ * For integer types values are rounded and cropped to the data type limits.
+ * \ingroup pipeline */
+void imProcessPipelineConvertDataType(imProcessPipeline* pipeline, int data_type);
+
+/** Executes all the operations storing the result in the destination image. \n
+ * Destination must have the same size and depth of the source image, but can have any data type except complex.
+ * Can be done in-place. The pipeline can be executed several times. \n
+ * Returns zero if the counter aborted or if the pipeline is invalid.
+ * \ingroup pipeline */
+int imProcessPipelineExecute(imProcessPipeline* pipeline, imImage* dst_image);
+
+
+/** \defgroup stack Image Stack Statistics
+ * \par
+ * Computes pixel statistics of a sequence of frames with the same size, depth and data type, 
+ * like the multiple image functions (\ref imProcessMultipleMean, \ref imProcessMultipleMedian, etc), 
+ * but the frames are added one at a time, so they can be released after added.
+ * \par
+ * Mean and standard deviation are updated when each frame is added (Welford's method), 
+ * so they do not need to keep the frames. 
+ * Median, percentiles and sigma clipped mean need all the samples, they are copied when max_frames is not zero. 
+ * Samples are stored in blocks of 64 pixels with all the frames of the block together, 
+ * so the results are computed while the block is in the cache. \n
+ * Median and percentiles of IM_BYTE and IM_USHORT use a radix selection, that is a histogram median 
+ * computed for all the pixels of the block at once, SSE2 accelerated for IM_BYTE. 
+ * Other types use a quick selection.
+ * \par
+ * Complex is not supported. Results can be stored in images of any data type except complex, 
+ * values are rounded and cropped for integer types. Uses OpenMP when enabled.
+ * \par
+ * See \ref im_process_pnt.h
+ * \ingroup process */
+
+/** \brief Image Stack Structure (Private).
+ * \ingroup stack */
+typedef struct _imProcessStack imProcessStack;
+
+/** Creates a stack for frames of the given size, color space and data type. \n
+ * max_frames is the maximum number of frames that will be added, 
+ * if zero the samples are not kept and only mean and standard deviation are available. \n
+ * Returns NULL if there is not enough memory or if the data type is complex.
+ * \ingroup stack */
+imProcessStack* imProcessStackCreate(int width, int height, int color_space, int data_type, int max_frames);
+
+/** Destroys the stack.
+ * \ingroup stack */
+void imProcessStackDestroy(imProcessStack* stack);
+
+/** Adds a frame to the stack. The image is not referenced after the call. \n
+ * Returns zero if the image does not match the stack or if max_frames was already added.
+ * \ingroup stack */
+int imProcessStackAdd(imProcessStack* stack, const imImage* image);
+
+/** Returns the number of frames added.
+ * \ingroup stack */
+int imProcessStackFrameCount(const imProcessStack* stack);
+
+/** Computes the mean of the frames. \n
+ * Returns zero if there are no frames or if the image does not match the stack.
+ * \ingroup stack */
+int imProcessStackMean(const imProcessStack* stack, imImage* dst_image);
+
+/** Computes the standard deviation of the frames, sqrt(sum(sqr(x - mean)) / N). \n
+ * Returns zero if there are no frames or if the image does not match the stack.
+ * \ingroup stack */
+int imProcessStackStdDev(const imProcessStack* stack, imImage* dst_image);
+
+/** Computes the median of the frames. For an even number of frames returns the upper median, 
+ * the same as \ref imProcessMultipleMedian. \n
+ * Returns zero if the counter aborted, if there are no samples or if the image does not match the stack.
+ * \ingroup stack */
+int imProcessStackMedian(const imProcessStack* stack, imImage* dst_image);
+
+/** Computes a percentile [0-100] of the frames, using the nearest rank round(percent/100 * (N-1)). \n
+ * Returns zero if the counter aborted, if there are no samples or if the image does not match the stack.
+ * \ingroup stack */
+int imProcessStackPercentile(const imProcessStack* stack, imImage* dst_image, double percent);
+
+/** Computes the sigma clipped mean of the frames. For each pixel, samples farther than kappa 
+ * standard deviations from the mean are rejected and the mean is computed again, 
+ * until no sample is rejected or for the given number of iterations. Useful to remove hot pixels and transients. \n
+ * Returns zero if the counter aborted, if there are no samples or if the image does not match the stack.
+ * \ingroup stack */
+int imProcessStackSigmaClippedMean(const imProcessStack* stack, imImage* dst_image, double kappa, int iterations);
+
+
 /** \defgroup procconvert Image Conversion
  * \par
  * Same as imConvert functions but using OpenMP when enabled.
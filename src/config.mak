@@ -82,7 +82,7 @@ SRC = \
     im_colorutil.cpp      im_format_ico.cpp   im_palette.cpp       im_format_ras.cpp    \
     im_convertbitmap.cpp  im_format_led.cpp   im_counter.cpp       im_str.cpp           \
     im_convertcolor.cpp   im_fileraw.cpp      im_format_krn.cpp    im_compress.cpp      \
-    im_file.cpp           im_old.cpp          im_format_pfm.cpp                         \
+    im_file.cpp           im_old.cpp          im_format_pfm.cpp    im_imagepool.cpp     \
     $(SRCJPEG) $(SRCTIFF) $(SRCPNG) $(SRCLZF)
     
 ifneq ($(findstring Win, $(TEC_SYSNAME)), )
@@ -25,6 +25,10 @@
 #include <assert.h>
 #include <memory.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IM_USE_SSE2
+#endif
 
 #ifndef IM_PROCESS
 #define IM_INT_PROCESSING     int processing = IM_ERR_NONE;
@@ -294,96 +298,165 @@ IM_STATIC int iPromoteIntToInt(int count, int width, const SRCT *src_map, DSTT *
   return processing;
 }
 
-template <class SRCT, class DSTT> 
-IM_STATIC int iDemoteIntToInt(int count, int width, const SRCT *src_map, DSTT *dst_map, int absolute, int cast_mode, int counter, imAttribTable* attrib_table)
+template <class T> 
+IM_STATIC void iMinMaxType(const T *map, int count, T& min, T& max, int absolute)
 {
-  // big integer to small integer, need to scale down
-  SRCT min, max;
-  DSTT dst_type_min, dst_type_max;
-
-  if (cast_mode == IM_CAST_MINMAX)  // search for min-max
-    imMinMaxType(src_map, count, min, max, absolute);
-  else  
+#ifdef _OPENMP
+  int chunk_count = IM_MAX_THREADS;
+  if (sizeof(T) != sizeof(imbyte) && chunk_count > 1 && IM_OMP_MINCOUNT(count))
   {
-    // IM_CAST_FIXED - use data type limits for min-max
-    iDataTypeIntMinMax(min, max, absolute);
-
-    if (cast_mode == IM_CAST_USER)  // get min,max from atributes
+    // each thread scans a contiguous part of the data
+    T* chunk_min = (T*)malloc(2 * chunk_count * sizeof(T));
+    if (chunk_min)
     {
-      double* amin = (double*)attrib_table->Get("UserMin");
-      if (amin) min = (SRCT)(*amin);
-      double* amax = (double*)attrib_table->Get("UserMax");
-      if (amax) max = (SRCT)(*amax);
+      T* chunk_max = chunk_min + chunk_count;
+      int chunk_size = (count + chunk_count - 1) / chunk_count;
+
+#pragma omp parallel for num_threads(chunk_count)
+      for (int c = 0; c < chunk_count; c++)
+      {
+        int start = c * chunk_size;
+        int size = (start + chunk_size < count)? chunk_size: count - start;
+        if (size > 0)
+          imMinMax(map + start, size, chunk_min[c], chunk_max[c], absolute);
+        else
+          chunk_min[c] = chunk_max[c] = chunk_min[0];  // not used
+      }
+
+      min = chunk_min[0];
+      max = chunk_max[0];
+      for (int c = 1; c < chunk_count && c * chunk_size < count; c++)
+      {
+        if (chunk_min[c] < min) min = chunk_min[c];
+        if (chunk_max[c] > max) max = chunk_max[c];
+      }
+
+      free(chunk_min);
+
+      // same as imMinMaxType
+      if (min == max)
+      {
+        max = min + 1;
+
+        if (min != 0)
+          min = min - 1;
+      }
+      return;
     }
   }
+#endif
 
-  iDataTypeIntMinMax(dst_type_min, dst_type_max, absolute);
+  imMinMaxType(map, count, min, max, absolute);
+}
 
-  int direct = 0; // must scale SRC to fit DST
-  if (min >= dst_type_min && max <= dst_type_max)
-    direct = 1; // no need for conversion
+/* The scaled conversions below are done by a conversion functor, func(src_value) returns the dst_value.
+   For integer sources of up to 16 bits (imbyte, short and imushort) the functor is evaluated 
+   for all the possible values in a lookup table, when the image has more pixels than the table, 
+   then the table is applied. So gamma, absolute and scaling are computed once per value. */
 
-  double factor = ((double)dst_type_max - (double)dst_type_min + 1.0f) / ((double)max - (double)min + 1.0);
+template <class SRCT, class DSTT, class F>
+inline void iConvertLine(const SRCT* src_line, DSTT* dst_line, int width, const F& func)
+{
+  for (int x = 0; x < width; x++)
+    dst_line[x] = func(src_line[x]);
+}
+
+template <class SRCT, class DSTT, class F>
+IM_STATIC int iConvertFunc(int count, int width, const SRCT *src_map, DSTT *dst_map, const F& func, int counter)
+{
+  DSTT* lut = NULL;
+  int lut_offset = 0;
+
+  if (sizeof(SRCT) <= 2)
+  {
+    int lut_size = 1 << (8 * sizeof(SRCT));
+    if (count > lut_size)
+      lut = (DSTT*)malloc(lut_size * sizeof(DSTT));
+
+    if (lut)
+    {
+      if (iIsNegativeType(*src_map))
+        lut_offset = lut_size / 2;
+
+      for (int v = 0; v < lut_size; v++)
+        lut[v] = func((SRCT)(v - lut_offset));
+    }
+  }
+
+  int line_count = count / width;
 
   IM_INT_PROCESSING;
 
 #ifdef _OPENMP
 #pragma omp parallel for if (IM_OMP_MINCOUNT(count))
 #endif
-  for (int i = 0; i < count; i++)
+  for (int y = 0; y < line_count; y++)
   {
-    if (i % width == 0)
-    {
 #ifdef _OPENMP
 #pragma omp flush (processing)
 #endif
-    }
     IM_BEGIN_PROCESSING;
 
-    SRCT value;
-    if (absolute)
-      value = imAbs(src_map[i]);
-    else
-      value = src_map[i];
+    const SRCT* src_line = src_map + (size_t)y * width;
+    DSTT* dst_line = dst_map + (size_t)y * width;
 
-    if (value >= max)
-      dst_map[i] = dst_type_max;
-    else if (value <= min)
-      dst_map[i] = dst_type_min;
-    else
+    if (lut)
     {
-      if (direct)
-        dst_map[i] = (DSTT)value;
-      else
-        dst_map[i] = (DSTT)imResampleInt(value - min, factor) + dst_type_min;
+      for (int x = 0; x < width; x++)
+        dst_line[x] = lut[(int)src_line[x] + lut_offset];
     }
+    else
+      iConvertLine(src_line, dst_line, width, func);
 
-    if (i % width == 0)
-    {
-      IM_COUNT_PROCESSING;
+    IM_COUNT_PROCESSING;
 #ifdef _OPENMP
 #pragma omp flush (processing)
 #endif
-    }
     IM_END_PROCESSING;
   }
 
+  if (lut)
+    free(lut);
+
   return processing;
 }
 
+template <class SRCT, class DSTT>
+struct iDemoteIntToIntFunc
+{
+  SRCT min, max;
+  DSTT dst_type_min, dst_type_max;
+  int absolute, direct;
+  double factor;
 
-/**********************************************************************/
+  inline DSTT operator()(SRCT value) const
+  {
+    if (absolute)
+      value = imAbs(value);
 
+    if (value >= max)
+      return dst_type_max;
+    else if (value <= min)
+      return dst_type_min;
+    else
+    {
+      if (direct)
+        return (DSTT)value;
+      else
+        return (DSTT)imResampleInt(value - min, factor) + dst_type_min;
+    }
+  }
+};
 
-template <class SRCT, class DSTT>
-IM_STATIC int iPromoteIntToReal(int count, int width, const SRCT *src_map, DSTT *dst_map, double gamma, int absolute, int cast_mode, int counter, imAttribTable* attrib_table)
+template <class SRCT, class DSTT> 
+IM_STATIC int iDemoteIntToInt(int count, int width, const SRCT *src_map, DSTT *dst_map, int absolute, int cast_mode, int counter, imAttribTable* attrib_table)
 {
-  // integer to real, always have to scale to 0:1 or -0.5:+0.5
+  // big integer to small integer, need to scale down
+  iDemoteIntToIntFunc<SRCT, DSTT> func;
   SRCT min, max;
-  DSTT dst_type_min, dst_type_max;
 
-  if (cast_mode == IM_CAST_MINMAX)   // search for min-max
-    imMinMaxType(src_map, count, min, max, absolute);
+  if (cast_mode == IM_CAST_MINMAX)  // search for min-max
+    iMinMaxType(src_map, count, min, max, absolute);
   else  
   {
     // IM_CAST_FIXED - use data type limits for min-max
@@ -398,142 +471,309 @@ IM_STATIC int iPromoteIntToReal(int count, int width, const SRCT *src_map, DSTT
     }
   }
 
-  iDataTypeRealMinMax(dst_type_min, dst_type_max, absolute, *src_map);
+  iDataTypeIntMinMax(func.dst_type_min, func.dst_type_max, absolute);
 
-  DSTT dst_type_range = 1.0f;
-  DSTT range = DSTT(max - min + 1);
+  func.direct = 0; // must scale SRC to fit DST
+  if (min >= func.dst_type_min && max <= func.dst_type_max)
+    func.direct = 1; // no need for conversion
 
-  gamma = -gamma; // gamma is inverted here, because we are promoting int2real
-  DSTT factor = iGammaFactor(dst_type_range, gamma);
+  func.factor = ((double)func.dst_type_max - (double)func.dst_type_min + 1.0f) / ((double)max - (double)min + 1.0);
+  func.min = min;
+  func.max = max;
+  func.absolute = absolute;
 
-  IM_INT_PROCESSING;
+  return iConvertFunc(count, width, src_map, dst_map, func, counter);
+}
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
-#endif
-  for (int i = 0; i < count; i++)
-  {
-    if (i % width == 0)
-    {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    }
-    IM_BEGIN_PROCESSING;
 
+/**********************************************************************/
+
+
+template <class SRCT, class DSTT>
+struct iPromoteIntToRealFunc
+{
+  SRCT min;
+  DSTT dst_type_min, dst_type_max, range, factor;
+  double gamma;
+  int absolute;
+
+  inline DSTT operator()(SRCT value) const
+  {
     DSTT fvalue;
     if (absolute)
-      fvalue = (imAbs(src_map[i]) - min + DSTT(0.5)) / range;
+      fvalue = (imAbs(value) - min + DSTT(0.5)) / range;
     else
-      fvalue = (src_map[i] - min + DSTT(0.5)) / range;
+      fvalue = (value - min + DSTT(0.5)) / range;
 
     // Now 0 <= fvalue <= 1 (if min-max are correct)
 
     if (fvalue >= 1)
-      dst_map[i] = dst_type_max;
+      return dst_type_max;
     else if (fvalue <= 0)
-      dst_map[i] = dst_type_min;
+      return dst_type_min;
     else
-      dst_map[i] = iGammaFunc(factor, dst_type_min, gamma, fvalue);
-
-    if (i % width == 0)
-    {
-      IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    }
-    IM_END_PROCESSING;
+      return iGammaFunc(factor, dst_type_min, gamma, fvalue);
   }
-
-  return processing;
-}
+};
 
 template <class SRCT, class DSTT>
-IM_STATIC int iDemoteRealToInt(int count, int width, const SRCT *src_map, DSTT *dst_map, double gamma, int absolute, int cast_mode, int counter, imAttribTable* attrib_table)
+IM_STATIC int iPromoteIntToReal(int count, int width, const SRCT *src_map, DSTT *dst_map, double gamma, int absolute, int cast_mode, int counter, imAttribTable* attrib_table)
 {
-  // real to integer, always have to scale from 0:1 or -0.5:+0.5
+  // integer to real, always have to scale to 0:1 or -0.5:+0.5
+  iPromoteIntToRealFunc<SRCT, DSTT> func;
   SRCT min, max;
-  DSTT dst_type_min, dst_type_max;
 
-  if (cast_mode == IM_CAST_MINMAX)  // search for min-max
-    imMinMaxType(src_map, count, min, max, absolute);
+  if (cast_mode == IM_CAST_MINMAX)   // search for min-max
+    iMinMaxType(src_map, count, min, max, absolute);
   else  
   {
     // IM_CAST_FIXED - use data type limits for min-max
-    iDataTypeRealMinMax(min, max, absolute, *dst_map);
+    iDataTypeIntMinMax(min, max, absolute);
 
     if (cast_mode == IM_CAST_USER)  // get min,max from atributes
     {
       double* amin = (double*)attrib_table->Get("UserMin");
-      if (amin) min = (SRCT)*amin;
+      if (amin) min = (SRCT)(*amin);
       double* amax = (double*)attrib_table->Get("UserMax");
-      if (amax) max = (SRCT)*amax;
+      if (amax) max = (SRCT)(*amax);
     }
   }
 
-  iDataTypeIntMinMax(dst_type_min, dst_type_max, absolute);
+  iDataTypeRealMinMax(func.dst_type_min, func.dst_type_max, absolute, *src_map);
 
-  int dst_type_range = dst_type_max - dst_type_min + 1;
-  SRCT range = max - min;
+  DSTT dst_type_range = 1.0f;
+  func.range = DSTT(max - min + 1);
+  func.min = min;
+  func.absolute = absolute;
 
-  SRCT factor = iGammaFactor((SRCT)dst_type_range, gamma);
+  func.gamma = -gamma; // gamma is inverted here, because we are promoting int2real
+  func.factor = iGammaFactor(dst_type_range, func.gamma);
 
-  IM_INT_PROCESSING;
+  return iConvertFunc(count, width, src_map, dst_map, func, counter);
+}
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
-#endif
-  for (int i = 0; i < count; i++)
-  {
-    if (i % width == 0)
-    {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    }
-    IM_BEGIN_PROCESSING;
+template <class SRCT, class DSTT>
+struct iDemoteRealToIntFunc
+{
+  SRCT min, range, factor;
+  DSTT dst_type_min, dst_type_max;
+  double gamma;
+  int absolute;
 
+  inline DSTT operator()(SRCT src) const
+  {
     SRCT value;
     if (absolute)
-      value = ((SRCT)imAbs(src_map[i]) - min) / range;
+      value = ((SRCT)imAbs(src) - min) / range;
     else
-      value = (src_map[i] - min)/range; 
+      value = (src - min)/range; 
 
     // Now 0 <= value <= 1 (if min-max are correct)
 
     if (value >= 1)
-      dst_map[i] = dst_type_max;
+      return dst_type_max;
     else if (value <= 0)
-      dst_map[i] = dst_type_min;
+      return dst_type_min;
     else
     {
       value = iGammaFunc(factor, (SRCT)dst_type_min, gamma, value);
       int ivalue = imRound(value);
       if (ivalue >= dst_type_max)
-        dst_map[i] = dst_type_max;
+        return dst_type_max;
       else if (ivalue <= dst_type_min)
-        dst_map[i] = dst_type_min;
+        return dst_type_min;
       else
-        dst_map[i] = (DSTT)imRound(value - 0.5f);
+        return (DSTT)imRound(value - 0.5f);
     }
+  }
+};
 
-    if (i % width == 0)
+#ifdef IM_USE_SSE2
+/* Same operations of iDemoteRealToIntFunc without gamma, 4 values at a time.
+   imRound is reproduced exactly, adding or subtracting 0.5 depending on the sign and truncating. */
+
+static inline __m128i iRoundPS(__m128 v, __m128 half, __m128 zero)
+{
+  __m128 neg = _mm_cmplt_ps(v, zero);
+  __m128 r = _mm_or_ps(_mm_and_ps(neg, _mm_sub_ps(v, half)), _mm_andnot_ps(neg, _mm_add_ps(v, half)));
+  return _mm_cvttps_epi32(r);
+}
+
+static inline __m128i iRoundPD(__m128d v0, __m128d v1, __m128d half, __m128d zero)
+{
+  __m128d neg0 = _mm_cmplt_pd(v0, zero);
+  __m128d neg1 = _mm_cmplt_pd(v1, zero);
+  __m128d r0 = _mm_or_pd(_mm_and_pd(neg0, _mm_sub_pd(v0, half)), _mm_andnot_pd(neg0, _mm_add_pd(v0, half)));
+  __m128d r1 = _mm_or_pd(_mm_and_pd(neg1, _mm_sub_pd(v1, half)), _mm_andnot_pd(neg1, _mm_add_pd(v1, half)));
+  return _mm_unpacklo_epi64(_mm_cvttpd_epi32(r0), _mm_cvttpd_epi32(r1));
+}
+
+static inline __m128i iSelectEPI32(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/* ivalue and rvalue are imRound(value) and imRound(value - 0.5),
+   ge1 and le0 are the masks of the normalized value before gamma */
+static inline __m128i iDemoteRealToIntSelect(__m128i ivalue, __m128i rvalue, __m128i ge1, __m128i le0, __m128i dst_min, __m128i dst_max)
+{
+  __m128i ge_max = _mm_xor_si128(_mm_cmplt_epi32(ivalue, dst_max), _mm_set1_epi32(-1));
+  __m128i le_min = _mm_xor_si128(_mm_cmpgt_epi32(ivalue, dst_min), _mm_set1_epi32(-1));
+  __m128i result = iSelectEPI32(le_min, dst_min, rvalue);
+  result = iSelectEPI32(ge_max, dst_max, result);
+  result = iSelectEPI32(le0, dst_min, result);
+  return iSelectEPI32(ge1, dst_max, result);
+}
+
+template <class DSTT>
+inline void iStoreEPI32(DSTT* dst, __m128i v)
+{
+  int values[4];
+  _mm_storeu_si128((__m128i*)values, v);
+  dst[0] = (DSTT)values[0];
+  dst[1] = (DSTT)values[1];
+  dst[2] = (DSTT)values[2];
+  dst[3] = (DSTT)values[3];
+}
+
+inline void iStoreEPI32(imbyte* dst, __m128i v)
+{
+  // values are already inside 0-255
+  v = _mm_packs_epi32(v, v);
+  v = _mm_packus_epi16(v, v);
+  int value = _mm_cvtsi128_si32(v);
+  memcpy(dst, &value, 4);
+}
+
+template <class DSTT>
+inline void iConvertLine(const float* src_line, DSTT* dst_line, int width, const iDemoteRealToIntFunc<float, DSTT>& func)
+{
+  int x = 0;
+
+  if (func.gamma == 0)
+  {
+    __m128 min = _mm_set1_ps(func.min);
+    __m128 range = _mm_set1_ps(func.range);
+    __m128 factor = _mm_set1_ps(func.factor);
+    __m128 fdst_min = _mm_set1_ps((float)func.dst_type_min);
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 sign = _mm_set1_ps(-0.0f);
+    __m128i dst_min = _mm_set1_epi32(func.dst_type_min);
+    __m128i dst_max = _mm_set1_epi32(func.dst_type_max);
+
+    for (; x + 4 <= width; x += 4)
     {
-      IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
+      __m128 src = _mm_loadu_ps(src_line + x);
+      if (func.absolute)
+        src = _mm_andnot_ps(sign, src);
+
+      __m128 value = _mm_div_ps(_mm_sub_ps(src, min), range);
+      __m128i ge1 = _mm_castps_si128(_mm_cmpge_ps(value, one));
+      __m128i le0 = _mm_castps_si128(_mm_cmple_ps(value, zero));
+
+      value = _mm_add_ps(_mm_mul_ps(factor, value), fdst_min);
+      __m128i ivalue = iRoundPS(value, half, zero);
+      __m128i rvalue = iRoundPS(_mm_sub_ps(value, half), half, zero);
+
+      iStoreEPI32(dst_line + x, iDemoteRealToIntSelect(ivalue, rvalue, ge1, le0, dst_min, dst_max));
+    }
+  }
+
+  for (; x < width; x++)
+    dst_line[x] = func(src_line[x]);
+}
+
+template <class DSTT>
+inline void iConvertLine(const double* src_line, DSTT* dst_line, int width, const iDemoteRealToIntFunc<double, DSTT>& func)
+{
+  int x = 0;
+
+  if (func.gamma == 0)
+  {
+    __m128d min = _mm_set1_pd(func.min);
+    __m128d range = _mm_set1_pd(func.range);
+    __m128d factor = _mm_set1_pd(func.factor);
+    __m128d fdst_min = _mm_set1_pd((double)func.dst_type_min);
+    __m128d half = _mm_set1_pd(0.5);
+    __m128d one = _mm_set1_pd(1.0);
+    __m128d zero = _mm_setzero_pd();
+    __m128d sign = _mm_set1_pd(-0.0);
+    __m128i dst_min = _mm_set1_epi32(func.dst_type_min);
+    __m128i dst_max = _mm_set1_epi32(func.dst_type_max);
+
+    for (; x + 4 <= width; x += 4)
+    {
+      __m128d src0 = _mm_loadu_pd(src_line + x);
+      __m128d src1 = _mm_loadu_pd(src_line + x + 2);
+      if (func.absolute)
+      {
+        src0 = _mm_andnot_pd(sign, src0);
+        src1 = _mm_andnot_pd(sign, src1);
+      }
+
+      __m128d value0 = _mm_div_pd(_mm_sub_pd(src0, min), range);
+      __m128d value1 = _mm_div_pd(_mm_sub_pd(src1, min), range);
+
+      /* 64 bits masks to 32 bits, all bits are equal */
+      __m128i ge1 = _mm_castps_si128(_mm_shuffle_ps(_mm_castpd_ps(_mm_cmpge_pd(value0, one)), _mm_castpd_ps(_mm_cmpge_pd(value1, one)), _MM_SHUFFLE(2, 0, 2, 0)));
+      __m128i le0 = _mm_castps_si128(_mm_shuffle_ps(_mm_castpd_ps(_mm_cmple_pd(value0, zero)), _mm_castpd_ps(_mm_cmple_pd(value1, zero)), _MM_SHUFFLE(2, 0, 2, 0)));
+
+      value0 = _mm_add_pd(_mm_mul_pd(factor, value0), fdst_min);
+      value1 = _mm_add_pd(_mm_mul_pd(factor, value1), fdst_min);
+      __m128i ivalue = iRoundPD(value0, value1, half, zero);
+      __m128i rvalue = iRoundPD(_mm_sub_pd(value0, half), _mm_sub_pd(value1, half), half, zero);
+
+      iStoreEPI32(dst_line + x, iDemoteRealToIntSelect(ivalue, rvalue, ge1, le0, dst_min, dst_max));
+    }
+  }
+
+  for (; x < width; x++)
+    dst_line[x] = func(src_line[x]);
+}
 #endif
+
+template <class SRCT, class DSTT>
+IM_STATIC int iDemoteRealToInt(int count, int width, const SRCT *src_map, DSTT *dst_map, double gamma, int absolute, int cast_mode, int counter, imAttribTable* attrib_table)
+{
+  // real to integer, always have to scale from 0:1 or -0.5:+0.5
+  iDemoteRealToIntFunc<SRCT, DSTT> func;
+  SRCT min, max;
+
+  if (cast_mode == IM_CAST_MINMAX)  // search for min-max
+    iMinMaxType(src_map, count, min, max, absolute);
+  else  
+  {
+    // IM_CAST_FIXED - use data type limits for min-max
+    iDataTypeRealMinMax(min, max, absolute, *dst_map);
+
+    if (cast_mode == IM_CAST_USER)  // get min,max from atributes
+    {
+      double* amin = (double*)attrib_table->Get("UserMin");
+      if (amin) min = (SRCT)*amin;
+      double* amax = (double*)attrib_table->Get("UserMax");
+      if (amax) max = (SRCT)*amax;
     }
-    IM_END_PROCESSING;
   }
 
-  return processing;
+  iDataTypeIntMinMax(func.dst_type_min, func.dst_type_max, absolute);
+
+  int dst_type_range = func.dst_type_max - func.dst_type_min + 1;
+  func.range = max - min;
+  func.min = min;
+  func.gamma = gamma;
+  func.absolute = absolute;
+
+  func.factor = iGammaFactor((SRCT)dst_type_range, gamma);
+
+  return iConvertFunc(count, width, src_map, dst_map, func, counter);
 }
 
 
 /**********************************************************************/
 
+
 template <class SRCT, class DSTT>
 static int iCopyCpxDirect(int count, int width, const imComplex<SRCT>* src_map, imComplex<DSTT> *dst_map, int counter)
 {
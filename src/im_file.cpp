@@ -51,7 +51,22 @@ void imFileSetBaseAttributes(imFile* ifile)
 
   attrib_table->Set("FileFormat", IM_BYTE, -1, ifileformat->iformat->format);
   attrib_table->Set("FileCompression", IM_BYTE, -1, ifileformat->compression);
-  attrib_table->Set("FileImageCount", IM_INT, 1, &ifileformat->image_count);
+  if (ifileformat->image_count >= 0)
+    attrib_table->Set("FileImageCount", IM_INT, 1, &ifileformat->image_count);
+}
+
+static void iFileCheckImageCount(imFileFormatBase* ifileformat)
+{
+  /* some drivers count the images only when requested */
+  if (ifileformat->is_new)
+    return;
+
+  if (ifileformat->image_count < 0)
+    ifileformat->image_count = ifileformat->ReadImageCount();
+
+  imAttribTable* attrib_table = (imAttribTable*)ifileformat->attrib_table;
+  if (!attrib_table->Get("FileImageCount"))
+    attrib_table->Set("FileImageCount", IM_INT, 1, &ifileformat->image_count);
 }
 
 imFile* imFileOpen(const char* file_name, int *error)
@@ -111,6 +126,53 @@ imFile* imFileNew(const char* file_name, const char* format, int *error)
   return ifileformat;
 }
 
+imFile* imFileReopen(imFile* ifile, const char* file_name, int *error)
+{
+  assert(ifile);
+  assert(file_name);
+  imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  imAttribTable* attrib_table = (imAttribTable*)ifile->attrib_table;
+
+  if (ifile->is_new)
+  {
+    imFileClose(ifile);
+    return imFileOpen(file_name, error);
+  }
+
+  imCounterEnd(ifile->counter);
+
+  *error = ifileformat->Reopen(file_name);
+  if (*error != IM_ERR_NONE)
+  {
+    // the driver is already closed, release the rest
+    if (ifile->line_buffer) free(ifile->line_buffer);
+    delete attrib_table;
+    delete ifileformat;
+
+    if (*error == IM_ERR_FORMAT)  // try the other formats
+      return imFileOpen(file_name, error);
+
+    return NULL;
+  }
+
+  // keep the line buffer and the attribute table
+  void* line_buffer = ifile->line_buffer;
+  int line_buffer_alloc = ifile->line_buffer_alloc;
+
+  imFileClear(ifileformat);
+
+  ifileformat->line_buffer = line_buffer;
+  ifileformat->line_buffer_alloc = line_buffer_alloc;
+
+  attrib_table->RemoveAll();
+  ifileformat->attrib_table = attrib_table;
+  imFileSetBaseAttributes(ifileformat);
+
+  ifileformat->counter = imCounterBegin(file_name);
+
+  return ifileformat;
+}
+
 void imFileClose(imFile* ifile)
 {
   assert(ifile);
@@ -180,6 +242,7 @@ const void* imFileGetAttribute(imFile* ifile, const char* attrib, int *data_type
   assert(ifile);
   assert(attrib);
   imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  if (imStrEqual(attrib, "FileImageCount")) iFileCheckImageCount(ifileformat);
   imAttribTable* attrib_table = (imAttribTable*)ifileformat->attrib_table;
   return attrib_table->Get(attrib, data_type, count);
 }
@@ -189,6 +252,7 @@ int imFileGetAttribInteger(const imFile* ifile, const char* attrib, int index)
   assert(ifile);
   assert(attrib);
   imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  if (imStrEqual(attrib, "FileImageCount")) iFileCheckImageCount(ifileformat);
   imAttribTable* attrib_table = (imAttribTable*)ifileformat->attrib_table;
   return attrib_table->GetInteger(attrib, index);
 }
@@ -198,6 +262,7 @@ double imFileGetAttribReal(const imFile* ifile, const char* attrib, int index)
   assert(ifile);
   assert(attrib);
   imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  if (imStrEqual(attrib, "FileImageCount")) iFileCheckImageCount(ifileformat);
   imAttribTable* attrib_table = (imAttribTable*)ifileformat->attrib_table;
   return attrib_table->GetReal(attrib, index);
 }
@@ -207,6 +272,7 @@ const char* imFileGetAttribString(const imFile* ifile, const char* attrib)
   assert(ifile);
   assert(attrib);
   imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
+  if (imStrEqual(attrib, "FileImageCount")) iFileCheckImageCount(ifileformat);
   imAttribTable* attrib_table = (imAttribTable*)ifileformat->attrib_table;
   return attrib_table->GetString(attrib);
 }
@@ -225,6 +291,7 @@ void imFileGetAttributeList(imFile* ifile, char** attrib, int *attrib_count)
 {
   assert(ifile);
   assert(attrib_count);
+  iFileCheckImageCount((imFileFormatBase*)ifile);
 
   imAttribTable* attrib_table = (imAttribTable*)ifile->attrib_table;
   *attrib_count = attrib_table->Count();
@@ -239,7 +306,11 @@ void imFileGetInfo(imFile* ifile, char* format, char* compression, int *image_co
 
   if(compression) strcpy(compression, ifile->compression);
   if(format) strcpy(format, ifileformat->iformat->format);
-  if (image_count) *image_count = ifile->image_count;
+  if (image_count) 
+  {
+    iFileCheckImageCount(ifileformat);
+    *image_count = ifile->image_count;
+  }
 }
 
 static int iFileCheckPaletteGray(imFile* ifile)
@@ -299,7 +370,8 @@ int imFileReadImageInfo(imFile* ifile, int index, int *width, int *height, int *
   assert(!ifile->is_new);
   imFileFormatBase* ifileformat = (imFileFormatBase*)ifile;
 
-  if (index >= ifile->image_count)
+  /* when image_count is not known yet, the driver will check the index */
+  if (ifile->image_count >= 0 && index >= ifile->image_count)
     return IM_ERR_DATA;
 
   if (ifile->image_index != -1 &&
@@ -14,6 +14,11 @@
 #include "im_complex.h"
 #include "im_color.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IM_USE_SSE2
+#endif
+
 
 int imFileLineSizeAligned(int width, int bpp, int align)
 {
@@ -25,6 +30,270 @@ int imFileLineSizeAligned(int width, int bpp, int align)
     return (width * bpp + 7) / 8;
 }
 
+/**************************************************************************************
+                   Specialized packed <-> unpacked line copies
+
+  The common case for reading and writing is a packed RGB or RGBA line buffer 
+  (PNG, JPEG, TIFF, BMP...) and an unpacked imImage. These kernels are used instead 
+  of the generic per pixel loop for 3 or 4 components. 
+  "step" is the number of components of the packed pixel, 
+  "count" is the number of planes effectively copied (alpha can be dropped or ignored).
+***************************************************************************************/
+
+template <class T> 
+static void iUnpackLine(int x, int width, int step, int count, const T* packed, T* data, int plane_size)
+{
+  T* data0 = data;
+  T* data1 = data + plane_size;
+  T* data2 = data + 2*plane_size;
+  T* data3 = data + 3*plane_size;
+
+  packed += x*step;
+
+  if (count == 4)
+  {
+    for (; x < width; x++)
+    {
+      data0[x] = packed[0];
+      data1[x] = packed[1];
+      data2[x] = packed[2];
+      data3[x] = packed[3];
+      packed += step;
+    }
+  }
+  else
+  {
+    for (; x < width; x++)
+    {
+      data0[x] = packed[0];
+      data1[x] = packed[1];
+      data2[x] = packed[2];
+      packed += step;
+    }
+  }
+}
+
+template <class T> 
+static void iPackLine(int x, int width, int step, int count, const T* data, T* packed, int plane_size)
+{
+  const T* data0 = data;
+  const T* data1 = data + plane_size;
+  const T* data2 = data + 2*plane_size;
+  const T* data3 = data + 3*plane_size;
+
+  packed += x*step;
+
+  if (count == 4)
+  {
+    for (; x < width; x++)
+    {
+      packed[0] = data0[x];
+      packed[1] = data1[x];
+      packed[2] = data2[x];
+      packed[3] = data3[x];
+      packed += step;
+    }
+  }
+  else
+  {
+    for (; x < width; x++)
+    {
+      packed[0] = data0[x];
+      packed[1] = data1[x];
+      packed[2] = data2[x];
+      packed += step;
+    }
+  }
+}
+
+#ifdef IM_USE_SSE2
+/* In SSE2 only the 4 components packed layout is vectorized, 
+   3 components needs byte shuffles not available before SSSE3. */
+
+static void iUnpackLine(int x, int width, int step, int count, const imbyte* packed, imbyte* data, int plane_size)
+{
+  if (step == 4)
+  {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    imbyte* data0 = data;
+    imbyte* data1 = data + plane_size;
+    imbyte* data2 = data + 2*plane_size;
+    imbyte* data3 = data + 3*plane_size;
+
+    for (; x + 16 <= width; x += 16)
+    {
+      const __m128i* src = (const __m128i*)(packed + x*4);
+      __m128i p0 = _mm_loadu_si128(src);
+      __m128i p1 = _mm_loadu_si128(src + 1);
+      __m128i p2 = _mm_loadu_si128(src + 2);
+      __m128i p3 = _mm_loadu_si128(src + 3);
+
+      // each 32 bits lane is a pixel, isolate one component per lane then pack down to bytes
+#define IM_UNPACK_COMP(_shift, _dst)                                                \
+      {                                                                             \
+        __m128i c0 = _mm_and_si128(_mm_srli_epi32(p0, _shift), mask);               \
+        __m128i c1 = _mm_and_si128(_mm_srli_epi32(p1, _shift), mask);               \
+        __m128i c2 = _mm_and_si128(_mm_srli_epi32(p2, _shift), mask);               \
+        __m128i c3 = _mm_and_si128(_mm_srli_epi32(p3, _shift), mask);               \
+        __m128i c01 = _mm_packs_epi32(c0, c1);                                      \
+        __m128i c23 = _mm_packs_epi32(c2, c3);                                      \
+        _mm_storeu_si128((__m128i*)(_dst + x), _mm_packus_epi16(c01, c23));         \
+      }
+
+      IM_UNPACK_COMP(0, data0)
+      IM_UNPACK_COMP(8, data1)
+      IM_UNPACK_COMP(16, data2)
+      if (count == 4)
+        IM_UNPACK_COMP(24, data3)
+
+#undef IM_UNPACK_COMP
+    }
+  }
+
+  iUnpackLine<imbyte>(x, width, step, count, packed, data, plane_size);
+}
+
+static void iPackLine(int x, int width, int step, int count, const imbyte* data, imbyte* packed, int plane_size)
+{
+  if (step == 4)
+  {
+    const imbyte* data0 = data;
+    const imbyte* data1 = data + plane_size;
+    const imbyte* data2 = data + 2*plane_size;
+    const imbyte* data3 = data + 3*plane_size;
+    const __m128i alpha_mask = _mm_set1_epi32((int)0xFF000000);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; x + 16 <= width; x += 16)
+    {
+      __m128i* dst = (__m128i*)(packed + x*4);
+      __m128i r = _mm_loadu_si128((const __m128i*)(data0 + x));
+      __m128i g = _mm_loadu_si128((const __m128i*)(data1 + x));
+      __m128i b = _mm_loadu_si128((const __m128i*)(data2 + x));
+      __m128i a = (count == 4)? _mm_loadu_si128((const __m128i*)(data3 + x)): zero;
+
+      __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+      __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+      __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+      __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+
+      __m128i p0 = _mm_unpacklo_epi16(rg_lo, ba_lo);
+      __m128i p1 = _mm_unpackhi_epi16(rg_lo, ba_lo);
+      __m128i p2 = _mm_unpacklo_epi16(rg_hi, ba_hi);
+      __m128i p3 = _mm_unpackhi_epi16(rg_hi, ba_hi);
+
+      if (count != 4)
+      {
+        // preserve the 4th component already in the buffer
+        p0 = _mm_or_si128(p0, _mm_and_si128(_mm_loadu_si128(dst), alpha_mask));
+        p1 = _mm_or_si128(p1, _mm_and_si128(_mm_loadu_si128(dst + 1), alpha_mask));
+        p2 = _mm_or_si128(p2, _mm_and_si128(_mm_loadu_si128(dst + 2), alpha_mask));
+        p3 = _mm_or_si128(p3, _mm_and_si128(_mm_loadu_si128(dst + 3), alpha_mask));
+      }
+
+      _mm_storeu_si128(dst, p0);
+      _mm_storeu_si128(dst + 1, p1);
+      _mm_storeu_si128(dst + 2, p2);
+      _mm_storeu_si128(dst + 3, p3);
+    }
+  }
+
+  iPackLine<imbyte>(x, width, step, count, data, packed, plane_size);
+}
+
+static void iUnpackLine(int x, int width, int step, int count, const imushort* packed, imushort* data, int plane_size)
+{
+  if (step == 4)
+  {
+    imushort* data0 = data;
+    imushort* data1 = data + plane_size;
+    imushort* data2 = data + 2*plane_size;
+    imushort* data3 = data + 3*plane_size;
+
+    for (; x + 8 <= width; x += 8)
+    {
+      // 4x8 transpose of 16 bits components
+      const __m128i* src = (const __m128i*)(packed + x*4);
+      __m128i p0 = _mm_loadu_si128(src);     // r0 g0 b0 a0 r1 g1 b1 a1
+      __m128i p1 = _mm_loadu_si128(src + 1);
+      __m128i p2 = _mm_loadu_si128(src + 2);
+      __m128i p3 = _mm_loadu_si128(src + 3);
+
+      __m128i t0 = _mm_unpacklo_epi16(p0, p1);   // r0 r2 g0 g2 b0 b2 a0 a2
+      __m128i t1 = _mm_unpackhi_epi16(p0, p1);   // r1 r3 g1 g3 b1 b3 a1 a3
+      __m128i t2 = _mm_unpacklo_epi16(p2, p3);
+      __m128i t3 = _mm_unpackhi_epi16(p2, p3);
+
+      __m128i u0 = _mm_unpacklo_epi16(t0, t1);   // r0 r1 r2 r3 g0 g1 g2 g3
+      __m128i u1 = _mm_unpackhi_epi16(t0, t1);   // b0 b1 b2 b3 a0 a1 a2 a3
+      __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+      __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+
+      _mm_storeu_si128((__m128i*)(data0 + x), _mm_unpacklo_epi64(u0, u2));
+      _mm_storeu_si128((__m128i*)(data1 + x), _mm_unpackhi_epi64(u0, u2));
+      _mm_storeu_si128((__m128i*)(data2 + x), _mm_unpacklo_epi64(u1, u3));
+      if (count == 4)
+        _mm_storeu_si128((__m128i*)(data3 + x), _mm_unpackhi_epi64(u1, u3));
+    }
+  }
+
+  iUnpackLine<imushort>(x, width, step, count, packed, data, plane_size);
+}
+
+static void iPackLine(int x, int width, int step, int count, const imushort* data, imushort* packed, int plane_size)
+{
+  if (step == 4)
+  {
+    const imushort* data0 = data;
+    const imushort* data1 = data + plane_size;
+    const imushort* data2 = data + 2*plane_size;
+    const imushort* data3 = data + 3*plane_size;
+    const __m128i alpha_mask = _mm_set_epi32((int)0xFFFF0000, 0, (int)0xFFFF0000, 0);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; x + 8 <= width; x += 8)
+    {
+      __m128i* dst = (__m128i*)(packed + x*4);
+      __m128i r = _mm_loadu_si128((const __m128i*)(data0 + x));
+      __m128i g = _mm_loadu_si128((const __m128i*)(data1 + x));
+      __m128i b = _mm_loadu_si128((const __m128i*)(data2 + x));
+      __m128i a = (count == 4)? _mm_loadu_si128((const __m128i*)(data3 + x)): zero;
+
+      __m128i rg_lo = _mm_unpacklo_epi16(r, g);   // r0 g0 r1 g1 r2 g2 r3 g3
+      __m128i rg_hi = _mm_unpackhi_epi16(r, g);
+      __m128i ba_lo = _mm_unpacklo_epi16(b, a);
+      __m128i ba_hi = _mm_unpackhi_epi16(b, a);
+
+      __m128i p0 = _mm_unpacklo_epi32(rg_lo, ba_lo);  // r0 g0 b0 a0 r1 g1 b1 a1
+      __m128i p1 = _mm_unpackhi_epi32(rg_lo, ba_lo);
+      __m128i p2 = _mm_unpacklo_epi32(rg_hi, ba_hi);
+      __m128i p3 = _mm_unpackhi_epi32(rg_hi, ba_hi);
+
+      if (count != 4)
+      {
+        // preserve the 4th component already in the buffer
+        p0 = _mm_or_si128(p0, _mm_and_si128(_mm_loadu_si128(dst), alpha_mask));
+        p1 = _mm_or_si128(p1, _mm_and_si128(_mm_loadu_si128(dst + 1), alpha_mask));
+        p2 = _mm_or_si128(p2, _mm_and_si128(_mm_loadu_si128(dst + 2), alpha_mask));
+        p3 = _mm_or_si128(p3, _mm_and_si128(_mm_loadu_si128(dst + 3), alpha_mask));
+      }
+
+      _mm_storeu_si128(dst, p0);
+      _mm_storeu_si128(dst + 1, p1);
+      _mm_storeu_si128(dst + 2, p2);
+      _mm_storeu_si128(dst + 3, p3);
+    }
+  }
+
+  iPackLine<imushort>(x, width, step, count, data, packed, plane_size);
+}
+#endif
+
+static int iCanFastPack(int packed_depth, int copy_depth)
+{
+  return (packed_depth == 3 || packed_depth == 4) && (copy_depth == 3 || copy_depth == 4);
+}
+
 template <class T> 
 static void iDoFillLineBuffer(int width, int height, int line, int plane,  
                               int file_color_mode, T* line_buffer, 
@@ -42,6 +311,13 @@ static void iDoFillLineBuffer(int width, int height, int line, int plane,
   else
     data += line*width;
 
+  if (imColorModeIsPacked(file_color_mode) && !imColorModeIsPacked(user_color_mode) &&
+      iCanFastPack(file_depth, IM_MIN(file_depth, data_depth)))
+  {
+    iPackLine(0, width, file_depth, IM_MIN(file_depth, data_depth), data, line_buffer, data_plane_size);
+    return;
+  }
+
   for (int x = 0; x < width; x++)
   {
     int x_data_offset = x*data_depth;    // This will be used in packed data
@@ -95,6 +371,13 @@ static void iDoFillData(int width, int height, int line, int plane,
   else
     data += line*width;
 
+  if (imColorModeIsPacked(file_color_mode) && !imColorModeIsPacked(user_color_mode) &&
+      iCanFastPack(file_depth, IM_MIN(file_depth, data_depth)))
+  {
+    iUnpackLine(0, width, file_depth, IM_MIN(file_depth, data_depth), line_buffer, data, data_plane_size);
+    return;
+  }
+
   for (int x = 0; x < width; x++)
   {
     int x_data_offset = x*data_depth;    // This will be used in packed data
@@ -51,12 +51,17 @@ struct iGIFData
 {
   unsigned char global_colors[256 * 3]; /* global color table if any */
   int global_num_colors, /* global color table number of colors */
-      offset,            /* image offset */
       step,              /* interlaced step */
       interlaced,        /* image is interlaced or not */
       screen_width,
-      screen_height,
-      start_offset[512], /* offset of first block */
+      screen_height;
+  unsigned long *start_offset, /* offset of the first block of each image found so far */
+                *end_offset,   /* offset after the data of each image found so far */
+                next_offset,   /* where to look for the next image, 0 if the end of file was reached */
+                data_offset,   /* compressed data of the current image */
+                data_end;
+  int offset_count,      /* number of images found so far */
+      offset_max,
 	    ClearCode,				 /* The CLEAR LZ code. */
     	BitsPerPixel,	     /* Bits per pixel (Codes uses at list this + 1). */
 	    EOFCode,				   /* The EOF LZ code. */
@@ -65,13 +70,16 @@ struct iGIFData
 	    MaxCode1,          /* 1 bigger than max. possible code, in RunningBits bits. */
 	    LastCode,		       /* The code before the current code. */
 	    CrntCode,				   /* Current algorithm code. */
-	    StackPtr,		       /* For character stack (see below). */
 	    CrntShiftState;		 /* Number of bits in CrntShiftDWord. */
-  unsigned char Buf[256];	                  /* Compressed input is buffered here. */
+  unsigned char Buf[256];	                  /* Compressed output is buffered here. */
   unsigned int CrntShiftDWord;             /* For bytes decomposition into codes. */
-  unsigned char Stack[GIF_LZ_MAX_CODE];	    /* Decoded pixels are stacked here. */
-  unsigned char Suffix[GIF_LZ_MAX_CODE+1];	/* So we can trace the codes. */
-  unsigned int Prefix[GIF_LZ_MAX_CODE+1];
+  unsigned char *Data;                     /* Compressed input, without the sub-block sizes. */
+  int DataSize, DataPos;
+  unsigned char *Frame;                    /* Decoded pixels of the whole image. */
+  int FrameSize, FramePos,
+      LastOffset, LastLength;              /* String of the last code in Frame. */
+  int Offset[GIF_LZ_MAX_CODE+1];           /* Each code string is a copy of a previous string in Frame. */
+  int Length[GIF_LZ_MAX_CODE+1];
   unsigned int HTable[GIF_HT_SIZE];            /* hash table for the compression only, when using LZW */
 };
 
@@ -301,32 +309,38 @@ static int iGIFCompressLine(iGIFData* igif, imBinFile* handle, unsigned char *Li
 }
 
 /******************************************************************************
-*   This routines read one gif data block at a time and buffers it internally *
-* so that the decompression routine could access it.			      *
-*   The routine returns the next byte from its internal buffer (or read next  *
-* block in if buffer empty).		      *
+*   Reads all the data sub-blocks of the current image at once, and removes   *
+* the sub-block sizes, so the decompression can access a contiguous buffer.   *
 ******************************************************************************/
-static int iGIFBufferedInput(imBinFile* handle, unsigned char *Buf, unsigned char *NextByte)
+static int iGIFReadData(iGIFData* igif, imBinFile* handle)
 {
-  if (Buf[0] == 0) 
-  {
-    /* Needs to read the next buffer - this one is empty: */
-    imBinFileRead(handle, Buf, 1, 1);
-    imBinFileRead(handle, &Buf[1], Buf[0], 1);
+  int size = (int)(igif->data_end - igif->data_offset);
 
-    if (imBinFileError(handle))
-      return IM_ERR_ACCESS;
+  igif->Data = (unsigned char*)malloc(size > 0? size: 1);
+  if (!igif->Data)
+    return IM_ERR_MEM;
 
-    *NextByte = Buf[1];
-    Buf[1] = 2;	   /* We use now the second place as last char read! */
-    Buf[0]--;
-  }
-  else 
+  imBinFileSeekTo(handle, igif->data_offset);
+  size = (int)imBinFileRead(handle, igif->Data, size, 1);
+
+  unsigned char *src = igif->Data, *dst = igif->Data, *end = igif->Data + size;
+  while (src < end)
   {
-    *NextByte = Buf[Buf[1]++];
-    Buf[0]--;
+    int block_size = *src++;
+    if (block_size == 0)
+      break;
+
+    if (block_size > end - src)  /* truncated file */
+      block_size = (int)(end - src);
+
+    memmove(dst, src, block_size);
+    dst += block_size;
+    src += block_size;
   }
 
+  igif->DataSize = (int)(dst - igif->Data);
+  igif->DataPos = 0;
+
   return IM_ERR_NONE;
 }
 
@@ -335,28 +349,19 @@ static int iGIFBufferedInput(imBinFile* handle, unsigned char *Buf, unsigned cha
 *   This routine is responsable for the decompression of the bit stream from  *
 * 8 bits (bytes) packets, into the real codes.				      *
 ******************************************************************************/
-static int iGIFDecompressInput(iGIFData* igif, imBinFile* handle, int *Code)
+static inline int iGIFDecompressInput(iGIFData* igif, int *Code)
 {
-  unsigned char NextByte;
-  static unsigned int CodeMasks[] = 
-  {
-    0x0000, 0x0001, 0x0003, 0x0007,
-    0x000f, 0x001f, 0x003f, 0x007f,
-    0x00ff, 0x01ff, 0x03ff, 0x07ff,
-    0x0fff
-  };
-
   while (igif->CrntShiftState < igif->RunningBits) 
   {
     /* Needs to get more bytes from input stream for next code: */
-    if (iGIFBufferedInput(handle, igif->Buf, &NextByte) != IM_ERR_NONE) 
+    if (igif->DataPos == igif->DataSize)
       return IM_ERR_ACCESS;
 
-    igif->CrntShiftDWord |= ((unsigned int) NextByte) << igif->CrntShiftState;
+    igif->CrntShiftDWord |= ((unsigned int)igif->Data[igif->DataPos++]) << igif->CrntShiftState;
     igif->CrntShiftState += 8;
   }
 
-  *Code = igif->CrntShiftDWord & CodeMasks[igif->RunningBits];
+  *Code = igif->CrntShiftDWord & ((1 << igif->RunningBits) - 1);
 
   igif->CrntShiftDWord >>= igif->RunningBits;
   igif->CrntShiftState -= igif->RunningBits;
@@ -373,150 +378,86 @@ static int iGIFDecompressInput(iGIFData* igif, imBinFile* handle, int *Code)
 }
 
 /******************************************************************************
-* Routine to trace the Prefixes linked list until we get a prefix which is    *
-* not code, but a pixel value (less than ClearCode). Returns that pixel value.*
-* If image is defective, we might loop here forever, so we limit the loops to *
-* the maximum possible if image O.k. - LZ_MAX_CODE times.		      *
+*   Decodes the image until at least Count pixels are in the Frame.          *
+*   Since the string of a new code is the string of the previous code plus   *
+* the first char of the current string, and the two strings are contiguous in *
+* Frame, each code is stored only as an offset and a length in Frame.         *
+* So each code string is copied at once, instead of traced char by char.      *
 ******************************************************************************/
-static int iGIFGetPrefixChar(unsigned int *Prefix, int Code, int ClearCode)
+static int iGIFDecompressFrame(iGIFData* igif, int Count)
 {
-  int i = 0;
-
-  while (Code > ClearCode && i++ <= GIF_LZ_MAX_CODE) 
-    Code = Prefix[Code];
-
-  return Code;
-}
+  unsigned char *Frame = igif->Frame;
+  int *Offset = igif->Offset, *Length = igif->Length;
+  int CrntCode, NewCode, CrntPos, CrntLength;
 
-static int iGIFDecompressLine(iGIFData* igif, imBinFile* handle, unsigned char *Line,	int LineLen)
-{
-  int i = 0, j, CrntCode, EOFCode, ClearCode, CrntPrefix, LastCode, StackPtr;
-  unsigned char *Stack, *Suffix;
-  unsigned int *Prefix;
-
-  StackPtr = igif->StackPtr;
-  Prefix = igif->Prefix;
-  Suffix = igif->Suffix;
-  Stack = igif->Stack;
-  EOFCode = igif->EOFCode;
-  ClearCode = igif->ClearCode;
-  LastCode = igif->LastCode;
-
-  if (StackPtr != 0) 
+  while (igif->FramePos < Count)
   {
-    /* Let pop the stack off before continueing to read the gif file: */
-    while (StackPtr != 0 && i < LineLen) 
-      Line[i++] = Stack[--StackPtr];
-  }
-
-  while (i < LineLen) 
-  {			    
-    /* Decode LineLen items. */
-    if (iGIFDecompressInput(igif, handle, &CrntCode))
+    if (iGIFDecompressInput(igif, &CrntCode) != IM_ERR_NONE)
       return IM_ERR_ACCESS;
 
-    if (CrntCode == EOFCode) 
+    if (CrntCode == igif->EOFCode)
     {
-      /* Note however that usually we will not be here as we will stop */
-      /* decoding as soon as we got all the pixel, or EOF code will    */
-      /* not be read at all, and DGifGetLine/Pixel clean everything.   */
-      if (i != LineLen - 1) 
-        return IM_ERR_ACCESS;
-  
-    i++;
+      /* stream ended before all the pixels were decoded */
+      return IM_ERR_ACCESS;
     }
-    else if (CrntCode == ClearCode) 
+    else if (CrntCode == igif->ClearCode)
     {
       /* We need to start over again: */
-      for (j = 0; j <= GIF_LZ_MAX_CODE; j++) 
-        Prefix[j] = GIF_NO_SUCH_CODE;
-
       igif->RunningCode = igif->EOFCode + 1;
       igif->RunningBits = igif->BitsPerPixel + 1;
       igif->MaxCode1 = 1 << igif->RunningBits;
-      LastCode = igif->LastCode = GIF_NO_SUCH_CODE;
+      igif->LastCode = GIF_NO_SUCH_CODE;
+      continue;
     }
-    else 
+
+    /* the code that will be defined by the last string plus the first char of this one */
+    NewCode = igif->RunningCode - 2;
+    CrntPos = igif->FramePos;
+
+    if (CrntCode < igif->ClearCode)
     {
-      /* Its regular code - if in pixel range simply add it to output  */
-      /* stream, otherwise trace to codes linked list until the prefix */
-      /* is in pixel range:					     */
-      if (CrntCode < ClearCode) 
+      /* This is simple - its pixel scalar, so add it to output:   */
+      Frame[CrntPos] = (unsigned char)CrntCode;
+      CrntLength = 1;
+    }
+    else
+    {
+      int CopyLength;
+
+      if (CrntCode > igif->EOFCode && CrntCode < NewCode)
       {
-        /* This is simple - its pixel scalar, so add it to output:   */
-        Line[i++] = (unsigned char)CrntCode;
+        CrntLength = Length[CrntCode];
+        CopyLength = CrntLength < igif->FrameSize - CrntPos? CrntLength: igif->FrameSize - CrntPos;
+        memcpy(Frame + CrntPos, Frame + Offset[CrntCode], CopyLength);
       }
-      else 
+      else if (CrntCode == NewCode && igif->LastCode != GIF_NO_SUCH_CODE)
       {
-        /* Its a code to needed to be traced: trace the linked list  */
-        /* until the prefix is a pixel, while pushing the suffix     */
-        /* pixels on our stack. If we done, pop the stack in reverse */
-        /* (thats what stack is good for!) order to output.	     */
-        if (Prefix[CrntCode] == GIF_NO_SUCH_CODE) 
-        {
-          /* Only allowed if CrntCode is exactly the running code: */
-          /* In that case CrntCode = XXXCode, CrntCode or the	     */
-          /* prefix code is last code and the suffix char is	     */
-          /* exactly the prefix of last code!			     */
-          if (CrntCode == igif->RunningCode - 2) 
-          {
-            CrntPrefix = LastCode;
-            Suffix[igif->RunningCode - 2] =
-            Stack[StackPtr++] = (unsigned char)iGIFGetPrefixChar(Prefix, LastCode, ClearCode);
-          }
-          else 
-            return IM_ERR_ACCESS;
-        }
-        else
-          CrntPrefix = CrntCode;
-
-        /* Now (if image is O.K.) we should not get an NO_SUCH_CODE  */
-        /* During the trace. As we might loop forever, in case of    */
-        /* defective image, we count the number of loops we trace    */
-        /* and stop if we got LZ_MAX_CODE. obviously we can not      */
-        /* loop more than that.					     */
-        j = 0;
-        while (j++ <= GIF_LZ_MAX_CODE && CrntPrefix > ClearCode && CrntPrefix <= GIF_LZ_MAX_CODE) 
-        {
-          Stack[StackPtr++] = Suffix[CrntPrefix];
-          CrntPrefix = Prefix[CrntPrefix];
-        }
-
-        if (j >= GIF_LZ_MAX_CODE || CrntPrefix > GIF_LZ_MAX_CODE) 
-            return IM_ERR_ACCESS;
-
-        /* Push the last character on stack: */
-        Stack[StackPtr++] = (unsigned char)CrntPrefix;
-
-        /* Now lets pop all the stack into output: */
-        while (StackPtr != 0 && i < LineLen)
-          Line[i++] = Stack[--StackPtr];
+        /* Only allowed if CrntCode is exactly the running code:    */
+        /* the string is the last string plus its own first char.   */
+        CrntLength = igif->LastLength + 1;
+        CopyLength = CrntLength < igif->FrameSize - CrntPos? CrntLength: igif->FrameSize - CrntPos;
+        memcpy(Frame + CrntPos, Frame + igif->LastOffset, CopyLength < igif->LastLength? CopyLength: igif->LastLength);
+        if (CopyLength == CrntLength)
+          Frame[CrntPos + CrntLength - 1] = Frame[igif->LastOffset];
       }
+      else
+        return IM_ERR_ACCESS;
 
-      if (LastCode != GIF_NO_SUCH_CODE) 
-      {
-        Prefix[igif->RunningCode - 2] = LastCode;
-
-        if (CrntCode == igif->RunningCode - 2) 
-        {
-          /* Only allowed if CrntCode is exactly the running code: */
-          /* In that case CrntCode = XXXCode, CrntCode or the	     */
-          /* prefix code is last code and the suffix char is	     */
-          /* exactly the prefix of last code!			     */
-          Suffix[igif->RunningCode - 2] = (unsigned char)iGIFGetPrefixChar(Prefix, LastCode, ClearCode);
-        }
-        else 
-        {
-          Suffix[igif->RunningCode - 2] = (unsigned char)iGIFGetPrefixChar(Prefix, CrntCode, ClearCode);
-        }
-      }
-    
-      LastCode = CrntCode;
+      /* the last string is cut at the end of the frame */
+      CrntLength = CopyLength;
     }
-  }
 
-  igif->LastCode = LastCode;
-  igif->StackPtr = StackPtr;
+    if (igif->LastCode != GIF_NO_SUCH_CODE && NewCode <= GIF_LZ_MAX_CODE)
+    {
+      Offset[NewCode] = igif->LastOffset;
+      Length[NewCode] = igif->LastLength + 1;
+    }
+
+    igif->LastCode = CrntCode;
+    igif->LastOffset = CrntPos;
+    igif->LastLength = CrntLength;
+    igif->FramePos = CrntPos + CrntLength;
+  }
 
   return IM_ERR_NONE;
 }
@@ -529,10 +470,9 @@ static int iGIFSkipSubBlocks(imBinFile* handle)
   unsigned char byte_value;
   do
   {
-    /* reads the number of bytes of the block or the terminator */
-    imBinFileRead(handle, &byte_value, 1, 1);
-
-    if (imBinFileError(handle))
+    /* reads the number of bytes of the block or the terminator,
+       at the end of a truncated file nothing is read */
+    if (!imBinFileRead(handle, &byte_value, 1, 1) || imBinFileError(handle))
       return IM_ERR_ACCESS;
 
     /* jump number of bytes, ignores the contents */
@@ -938,6 +878,7 @@ class imFileFormatGIF: public imFileFormatBase
 
   int GIFReadImageInfo();
   int GIFWriteImageInfo();
+  int FindImage(int index);
 
 public:
   imFileFormatGIF(const imFormat* _iformat): imFileFormatBase(_iformat) {}
@@ -951,6 +892,7 @@ public:
   int ReadImageData(void* data);
   int WriteImageInfo();
   int WriteImageData(void* data);
+  int ReadImageCount();
 };
 
 class imFormatGIF: public imFormat
@@ -1033,18 +975,29 @@ int imFileFormatGIF::Open(const char* file_name)
     return IM_ERR_ACCESS;
   }
 
-  /* count number of images */
-  int error, terminate;
-  this->image_count = 0;
-  do
+  /* The images are found only when requested, 
+     so the number of images is unknown until needed. */
+  this->image_count = -1;
+  gif_data.offset_count = 0;
+  gif_data.offset_max = 16;
+  gif_data.start_offset = (unsigned long*)malloc(gif_data.offset_max * sizeof(unsigned long));
+  gif_data.end_offset = (unsigned long*)malloc(gif_data.offset_max * sizeof(unsigned long));
+  gif_data.next_offset = imBinFileTell(handle);
+
+  if (!gif_data.start_offset || !gif_data.end_offset)
   {
-    // store each offset before counting images
-    gif_data.start_offset[this->image_count] = imBinFileTell(handle);
-    error = iGIFSkipImage(handle, &this->image_count, &terminate);
-  } while (!terminate && error == IM_ERR_NONE);
+    if (gif_data.start_offset) free(gif_data.start_offset);
+    if (gif_data.end_offset) free(gif_data.end_offset);
+    imBinFileClose(handle);
+    return IM_ERR_MEM;
+  }
 
-  if (this->image_count == 0 || error != IM_ERR_NONE)
+  /* at least one image must exist */
+  int error = FindImage(0);
+  if (error != IM_ERR_NONE)
   {
+    free(gif_data.start_offset);
+    free(gif_data.end_offset);
     imBinFileClose(handle);
     return error;
   }
@@ -1052,6 +1005,58 @@ int imFileFormatGIF::Open(const char* file_name)
   return IM_ERR_NONE;
 }
 
+int imFileFormatGIF::FindImage(int index)
+{
+  while (index >= gif_data.offset_count)
+  {
+    if (gif_data.next_offset == 0)
+      return IM_ERR_DATA;
+
+    imBinFileSeekTo(handle, gif_data.next_offset);
+
+    int count = gif_data.offset_count, terminate;
+    int error = iGIFSkipImage(handle, &count, &terminate);
+    if (error != IM_ERR_NONE || count == gif_data.offset_count)
+    {
+      /* no more images */
+      gif_data.next_offset = 0;
+      this->image_count = gif_data.offset_count;
+      return error != IM_ERR_NONE? error: IM_ERR_DATA;
+    }
+
+    if (gif_data.offset_count == gif_data.offset_max)
+    {
+      /* the old arrays are kept if failed, so the images found so far can still be read */
+      size_t new_size = 2 * gif_data.offset_max * sizeof(unsigned long);
+
+      unsigned long* start_offset = (unsigned long*)realloc(gif_data.start_offset, new_size);
+      if (!start_offset)
+        return IM_ERR_MEM;
+      gif_data.start_offset = start_offset;
+
+      unsigned long* end_offset = (unsigned long*)realloc(gif_data.end_offset, new_size);
+      if (!end_offset)
+        return IM_ERR_MEM;
+      gif_data.end_offset = end_offset;
+
+      gif_data.offset_max *= 2;
+    }
+
+    gif_data.start_offset[gif_data.offset_count] = gif_data.next_offset;
+    gif_data.next_offset = imBinFileTell(handle);
+    gif_data.end_offset[gif_data.offset_count] = gif_data.next_offset;
+    gif_data.offset_count++;
+  }
+
+  return IM_ERR_NONE;
+}
+
+int imFileFormatGIF::ReadImageCount()
+{
+  FindImage(0x7FFFFFFF);
+  return this->image_count;
+}
+
 int imFileFormatGIF::New(const char* file_name)
 {
   this->handle = imBinFileNew(file_name);
@@ -1074,6 +1079,8 @@ int imFileFormatGIF::New(const char* file_name)
   }
 
   strcpy(this->compression, "LZW");
+  gif_data.start_offset = NULL;
+  gif_data.end_offset = NULL;
   
   return IM_ERR_NONE;
 }
@@ -1083,6 +1090,12 @@ void imFileFormatGIF::Close()
   if (this->is_new && !imBinFileError(this->handle))
     imBinFileWrite(this->handle, (void*)";", 1, 1);
 
+  if (gif_data.start_offset)
+  {
+    free(gif_data.start_offset);
+    free(gif_data.end_offset);
+  }
+
   imBinFileClose(this->handle);
 }
 
@@ -1245,6 +1258,13 @@ int imFileFormatGIF::GIFWriteImageInfo()
 
 int imFileFormatGIF::ReadImageInfo(int index)
 {
+  if (index < 0)
+    return IM_ERR_DATA;
+
+  int error = FindImage(index);
+  if (error != IM_ERR_NONE)
+    return error;
+
   imAttribTable* attrib_table = AttribTable();
 
   /* must clear the attribute list, because it can have multiple images and 
@@ -1303,27 +1323,16 @@ int imFileFormatGIF::ReadImageInfo(int index)
   if (imBinFileError(handle))
     return IM_ERR_ACCESS;
 
-  /* reads the LZW Min code byte */
+  /* reads the LZW Min code byte,
+     codes have at most 12 bits and the first code size is one more than this */
   imBinFileRead(handle, &byte_value, 1, 1);
-
-  /* now initialize the compression control data */
-
+  if (byte_value < 1 || byte_value > 11)
+    return IM_ERR_FORMAT;
   gif_data.BitsPerPixel = byte_value;
-  gif_data.ClearCode = (1 << byte_value);
-  gif_data.EOFCode = gif_data.ClearCode + 1;
-  gif_data.RunningCode = gif_data.EOFCode + 1;
-  gif_data.RunningBits = byte_value + 1;	 /* Number of bits per code. */
-  gif_data.MaxCode1 = 1 << gif_data.RunningBits;     /* Max. code + 1. */
-  gif_data.StackPtr = 0;		    /* No pixels on the pixel stack. */
-  gif_data.LastCode = GIF_NO_SUCH_CODE;
-  gif_data.CrntShiftState = 0;	/* No information in CrntShiftDWord. */
-  gif_data.CrntShiftDWord = 0;
-  gif_data.Buf[0] = 0;			      /* Input Buffer empty. */
 
-  for (int i = 0; i <= GIF_LZ_MAX_CODE; i++) 
-    gif_data.Prefix[i] = GIF_NO_SUCH_CODE;
-
-  gif_data.step = 0;
+  /* compressed data will be read at once in ReadImageData */
+  gif_data.data_offset = imBinFileTell(handle);
+  gif_data.data_end = gif_data.end_offset[index];
 
   return IM_ERR_NONE;
 }
@@ -1412,17 +1421,54 @@ int imFileFormatGIF::ReadImageData(void* data)
 {
   imCounterTotal(this->counter, this->height, "Reading GIF...");
 
-  int lin = 0, error;
+  if (iGIFReadData(&gif_data, handle) != IM_ERR_NONE)
+    return IM_ERR_MEM;
+
+  /* now initialize the compression control data */
+
+  gif_data.ClearCode = (1 << gif_data.BitsPerPixel);
+  gif_data.EOFCode = gif_data.ClearCode + 1;
+  gif_data.RunningCode = gif_data.EOFCode + 1;
+  gif_data.RunningBits = gif_data.BitsPerPixel + 1;	 /* Number of bits per code. */
+  gif_data.MaxCode1 = 1 << gif_data.RunningBits;     /* Max. code + 1. */
+  gif_data.LastCode = GIF_NO_SUCH_CODE;
+  gif_data.CrntShiftState = 0;	/* No information in CrntShiftDWord. */
+  gif_data.CrntShiftDWord = 0;
+
+  gif_data.step = 0;
+
+  if ((double)this->width * (double)this->height > 0x7FFFFFFF)
+  {
+    free(gif_data.Data);
+    return IM_ERR_MEM;
+  }
+
+  gif_data.FrameSize = this->width * this->height;
+  gif_data.FramePos = 0;
+  gif_data.Frame = (unsigned char*)malloc(gif_data.FrameSize > 0? gif_data.FrameSize: 1);
+  if (!gif_data.Frame)
+  {
+    free(gif_data.Data);
+    return IM_ERR_MEM;
+  }
+
+  int lin = 0, error = IM_ERR_NONE;
   for (int i = 0; i < this->height; i++)
   {
-    error = iGIFDecompressLine(&gif_data, handle, (imbyte*)this->line_buffer, this->width);
-    if (error != IM_ERR_NONE)
-      return IM_ERR_ACCESS;
+    if (iGIFDecompressFrame(&gif_data, (i + 1) * this->width) != IM_ERR_NONE)
+    {
+      error = IM_ERR_ACCESS;
+      break;
+    }
 
+    memcpy(this->line_buffer, gif_data.Frame + i * this->width, this->width);
     imFileLineBufferRead(this, data, lin, 0);
 
     if (!imCounterInc(this->counter))
-      return IM_ERR_COUNTER;
+    {
+      error = IM_ERR_COUNTER;
+      break;
+    }
 
 	  if (gif_data.interlaced)
 	  {
@@ -1438,11 +1484,10 @@ int imFileFormatGIF::ReadImageData(void* data)
       lin++;
   }
 
-  /* Skip remaining empty blocks of the image data */
-  if (iGIFSkipSubBlocks(handle) != IM_ERR_NONE)
-    return IM_ERR_ACCESS;
+  free(gif_data.Frame);
+  free(gif_data.Data);
 
-  return IM_ERR_NONE;
+  return error;
 }
 
 int imFileFormatGIF::WriteImageData(void* data)
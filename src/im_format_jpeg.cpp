@@ -315,6 +315,7 @@ public:
   int ReadImageData(void* data);
   int WriteImageInfo();
   int WriteImageData(void* data);
+  int Reopen(const char* file_name);
 };
 
 class imFormatJPEG: public imFormat
@@ -429,6 +430,48 @@ void imFileFormatJPEG::Close()
   imBinFileClose(this->handle);
 }
 
+int imFileFormatJPEG::Reopen(const char* file_name)
+{
+  if (this->is_new)
+    return imFileFormatBase::Reopen(file_name);
+
+  /* Reuse the decompression object, its memory manager and the source manager buffer.
+     Aborting releases only the per image state. */
+  jpeg_abort_decompress(&this->dinfo);
+  imBinFileClose(this->handle);
+
+  this->handle = imBinFileOpen(file_name);
+  if (this->handle == NULL)
+  {
+    jpeg_destroy_decompress(&this->dinfo);
+    return IM_ERR_OPEN;
+  }
+
+  unsigned char sig[2];
+  if (!imBinFileRead(this->handle, sig, 2, 1))
+  {
+    jpeg_destroy_decompress(&this->dinfo);
+    imBinFileClose(this->handle);
+    return IM_ERR_ACCESS;
+  }
+
+  if (sig[0] != 0xFF || sig[1] != 0xD8)
+  {
+    jpeg_destroy_decompress(&this->dinfo);
+    imBinFileClose(this->handle);
+    return IM_ERR_FORMAT;
+  }
+
+  imBinFileSeekTo(this->handle, 0);
+
+  strcpy(this->compression, "JPEG");
+  this->image_count = 1;
+
+  jpeg_stdio_src(&this->dinfo, (FILE*)this->handle);
+
+  return IM_ERR_NONE;
+}
+
 void* imFileFormatJPEG::Handle(int index)
 {
   if (index == 0)
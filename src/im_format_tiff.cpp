@@ -516,16 +516,18 @@ static void iTIFFReadAttributes(TIFF* tiff, imAttribTable* attrib_table)
   uint64 offset;
   if (TIFFGetField(tiff, TIFFTAG_EXIFIFD, &offset))
   {
-    tdir_t cur_dir = TIFFCurrentDirectory(tiff);
+    /* restore using the offset, the current directory can be a SubIFD,
+       and it does not walk the IFD chain again */
+    uint64 cur_offset = TIFFCurrentDirOffset(tiff);
 
     if (!TIFFReadEXIFDirectory(tiff, offset))
     {
-      TIFFSetDirectory(tiff, cur_dir);
+      TIFFSetSubDirectory(tiff, cur_offset);
       return;
     }
 
     iTIFFReadCustomTags(tiff, attrib_table);
-    TIFFSetDirectory(tiff, cur_dir);
+    TIFFSetSubDirectory(tiff, cur_offset);
   }
 }
 
@@ -581,6 +583,44 @@ static void iTIFFWriteAttributes(TIFF* tiff, imAttribTable* attrib_table)
   iTIFFWriteCustomTags(tiff, attrib_table);
 }
 
+/* Reads only the entry count and the link of the directory at diroff,
+   same as TIFFAdvanceDirectory. Much faster than TIFFReadDirectory. */
+static int iTIFFNextDirOffset(TIFF* tiff, uint64 diroff, uint64 *nextdiroff)
+{
+  if (!(tiff->tif_flags & TIFF_BIGTIFF))
+  {
+    uint16 dircount;
+    uint32 nextdir32;
+    if (!SeekOK(tiff, diroff) || !ReadOK(tiff, &dircount, sizeof(uint16)))
+      return 0;
+    if (tiff->tif_flags & TIFF_SWAB)
+      TIFFSwabShort(&dircount);
+
+    if (!SeekOK(tiff, diroff + sizeof(uint16) + dircount*12) || !ReadOK(tiff, &nextdir32, sizeof(uint32)))
+      return 0;
+    if (tiff->tif_flags & TIFF_SWAB)
+      TIFFSwabLong(&nextdir32);
+    *nextdiroff = nextdir32;
+  }
+  else
+  {
+    uint64 dircount64;
+    if (!SeekOK(tiff, diroff) || !ReadOK(tiff, &dircount64, sizeof(uint64)))
+      return 0;
+    if (tiff->tif_flags & TIFF_SWAB)
+      TIFFSwabLong8(&dircount64);
+    if (dircount64 > 0xFFFF)
+      return 0;
+
+    if (!SeekOK(tiff, diroff + sizeof(uint64) + dircount64*20) || !ReadOK(tiff, nextdiroff, sizeof(uint64)))
+      return 0;
+    if (tiff->tif_flags & TIFF_SWAB)
+      TIFFSwabLong8(nextdiroff);
+  }
+
+  return 1;
+}
+
 class imFileFormatTIFF: public imFileFormatBase
 {
   TIFF* tiff;
@@ -598,8 +638,13 @@ class imFileFormatTIFF: public imFileFormatBase
   int tile_buf_count, tile_width, tile_height, 
       tile_start_lin, tile_line_size, tile_line_raw_size;
 
+  uint64* dir_offset;        // offsets of the directories found so far (when reading)
+  int dir_offset_count, dir_offset_max;
+  uint64 dir_next_offset;    // next directory to be found, 0 if the end of the chain was reached
+
   int ReadTileline(void* line_buffer, int lin, int plane);
   void InvertBits(void* line_buffer, int size);
+  int FindDirectory(int index);
 
 public:
   imFileFormatTIFF(const imFormat* _iformat): imFileFormatBase(_iformat) {}
@@ -613,6 +658,7 @@ public:
   int ReadImageData(void* data);
   int WriteImageInfo();
   int WriteImageData(void* data);
+  int ReadImageCount();
 };
 
 class imFormatTIFF: public imFormat
@@ -657,13 +703,75 @@ int imFileFormatTIFF::Open(const char* file_name)
   if (comp_index == -1) return IM_ERR_COMPRESS;
   strcpy(this->compression, iTIFFCompTable[comp_index]);
 
-  this->image_count = TIFFNumberOfDirectories(this->tiff);
+  /* The IFD chain is walked only up to the requested image,
+     so the number of images is unknown until needed. */
+  this->image_count = -1;
   this->tile_buf = NULL;
   this->start_plane = 0;
 
+  this->dir_offset_count = 0;
+  this->dir_offset_max = 16;
+  this->dir_offset = (uint64*)malloc(this->dir_offset_max * sizeof(uint64));
+  if (!this->dir_offset)
+  {
+    TIFFClose(this->tiff);
+    return IM_ERR_MEM;
+  }
+
+  if (!(this->tiff->tif_flags & TIFF_BIGTIFF))
+    this->dir_next_offset = this->tiff->tif_header.classic.tiff_diroff;
+  else
+    this->dir_next_offset = this->tiff->tif_header.big.tiff_diroff;
+
+  return IM_ERR_NONE;
+}
+
+int imFileFormatTIFF::FindDirectory(int index)
+{
+  /* Same as TIFFNumberOfDirectories, but only up to index, 
+     and the offsets are stored so TIFFSetSubDirectory can be used to go directly to each one. 
+     Returns IM_ERR_DATA if the chain ends before index. */
+  while (index >= this->dir_offset_count)
+  {
+    uint64 nextdiroff;
+    if (this->dir_next_offset == 0 || 
+        this->dir_offset_count == 65535 ||
+        !iTIFFNextDirOffset(this->tiff, this->dir_next_offset, &nextdiroff))
+    {
+      this->dir_next_offset = 0;
+      this->image_count = this->dir_offset_count;
+      return IM_ERR_DATA;
+    }
+
+    if (this->dir_offset_count == this->dir_offset_max)
+    {
+      uint64* new_dir_offset = (uint64*)realloc(this->dir_offset, 2 * this->dir_offset_max * sizeof(uint64));
+      if (!new_dir_offset)
+        return IM_ERR_MEM;
+
+      this->dir_offset = new_dir_offset;
+      this->dir_offset_max *= 2;
+    }
+
+    this->dir_offset[this->dir_offset_count] = this->dir_next_offset;
+    this->dir_offset_count++;
+    this->dir_next_offset = nextdiroff;
+
+    if (nextdiroff == 0)
+      this->image_count = this->dir_offset_count;
+  }
+
   return IM_ERR_NONE;
 }
 
+int imFileFormatTIFF::ReadImageCount()
+{
+  if (FindDirectory(65535) == IM_ERR_MEM)
+    return this->dir_offset_count;  /* only the images found so far can be read */
+
+  return this->image_count;
+}
+
 int imFileFormatTIFF::New(const char* file_name)
 {
   this->tiff = TIFFOpen(file_name, "w");
@@ -671,6 +779,7 @@ int imFileFormatTIFF::New(const char* file_name)
     return IM_ERR_OPEN;
 
   this->tile_buf = NULL;
+  this->dir_offset = NULL;
 
   return IM_ERR_NONE;
 }
@@ -684,6 +793,9 @@ void imFileFormatTIFF::Close()
     free(this->tile_buf);
   }
 
+  if (this->dir_offset)
+    free(this->dir_offset);
+
   TIFFClose(this->tiff);
 }
 
@@ -710,7 +822,14 @@ int imFileFormatTIFF::ReadImageInfo(int index)
   this->h_subsample = 1;
   this->v_subsample = 1;
 
-  if (!TIFFSetDirectory(this->tiff, (tdir_t)index))
+  if (index < 0)
+    return IM_ERR_DATA;
+
+  int error = FindDirectory(index);
+  if (error)
+    return error;
+
+  if (!TIFFSetSubDirectory(this->tiff, this->dir_offset[index]))
     return IM_ERR_ACCESS;
 
   imAttribTable* attrib_table = AttribTable();
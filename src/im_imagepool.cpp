@@ -0,0 +1,300 @@
+/** \file
+ * \brief Image Pool
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+#include <stdlib.h>
+#include <memory.h>
+#include <assert.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sys/mman.h>
+#endif
+
+#include "im.h"
+#include "im_image.h"
+#include "im_attrib.h"
+#include "im_color.h"
+#include "im_palette.h"
+
+
+#define IPOOL_HUGEPAGE_SIZE (2*1024*1024)
+
+struct iPoolNode
+{
+  imImage* image;
+  size_t size;
+  iPoolNode* next;
+};
+
+struct _imImagePool
+{
+  size_t max_size,
+         size;
+  int use_huge_pages,
+      count,
+      hits,
+      misses;
+
+  iPoolNode* first;   /* most recently released first */
+
+#ifdef WIN32
+  CRITICAL_SECTION lock;
+#else
+  pthread_mutex_t lock;
+#endif
+};
+
+static void iPoolLock(imImagePool* pool)
+{
+#ifdef WIN32
+  EnterCriticalSection(&pool->lock);
+#else
+  pthread_mutex_lock(&pool->lock);
+#endif
+}
+
+static void iPoolUnlock(imImagePool* pool)
+{
+#ifdef WIN32
+  LeaveCriticalSection(&pool->lock);
+#else
+  pthread_mutex_unlock(&pool->lock);
+#endif
+}
+
+static size_t iPoolImageSize(const imImage* image)
+{
+  int depth = image->has_alpha? image->depth+1: image->depth;
+  return (size_t)image->plane_size * depth;
+}
+
+static void iPoolAllocHugePages(imImage* image)
+{
+#if defined(MADV_HUGEPAGE)
+  size_t size = iPoolImageSize(image);
+  if (size < IPOOL_HUGEPAGE_SIZE)
+    return;
+
+  void* data = NULL;
+  size = ((size + IPOOL_HUGEPAGE_SIZE - 1) / IPOOL_HUGEPAGE_SIZE) * IPOOL_HUGEPAGE_SIZE;
+  if (posix_memalign(&data, IPOOL_HUGEPAGE_SIZE, size) != 0)
+    return;
+
+  /* just an advice, if not accepted the buffer will use regular pages */
+  madvise(data, size, MADV_HUGEPAGE);
+
+  /* memory allocated by posix_memalign can be released by free,
+     so the image can still be destroyed by imImageDestroy */
+  free(image->data[0]);
+  image->data[0] = data;
+
+  int depth = image->has_alpha? image->depth+1: image->depth;
+  for (int d = 1; d < depth; d++)
+    image->data[d] = (imbyte*)(image->data[0]) + d*image->plane_size;
+#else
+  (void)image;
+#endif
+}
+
+static void iPoolResetImage(imImage* image)
+{
+  imAttribTable* attrib_table = (imAttribTable*)image->attrib_table;
+  attrib_table->RemoveAll();
+
+  if (image->palette)
+  {
+    if (image->color_space == IM_BINARY)
+    {
+      image->palette_count = 2;
+      image->palette[0] = imColorEncode(0, 0, 0);
+      image->palette[1] = imColorEncode(255, 255, 255);
+    }
+    else
+    {
+      image->palette_count = 256;
+      for (int i = 0; i < 256; i++)
+        image->palette[i] = imColorEncode((imbyte)i, (imbyte)i, (imbyte)i);
+    }
+  }
+}
+
+/* Must be called with the pool locked */
+static void iPoolTrim(imImagePool* pool, size_t max_size)
+{
+  while (pool->size > max_size)
+  {
+    /* remove the least recently released, the last one */
+    iPoolNode** node_p = &pool->first;
+    while ((*node_p)->next)
+      node_p = &((*node_p)->next);
+
+    iPoolNode* node = *node_p;
+    *node_p = NULL;
+
+    pool->size -= node->size;
+    pool->count--;
+
+    imImageDestroy(node->image);
+    delete node;
+  }
+}
+
+imImagePool* imImagePoolCreate(int max_mbytes, int use_huge_pages)
+{
+  imImagePool* pool = new imImagePool;
+  pool->max_size = (size_t)max_mbytes * 1024 * 1024;
+  pool->size = 0;
+  pool->use_huge_pages = use_huge_pages;
+  pool->count = 0;
+  pool->hits = 0;
+  pool->misses = 0;
+  pool->first = NULL;
+
+#ifdef WIN32
+  InitializeCriticalSection(&pool->lock);
+#else
+  pthread_mutex_init(&pool->lock, NULL);
+#endif
+
+  return pool;
+}
+
+void imImagePoolDestroy(imImagePool* pool)
+{
+  assert(pool);
+
+  iPoolTrim(pool, 0);
+
+#ifdef WIN32
+  DeleteCriticalSection(&pool->lock);
+#else
+  pthread_mutex_destroy(&pool->lock);
+#endif
+
+  delete pool;
+}
+
+imImage* imImagePoolAcquire(imImagePool* pool, int width, int height, int color_mode, int data_type)
+{
+  assert(pool);
+
+  int color_space = imColorModeSpace(color_mode);
+  int has_alpha = imColorModeHasAlpha(color_mode)? 1: 0;
+
+  iPoolLock(pool);
+
+  iPoolNode** node_p = &pool->first;
+  while (*node_p)
+  {
+    imImage* image = (*node_p)->image;
+    if (image->width == width && image->height == height &&
+        image->color_space == color_space && image->data_type == data_type &&
+        (image->has_alpha? 1: 0) == has_alpha)
+    {
+      iPoolNode* node = *node_p;
+      *node_p = node->next;
+
+      pool->size -= node->size;
+      pool->count--;
+      pool->hits++;
+
+      iPoolUnlock(pool);
+
+      delete node;
+      iPoolResetImage(image);
+      return image;
+    }
+
+    node_p = &((*node_p)->next);
+  }
+
+  pool->misses++;
+  int use_huge_pages = pool->use_huge_pages;
+
+  iPoolUnlock(pool);
+
+  imImage* image = imImageCreate(width, height, color_space, data_type);
+  if (!image)
+    return NULL;
+
+  if (has_alpha)
+  {
+    imImageAddAlpha(image);
+    if (!image->has_alpha)
+    {
+      imImageDestroy(image);
+      return NULL;
+    }
+  }
+
+  if (use_huge_pages)
+    iPoolAllocHugePages(image);
+
+  return image;
+}
+
+void imImagePoolRelease(imImagePool* pool, imImage* image)
+{
+  assert(pool);
+  assert(image);
+
+  size_t size = iPoolImageSize(image);
+
+  iPoolLock(pool);
+
+  if (size > pool->max_size || !image->data[0])
+  {
+    iPoolUnlock(pool);
+    imImageDestroy(image);
+    return;
+  }
+
+  iPoolTrim(pool, pool->max_size - size);
+
+  iPoolNode* node = new iPoolNode;
+  node->image = image;
+  node->size = size;
+  node->next = pool->first;
+  pool->first = node;
+
+  pool->size += size;
+  pool->count++;
+
+  iPoolUnlock(pool);
+}
+
+void imImagePoolSetMaxSize(imImagePool* pool, int max_mbytes)
+{
+  assert(pool);
+
+  iPoolLock(pool);
+  pool->max_size = (size_t)max_mbytes * 1024 * 1024;
+  iPoolTrim(pool, pool->max_size);
+  iPoolUnlock(pool);
+}
+
+void imImagePoolClear(imImagePool* pool)
+{
+  assert(pool);
+
+  iPoolLock(pool);
+  iPoolTrim(pool, 0);
+  iPoolUnlock(pool);
+}
+
+void imImagePoolStats(imImagePool* pool, int *hits, int *misses, int *count, double *mbytes)
+{
+  assert(pool);
+
+  iPoolLock(pool);
+  if (hits) *hits = pool->hits;
+  if (misses) *misses = pool->misses;
+  if (count) *count = pool->count;
+  if (mbytes) *mbytes = (double)pool->size / (1024.0 * 1024.0);
+  iPoolUnlock(pool);
+}
@@ -21,6 +21,10 @@
 #include "im_convert.h"
 #include "im_counter.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 
 /* RANGE forces a to be in the range b..c (inclusive) */
 #define RANGE(a,b,c) { if (a < b) a = b;  if (a > c) a = c; }
@@ -194,106 +198,164 @@ typedef struct {
 } box;
 typedef box * boxptr;
 
-/* Local state for the IJG quantizer */
-
-static hist2d * sl_histogram;	/* pointer to the 3D histogram array */
-static FSERRPTR sl_fserrors;	/* accumulated-errors array */
-static int * sl_error_limiter;	/* table for clamping the applied error */
-static int sl_on_odd_lin;	/* flag to remember which line we are on */
-static imbyte* sl_colormap[3];	/* selected colormap */
-static int sl_num_colors;	/* number of selected colors */
+/* Local state for the IJG quantizer, 
+   kept in a context so several conversions can run at the same time. */
 
-
-static int    slow_fill_histogram(imbyte*, imbyte*, imbyte*, int, int, int);
+struct _imQuantContext
+{
+  hist2d * histogram;	/* pointer to the 3D histogram array, 
+                           then used as the inverse color map cache */
+  FSERRPTR fserrors;	/* accumulated-errors array */
+  int fserrors_width;	/* width the errors array was allocated for */
+  int error_limiter[255*2+1];	/* table for clamping the applied error */
+  int on_odd_lin;	/* flag to remember which line we are on */
+  imbyte colormap[3][MAXNUMCOLORS];	/* selected colormap */
+  int num_colors;	/* number of selected colors */
+  int cmap_cached;	/* histogram contains the inverse map of colormap */
+};
+
+
+static int    slow_fill_histogram(imQuantContext*, imbyte*, imbyte*, imbyte*, int, int, int);
 static boxptr find_biggest_color_pop (boxptr, int);
 static boxptr find_biggest_volume (boxptr, int);
-static void   update_box (boxptr);
-static int    median_cut (boxptr, int, int);
-static void   compute_color (boxptr, int);
-static void   slow_select_colors (int);
-static int    find_nearby_colors (int, int, int, imbyte []);
-static void   find_best_colors (int,int,int,int, imbyte [], imbyte []);
-static void   fill_inverse_cmap (int, int, int);
-static int    slow_map_pixels(imbyte*, imbyte*, imbyte*, int, int, imbyte*, int);
-static void   init_error_limit (void);
-
-
-/* Master control for slow quantizer. */
-static int slow_quant(imbyte *red, imbyte *green, imbyte *blue, int w, int h, imbyte *map, 
-                      imbyte *rm, imbyte *gm, imbyte *bm, int descols, int counter)
+static void   update_box (imQuantContext*, boxptr);
+static int    median_cut (imQuantContext*, boxptr, int, int);
+static void   compute_color (imQuantContext*, boxptr, int);
+static void   slow_select_colors (imQuantContext*, int);
+static int    find_nearby_colors (imQuantContext*, int, int, int, imbyte []);
+static void   find_best_colors (imQuantContext*, int,int,int,int, imbyte [], imbyte []);
+static void   fill_inverse_cmap (imQuantContext*, int, int, int);
+static int    slow_map_pixels(imQuantContext*, imbyte*, imbyte*, imbyte*, int, int, imbyte*, int);
+static void   init_error_limit (int*);
+
+
+/* Allocate the errors array for the given width, if necessary */
+static int slow_init_errors(imQuantContext* ctx, int w)
 {
   size_t fs_arraysize = (w + 2) * (3 * sizeof(FSERROR));
-  
-  /* Allocate all the temporary storage needed */
-  init_error_limit();
 
-  sl_histogram = (hist2d *) malloc(sizeof(hist3d));
-  sl_fserrors = (FSERRPTR) malloc(fs_arraysize);
-  
-  if (! sl_error_limiter || ! sl_histogram || ! sl_fserrors) 
+  if (w > ctx->fserrors_width)
   {
-    if (sl_error_limiter) free(sl_error_limiter-255);
-    if (sl_fserrors) free(sl_fserrors);
-    if (sl_histogram) free(sl_histogram);
-    return IM_ERR_MEM;
+    FSERRPTR fserrors = (FSERRPTR) realloc(ctx->fserrors, fs_arraysize);
+    if (!fserrors)
+      return IM_ERR_MEM;
+
+    ctx->fserrors = fserrors;
+    ctx->fserrors_width = w;
   }
-  
-  sl_colormap[0] = (imbyte*) rm;
-  sl_colormap[1] = (imbyte*) gm;
-  sl_colormap[2] = (imbyte*) bm;
-  
+
+  /* Initialize the propagated errors to zero. */
+  memset(ctx->fserrors, 0, fs_arraysize);
+  ctx->on_odd_lin = 0;
+  return IM_ERR_NONE;
+}
+
+/* Master control for slow quantizer. */
+static int slow_quant(imQuantContext* ctx, imbyte *red, imbyte *green, imbyte *blue, int w, int h, imbyte *map, 
+                      int descols, int counter)
+{
+  if (slow_init_errors(ctx, w) != IM_ERR_NONE)
+    return IM_ERR_MEM;
+
   /* Compute the color histogram */
-  int ret = slow_fill_histogram(red, green, blue, w*h, counter, w);
+  ctx->cmap_cached = 0;
+  int ret = slow_fill_histogram(ctx, red, green, blue, w, h, counter);
   if (ret != IM_ERR_NONE)
     return ret;
   
   /* Select the colormap */
-  slow_select_colors(descols);
+  slow_select_colors(ctx, descols);
   
   /* Zero the histogram: now to be used as inverse color map */
-  memset(sl_histogram, 0, sizeof(hist3d));
-  
-  /* Initialize the propagated errors to zero. */
-  memset(sl_fserrors, 0, fs_arraysize);
-  sl_on_odd_lin = 0;
+  memset(ctx->histogram, 0, sizeof(hist3d));
+  ctx->cmap_cached = 1;
   
   /* Map the image. */
-  ret = slow_map_pixels(red, green, blue, w, h, map, counter);
-  
-  /* Release working memory. */
-  free(sl_histogram);
-  free(sl_error_limiter-255);
-  free(sl_fserrors);
-
-  return ret;
+  return slow_map_pixels(ctx, red, green, blue, w, h, map, counter);
 }
 
 
-static int slow_fill_histogram(register imbyte *red, register imbyte *green, register imbyte *blue, register int numpixels, int counter, int w)
+static void slow_fill_line(hist2d * histogram, const imbyte *red, const imbyte *green, const imbyte *blue, int w)
 {
-  register histptr histp;
-  register hist2d * histogram = sl_histogram;
-  int r_index, g_index, b_index;
-  
-  memset(histogram, 0, sizeof(hist3d));
-  
-  while (numpixels-- > 0) 
+  for (int i = 0; i < w; i++)
   {
     /* get pixel value and index into the histogram */
-    r_index = *red >> C0_SHIFT;
-    g_index = *green >> C1_SHIFT;
-    b_index = *blue >> C2_SHIFT;
-    histp = &histogram[r_index][g_index][b_index];
+    histptr histp = &histogram[red[i] >> C0_SHIFT][green[i] >> C1_SHIFT][blue[i] >> C2_SHIFT];
 
     /* increment, check for overflow and undo increment if so. */
-    if (++(*histp) <= 0)
+    if (++(*histp) == 0)
       (*histp)--;
+  }
+}
+
+static int slow_fill_histogram(imQuantContext* ctx, imbyte *red, imbyte *green, imbyte *blue, int w, int h, int counter)
+{
+  memset(ctx->histogram, 0, sizeof(hist3d));
+
+#ifdef _OPENMP
+  /* each thread fills a private histogram for its lines, 
+     at least 16 lines for each thread, they are merged at the end */
+  int thread_count = omp_get_max_threads();
+  if (thread_count > h / 16)
+    thread_count = h / 16;
+
+  hist3d * thread_histogram = NULL;
+  if (thread_count > 1)
+    thread_histogram = (hist3d *) calloc(thread_count - 1, sizeof(hist3d));
+
+  if (thread_histogram)
+  {
+    int processing = IM_ERR_NONE;
+
+#pragma omp parallel for num_threads(thread_count)
+    for (int lin = 0; lin < h; lin++)
+    {
+#pragma omp flush (processing)
+      if (processing == IM_ERR_NONE)
+      {
+        int t = omp_get_thread_num();
+        hist2d * histogram = (t == 0)? ctx->histogram: thread_histogram[t - 1];
+        size_t offset = (size_t)lin * w;
+        slow_fill_line(histogram, red + offset, green + offset, blue + offset, w);
+
+        /* the counter is not thread safe */
+#pragma omp critical (rgb2map_counter)
+        {
+          if (processing == IM_ERR_NONE && !imCounterInc(counter))
+            processing = IM_ERR_COUNTER;
+        }
+#pragma omp flush (processing)
+      }
+    }
+
+    if (processing == IM_ERR_NONE)
+    {
+      /* merge saturating the count, as a single histogram would do */
+      histptr histogram = &ctx->histogram[0][0][0];
+      int count = HIST_C0_ELEMS*HIST_C1_ELEMS*HIST_C2_ELEMS;
+
+      for (int t = 0; t < thread_count - 1; t++)
+      {
+        histptr t_histogram = &thread_histogram[t][0][0][0];
+        for (int i = 0; i < count; i++)
+        {
+          unsigned int sum = (unsigned int)histogram[i] + t_histogram[i];
+          histogram[i] = (histcell) (sum > 65535? 65535: sum);
+        }
+      }
+    }
 
-    red++;
-    green++;
-    blue++;
+    free(thread_histogram);
+    return processing;
+  }
+#endif
 
-    if (numpixels % w == 0 && !imCounterInc(counter))
+  for (int lin = 0; lin < h; lin++)
+  {
+    size_t offset = (size_t)lin * w;
+    slow_fill_line(ctx->histogram, red + offset, green + offset, blue + offset, w);
+
+    if (!imCounterInc(counter))
       return IM_ERR_COUNTER;
   }
 
@@ -334,9 +396,9 @@ static boxptr find_biggest_volume (boxptr boxlist, int numboxes)
 }
 
 
-static void update_box (boxptr boxp)
+static void update_box (imQuantContext* ctx, boxptr boxp)
 {
-  hist2d * histogram = sl_histogram;
+  hist2d * histogram = ctx->histogram;
   histptr histp;
   int c0,c1,c2;
   int c0min,c0max,c1min,c1max,c2min,c2max;
@@ -436,7 +498,7 @@ have_c2max:
 }
 
 
-static int median_cut (boxptr boxlist, int numboxes, int desired_colors)
+static int median_cut (imQuantContext* ctx, boxptr boxlist, int numboxes, int desired_colors)
 {
   int n,lb;
   int c0,c1,c2,cmax;
@@ -483,18 +545,18 @@ static int median_cut (boxptr boxlist, int numboxes, int desired_colors)
       break;
     }
     /* Update stats for boxes */
-    update_box(b1);
-    update_box(b2);
+    update_box(ctx, b1);
+    update_box(ctx, b2);
     numboxes++;
   }
   return numboxes;
 }
 
-static void compute_color (boxptr boxp, int icolor)
+static void compute_color (imQuantContext* ctx, boxptr boxp, int icolor)
 {
   /* Current algorithm: mean weighted by pixels (not colors) */
   /* Note it is important to get the rounding correct! */
-  hist2d * histogram = sl_histogram;
+  hist2d * histogram = ctx->histogram;
   histptr histp;
   int c0,c1,c2;
   int c0min,c0max,c1min,c1max,c2min,c2max;
@@ -526,13 +588,13 @@ static void compute_color (boxptr boxp, int icolor)
     }
   }
     
-  sl_colormap[0][icolor] = (imbyte) ((c0total + (total>>1)) / total);
-  sl_colormap[1][icolor] = (imbyte) ((c1total + (total>>1)) / total);
-  sl_colormap[2][icolor] = (imbyte) ((c2total + (total>>1)) / total);
+  ctx->colormap[0][icolor] = (imbyte) ((c0total + (total>>1)) / total);
+  ctx->colormap[1][icolor] = (imbyte) ((c1total + (total>>1)) / total);
+  ctx->colormap[2][icolor] = (imbyte) ((c2total + (total>>1)) / total);
 }
 
 
-static void slow_select_colors (int descolors)
+static void slow_select_colors (imQuantContext* ctx, int descolors)
 /* Master routine for color selection */
 {
   box boxlist[MAXNUMCOLORS];
@@ -548,13 +610,13 @@ static void slow_select_colors (int descolors)
   boxlist[0].c2min = 0;
   boxlist[0].c2max = 255 >> C2_SHIFT;
   /* Shrink it to actually-used volume and set its statistics */
-  update_box(& boxlist[0]);
+  update_box(ctx, & boxlist[0]);
   /* Perform median-cut to produce final box list */
-  numboxes = median_cut(boxlist, numboxes, descolors);
+  numboxes = median_cut(ctx, boxlist, numboxes, descolors);
   /* Compute the representative color for each box, fill colormap */
   for (i = 0; i < numboxes; i++)
-    compute_color(& boxlist[i], i);
-  sl_num_colors = numboxes;
+    compute_color(ctx, & boxlist[i], i);
+  ctx->num_colors = numboxes;
 }
 
 
@@ -572,9 +634,9 @@ static void slow_select_colors (int descolors)
 #define BOX_C2_SHIFT  (C2_SHIFT + BOX_C2_LOG)
 
 
-static int find_nearby_colors (int minc0, int minc1, int minc2, imbyte* colorlist)
+static int find_nearby_colors (imQuantContext* ctx, int minc0, int minc1, int minc2, imbyte* colorlist)
 {
-  int numcolors = sl_num_colors;
+  int numcolors = ctx->num_colors;
   int maxc0, maxc1, maxc2;
   int centerc0, centerc1, centerc2;
   int i, x, ncolors;
@@ -592,7 +654,7 @@ static int find_nearby_colors (int minc0, int minc1, int minc2, imbyte* colorlis
   
   for (i = 0; i < numcolors; i++) {
     /* We compute the squared-c0-distance term, then add in the other two. */
-    x = sl_colormap[0][i];
+    x = ctx->colormap[0][i];
     if (x < minc0) {
       tdist = (x - minc0) * C0_SCALE;
       min_dist = tdist*tdist;
@@ -615,7 +677,7 @@ static int find_nearby_colors (int minc0, int minc1, int minc2, imbyte* colorlis
       }
     }
     
-    x = sl_colormap[1][i];
+    x = ctx->colormap[1][i];
     if (x < minc1) {
       tdist = (x - minc1) * C1_SCALE;
       min_dist += tdist*tdist;
@@ -637,7 +699,7 @@ static int find_nearby_colors (int minc0, int minc1, int minc2, imbyte* colorlis
       }
     }
     
-    x = sl_colormap[2][i];
+    x = ctx->colormap[2][i];
     if (x < minc2) {
       tdist = (x - minc2) * C2_SCALE;
       min_dist += tdist*tdist;
@@ -673,7 +735,7 @@ static int find_nearby_colors (int minc0, int minc1, int minc2, imbyte* colorlis
 }
 
 
-static void find_best_colors (int minc0, int minc1, int minc2, int numcolors,
+static void find_best_colors (imQuantContext* ctx, int minc0, int minc1, int minc2, int numcolors,
                               imbyte* colorlist, imbyte* bestcolor)
 {
   int ic0, ic1, ic2;
@@ -701,11 +763,11 @@ static void find_best_colors (int minc0, int minc1, int minc2, int numcolors,
   for (i = 0; i < numcolors; i++) {
     icolor = colorlist[i];
     /* Compute (square of) distance from minc0/c1/c2 to this color */
-    inc0 = (minc0 - (int) sl_colormap[0][icolor]) * C0_SCALE;
+    inc0 = (minc0 - (int) ctx->colormap[0][icolor]) * C0_SCALE;
     dist0 = inc0*inc0;
-    inc1 = (minc1 - (int) sl_colormap[1][icolor]) * C1_SCALE;
+    inc1 = (minc1 - (int) ctx->colormap[1][icolor]) * C1_SCALE;
     dist0 += inc1*inc1;
-    inc2 = (minc2 - (int) sl_colormap[2][icolor]) * C2_SCALE;
+    inc2 = (minc2 - (int) ctx->colormap[2][icolor]) * C2_SCALE;
     dist0 += inc2*inc2;
     /* Form the initial difference increments */
     inc0 = inc0 * (2 * STEP_C0) + STEP_C0 * STEP_C0;
@@ -741,9 +803,9 @@ static void find_best_colors (int minc0, int minc1, int minc2, int numcolors,
 }
 
 
-static void fill_inverse_cmap (int c0, int c1, int c2)
+static void fill_inverse_cmap (imQuantContext* ctx, int c0, int c1, int c2)
 {
-  hist2d * histogram = sl_histogram;
+  hist2d * histogram = ctx->histogram;
   int minc0, minc1, minc2;	/* lower left corner of update box */
   int ic0, ic1, ic2;
   register imbyte * cptr;	/* pointer into bestcolor[] array */
@@ -763,10 +825,10 @@ static void fill_inverse_cmap (int c0, int c1, int c2)
   minc1 = (c1 << BOX_C1_SHIFT) + ((1 << C1_SHIFT) >> 1);
   minc2 = (c2 << BOX_C2_SHIFT) + ((1 << C2_SHIFT) >> 1);
   
-  numcolors = find_nearby_colors(minc0, minc1, minc2, colorlist);
+  numcolors = find_nearby_colors(ctx, minc0, minc1, minc2, colorlist);
   
   /* Determine the actually nearest colors. */
-  find_best_colors(minc0, minc1, minc2, numcolors, colorlist, bestcolor);
+  find_best_colors(ctx, minc0, minc1, minc2, numcolors, colorlist, bestcolor);
   
   /* Save the best color numbers (plus 1) in the main cache array */
   c0 <<= BOX_C0_LOG;		/* convert ID back to base cell indexes */
@@ -784,7 +846,7 @@ static void fill_inverse_cmap (int c0, int c1, int c2)
 }
 
 
-static int slow_map_pixels (imbyte *red, imbyte *green, imbyte *blue, int width, int height, imbyte *map, int counter)
+static int slow_map_pixels (imQuantContext* ctx, imbyte *red, imbyte *green, imbyte *blue, int width, int height, imbyte *map, int counter)
 {
   register LOCFSERROR cur0, cur1, cur2;	/* current error or pixel value */
   LOCFSERROR belowerr0, belowerr1, belowerr2; /* error for pixel below cur */
@@ -796,11 +858,11 @@ static int slow_map_pixels (imbyte *red, imbyte *green, imbyte *blue, int width,
   int dir;			/* +1 or -1 depending on direction */
   int dir3;			/* 3*dir, for advancing errorptr */
   int lin, col, offset;
-  int *error_limit = sl_error_limiter;
-  imbyte* colormap0 = sl_colormap[0];
-  imbyte* colormap1 = sl_colormap[1];
-  imbyte* colormap2 = sl_colormap[2];
-  hist2d * histogram = sl_histogram;
+  int *error_limit = ctx->error_limiter + 255;
+  imbyte* colormap0 = ctx->colormap[0];
+  imbyte* colormap1 = ctx->colormap[1];
+  imbyte* colormap2 = ctx->colormap[2];
+  hist2d * histogram = ctx->histogram;
   
   for (lin = 0; lin < height; lin++) 
   {
@@ -811,7 +873,7 @@ static int slow_map_pixels (imbyte *red, imbyte *green, imbyte *blue, int width,
     inBptr = & blue[offset];
     outptr = & map[offset];
 
-    if (sl_on_odd_lin) 
+    if (ctx->on_odd_lin) 
     {
       /* work right to left in this line */
       offset = width-1;
@@ -824,16 +886,16 @@ static int slow_map_pixels (imbyte *red, imbyte *green, imbyte *blue, int width,
 
       dir = -1;
       dir3 = -3;
-      errorptr = sl_fserrors + (width+1)*3; /* => entry after last column */
-      sl_on_odd_lin = 0;	/* flip for next time */
+      errorptr = ctx->fserrors + (width+1)*3; /* => entry after last column */
+      ctx->on_odd_lin = 0;	/* flip for next time */
     } 
     else 
     {
       /* work left to right in this line */
       dir = 1;
       dir3 = 3;
-      errorptr = sl_fserrors;	/* => entry before first real column */
-      sl_on_odd_lin = 1;	/* flip for next time */
+      errorptr = ctx->fserrors;	/* => entry before first real column */
+      ctx->on_odd_lin = 1;	/* flip for next time */
     }
 
     /* Preset error values: no error propagated to first pixel from left */
@@ -866,7 +928,7 @@ static int slow_map_pixels (imbyte *red, imbyte *green, imbyte *blue, int width,
       /* If we have not seen this color before, find nearest colormap */
       /* entry and update the cache */
       if (*cachep == 0)
-        fill_inverse_cmap(cur0>>C0_SHIFT, cur1>>C1_SHIFT, cur2>>C2_SHIFT);
+        fill_inverse_cmap(ctx, cur0>>C0_SHIFT, cur1>>C1_SHIFT, cur2>>C2_SHIFT);
 
       /* Now emit the colormap index for this cell */
       {
@@ -936,17 +998,12 @@ static int slow_map_pixels (imbyte *red, imbyte *green, imbyte *blue, int width,
 }
 
 
-/* Allocate and fill in the error_limiter table */
-static void init_error_limit (void)
+/* Fill in the error_limiter table */
+static void init_error_limit (int* table)
 {
-  int * table;
   int in, out, STEPSIZE;
   
-  table = (int *) malloc((size_t) ((255*2+1) * sizeof(int)));
-  if (! table) return;
-  
   table += 255;		/* so can index -255 .. +255 */
-  sl_error_limiter = table;
   
   STEPSIZE = ((255+1)/16);
 
@@ -973,18 +1030,108 @@ static void init_error_limit (void)
   }
 }
 
+imQuantContext* imQuantContextCreate(void)
+{
+  imQuantContext* ctx = (imQuantContext*) malloc(sizeof(imQuantContext));
+  if (!ctx)
+    return NULL;
+
+  ctx->histogram = (hist2d *) malloc(sizeof(hist3d));
+  if (!ctx->histogram)
+  {
+    free(ctx);
+    return NULL;
+  }
+
+  ctx->fserrors = NULL;
+  ctx->fserrors_width = 0;
+  ctx->on_odd_lin = 0;
+  ctx->num_colors = 0;
+  ctx->cmap_cached = 0;
+
+  init_error_limit(ctx->error_limiter);
+
+  return ctx;
+}
+
+void imQuantContextDestroy(imQuantContext* ctx)
+{
+  if (ctx->fserrors) free(ctx->fserrors);
+  free(ctx->histogram);
+  free(ctx);
+}
+
+/* Loads a given palette as the colormap, 
+   keeps the inverse color map if it is the same colormap of the previous conversion. */
+static void slow_load_palette(imQuantContext* ctx, const long *palette, int palette_count)
+{
+  int i, same = ctx->cmap_cached && palette_count == ctx->num_colors;
+
+  for (i = 0; i < palette_count; i++)
+  {
+    imbyte r, g, b;
+    imColorDecode(&r, &g, &b, palette[i]);
+
+    if (r != ctx->colormap[0][i] || g != ctx->colormap[1][i] || b != ctx->colormap[2][i])
+    {
+      same = 0;
+      ctx->colormap[0][i] = r;
+      ctx->colormap[1][i] = g;
+      ctx->colormap[2][i] = b;
+    }
+  }
+
+  ctx->num_colors = palette_count;
+
+  if (!same)
+  {
+    /* Zero the histogram: used only as inverse color map */
+    memset(ctx->histogram, 0, sizeof(hist3d));
+    ctx->cmap_cached = 1;
+  }
+}
+
 int imConvertRGB2Map(int width, int height, unsigned char *red, unsigned char *green, unsigned char *blue, unsigned char *map, long *palette, int *palette_count)
 {
   return imConvertRGB2MapCounter(width, height, red, green, blue, map, palette, palette_count, -1);
 }
 
 int imConvertRGB2MapCounter(int width, int height, unsigned char *red, unsigned char *green, unsigned char *blue, unsigned char *map, long *palette, int *palette_count, int counter)
+{
+  imQuantContext* ctx = imQuantContextCreate();
+  if (!ctx)
+    return IM_ERR_MEM;
+
+  int ret = imConvertRGB2MapContext(ctx, width, height, red, green, blue, map, palette, palette_count, 0, counter);
+
+  imQuantContextDestroy(ctx);
+  return ret;
+}
+
+int imConvertRGB2MapContext(imQuantContext* ctx, int width, int height, unsigned char *red, unsigned char *green, unsigned char *blue, unsigned char *map, long *palette, int *palette_count, int reuse_palette, int counter)
 {
   int i, new_palette_count;
   imbyte rm[256], gm[256], bm[256];
 
   if (*palette_count <= 0 || *palette_count > 256)
+  {
+    if (reuse_palette)
+      return IM_ERR_DATA;
+
     *palette_count = 256;
+  }
+
+  if (reuse_palette)
+  {
+    imCounterTotal(counter, height, "Converting...");
+
+    if (slow_init_errors(ctx, width) != IM_ERR_NONE)
+      return IM_ERR_MEM;
+
+    slow_load_palette(ctx, palette, *palette_count);
+
+    return slow_map_pixels(ctx, red, green, blue, width, height, map, counter);
+  }
 
   imCounterTotal(counter, 2 * height + 2 * height, "Converting...");
 
@@ -1001,12 +1148,15 @@ int imConvertRGB2MapCounter(int width, int height, unsigned char *red, unsigned
     return IM_ERR_NONE;
   }
 
-  ret = slow_quant(red, green, blue, width, height, map, rm, gm, bm, *palette_count, counter);
+  ret = slow_quant(ctx, red, green, blue, width, height, map, *palette_count, counter);
   if (ret != IM_ERR_NONE)
     return ret;
 
-  for (i = 0; i < *palette_count; i++)
-    *palette++ = imColorEncode(rm[i], gm[i], bm[i]);
+  /* median cut can find less colors than requested */
+  *palette_count = ctx->num_colors;
+
+  for (i = 0; i < ctx->num_colors; i++)
+    *palette++ = imColorEncode(ctx->colormap[0][i], ctx->colormap[1][i], ctx->colormap[2][i]);
 
   return IM_ERR_NONE;
 }
@@ -135,6 +135,7 @@ OneSourceOneDest("ProcessRemoveByArea")
 OneSourceOneDest("ProcessFillHoles")
 OneSourceOneDest("ProcessHoughLines", 180, hough_height, im.GRAY, im.INT)
 OneSourceOneDest("ProcessHoughLinesDraw")
+TwoSourcesOneDest("ProcessHoughLinesGradient", 180, hough_height, im.GRAY, im.INT)
 OneSourceOneDest("ProcessDistanceTransform", nil, nil, nil, im.FLOAT)
 OneSourceOneDest("ProcessRegionalMaximum", nil, nil, im.BINARY, nil)
 
@@ -176,6 +177,8 @@ function im.ProcessRotateNew (src_image, cos0, sin0, order)
 end
 
 OneSourceOneDest("ProcessRotateRef")
+OneSourceOneDest("ProcessWarpAffine")
+OneSourceOneDest("ProcessWarpPerspective")
 OneSourceOneDest("ProcessRotate90", function (image) return image:Height() end, function (image) return image:Width() end)
 OneSourceOneDest("ProcessRotate180")
 OneSourceOneDest("ProcessMirror")
@@ -241,8 +244,11 @@ OneSourceOneDest("ProcessSplineEdgeConvolve")
 OneSourceOneDest("ProcessPrewittConvolve")
 OneSourceOneDest("ProcessZeroCrossing")
 OneSourceOneDest("ProcessCanny")
+OneSourceOneDest("ProcessCannyHysteresis", nil, nil, im.BINARY, nil)
 OneSourceOneDest("ProcessUnaryPointOp")
 OneSourceOneDest("ProcessUnaryPointColorOp")
+OneSourceOneDest("ProcessUnaryPointLutOp")
+OneSourceOneDest("ProcessUnaryPointColorLutOp")
 OneSourceOneDest("ProcessUnArithmeticOp")
 TwoSourcesOneDest("ProcessArithmeticOp")
 OneSourceOneDest("ProcessUnsharp")
@@ -299,6 +305,15 @@ function im.ProcessMultipleMedianNew (src_image_list, dst_image)
 end
 
 TwoSourcesOneDest("ProcessAutoCovariance")
+
+function im.ProcessNormalizedCrossCorrelationNew(src_image, templ_image)
+  local data_type = im.FLOAT
+  if (src_image:DataType() == im.DOUBLE) then data_type = im.DOUBLE end
+  local dst_image = im.ImageCreateBased(src_image, nil, nil, nil, data_type)
+  local ret = im.ProcessNormalizedCrossCorrelation(src_image, templ_image, dst_image)
+  return ret, dst_image
+end
+
 TwoSourcesOneDest("ProcessMultiplyConj")
 TwoSourcesOneDest("ProcessBackSub")
 OneSourceOneDest("ProcessQuantizeRGBUniform", nil, nil, im.MAP, nil)
@@ -317,6 +332,8 @@ end
 
 OneSourceThreeDests("ProcessSplitHSI", nil, nil, im.GRAY, im.FLOAT)
 ThreeSourcesOneDest("ProcessMergeHSI", nil, nil, im.RGB, im.BYTE)
+OneSourceThreeDests("ProcessSplitHSIFast", nil, nil, im.GRAY, im.FLOAT)
+ThreeSourcesOneDest("ProcessMergeHSIFast", nil, nil, im.RGB, im.BYTE)
 
 function im.ProcessSplitComponentsNew (src_image)
   local depth = src_image:Depth()
@@ -342,6 +359,7 @@ end
 OneSourceOneDest("ProcessReplaceColor")
 OneSourceOneDest("ProcessFixBGR")
 OneSourceOneDest("ProcessSelectHue")
+OneSourceOneDest("ProcessSelectHueFast")
 TwoSourcesOneDest("ProcessBitwiseOp")
 OneSourceOneDest("ProcessBitwiseNot")
 OneSourceOneDest("ProcessBitMask")
@@ -351,14 +369,19 @@ OneSourceOneDest("ProcessUnNormalize", nil, nil, nil, im.BYTE)
 OneSourceOneDest("ProcessDirectConv", nil, nil, nil, im.BYTE)
 OneSourceOneDest("ProcessNegative")
 OneSourceOneDest("ProcessShiftHSI")
+OneSourceOneDest("ProcessShiftHSIFast")
 OneSourceOneDest("ProcessShiftComponent")
 OneSourceOneDest("ProcessRangeContrastThreshold", nil, nil, im.BINARY, nil)
 OneSourceOneDest("ProcessLocalMaxThreshold", nil, nil, im.BINARY, nil)
+OneSourceOneDest("ProcessNiblackThreshold", nil, nil, im.BINARY, nil)
+OneSourceOneDest("ProcessSauvolaThreshold", nil, nil, im.BINARY, nil)
+OneSourceOneDest("ProcessBradleyThreshold", nil, nil, im.BINARY, nil)
 OneSourceOneDest("ProcessThreshold", nil, nil, im.BINARY, nil)
 TwoSourcesOneDest("ProcessThresholdByDiff")
 OneSourceOneDest("ProcessHysteresisThreshold", nil, nil, im.BINARY, nil)
 OneSourceOneDest("ProcessUniformErrThreshold", nil, nil, im.BINARY, nil)
 OneSourceOneDest("ProcessDiffusionErrThreshold")
+OneSourceOneDest("ProcessDitherThreshold")
 OneSourceOneDest("ProcessPercentThreshold")
 OneSourceOneDest("ProcessOtsuThreshold")
 OneSourceOneDest("ProcessMinMaxThreshold", nil, nil, im.BINARY, nil)
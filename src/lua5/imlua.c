@@ -12,6 +12,7 @@
 #include "im_lib.h"
 #include "im_image.h"
 #include "im_convert.h"
+#include "im_palette.h"
 
 #include <lua.h>
 #include <lauxlib.h>
@@ -200,6 +201,11 @@ static const imlua_constant im_constants[] = {
   { "CAST_DIRECT", IM_CAST_DIRECT, NULL },
   { "CAST_USER", IM_CAST_USER, NULL },
 
+  { "PALETTE_DITHER_NONE", IM_PALETTE_DITHER_NONE, NULL },
+  { "PALETTE_DITHER_ORDERED", IM_PALETTE_DITHER_ORDERED, NULL },
+  { "PALETTE_DITHER_DIFFUSION", IM_PALETTE_DITHER_DIFFUSION, NULL },
+  { "PALETTE_DITHER_BLUENOISE", IM_PALETTE_DITHER_BLUENOISE, NULL },
+
   { "_AUTHOR",  0, IM_AUTHOR },
   { "_COPYRIGHT",  0, IM_COPYRIGHT },
   { "_VERSION_DATE",  0, IM_VERSION_DATE },
@@ -116,6 +116,22 @@ static int imluaFileNewRaw (lua_State *L)
   return imlua_pushifileerror(L, ifile, error);
 }
 
+/*****************************************************************************\
+ file:Reopen(filename)
+\*****************************************************************************/
+static int imluaFileReopen (lua_State *L)
+{
+  imFile** ifile_p = imlua_rawcheckfile(L, 1);
+  const char *filename = luaL_checkstring(L, 2);
+  int error;
+  if (!(*ifile_p))
+    luaL_argerror(L, 1, "closed imFile");
+
+  *ifile_p = imFileReopen(*ifile_p, filename, &error);  /* if NULL marks as closed */
+  imlua_pusherror(L, error);
+  return 1;
+}
+
 /*****************************************************************************\
  file:Handle()
 \*****************************************************************************/
@@ -753,6 +769,7 @@ static const luaL_Reg imfile_lib[] = {
 static const luaL_Reg imfile_metalib[] = {
   {"Handle", imluaFileHandle},
   {"Close", imluaFileClose},
+  {"Reopen", imluaFileReopen},
   {"LoadImage", imluaFileLoadImage},
   {"LoadImageFrame", imluaFileLoadImageFrame},
   {"LoadImageRegion", imluaFileLoadImageRegion},
@@ -165,6 +165,74 @@ static int imluaCalcHistogram (lua_State *L)
   return 2;
 }
 
+/*****************************************************************************\
+ im.CalcRGBHistogram(src_image, cumulative)
+\*****************************************************************************/
+static int imluaCalcRGBHistogram (lua_State *L)
+{
+  int hcount;
+  unsigned long *histo;
+  imImage* src_image = imlua_checkimage(L, 1);
+  int cumulative = lua_toboolean(L, 2);
+
+  imlua_checkhistogramtype(L, 1, src_image);
+  imlua_checkcolorspace(L, 1, src_image, IM_RGB);
+
+  hcount = imHistogramCount(src_image->data_type);
+  histo = (unsigned long*)malloc(3*hcount*sizeof(unsigned long));
+
+  lua_pushboolean(L, imCalcRGBHistogram(src_image, histo, cumulative));
+
+  imlua_newarrayulong(L, histo, hcount, 0);
+  imlua_newarrayulong(L, histo + hcount, hcount, 0);
+  imlua_newarrayulong(L, histo + 2*hcount, hcount, 0);
+
+  free(histo);
+  return 4;
+}
+
+/*****************************************************************************\
+ im.CalcHistogramTiles(src_image, plane, tile_width, tile_height, cumulative)
+\*****************************************************************************/
+static int imluaCalcHistogramTiles (lua_State *L)
+{
+  int hcount, tiles_x, tiles_y, t;
+  unsigned long *histo;
+  imImage* src_image = imlua_checkimage(L, 1);
+  int plane = (int)luaL_checkinteger(L, 2);
+  int tile_width = (int)luaL_checkinteger(L, 3);
+  int tile_height = (int)luaL_checkinteger(L, 4);
+  int cumulative = lua_toboolean(L, 5);
+
+  imlua_checkhistogramtype(L, 1, src_image);
+
+  if (plane < 0 || plane >= src_image->depth)
+    luaL_argerror(L, 2, "invalid plane");
+  if (tile_width <= 0)
+    luaL_argerror(L, 3, "invalid tile width");
+  if (tile_height <= 0)
+    luaL_argerror(L, 4, "invalid tile height");
+
+  hcount = imHistogramCount(src_image->data_type);
+  tiles_x = (src_image->width + tile_width - 1) / tile_width;
+  tiles_y = (src_image->height + tile_height - 1) / tile_height;
+  histo = (unsigned long*)malloc((size_t)tiles_x*tiles_y*hcount*sizeof(unsigned long));
+  if (!histo)
+    luaL_error(L, "not enough memory");
+
+  lua_pushboolean(L, imCalcHistogramTiles(src_image, plane, tile_width, tile_height, histo, cumulative));
+
+  lua_newtable(L);
+  for (t = 0; t < tiles_x*tiles_y; t++)
+  {
+    imlua_newarrayulong(L, histo + (size_t)t*hcount, hcount, 0);
+    lua_rawseti(L, -2, t);
+  }
+
+  free(histo);
+  return 2;
+}
+
 /*****************************************************************************\
  im.CalcGrayHistogram(src_image, cumulative)
 \*****************************************************************************/
@@ -234,6 +302,68 @@ static int imluaCalcImageStatistics (lua_State *L)
   return 2;
 }
 
+/*****************************************************************************\
+ im.CalcImageStatisticsMask(src_image, mask_image)
+\*****************************************************************************/
+static int imluaCalcImageStatisticsMask (lua_State *L)
+{
+  imStats stats[4];
+  imImage *image = imlua_checkimage(L, 1);
+  imImage *mask_image = imlua_checkimage(L, 2);
+
+  imlua_checknotcomplex(L, 1, image);
+  imlua_checkcolorspace(L, 2, mask_image, IM_BINARY);
+  imlua_matchsize(L, image, mask_image);
+
+  lua_pushboolean(L, imCalcImageStatisticsMask(image, mask_image, stats));
+
+  imlua_pushStats(L, stats, image->depth);
+  return 2;
+}
+
+/*****************************************************************************\
+ im.CalcImageStatisticsTiles(src_image, mask_image, tile_width, tile_height)
+\*****************************************************************************/
+static int imluaCalcImageStatisticsTiles (lua_State *L)
+{
+  imStats* stats;
+  int tiles_x, tiles_y, t;
+  imImage *image = imlua_checkimage(L, 1);
+  imImage *mask_image = NULL;
+  int tile_width = (int)luaL_checkinteger(L, 3);
+  int tile_height = (int)luaL_checkinteger(L, 4);
+
+  imlua_checknotcomplex(L, 1, image);
+
+  if (lua_isuserdata(L, 2)) /* optional */
+  {
+    mask_image = imlua_checkimage(L, 2);
+    imlua_checkcolorspace(L, 2, mask_image, IM_BINARY);
+    imlua_matchsize(L, image, mask_image);
+  }
+
+  if (tile_width <= 0)
+    luaL_argerror(L, 3, "invalid tile width");
+  if (tile_height <= 0)
+    luaL_argerror(L, 4, "invalid tile height");
+
+  tiles_x = (image->width + tile_width - 1) / tile_width;
+  tiles_y = (image->height + tile_height - 1) / tile_height;
+  stats = (imStats*)malloc(sizeof(imStats)*tiles_x*tiles_y*image->depth);
+
+  lua_pushboolean(L, imCalcImageStatisticsTiles(image, mask_image, tile_width, tile_height, stats));
+
+  lua_newtable(L);
+  for (t = 0; t < tiles_x*tiles_y; t++)
+  {
+    imlua_pushStats(L, stats + t*image->depth, image->depth);
+    lua_rawseti(L, -2, t);
+  }
+
+  free(stats);
+  return 2;
+}
+
 /*****************************************************************************\
  im.CalcHistogramStatistics(src_image)
 \*****************************************************************************/
@@ -528,6 +658,79 @@ static int imluaAnalyzeMeasurePerimeter (lua_State *L)
   return 2;
 }
 
+/*****************************************************************************\
+ im.AnalyzeMeasureRegions(image, [gray_image], [count])
+\*****************************************************************************/
+static void imlua_setfieldarraydouble(lua_State *L, const char* name, const double* value, int count)
+{
+  lua_pushstring(L, name);
+  imlua_newarraydouble(L, value, count, 0);
+  lua_rawset(L, -3);
+}
+
+static void imlua_setfieldarrayint(lua_State *L, const char* name, const int* value, int count)
+{
+  lua_pushstring(L, name);
+  imlua_newarrayint(L, value, count, 0);
+  lua_rawset(L, -3);
+}
+
+static int imluaAnalyzeMeasureRegions (lua_State *L)
+{
+  static const char* moment_names[IM_MOMENT_COUNT] = {"m00", "m10", "m01", "m20", "m11", "m02", "m30", "m21", "m12", "m03"};
+  int count, m;
+  imRegionMeasures* measures;
+  imImage* gray_image = NULL;
+
+  imImage* image = imlua_checkimage(L, 1);
+
+  imlua_checktype(L, 1, image, IM_GRAY, IM_USHORT);
+
+  if (!lua_isnoneornil(L, 2))
+  {
+    gray_image = imlua_checkimage(L, 2);
+    imlua_checknotcomplex(L, 2, gray_image);
+    imlua_matchsize(L, image, gray_image);
+  }
+
+  count = imlua_checkregioncount(L, 3, image);
+  measures = imRegionMeasuresCreate(count);
+  if (!measures)
+    luaL_error(L, "not enough memory");
+
+  lua_pushboolean(L, imAnalyzeMeasureRegions(image, gray_image, measures));
+
+  lua_newtable(L);
+  imlua_setfieldarrayint(L, "area", measures->area, count);
+  imlua_setfieldarraydouble(L, "cx", measures->cx, count);
+  imlua_setfieldarraydouble(L, "cy", measures->cy, count);
+  imlua_setfieldarrayint(L, "xmin", measures->xmin, count);
+  imlua_setfieldarrayint(L, "ymin", measures->ymin, count);
+  imlua_setfieldarrayint(L, "xmax", measures->xmax, count);
+  imlua_setfieldarrayint(L, "ymax", measures->ymax, count);
+  imlua_setfieldarraydouble(L, "major_angle", measures->major_angle, count);
+  imlua_setfieldarraydouble(L, "major_length", measures->major_length, count);
+  imlua_setfieldarraydouble(L, "minor_length", measures->minor_length, count);
+  imlua_setfieldarraydouble(L, "perimeter", measures->perimeter, count);
+  imlua_setfieldarraydouble(L, "mean", measures->mean, count);
+
+  lua_pushstring(L, "moment");
+  lua_newtable(L);
+  for (m = 0; m < IM_MOMENT_COUNT; m++)
+    imlua_setfieldarraydouble(L, moment_names[m], measures->moment[m], count);
+  lua_rawset(L, -3);
+
+  lua_pushstring(L, "central_moment");
+  lua_newtable(L);
+  for (m = 0; m < IM_MOMENT_COUNT; m++)
+    imlua_setfieldarraydouble(L, moment_names[m], measures->central_moment[m], count);
+  lua_rawset(L, -3);
+
+  imRegionMeasuresDestroy(measures);
+
+  return 2;
+}
+
 /*****************************************************************************\
  im.ProcessPerimeterLine(src_image, dst_image)
 \*****************************************************************************/
@@ -608,6 +811,32 @@ static int imluaProcessHoughLines (lua_State *L)
   return 0;
 }
 
+/*****************************************************************************\
+ im.ProcessHoughLinesGradient(src_image, gray_image, dst_image, theta_delta)
+\*****************************************************************************/
+static int imluaProcessHoughLinesGradient (lua_State *L)
+{
+  imImage* src_image = imlua_checkimage(L, 1);
+  imImage* dst_image = imlua_checkimage(L, 3);
+  int theta_delta = (int)luaL_checkinteger(L, 4);
+  imImage* gray_image = NULL;
+
+  imlua_checkcolorspace(L, 1, src_image, IM_BINARY);
+
+  if (lua_isuserdata(L, 2)) /* optional */
+  {
+    gray_image = imlua_checkimage(L, 2);
+    imlua_checktype(L, 2, gray_image, IM_GRAY, IM_BYTE);
+    imlua_matchsize(L, src_image, gray_image);
+  }
+
+  imlua_checktype(L, 3, dst_image, IM_GRAY, IM_INT);
+  imlua_checkhoughsize(L, src_image, dst_image, 3);
+
+  lua_pushboolean(L, imProcessHoughLinesGradient(src_image, gray_image, dst_image, theta_delta));
+  return 1;
+}
+
 /*****************************************************************************\
  im.ProcessHoughLinesDraw(src_image, hough, hough_points, dst_image)
 \*****************************************************************************/
@@ -860,6 +1089,77 @@ static int imluaProcessRotateRef (lua_State *L)
   return 1;
 }
 
+/*****************************************************************************\
+ im.ProcessWarpAffine
+\*****************************************************************************/
+static int imluaProcessWarpAffine (lua_State *L)
+{
+  int count;
+  double *matrix;
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *dst_image = imlua_checkimage(L, 2);
+  int order = imlua_getorder(L, src_image, 4);
+
+  imlua_matchcolor(L, src_image, dst_image);
+
+  matrix = imlua_toarraydouble(L, 3, &count, 1);
+  if (count != 6)
+  {
+    free(matrix);
+    luaL_argerror(L, 3, "matrix must have 6 elements");
+  }
+
+  lua_pushboolean(L, imProcessWarpAffine(src_image, dst_image, matrix, order));
+  free(matrix);
+  return 1;
+}
+
+/*****************************************************************************\
+ im.ProcessWarpPerspective
+\*****************************************************************************/
+static int imluaProcessWarpPerspective (lua_State *L)
+{
+  int count;
+  double *matrix;
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *dst_image = imlua_checkimage(L, 2);
+  int order = imlua_getorder(L, src_image, 4);
+
+  imlua_matchcolor(L, src_image, dst_image);
+
+  matrix = imlua_toarraydouble(L, 3, &count, 1);
+  if (count != 9)
+  {
+    free(matrix);
+    luaL_argerror(L, 3, "matrix must have 9 elements");
+  }
+
+  lua_pushboolean(L, imProcessWarpPerspective(src_image, dst_image, matrix, order));
+  free(matrix);
+  return 1;
+}
+
+/*****************************************************************************\
+ im.ProcessRemap
+\*****************************************************************************/
+static int imluaProcessRemap (lua_State *L)
+{
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *map_x_image = imlua_checkimage(L, 2);
+  imImage *map_y_image = imlua_checkimage(L, 3);
+  imImage *dst_image = imlua_checkimage(L, 4);
+  int order = imlua_getorder(L, src_image, 5);
+
+  imlua_matchcolor(L, src_image, dst_image);
+  imlua_checktype(L, 2, map_x_image, IM_GRAY, IM_FLOAT);
+  imlua_checktype(L, 3, map_y_image, IM_GRAY, IM_FLOAT);
+  imlua_matchsize(L, map_x_image, dst_image);
+  imlua_matchsize(L, map_y_image, dst_image);
+
+  lua_pushboolean(L, imProcessRemap(src_image, map_x_image, map_y_image, dst_image, order));
+  return 1;
+}
+
 /*****************************************************************************\
  im.ProcessRotate90
 \*****************************************************************************/
@@ -1595,6 +1895,25 @@ static int imluaProcessCanny (lua_State *L)
   return 1;
 }
 
+/*****************************************************************************\
+ im.ProcessCannyHysteresis
+\*****************************************************************************/
+static int imluaProcessCannyHysteresis (lua_State *L)
+{
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *dst_image = imlua_checkimage(L, 2);
+  double stddev =  luaL_checknumber(L, 3);
+  int low_thres = (int)luaL_checkinteger(L, 4);
+  int high_thres = (int)luaL_checkinteger(L, 5);
+
+  imlua_checktype(L, 1, src_image, IM_GRAY, IM_BYTE);
+  imlua_checkcolorspace(L, 2, dst_image, IM_BINARY);
+  imlua_matchsize(L, src_image, dst_image);
+
+  lua_pushboolean(L, imProcessCannyHysteresis(src_image, dst_image, stddev, low_thres, high_thres));
+  return 1;
+}
+
 /*****************************************************************************\
  im.ProcessUnsharp
 \*****************************************************************************/
@@ -1771,6 +2090,38 @@ static int imluaProcessUnaryPointOp(lua_State *L)
   return 1;
 }
 
+static int imluaProcessUnaryPointLutOp(lua_State *L)
+{
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *dst_image = imlua_checkimage(L, 2);
+  const char *op_name = luaL_optstring(L, 6, NULL);
+  int use_lut = (src_image->data_type == IM_BYTE || src_image->data_type == IM_USHORT);
+
+#ifdef _OPENMP
+  /* when the table is used the function is called sequentially, 
+     and the table can be applied in parallel */
+  int old_num_threads = omp_get_num_threads();
+  if (!use_lut) omp_set_num_threads(1);
+#endif
+
+  imlua_checknotcomplex(L, 1, src_image);
+  imlua_checknotcomplex(L, 1, dst_image);
+  imlua_matchsize(L, src_image, dst_image);
+  if (src_image->depth != dst_image->depth)
+    luaL_error(L, "images must have the same depth");
+  luaL_checktype(L, 3, LUA_TFUNCTION);
+  luaL_checktype(L, 4, LUA_TTABLE);
+  /* no need to check the userdata at 5 */
+
+  lua_pushboolean(L, imProcessUnaryPointLutOp(src_image, dst_image, imluaUnOpFunc, NULL, L, op_name));
+
+#ifdef _OPENMP
+  if (!use_lut) omp_set_num_threads(old_num_threads);
+#endif
+
+  return 1;
+}
+
 static int imluaUnColorOpFunc(const double* src_value, double* dst_value, double* params, void* userdata, int x, int y)
 {
   int d, n, ret = 0;
@@ -1832,6 +2183,42 @@ static int imluaProcessUnaryPointColorOp(lua_State *L)
   return 1;
 }
 
+static int imluaProcessUnaryPointColorLutOp(lua_State *L)
+{
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *dst_image = imlua_checkimage(L, 2);
+  const char *op_name = luaL_optstring(L, 6, NULL);
+  int src_depth = src_image->has_alpha && dst_image->has_alpha? src_image->depth+1: src_image->depth;
+  int dst_depth = dst_image->has_alpha? dst_image->depth+1: dst_image->depth;
+  int use_lut = src_depth == 1 && (src_image->data_type == IM_BYTE || src_image->data_type == IM_USHORT);
+  double params[2];
+
+#ifdef _OPENMP
+  /* when the table is used the function is called sequentially, 
+     and the table can be applied in parallel */
+  int old_num_threads = omp_get_num_threads();
+  if (!use_lut) omp_set_num_threads(1);
+#endif
+
+  params[0] = src_depth;
+  params[1] = dst_depth;
+
+  imlua_checknotcomplex(L, 1, src_image);
+  imlua_checknotcomplex(L, 1, dst_image);
+  imlua_matchsize(L, src_image, dst_image);
+  luaL_checktype(L, 3, LUA_TFUNCTION);
+  luaL_checktype(L, 4, LUA_TTABLE);
+  /* no need to check the userdata at 5 */
+
+  lua_pushboolean(L, imProcessUnaryPointColorLutOp(src_image, dst_image, imluaUnColorOpFunc, params, L, op_name));
+
+#ifdef _OPENMP
+  if (!use_lut) omp_set_num_threads(old_num_threads);
+#endif
+
+  return 1;
+}
+
 static int imluaMultiOpFunc(const double* src_value, double *dst_value, double* params, void* userdata, int x, int y, int d, int src_count)
 {
   lua_State *L = userdata;
@@ -2266,6 +2653,7 @@ static int imluaProcessAutoCovariance (lua_State *L)
 
   imlua_match(L, src_image, mean_image);
   imlua_matchcolorspace(L, src_image, dst_image);
+  imlua_matchcheck(L, dst_image->width <= src_image->width && dst_image->height <= src_image->height, "target can not be larger than the source");
   imlua_checkreal(L, 3, dst_image);
   imlua_checkreal_dst(L, 3, src_image, dst_image);
 
@@ -2273,6 +2661,27 @@ static int imluaProcessAutoCovariance (lua_State *L)
   return 1;
 }
 
+/*****************************************************************************\
+ im.ProcessNormalizedCrossCorrelation
+\*****************************************************************************/
+static int imluaProcessNormalizedCrossCorrelation (lua_State *L)
+{
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *templ_image = imlua_checkimage(L, 2);
+  imImage *dst_image = imlua_checkimage(L, 3);
+
+  imlua_checknotcomplex(L, 1, src_image);
+  imlua_checknotcomplex(L, 2, templ_image);
+  luaL_argcheck(L, templ_image->depth == src_image->depth, 2, "template must have the same depth of the source");
+  imlua_matchsize(L, src_image, dst_image);
+  imlua_matchcolorspace(L, src_image, dst_image);
+  imlua_checkreal(L, 3, dst_image);
+  imlua_checkreal_dst(L, 3, src_image, dst_image);
+
+  lua_pushboolean(L, imProcessNormalizedCrossCorrelation(src_image, templ_image, dst_image));
+  return 1;
+}
+
 /*****************************************************************************\
  im.ProcessMultiplyConj
 \*****************************************************************************/
@@ -2314,7 +2723,7 @@ static int imluaProcessQuantizeRGBUniform (lua_State *L)
 {
   imImage *src_image = imlua_checkimage(L, 1);
   imImage *dst_image = imlua_checkimage(L, 2);
-  int dither = lua_toboolean(L, 3);
+  int dither = lua_type(L, 3) == LUA_TNUMBER? (int)lua_tointeger(L, 3): lua_toboolean(L, 3);
 
   imlua_checktype(L, 1, src_image, IM_RGB, IM_BYTE);
   imlua_checkcolorspace(L, 2, dst_image, IM_MAP);
@@ -2337,6 +2746,23 @@ static int imluaProcessQuantizeRGBMedianCut(lua_State *L)
   return 0;
 }
 
+/*****************************************************************************\
+ im.ProcessQuantizeRGBPalette
+\*****************************************************************************/
+static int imluaProcessQuantizeRGBPalette(lua_State *L)
+{
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *dst_image = imlua_checkimage(L, 2);
+  int dither = lua_type(L, 3) == LUA_TNUMBER? (int)lua_tointeger(L, 3): lua_toboolean(L, 3);
+
+  imlua_checktype(L, 1, src_image, IM_RGB, IM_BYTE);
+  imlua_checkcolorspace(L, 2, dst_image, IM_MAP);
+  imlua_matchsize(L, src_image, dst_image);
+
+  lua_pushboolean(L, imProcessQuantizeRGBPalette(src_image, dst_image, dither));
+  return 1;
+}
+
 /*****************************************************************************\
  im.ProcessQuantizeGrayUniform
 \*****************************************************************************/
@@ -2460,6 +2886,29 @@ static int imluaProcessSplitHSI (lua_State *L)
   return 0;
 }
 
+/*****************************************************************************\
+ im.ProcessSplitHSIFast
+\*****************************************************************************/
+static int imluaProcessSplitHSIFast (lua_State *L)
+{
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *h_image = imlua_checkimage(L, 2);
+  imImage *s_image = imlua_checkimage(L, 3);
+  imImage *i_image = imlua_checkimage(L, 4);
+
+  imlua_checkcolorspace(L, 1, src_image, IM_RGB);
+  luaL_argcheck(L, src_image->data_type == IM_BYTE || src_image->data_type == IM_FLOAT, 1, "data type can be byte or float only");
+  imlua_checktype(L, 2, h_image, IM_GRAY, IM_FLOAT);
+  imlua_checktype(L, 3, s_image, IM_GRAY, IM_FLOAT);
+  imlua_checktype(L, 4, i_image, IM_GRAY, IM_FLOAT);
+  imlua_matchsize(L, src_image, h_image);
+  imlua_matchsize(L, src_image, s_image);
+  imlua_matchsize(L, src_image, i_image);
+
+  imProcessSplitHSIFast(src_image, h_image, s_image, i_image);
+  return 0;
+}
+
 /*****************************************************************************\
  im.ProcessMergeHSI
 \*****************************************************************************/
@@ -2483,6 +2932,29 @@ static int imluaProcessMergeHSI (lua_State *L)
   return 0;
 }
 
+/*****************************************************************************\
+ im.ProcessMergeHSIFast
+\*****************************************************************************/
+static int imluaProcessMergeHSIFast (lua_State *L)
+{
+  imImage *h_image = imlua_checkimage(L, 1);
+  imImage *s_image = imlua_checkimage(L, 2);
+  imImage *i_image = imlua_checkimage(L, 3);
+  imImage *dst_image = imlua_checkimage(L, 4);
+
+  imlua_checktype(L, 1, h_image, IM_GRAY, IM_FLOAT);
+  imlua_checktype(L, 2, s_image, IM_GRAY, IM_FLOAT);
+  imlua_checktype(L, 3, i_image, IM_GRAY, IM_FLOAT);
+  imlua_checkcolorspace(L, 4, dst_image, IM_RGB);
+  luaL_argcheck(L, dst_image->data_type == IM_BYTE || dst_image->data_type == IM_FLOAT, 4, "data type can be byte or float only");
+  imlua_matchsize(L, dst_image, h_image);
+  imlua_matchsize(L, dst_image, s_image);
+  imlua_matchsize(L, dst_image, i_image);
+
+  imProcessMergeHSIFast(h_image, s_image, i_image, dst_image);
+  return 0;
+}
+
 /*****************************************************************************\
  im.ProcessSplitComponents(src_image, { r, g, b} )
 \*****************************************************************************/
@@ -2624,6 +3096,18 @@ static int imluaProcessSelectHue(lua_State *L)
   return 0;
 }
 
+static int imluaProcessSelectHueFast(lua_State *L)
+{
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *dst_image = imlua_checkimage(L, 2);
+
+  imlua_match(L, src_image, dst_image);
+  imlua_checkcolorspace(L, 1, src_image, IM_RGB);
+
+  imProcessSelectHueFast(src_image, dst_image, luaL_checknumber(L, 3), luaL_checknumber(L, 4));
+  return 0;
+}
+
 /*****************************************************************************\
  im.ProcessReplaceColor
 \*****************************************************************************/
@@ -2915,6 +3399,15 @@ static int imluaProcessRenderAddUniformNoise (lua_State *L)
   return 1;
 }
 
+/*****************************************************************************\
+ im.ProcessRenderRandomSeed
+\*****************************************************************************/
+static int imluaProcessRenderRandomSeed (lua_State *L)
+{
+  imProcessRenderRandomSeed((unsigned int)luaL_checkinteger(L, 1));
+  return 0;
+}
+
 /*****************************************************************************\
  im.ProcessRenderRandomNoise
 \*****************************************************************************/
@@ -3158,6 +3651,98 @@ static int imluaProcessRenderFloodFill(lua_State *L)
   return 0;
 }
 
+/*****************************************************************************\
+ im.ProcessRenderFloodFillSeeds
+\*****************************************************************************/
+static int imluaProcessRenderFloodFillSeeds(lua_State *L)
+{
+  imImage *image = imlua_checkimage(L, 1);
+  double tolerance = luaL_checknumber(L, 5);
+  int tol_space = (int)luaL_optinteger(L, 6, IM_RGB);
+  int count, seed_count, i, area;
+  int *seed_x, *seed_y;
+  double *color;
+  imFloodFillResult* results;
+
+  imlua_checknotcomplex(L, 1, image);
+  if (image->color_space != IM_RGB && image->color_space != IM_GRAY)
+  {
+    luaL_argerror(L, 1, "color space must be RGB or GRAY");
+    return 0;
+  }
+
+  if (tol_space != IM_RGB && tol_space != IM_LAB)
+    luaL_argerror(L, 6, "tolerance color space must be RGB or LAB");
+
+  /* minimize leak when error, checking array after other checks */
+  color = imlua_toarraydouble(L, 4, &count, 1);
+  if (count != (image->color_space == IM_RGB? 3: 1))
+  {
+    free(color);
+    luaL_argerror(L, 4, image->color_space == IM_RGB? "the color must have 3 components": "the color must have 1 component");
+    return 0;
+  }
+
+  seed_x = imlua_toarrayint(L, 2, &seed_count, 1);
+  seed_y = imlua_toarrayint(L, 3, &count, 1);
+  if (count != seed_count)
+  {
+    free(color);
+    free(seed_x);
+    free(seed_y);
+    luaL_argerror(L, 3, "the seed arrays must have the same size");
+    return 0;
+  }
+
+  results = (imFloodFillResult*)malloc(seed_count * sizeof(imFloodFillResult));
+  if (!results)
+  {
+    free(color);
+    free(seed_x);
+    free(seed_y);
+    luaL_error(L, "not enough memory");
+    return 0;
+  }
+
+  area = imProcessRenderFloodFillSeeds(image, seed_count, seed_x, seed_y, color, tolerance, tol_space, results);
+  lua_pushinteger(L, area);
+
+  if (area == -1)
+  {
+    /* results were not filled */
+    lua_pushnil(L);
+
+    free(results);
+    free(color);
+    free(seed_x);
+    free(seed_y);
+    return 2;
+  }
+
+  lua_createtable(L, seed_count, 0);
+  for (i = 0; i < seed_count; i++)
+  {
+    lua_createtable(L, 0, 5);
+    lua_pushinteger(L, results[i].area);
+    lua_setfield(L, -2, "area");
+    lua_pushinteger(L, results[i].xmin);
+    lua_setfield(L, -2, "xmin");
+    lua_pushinteger(L, results[i].ymin);
+    lua_setfield(L, -2, "ymin");
+    lua_pushinteger(L, results[i].xmax);
+    lua_setfield(L, -2, "xmax");
+    lua_pushinteger(L, results[i].ymax);
+    lua_setfield(L, -2, "ymax");
+    lua_rawseti(L, -2, i + 1);
+  }
+
+  free(results);
+  free(color);
+  free(seed_x);
+  free(seed_y);
+  return 2;
+}
+
 
 /*****************************************************************************\
  Tone Gamut Operations
@@ -3315,6 +3900,21 @@ static int imluaProcessShiftHSI(lua_State *L)
   return 0;
 }
 
+static int imluaProcessShiftHSIFast(lua_State *L)
+{
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *dst_image = imlua_checkimage(L, 2);
+
+  imlua_checkcolorspace(L, 1, src_image, IM_RGB);
+  imlua_checknotcomplex(L, 1, src_image);
+  imlua_match(L, src_image, dst_image);
+
+  imProcessShiftHSIFast(src_image, dst_image, luaL_checknumber(L, 3), 
+                                              luaL_checknumber(L, 4), 
+                                              luaL_checknumber(L, 5));
+  return 0;
+}
+
 static int imluaProcessShiftComponent(lua_State *L)
 {
   imImage *src_image = imlua_checkimage(L, 1);
@@ -3372,6 +3972,64 @@ static int imluaProcessLocalMaxThreshold (lua_State *L)
   return 1;
 }
 
+/*****************************************************************************\
+ im.ProcessNiblackThreshold
+\*****************************************************************************/
+static int imluaProcessNiblackThreshold (lua_State *L)
+{
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *dst_image = imlua_checkimage(L, 2);
+  int kernel_size = (int)luaL_checkinteger(L, 3);
+  double k = luaL_checknumber(L, 4);
+
+  imlua_checkcolorspace(L, 1, src_image, IM_GRAY);
+  imlua_checknotcomplex(L, 1, src_image);
+  imlua_checkcolorspace(L, 2, dst_image, IM_BINARY);
+  imlua_matchsize(L, src_image, dst_image);
+
+  lua_pushboolean(L, imProcessNiblackThreshold(src_image, dst_image, kernel_size, k));
+  return 1;
+}
+
+/*****************************************************************************\
+ im.ProcessSauvolaThreshold
+\*****************************************************************************/
+static int imluaProcessSauvolaThreshold (lua_State *L)
+{
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *dst_image = imlua_checkimage(L, 2);
+  int kernel_size = (int)luaL_checkinteger(L, 3);
+  double k = luaL_checknumber(L, 4);
+  double range = luaL_checknumber(L, 5);
+
+  imlua_checkcolorspace(L, 1, src_image, IM_GRAY);
+  imlua_checknotcomplex(L, 1, src_image);
+  imlua_checkcolorspace(L, 2, dst_image, IM_BINARY);
+  imlua_matchsize(L, src_image, dst_image);
+
+  lua_pushboolean(L, imProcessSauvolaThreshold(src_image, dst_image, kernel_size, k, range));
+  return 1;
+}
+
+/*****************************************************************************\
+ im.ProcessBradleyThreshold
+\*****************************************************************************/
+static int imluaProcessBradleyThreshold (lua_State *L)
+{
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *dst_image = imlua_checkimage(L, 2);
+  int kernel_size = (int)luaL_checkinteger(L, 3);
+  double percent = luaL_checknumber(L, 4);
+
+  imlua_checkcolorspace(L, 1, src_image, IM_GRAY);
+  imlua_checknotcomplex(L, 1, src_image);
+  imlua_checkcolorspace(L, 2, dst_image, IM_BINARY);
+  imlua_matchsize(L, src_image, dst_image);
+
+  lua_pushboolean(L, imProcessBradleyThreshold(src_image, dst_image, kernel_size, percent));
+  return 1;
+}
+
 /*****************************************************************************\
  im.ProcessThreshold
 \*****************************************************************************/
@@ -3481,6 +4139,25 @@ static int imluaProcessDiffusionErrThreshold (lua_State *L)
   return 0;
 }
 
+/*****************************************************************************\
+ im.ProcessDitherThreshold
+\*****************************************************************************/
+static int imluaProcessDitherThreshold (lua_State *L)
+{
+  imImage *src_image = imlua_checkimage(L, 1);
+  imImage *dst_image = imlua_checkimage(L, 2);
+  int level = (int)luaL_checkinteger(L, 3);
+  int dither = (int)luaL_checkinteger(L, 4);
+
+  imlua_checkdatatype(L, 1, src_image, IM_BYTE);
+  imlua_checkdatatype(L, 2, dst_image, IM_BYTE);
+  imlua_matchcheck(L, src_image->depth == dst_image->depth, "images must have the same depth");
+  imlua_matchsize(L, src_image, dst_image);
+
+  lua_pushboolean(L, imProcessDitherThreshold(src_image, dst_image, level, dither));
+  return 1;
+}
+
 /*****************************************************************************\
  im.ProcessPercentThreshold
 \*****************************************************************************/
@@ -3698,7 +4375,11 @@ static const luaL_Reg improcess_lib[] = {
   {"CalcCountColors", imluaCalcCountColors},
   {"CalcHistogram", imluaCalcHistogram},
   {"CalcGrayHistogram", imluaCalcGrayHistogram},
+  {"CalcRGBHistogram", imluaCalcRGBHistogram},
+  {"CalcHistogramTiles", imluaCalcHistogramTiles},
   {"CalcImageStatistics", imluaCalcImageStatistics},
+  {"CalcImageStatisticsMask", imluaCalcImageStatisticsMask},
+  {"CalcImageStatisticsTiles", imluaCalcImageStatisticsTiles},
   {"CalcHistogramStatistics", imluaCalcHistogramStatistics},
   {"CalcHistoImageStatistics", imluaCalcHistoImageStatistics},
   {"CalcPercentMinMax", imluaCalcPercentMinMax},
@@ -3710,6 +4391,7 @@ static const luaL_Reg improcess_lib[] = {
   {"AnalyzeMeasurePrincipalAxis", imluaAnalyzeMeasurePrincipalAxis},
   {"AnalyzeMeasurePerimeter", imluaAnalyzeMeasurePerimeter},
   {"AnalyzeMeasureHoles", imluaAnalyzeMeasureHoles},
+  {"AnalyzeMeasureRegions", imluaAnalyzeMeasureRegions},
 
   {"ProcessPerimeterLine", imluaProcessPerimeterLine},
   {"ProcessRemoveByArea", imluaProcessRemoveByArea},
@@ -3717,6 +4399,7 @@ static const luaL_Reg improcess_lib[] = {
 
   {"ProcessHoughLines", imluaProcessHoughLines},
   {"ProcessHoughLinesDraw", imluaProcessHoughLinesDraw},
+  {"ProcessHoughLinesGradient", imluaProcessHoughLinesGradient},
   {"ProcessDistanceTransform", imluaProcessDistanceTransform},
   {"ProcessRegionalMaximum", imluaProcessRegionalMaximum},
 
@@ -3730,6 +4413,9 @@ static const luaL_Reg improcess_lib[] = {
   {"ProcessCalcRotateSize", imluaProcessCalcRotateSize},
   {"ProcessRotate", imluaProcessRotate},
   {"ProcessRotateRef", imluaProcessRotateRef},
+  {"ProcessWarpAffine", imluaProcessWarpAffine},
+  {"ProcessWarpPerspective", imluaProcessWarpPerspective},
+  {"ProcessRemap", imluaProcessRemap},
   {"ProcessRotate90", imluaProcessRotate90},
   {"ProcessRotate180", imluaProcessRotate180},
   {"ProcessMirror", imluaProcessMirror},
@@ -3777,6 +4463,7 @@ static const luaL_Reg improcess_lib[] = {
   {"ProcessSplineEdgeConvolve", imluaProcessSplineEdgeConvolve},
   {"ProcessZeroCrossing", imluaProcessZeroCrossing},
   {"ProcessCanny", imluaProcessCanny},
+  {"ProcessCannyHysteresis", imluaProcessCannyHysteresis},
   {"ProcessUnsharp", imluaProcessUnsharp},
   {"ProcessSharp", imluaProcessSharp},
   {"ProcessSharpKernel", imluaProcessSharpKernel},
@@ -3785,6 +4472,8 @@ static const luaL_Reg improcess_lib[] = {
 
   {"ProcessUnaryPointOp", imluaProcessUnaryPointOp},
   {"ProcessUnaryPointColorOp", imluaProcessUnaryPointColorOp},
+  {"ProcessUnaryPointLutOp", imluaProcessUnaryPointLutOp},
+  {"ProcessUnaryPointColorLutOp", imluaProcessUnaryPointColorLutOp},
   {"ProcessMultiPointOp", imluaProcessMultiPointOp},
   {"ProcessMultiPointColorOp", imluaProcessMultiPointColorOp},
   {"ProcessUnArithmeticOp", imluaProcessUnArithmeticOp},
@@ -3799,6 +4488,7 @@ static const luaL_Reg improcess_lib[] = {
   {"ProcessMultipleStdDev", imluaProcessMultipleStdDev},
   { "ProcessMultipleMedian", imluaProcessMultipleMedian },
   { "ProcessAutoCovariance", imluaProcessAutoCovariance },
+  { "ProcessNormalizedCrossCorrelation", imluaProcessNormalizedCrossCorrelation },
   {"ProcessMultiplyConj", imluaProcessMultiplyConj},
   { "ProcessBackSub", imluaProcessBackSub },
 
@@ -3806,6 +4496,7 @@ static const luaL_Reg improcess_lib[] = {
   {"ProcessQuantizeRGBUniform", imluaProcessQuantizeRGBUniform},
   {"ProcessQuantizeGrayUniform", imluaProcessQuantizeGrayUniform},
   { "ProcessQuantizeRGBMedianCut", imluaProcessQuantizeRGBMedianCut },
+  { "ProcessQuantizeRGBPalette", imluaProcessQuantizeRGBPalette },
   { "ProcessQuantizeGrayMedianCut", imluaProcessQuantizeGrayMedianCut },
 
   {"ProcessExpandHistogram", imluaProcessExpandHistogram},
@@ -3814,6 +4505,8 @@ static const luaL_Reg improcess_lib[] = {
   {"ProcessSplitYChroma", imluaProcessSplitYChroma},
   {"ProcessSplitHSI", imluaProcessSplitHSI},
   {"ProcessMergeHSI", imluaProcessMergeHSI},
+  {"ProcessSplitHSIFast", imluaProcessSplitHSIFast},
+  {"ProcessMergeHSIFast", imluaProcessMergeHSIFast},
   {"ProcessSplitComponents", imluaProcessSplitComponents},
   {"ProcessMergeComponents", imluaProcessMergeComponents},
   {"ProcessNormalizeComponents", imluaProcessNormalizeComponents},
@@ -3822,6 +4515,7 @@ static const luaL_Reg improcess_lib[] = {
   { "ProcessPseudoColor", imluaProcessPseudoColor },
   { "ProcessFixBGR", imluaProcessFixBGR },
   { "ProcessSelectHue", imluaProcessSelectHue },
+  { "ProcessSelectHueFast", imluaProcessSelectHueFast },
 
   {"ProcessBitwiseOp", imluaProcessBitwiseOp},
   {"ProcessBitwiseNot", imluaProcessBitwiseNot},
@@ -3834,6 +4528,7 @@ static const luaL_Reg improcess_lib[] = {
   {"ProcessRenderAddGaussianNoise", imluaProcessRenderAddGaussianNoise},
   {"ProcessRenderAddUniformNoise", imluaProcessRenderAddUniformNoise},
   {"ProcessRenderRandomNoise", imluaProcessRenderRandomNoise},
+  {"ProcessRenderRandomSeed", imluaProcessRenderRandomSeed},
   {"ProcessRenderConstant", imluaProcessRenderConstant},
   {"ProcessRenderWheel", imluaProcessRenderWheel},
   {"ProcessRenderCone", imluaProcessRenderCone},
@@ -3847,6 +4542,7 @@ static const luaL_Reg improcess_lib[] = {
   {"ProcessRenderGrid", imluaProcessRenderGrid},
   {"ProcessRenderChessboard", imluaProcessRenderChessboard},
   {"ProcessRenderFloodFill", imluaProcessRenderFloodFill },
+  {"ProcessRenderFloodFillSeeds", imluaProcessRenderFloodFillSeeds },
 
   {"ProcessToneGamut", imluaProcessToneGamut},
   {"ProcessUnNormalize", imluaProcessUnNormalize},
@@ -3854,16 +4550,21 @@ static const luaL_Reg improcess_lib[] = {
   {"ProcessNegative", imluaProcessNegative},
   {"ProcessCalcAutoGamma", imluaProcessCalcAutoGamma},
   {"ProcessShiftHSI", imluaProcessShiftHSI},
+  {"ProcessShiftHSIFast", imluaProcessShiftHSIFast},
   { "ProcessShiftComponent", imluaProcessShiftComponent },
 
   {"ProcessRangeContrastThreshold", imluaProcessRangeContrastThreshold},
   {"ProcessLocalMaxThreshold", imluaProcessLocalMaxThreshold},
+  {"ProcessNiblackThreshold", imluaProcessNiblackThreshold},
+  {"ProcessSauvolaThreshold", imluaProcessSauvolaThreshold},
+  {"ProcessBradleyThreshold", imluaProcessBradleyThreshold},
   {"ProcessThreshold", imluaProcessThreshold},
   {"ProcessThresholdByDiff", imluaProcessThresholdByDiff},
   {"ProcessHysteresisThreshold", imluaProcessHysteresisThreshold},
   {"ProcessHysteresisThresEstimate", imluaProcessHysteresisThresEstimate},
   {"ProcessUniformErrThreshold", imluaProcessUniformErrThreshold},
   {"ProcessDiffusionErrThreshold", imluaProcessDiffusionErrThreshold},
+  {"ProcessDitherThreshold", imluaProcessDitherThreshold},
   {"ProcessPercentThreshold", imluaProcessPercentThreshold},
   {"ProcessOtsuThreshold", imluaProcessOtsuThreshold},
   {"ProcessMinMaxThreshold", imluaProcessMinMaxThreshold},
@@ -3928,6 +4629,7 @@ static const imlua_constant im_process_constants[] = {
   { "BIT_OR", IM_BIT_OR, NULL },
   { "BIT_XOR", IM_BIT_XOR, NULL },
 
+
   { "GAMUT_NORMALIZE", IM_GAMUT_NORMALIZE, NULL },
   { "GAMUT_POW", IM_GAMUT_POW, NULL },
   { "GAMUT_LOG", IM_GAMUT_LOG, NULL },
@@ -628,7 +628,7 @@ static int iCalcMoment(double* cm, int px, int py, const imImage* image, const d
 }
 
 template<class T>
-static inline int IsPerimeterPoint(T* map, int width, int height, int x, int y)
+static inline int IsPerimeterPoint(const T* map, int width, int height, int x, int y)
 {
   // map here points to the start of the line, even if its an invalid line.
 
@@ -656,98 +656,16 @@ static inline int IsPerimeterPoint(T* map, int width, int height, int x, int y)
   return 0;
 }
 
-int imAnalyzeMeasurePrincipalAxis(const imImage* image, const int* data_area, const double* data_cx, const double* data_cy,
-                                   const int region_count, double* major_slope, double* major_length, 
-                                                           double* minor_slope, double* minor_length)
-{
-  int *local_data_area = 0;
-  double *local_data_cx = 0, *local_data_cy = 0;
-  int ret = 0;
-
-  int counter = imProcessCounterBegin("PrincipalAxis");
-
-  if (!data_area)
-  {
-    local_data_area = (int*)malloc(region_count*sizeof(int));
-    ret = imAnalyzeMeasureArea(image, local_data_area, region_count);
-    data_area = (const int*)local_data_area;
-
-    if (!ret)
-    {
-      free(local_data_area);
-      imProcessCounterEnd(counter);
-      return 0;
-    }
-  }
-
-  if (!data_cx || !data_cy)
-  {
-    if (!data_cx)
-    {
-      local_data_cx = (double*)malloc(region_count*sizeof(double));
-      data_cx = (const double*)local_data_cx;
-    }
-
-    if (!data_cy)
-    {
-      local_data_cy = (double*)malloc(region_count*sizeof(double));
-      data_cy = (const double*)local_data_cy;
-    }
-
-    ret = 1;
-    if (local_data_cx && local_data_cy)
-      ret = imAnalyzeMeasureCentroid(image, data_area, region_count, local_data_cx, local_data_cy);
-    else if (local_data_cx)
-      ret = imAnalyzeMeasureCentroid(image, data_area, region_count, local_data_cx, NULL);
-    else if (local_data_cy)
-      ret = imAnalyzeMeasureCentroid(image, data_area, region_count, NULL, local_data_cy);
+/* Maximum memory used by the per-thread partial results of the region measures */
+#define IM_REGION_ACC_MAXMEM (64*1024*1024)
 
-    if (!ret)
-    {
-      if (local_data_cx) free(local_data_cx);
-      if (local_data_cy) free(local_data_cy);
-      imProcessCounterEnd(counter);
-      return 0;
-    }
-  }
-
-  imCounterTotal(counter, 4 * image->height + 2 * region_count, "Analyzing...");
-
-  // additional moments
-  double* cm20 = (double*)malloc(region_count*sizeof(double));
-  double* cm02 = (double*)malloc(region_count*sizeof(double));
-  double* cm11 = (double*)malloc(region_count*sizeof(double));
-  
-  ret = iCalcMoment(cm20, 2, 0, image, data_cx, data_cy, region_count, counter);
-  if (!ret)
-  {
-    if (local_data_area) free(local_data_area);
-    if (local_data_cx) free(local_data_cx);
-    if (local_data_cy) free(local_data_cy);
-    if (cm20) free(cm20); if (cm02) free(cm02); if (cm11) free(cm11);
-    imProcessCounterEnd(counter);
-    return 0;
-  }
-  ret = iCalcMoment(cm02, 0, 2, image, data_cx, data_cy, region_count, counter);
-  if (!ret)
-  {
-    if (local_data_area) free(local_data_area);
-    if (local_data_cx) free(local_data_cx);
-    if (local_data_cy) free(local_data_cy);
-    if (cm20) free(cm20); if (cm02) free(cm02); if (cm11) free(cm11);
-    imProcessCounterEnd(counter);
-    return 0;
-  }
-  ret = iCalcMoment(cm11, 1, 1, image, data_cx, data_cy, region_count, counter);
-  if (!ret)
-  {
-    if (local_data_area) free(local_data_area);
-    if (local_data_cx) free(local_data_cx);
-    if (local_data_cy) free(local_data_cy);
-    if (cm20) free(cm20); if (cm02) free(cm02); if (cm11) free(cm11);
-    imProcessCounterEnd(counter);
-    return 0;
-  }
+/* Principal axes from the second order central moments, 
+   the axis lengths are the maximum extent of the perimeter points on each side of the axes. */
+static int iCalcPrincipalAxis(const imImage* image, const double* data_cx, const double* data_cy, 
+                              const double* cm20, const double* cm02, const double* cm11, int region_count, 
+                              double* major_slope, double* major_length, double* minor_slope, double* minor_length, int counter)
+{
+  int ret = 1;
 
   double *local_major_slope = 0, *local_minor_slope = 0;
   if (!major_slope)
@@ -833,37 +751,53 @@ int imAnalyzeMeasurePrincipalAxis(const imImage* image, const int* data_area, co
       free(A2);
       free(C1);
       free(C2);
-
-      if (local_data_area) free(local_data_area);
-      if (local_data_cx) free(local_data_cx);
-      if (local_data_cy) free(local_data_cy);
-      if (cm20) free(cm20); if (cm02) free(cm02); if (cm11) free(cm11);
-
-      imProcessCounterEnd(counter);
       return 0;
     }
   }
 
-  // moments are not necessary anymore
-  free(cm20); free(cm02); free(cm11);
-  cm20 = 0; cm02 = 0; cm11 = 0;
-
   // maximum distance from a point in the perimeter to an axis in each side of the axis
-  // D1 is distance to axis 1, a and b are sides
-  double* D1a = (double*)malloc(region_count*sizeof(double));
-  double* D1b = (double*)malloc(region_count*sizeof(double));
-  double* D2a = (double*)malloc(region_count*sizeof(double));
-  double* D2b = (double*)malloc(region_count*sizeof(double));
-  memset(D1a, 0, region_count*sizeof(double));
-  memset(D1b, 0, region_count*sizeof(double));
-  memset(D2a, 0, region_count*sizeof(double));
-  memset(D2b, 0, region_count*sizeof(double));
-
-  imushort* img_data = (imushort*)image->data[0];
+  // D1 is distance to axis 1, a and b are sides.
+  // Each thread has its own distances, merged later, so the result does not depend on the thread count.
   int width = image->width;
   int height = image->height;
+  int thread_count = IM_OMP_MINHEIGHT(height)? IM_MAX_THREADS: 1;
+  size_t dist_size = 4 * (size_t)region_count * sizeof(double);
+  if (thread_count > 1 && (size_t)thread_count * dist_size > IM_REGION_ACC_MAXMEM)
+  {
+    thread_count = (int)(IM_REGION_ACC_MAXMEM / dist_size);
+    if (thread_count < 1) thread_count = 1;
+  }
+
+  double* thread_dist = (double*)calloc(thread_count, dist_size);
+  if (!thread_dist)
+  {
+    if (local_major_slope) free(local_major_slope);
+    if (local_minor_slope) free(local_minor_slope);
+    free(A1);
+    free(A2);
+    free(C1);
+    free(C2);
+    return 0;
+  }
+
+  imushort* img_data = (imushort*)image->data[0];
+
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (thread_count > 1) num_threads(thread_count)
+#endif
   for (int y = 0; y < height; y++) 
   {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    double* D1a = thread_dist + 4 * (size_t)IM_THREAD_NUM * region_count;
+    double* D1b = D1a + region_count;
+    double* D2a = D1b + region_count;
+    double* D2b = D2a + region_count;
     int offset = y*width;
 
     for (int x = 0; x < width; x++)
@@ -910,10 +844,26 @@ int imAnalyzeMeasurePrincipalAxis(const imImage* image, const int* data_area, co
       }
     }
 
-    if (!imCounterInc(counter))
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  ret = processing;
+
+  double* D1a = thread_dist;
+  double* D1b = D1a + region_count;
+  double* D2a = D1b + region_count;
+  double* D2b = D2a + region_count;
+  for (int t = 1; t < thread_count && ret != 0; t++)
+  {
+    const double* tD = thread_dist + 4 * (size_t)t * region_count;
+    for (int i = 0; i < 4*region_count; i++)
     {
-      ret = 0;
-      break;
+      if (tD[i] > D1a[i])
+        D1a[i] = tD[i];
     }
   }
 
@@ -951,10 +901,7 @@ int imAnalyzeMeasurePrincipalAxis(const imImage* image, const int* data_area, co
     }
   }
 
-  free(D1b);
-  free(D2b);
-  free(D1a);
-  free(D2a);
+  free(thread_dist);
 
   if (local_major_slope) free(local_major_slope);
   if (local_minor_slope) free(local_minor_slope);
@@ -963,6 +910,105 @@ int imAnalyzeMeasurePrincipalAxis(const imImage* image, const int* data_area, co
   free(C1);  
   free(C2);
 
+  return ret;
+}
+
+int imAnalyzeMeasurePrincipalAxis(const imImage* image, const int* data_area, const double* data_cx, const double* data_cy,
+                                   const int region_count, double* major_slope, double* major_length, 
+                                                           double* minor_slope, double* minor_length)
+{
+  int *local_data_area = 0;
+  double *local_data_cx = 0, *local_data_cy = 0;
+  int ret = 0;
+
+  int counter = imProcessCounterBegin("PrincipalAxis");
+
+  if (!data_area)
+  {
+    local_data_area = (int*)malloc(region_count*sizeof(int));
+    ret = imAnalyzeMeasureArea(image, local_data_area, region_count);
+    data_area = (const int*)local_data_area;
+
+    if (!ret)
+    {
+      free(local_data_area);
+      imProcessCounterEnd(counter);
+      return 0;
+    }
+  }
+
+  if (!data_cx || !data_cy)
+  {
+    if (!data_cx)
+    {
+      local_data_cx = (double*)malloc(region_count*sizeof(double));
+      data_cx = (const double*)local_data_cx;
+    }
+
+    if (!data_cy)
+    {
+      local_data_cy = (double*)malloc(region_count*sizeof(double));
+      data_cy = (const double*)local_data_cy;
+    }
+
+    ret = 1;
+    if (local_data_cx && local_data_cy)
+      ret = imAnalyzeMeasureCentroid(image, data_area, region_count, local_data_cx, local_data_cy);
+    else if (local_data_cx)
+      ret = imAnalyzeMeasureCentroid(image, data_area, region_count, local_data_cx, NULL);
+    else if (local_data_cy)
+      ret = imAnalyzeMeasureCentroid(image, data_area, region_count, NULL, local_data_cy);
+
+    if (!ret)
+    {
+      if (local_data_cx) free(local_data_cx);
+      if (local_data_cy) free(local_data_cy);
+      imProcessCounterEnd(counter);
+      return 0;
+    }
+  }
+
+  imCounterTotal(counter, 4 * image->height + 2 * region_count, "Analyzing...");
+
+  // additional moments
+  double* cm20 = (double*)malloc(region_count*sizeof(double));
+  double* cm02 = (double*)malloc(region_count*sizeof(double));
+  double* cm11 = (double*)malloc(region_count*sizeof(double));
+  
+  ret = iCalcMoment(cm20, 2, 0, image, data_cx, data_cy, region_count, counter);
+  if (!ret)
+  {
+    if (local_data_area) free(local_data_area);
+    if (local_data_cx) free(local_data_cx);
+    if (local_data_cy) free(local_data_cy);
+    if (cm20) free(cm20); if (cm02) free(cm02); if (cm11) free(cm11);
+    imProcessCounterEnd(counter);
+    return 0;
+  }
+  ret = iCalcMoment(cm02, 0, 2, image, data_cx, data_cy, region_count, counter);
+  if (!ret)
+  {
+    if (local_data_area) free(local_data_area);
+    if (local_data_cx) free(local_data_cx);
+    if (local_data_cy) free(local_data_cy);
+    if (cm20) free(cm20); if (cm02) free(cm02); if (cm11) free(cm11);
+    imProcessCounterEnd(counter);
+    return 0;
+  }
+  ret = iCalcMoment(cm11, 1, 1, image, data_cx, data_cy, region_count, counter);
+  if (!ret)
+  {
+    if (local_data_area) free(local_data_area);
+    if (local_data_cx) free(local_data_cx);
+    if (local_data_cy) free(local_data_cy);
+    if (cm20) free(cm20); if (cm02) free(cm02); if (cm11) free(cm11);
+    imProcessCounterEnd(counter);
+    return 0;
+  }
+
+  ret = iCalcPrincipalAxis(image, data_cx, data_cy, cm20, cm02, cm11, region_count, 
+                           major_slope, major_length, minor_slope, minor_length, counter);
+
   if (local_data_area) free(local_data_area);
   if (local_data_cx) free(local_data_cx);
   if (local_data_cy) free(local_data_cy);
@@ -1269,17 +1315,63 @@ const double DT_SQRT2D2 = 0.707106781187;
   v[4] = 0.5;
 }
 
-int imAnalyzeMeasurePerimeter(const imImage* image, double* perim_data, int region_count)
+static imbyte perim_templ[256];
+static double perim_vt[5];
+
+static void iGetPerimTemplate(const imbyte* *templ, const double* *vt)
 {
-  static imbyte templ[256];
-  static double vt[5];
   static int first = 1;
   if (first)
   {
-    iInitPerimTemplate(templ, vt);
+    iInitPerimTemplate(perim_templ, perim_vt);
     first = 0;
   }
 
+  *templ = perim_templ;
+  *vt = perim_vt;
+}
+
+/* map here points to the start of the line. 
+   Returns zero if (x,y) is not a perimeter point. */
+static inline double iPerimeterIncrement(const imushort* map, int width, int height, int x, int y, const imbyte* templ, const double* vt)
+{
+  if (!IsPerimeterPoint(map, width, height, x, y))
+    return 0;
+
+  int T = 0;
+
+  // check the 8 neighbors if they belong to the perimeter
+  if (IsPerimeterPoint(map+width, width, height, x-1, y+1))
+    T |= 0x01;
+  if (IsPerimeterPoint(map+width, width, height, x, y+1))
+    T |= 0x02;
+  if (IsPerimeterPoint(map+width, width, height, x+1, y+1))
+    T |= 0x04;
+
+  if (IsPerimeterPoint(map, width, height, x-1, y))
+    T |= 0x08;
+  if (IsPerimeterPoint(map, width, height, x+1, y))
+    T |= 0x10;
+
+  if (IsPerimeterPoint(map-width, width, height, x-1, y-1))
+    T |= 0x20;
+  if (IsPerimeterPoint(map-width, width, height, x, y-1))
+    T |= 0x40;
+  if (IsPerimeterPoint(map-width, width, height, x+1, y-1))
+    T |= 0x80;
+
+  if (T)
+    return vt[templ[T]];
+  else
+    return 0;
+}
+
+int imAnalyzeMeasurePerimeter(const imImage* image, double* perim_data, int region_count)
+{
+  const imbyte* templ;
+  const double* vt;
+  iGetPerimTemplate(&templ, &vt);
+
   int counter = imProcessCounterBegin("MeasurePerimeter");
   imCounterTotal(counter, image->height, "Analyzing...");
 
@@ -1306,39 +1398,14 @@ int imAnalyzeMeasurePerimeter(const imImage* image, double* perim_data, int regi
 
     for (int x = 0; x < width; x++)
     {
-      if (IsPerimeterPoint(map+offset, width, height, x, y))
+      double inc = iPerimeterIncrement(map+offset, width, height, x, y, templ, vt);
+      if (inc)
       {
-        int T = 0;
-
-        // check the 8 neighbors if they belong to the perimeter
-        if (IsPerimeterPoint(map+offset+width, width, height, x-1, y+1))
-          T |= 0x01;
-        if (IsPerimeterPoint(map+offset+width, width, height, x, y+1))
-          T |= 0x02;
-        if (IsPerimeterPoint(map+offset+width, width, height, x+1, y+1))
-          T |= 0x04;
-
-        if (IsPerimeterPoint(map+offset, width, height, x-1, y))
-          T |= 0x08;
-        if (IsPerimeterPoint(map+offset, width, height, x+1, y))
-          T |= 0x10;
-
-        if (IsPerimeterPoint(map+offset-width, width, height, x-1, y-1))
-          T |= 0x20;
-        if (IsPerimeterPoint(map+offset-width, width, height, x, y-1))
-          T |= 0x40;
-        if (IsPerimeterPoint(map+offset-width, width, height, x+1, y-1))
-          T |= 0x80;
-
-        if (T)
-        {
-          int index = map[offset+x] - 1;
-          double inc = vt[templ[T]];
+        int index = map[offset+x] - 1;
 #ifdef _OPENMP
 #pragma omp atomic
 #endif
-          perim_data[index] += inc;
-        }
+        perim_data[index] += inc;
       }
     }
 
@@ -1713,3 +1780,348 @@ int imProcessFillHoles(const imImage* src_image, imImage* dst_image, int connect
   imProcessCounterEnd(counter);
   return processing;
 }
+
+imRegionMeasures* imRegionMeasuresCreate(int region_count)
+{
+  imRegionMeasures* measures = (imRegionMeasures*)calloc(1, sizeof(imRegionMeasures));
+  if (!measures)
+    return NULL;
+
+  measures->region_count = region_count;
+
+  int n = region_count > 0? region_count: 1;
+  int ok = 1;
+
+#define IM_MEASURE_ALLOC(_p, _t) { _p = (_t*)calloc(n, sizeof(_t)); if (!_p) ok = 0; }
+  IM_MEASURE_ALLOC(measures->area, int);
+  IM_MEASURE_ALLOC(measures->cx, double);
+  IM_MEASURE_ALLOC(measures->cy, double);
+  IM_MEASURE_ALLOC(measures->xmin, int);
+  IM_MEASURE_ALLOC(measures->ymin, int);
+  IM_MEASURE_ALLOC(measures->xmax, int);
+  IM_MEASURE_ALLOC(measures->ymax, int);
+  for (int m = 0; m < IM_MOMENT_COUNT; m++)
+  {
+    IM_MEASURE_ALLOC(measures->moment[m], double);
+    IM_MEASURE_ALLOC(measures->central_moment[m], double);
+  }
+  IM_MEASURE_ALLOC(measures->major_angle, double);
+  IM_MEASURE_ALLOC(measures->major_length, double);
+  IM_MEASURE_ALLOC(measures->minor_length, double);
+  IM_MEASURE_ALLOC(measures->perimeter, double);
+  IM_MEASURE_ALLOC(measures->mean, double);
+#undef IM_MEASURE_ALLOC
+
+  if (!ok)
+  {
+    imRegionMeasuresDestroy(measures);
+    return NULL;
+  }
+
+  return measures;
+}
+
+void imRegionMeasuresDestroy(imRegionMeasures* measures)
+{
+  free(measures->area);
+  free(measures->cx);
+  free(measures->cy);
+  free(measures->xmin);
+  free(measures->ymin);
+  free(measures->xmax);
+  free(measures->ymax);
+  for (int m = 0; m < IM_MOMENT_COUNT; m++)
+  {
+    free(measures->moment[m]);
+    free(measures->central_moment[m]);
+  }
+  free(measures->major_angle);
+  free(measures->major_length);
+  free(measures->minor_length);
+  free(measures->perimeter);
+  free(measures->mean);
+  free(measures);
+}
+
+/* Partial sums of one region in one thread.
+   Moments are relative to (rx,ry), the first point of the region found by the thread,
+   so the sums stay small and the central moments can be computed without cancelation. */
+struct iRegionAcc
+{
+  double m[IM_MOMENT_COUNT];
+  double perim, gray_sum;
+  int rx, ry;
+  int xmin, ymin, xmax, ymax;
+};
+
+/* Given the moments relative to a point, 
+   returns the moments relative to the same point translated by (-sx,-sy). */
+static void iShiftMoments(const double* m, double sx, double sy, double* r)
+{
+  double sx2 = sx*sx, sy2 = sy*sy;
+
+  r[IM_M00] = m[IM_M00];
+  r[IM_M10] = m[IM_M10] + sx*m[IM_M00];
+  r[IM_M01] = m[IM_M01] + sy*m[IM_M00];
+  r[IM_M20] = m[IM_M20] + 2*sx*m[IM_M10] + sx2*m[IM_M00];
+  r[IM_M11] = m[IM_M11] + sx*m[IM_M01] + sy*m[IM_M10] + sx*sy*m[IM_M00];
+  r[IM_M02] = m[IM_M02] + 2*sy*m[IM_M01] + sy2*m[IM_M00];
+  r[IM_M30] = m[IM_M30] + 3*sx*m[IM_M20] + 3*sx2*m[IM_M10] + sx2*sx*m[IM_M00];
+  r[IM_M21] = m[IM_M21] + sy*m[IM_M20] + 2*sx*m[IM_M11] + 2*sx*sy*m[IM_M10] + sx2*m[IM_M01] + sx2*sy*m[IM_M00];
+  r[IM_M12] = m[IM_M12] + sx*m[IM_M02] + 2*sy*m[IM_M11] + 2*sx*sy*m[IM_M01] + sy2*m[IM_M10] + sx*sy2*m[IM_M00];
+  r[IM_M03] = m[IM_M03] + 3*sy*m[IM_M02] + 3*sy2*m[IM_M01] + sy2*sy*m[IM_M00];
+}
+
+/* Adds a run of n points of the same region, starting at (x,y), 
+   using the closed form of the power sums of consecutive integers. */
+static inline void iRegionAccAddRun(iRegionAcc* acc, int x, int y, int n)
+{
+  if (acc->m[IM_M00] == 0)
+  {
+    acc->rx = x;
+    acc->ry = y;
+    acc->xmin = x;
+    acc->xmax = x+n-1;
+    acc->ymin = y;
+    acc->ymax = y;
+  }
+  else
+  {
+    if (x < acc->xmin) acc->xmin = x;
+    if (x+n-1 > acc->xmax) acc->xmax = x+n-1;
+    if (y < acc->ymin) acc->ymin = y;
+    if (y > acc->ymax) acc->ymax = y;
+  }
+
+  double a = (double)(x - acc->rx);
+  double dy = (double)(y - acc->ry);
+  double N = (double)n;
+
+  /* sums of k, k^2 and k^3 for k in [0,n-1] */
+  double K1 = N*(N-1)/2;
+  double K2 = (N-1)*N*(2*N-1)/6;
+  double K3 = K1*K1;
+
+  /* sums of (a+k)^p for k in [0,n-1] */
+  double S0 = N;
+  double S1 = N*a + K1;
+  double S2 = N*a*a + 2*a*K1 + K2;
+  double S3 = N*a*a*a + 3*a*a*K1 + 3*a*K2 + K3;
+
+  double dy2 = dy*dy;
+
+  acc->m[IM_M00] += S0;
+  acc->m[IM_M10] += S1;
+  acc->m[IM_M01] += S0*dy;
+  acc->m[IM_M20] += S2;
+  acc->m[IM_M11] += S1*dy;
+  acc->m[IM_M02] += S0*dy2;
+  acc->m[IM_M30] += S3;
+  acc->m[IM_M21] += S2*dy;
+  acc->m[IM_M12] += S1*dy2;
+  acc->m[IM_M03] += S0*dy2*dy;
+}
+
+template <class T>
+static int DoAnalyzeMeasureRegions(const imushort* map, const T* gray_map, int width, int height, int region_count, imRegionMeasures* measures, int counter)
+{
+  const imbyte* templ;
+  const double* vt;
+  iGetPerimTemplate(&templ, &vt);
+
+  int thread_count = IM_OMP_MINHEIGHT(height)? IM_MAX_THREADS: 1;
+  size_t acc_size = (size_t)region_count * sizeof(iRegionAcc);
+  if (thread_count > 1 && (size_t)thread_count * acc_size > IM_REGION_ACC_MAXMEM)
+  {
+    thread_count = (int)(IM_REGION_ACC_MAXMEM / acc_size);
+    if (thread_count < 1) thread_count = 1;
+  }
+
+  iRegionAcc* thread_acc = (iRegionAcc*)calloc(thread_count, acc_size);
+  if (!thread_acc)
+    return 0;
+
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (thread_count > 1) num_threads(thread_count)
+#endif
+  for (int y = 0; y < height; y++) 
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    iRegionAcc* acc = thread_acc + IM_THREAD_NUM * region_count;
+    int offset = y*width;
+    const imushort* line = map + offset;
+
+    int x = 0;
+    while (x < width)
+    {
+      imushort v = line[x];
+      if (!v)
+      {
+        x++;
+        continue;
+      }
+
+      int x0 = x;
+      double perim = 0, gray_sum = 0;
+      while (x < width && line[x] == v)
+      {
+        perim += iPerimeterIncrement(line, width, height, x, y, templ, vt);
+        if (gray_map) gray_sum += (double)gray_map[offset+x];
+        x++;
+      }
+
+      iRegionAcc* racc = acc + (v-1);
+      iRegionAccAddRun(racc, x0, y, x-x0);
+      racc->perim += perim;
+      racc->gray_sum += gray_sum;
+    }
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  if (processing)
+  {
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(region_count))
+#endif
+    for (int i = 0; i < region_count; i++)
+    {
+      iRegionAcc total;
+      memset(&total, 0, sizeof(iRegionAcc));
+
+      for (int t = 0; t < thread_count; t++)
+      {
+        const iRegionAcc* acc = thread_acc + t*region_count + i;
+        if (acc->m[IM_M00] == 0)
+          continue;
+
+        if (total.m[IM_M00] == 0)
+        {
+          total = *acc;
+          continue;
+        }
+
+        double m[IM_MOMENT_COUNT];
+        iShiftMoments(acc->m, (double)(acc->rx - total.rx), (double)(acc->ry - total.ry), m);
+        for (int k = 0; k < IM_MOMENT_COUNT; k++)
+          total.m[k] += m[k];
+
+        if (acc->xmin < total.xmin) total.xmin = acc->xmin;
+        if (acc->ymin < total.ymin) total.ymin = acc->ymin;
+        if (acc->xmax > total.xmax) total.xmax = acc->xmax;
+        if (acc->ymax > total.ymax) total.ymax = acc->ymax;
+        total.perim += acc->perim;
+        total.gray_sum += acc->gray_sum;
+      }
+
+      double area = total.m[IM_M00];
+      if (area == 0)
+      {
+        measures->area[i] = 0;
+        measures->cx[i] = 0;
+        measures->cy[i] = 0;
+        measures->xmin[i] = 0;
+        measures->ymin[i] = 0;
+        measures->xmax[i] = 0;
+        measures->ymax[i] = 0;
+        for (int k = 0; k < IM_MOMENT_COUNT; k++)
+        {
+          measures->moment[k][i] = 0;
+          measures->central_moment[k][i] = 0;
+        }
+        measures->major_angle[i] = 0;
+        measures->major_length[i] = 0;
+        measures->minor_length[i] = 0;
+        measures->perimeter[i] = 0;
+        measures->mean[i] = 0;
+        continue;
+      }
+
+      /* centroid relative to the reference point */
+      double dcx = total.m[IM_M10] / area;
+      double dcy = total.m[IM_M01] / area;
+
+      double cm[IM_MOMENT_COUNT], m[IM_MOMENT_COUNT];
+      iShiftMoments(total.m, -dcx, -dcy, cm);
+      iShiftMoments(total.m, (double)total.rx, (double)total.ry, m);
+
+      /* these are exactly zero */
+      cm[IM_M10] = 0;
+      cm[IM_M01] = 0;
+
+      for (int k = 0; k < IM_MOMENT_COUNT; k++)
+      {
+        measures->moment[k][i] = m[k];
+        measures->central_moment[k][i] = cm[k];
+      }
+
+      measures->area[i] = (int)area;
+      measures->cx[i] = total.rx + dcx;
+      measures->cy[i] = total.ry + dcy;
+      measures->xmin[i] = total.xmin;
+      measures->ymin[i] = total.ymin;
+      measures->xmax[i] = total.xmax;
+      measures->ymax[i] = total.ymax;
+      measures->perimeter[i] = total.perim;
+      measures->mean[i] = gray_map? total.gray_sum / area: 0;
+    }
+  }
+
+  free(thread_acc);
+  return processing;
+}
+
+int imAnalyzeMeasureRegions(const imImage* image, const imImage* gray_image, imRegionMeasures* measures)
+{
+  int ret = 0;
+  int counter = imProcessCounterBegin("MeasureRegions");
+  imCounterTotal(counter, 2 * image->height + 2 * measures->region_count, "Analyzing...");
+
+  imushort* map = (imushort*)image->data[0];
+  int width = image->width;
+  int height = image->height;
+  int region_count = measures->region_count;
+
+  switch (gray_image? gray_image->data_type: -1)
+  {
+  case IM_BYTE:
+    ret = DoAnalyzeMeasureRegions(map, (const imbyte*)gray_image->data[0], width, height, region_count, measures, counter);
+    break;
+  case IM_SHORT:
+    ret = DoAnalyzeMeasureRegions(map, (const short*)gray_image->data[0], width, height, region_count, measures, counter);
+    break;
+  case IM_USHORT:
+    ret = DoAnalyzeMeasureRegions(map, (const imushort*)gray_image->data[0], width, height, region_count, measures, counter);
+    break;
+  case IM_INT:
+    ret = DoAnalyzeMeasureRegions(map, (const int*)gray_image->data[0], width, height, region_count, measures, counter);
+    break;
+  case IM_FLOAT:
+    ret = DoAnalyzeMeasureRegions(map, (const float*)gray_image->data[0], width, height, region_count, measures, counter);
+    break;
+  case IM_DOUBLE:
+    ret = DoAnalyzeMeasureRegions(map, (const double*)gray_image->data[0], width, height, region_count, measures, counter);
+    break;
+  default:
+    ret = DoAnalyzeMeasureRegions(map, (const imbyte*)NULL, width, height, region_count, measures, counter);
+    break;
+  }
+
+  if (ret)
+    ret = iCalcPrincipalAxis(image, measures->cx, measures->cy, 
+                             measures->central_moment[IM_M20], measures->central_moment[IM_M02], measures->central_moment[IM_M11], 
+                             region_count, measures->major_angle, measures->major_length, NULL, measures->minor_length, counter);
+
+  imProcessCounterEnd(counter);
+  return ret;
+}
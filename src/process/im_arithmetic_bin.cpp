@@ -18,6 +18,283 @@
 #include <stdlib.h>
 #include <memory.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IM_USE_SSE2
+#endif
+
+
+/* Number of samples processed by each iteration of the parallel loops 
+   that use the saturating kernels. */
+#define SAT_BLOCK 4096
+
+static inline imushort crop_ushort(int v)
+{
+  return (imushort)(v < 0? 0: v > 65535? 65535: v);
+}
+
+/* Saturating operations for same type byte and ushort images.
+   Each one has a scalar and, when available, an SSE2 version. */
+
+struct iSatByteAdd {
+  static inline imbyte scalar(int a, int b) { return (imbyte)crop_byte(a + b); }
+#ifdef IM_USE_SSE2
+  static inline __m128i simd(__m128i a, __m128i b) { return _mm_adds_epu8(a, b); }
+#endif
+};
+
+struct iSatByteSub {
+  static inline imbyte scalar(int a, int b) { return (imbyte)crop_byte(a - b); }
+#ifdef IM_USE_SSE2
+  static inline __m128i simd(__m128i a, __m128i b) { return _mm_subs_epu8(a, b); }
+#endif
+};
+
+struct iSatByteDiff {
+  static inline imbyte scalar(int a, int b) { return (imbyte)(a > b? a - b: b - a); }
+#ifdef IM_USE_SSE2
+  static inline __m128i simd(__m128i a, __m128i b) { return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a)); }
+#endif
+};
+
+struct iSatByteMin {
+  static inline imbyte scalar(int a, int b) { return (imbyte)(a < b? a: b); }
+#ifdef IM_USE_SSE2
+  static inline __m128i simd(__m128i a, __m128i b) { return _mm_min_epu8(a, b); }
+#endif
+};
+
+struct iSatByteMax {
+  static inline imbyte scalar(int a, int b) { return (imbyte)(a < b? b: a); }
+#ifdef IM_USE_SSE2
+  static inline __m128i simd(__m128i a, __m128i b) { return _mm_max_epu8(a, b); }
+#endif
+};
+
+struct iSatUShortAdd {
+  static inline imushort scalar(int a, int b) { return crop_ushort(a + b); }
+#ifdef IM_USE_SSE2
+  static inline __m128i simd(__m128i a, __m128i b) { return _mm_adds_epu16(a, b); }
+#endif
+};
+
+struct iSatUShortSub {
+  static inline imushort scalar(int a, int b) { return crop_ushort(a - b); }
+#ifdef IM_USE_SSE2
+  static inline __m128i simd(__m128i a, __m128i b) { return _mm_subs_epu16(a, b); }
+#endif
+};
+
+struct iSatUShortDiff {
+  static inline imushort scalar(int a, int b) { return (imushort)(a > b? a - b: b - a); }
+#ifdef IM_USE_SSE2
+  static inline __m128i simd(__m128i a, __m128i b) { return _mm_or_si128(_mm_subs_epu16(a, b), _mm_subs_epu16(b, a)); }
+#endif
+};
+
+/* SSE2 has no unsigned 16 bits min/max, 
+   so min = a - (a - b)+ and max = b + (a - b)+ */
+struct iSatUShortMin {
+  static inline imushort scalar(int a, int b) { return (imushort)(a < b? a: b); }
+#ifdef IM_USE_SSE2
+  static inline __m128i simd(__m128i a, __m128i b) { return _mm_sub_epi16(a, _mm_subs_epu16(a, b)); }
+#endif
+};
+
+struct iSatUShortMax {
+  static inline imushort scalar(int a, int b) { return (imushort)(a < b? b: a); }
+#ifdef IM_USE_SSE2
+  static inline __m128i simd(__m128i a, __m128i b) { return _mm_add_epi16(b, _mm_subs_epu16(a, b)); }
+#endif
+};
+
+#ifdef IM_USE_SSE2
+static inline __m128i iSatSet1(imbyte v)   { return _mm_set1_epi8((char)v); }
+static inline __m128i iSatSet1(imushort v) { return _mm_set1_epi16((short)v); }
+#endif
+
+template <class OP, class T> 
+static void iSatBinaryLine(const T* map1, const T* map2, T* map, int count)
+{
+  int i = 0;
+#ifdef IM_USE_SSE2
+  const int step = 16 / sizeof(T);
+  for (; i + step <= count; i += step)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i*)(map1 + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(map2 + i));
+    _mm_storeu_si128((__m128i*)(map + i), OP::simd(a, b));
+  }
+#endif
+  for (; i < count; i++)
+    map[i] = OP::scalar((int)map1[i], (int)map2[i]);
+}
+
+template <class OP, class T> 
+static void iSatBinaryConstLine(const T* map1, T value, T* map, int count)
+{
+  int i = 0;
+#ifdef IM_USE_SSE2
+  const int step = 16 / sizeof(T);
+  __m128i b = iSatSet1(value);
+  for (; i + step <= count; i += step)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i*)(map1 + i));
+    _mm_storeu_si128((__m128i*)(map + i), OP::simd(a, b));
+  }
+#endif
+  for (; i < count; i++)
+    map[i] = OP::scalar((int)map1[i], (int)value);
+}
+
+template <class OP, class T> 
+static void DoSatBinaryOp(const T* map1, const T* map2, T* map, int count)
+{
+  int block_count = (count + SAT_BLOCK - 1) / SAT_BLOCK;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+  for (int b = 0; b < block_count; b++)
+  {
+    int i = b * SAT_BLOCK;
+    int n = (count - i < SAT_BLOCK)? count - i: SAT_BLOCK;
+    iSatBinaryLine<OP>(map1 + i, map2 + i, map + i, n);
+  }
+}
+
+template <class OP, class T> 
+static void DoSatBinaryConstOp(const T* map1, T value, T* map, int count)
+{
+  int block_count = (count + SAT_BLOCK - 1) / SAT_BLOCK;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+  for (int b = 0; b < block_count; b++)
+  {
+    int i = b * SAT_BLOCK;
+    int n = (count - i < SAT_BLOCK)? count - i: SAT_BLOCK;
+    iSatBinaryConstLine<OP>(map1 + i, value, map + i, n);
+  }
+}
+
+/* returns 0 if the operation has no saturating kernel */
+static int DoSatBinaryOpByte(const imbyte* map1, const imbyte* map2, imbyte* map, int count, int op)
+{
+  switch(op)
+  {
+  case IM_BIN_ADD:  DoSatBinaryOp<iSatByteAdd>(map1, map2, map, count);  return 1;
+  case IM_BIN_SUB:  DoSatBinaryOp<iSatByteSub>(map1, map2, map, count);  return 1;
+  case IM_BIN_DIFF: DoSatBinaryOp<iSatByteDiff>(map1, map2, map, count); return 1;
+  case IM_BIN_MIN:  DoSatBinaryOp<iSatByteMin>(map1, map2, map, count);  return 1;
+  case IM_BIN_MAX:  DoSatBinaryOp<iSatByteMax>(map1, map2, map, count);  return 1;
+  }
+  return 0;
+}
+
+static int DoSatBinaryOpUShort(const imushort* map1, const imushort* map2, imushort* map, int count, int op)
+{
+  switch(op)
+  {
+  case IM_BIN_ADD:  DoSatBinaryOp<iSatUShortAdd>(map1, map2, map, count);  return 1;
+  case IM_BIN_SUB:  DoSatBinaryOp<iSatUShortSub>(map1, map2, map, count);  return 1;
+  case IM_BIN_DIFF: DoSatBinaryOp<iSatUShortDiff>(map1, map2, map, count); return 1;
+  case IM_BIN_MIN:  DoSatBinaryOp<iSatUShortMin>(map1, map2, map, count);  return 1;
+  case IM_BIN_MAX:  DoSatBinaryOp<iSatUShortMax>(map1, map2, map, count);  return 1;
+  }
+  return 0;
+}
+
+/* the constant must be inside the data type range */
+static int DoSatBinaryConstOpByte(const imbyte* map1, imbyte value, imbyte* map, int count, int op)
+{
+  switch(op)
+  {
+  case IM_BIN_ADD:  DoSatBinaryConstOp<iSatByteAdd>(map1, value, map, count);  return 1;
+  case IM_BIN_SUB:  DoSatBinaryConstOp<iSatByteSub>(map1, value, map, count);  return 1;
+  case IM_BIN_DIFF: DoSatBinaryConstOp<iSatByteDiff>(map1, value, map, count); return 1;
+  case IM_BIN_MIN:  DoSatBinaryConstOp<iSatByteMin>(map1, value, map, count);  return 1;
+  case IM_BIN_MAX:  DoSatBinaryConstOp<iSatByteMax>(map1, value, map, count);  return 1;
+  }
+  return 0;
+}
+
+static int DoSatBinaryConstOpUShort(const imushort* map1, imushort value, imushort* map, int count, int op)
+{
+  switch(op)
+  {
+  case IM_BIN_ADD:  DoSatBinaryConstOp<iSatUShortAdd>(map1, value, map, count);  return 1;
+  case IM_BIN_SUB:  DoSatBinaryConstOp<iSatUShortSub>(map1, value, map, count);  return 1;
+  case IM_BIN_DIFF: DoSatBinaryConstOp<iSatUShortDiff>(map1, value, map, count); return 1;
+  case IM_BIN_MIN:  DoSatBinaryConstOp<iSatUShortMin>(map1, value, map, count);  return 1;
+  case IM_BIN_MAX:  DoSatBinaryConstOp<iSatUShortMax>(map1, value, map, count);  return 1;
+  }
+  return 0;
+}
+
+template <class T>
+static void DoBackSubSat(const T *map1, const T *map2, T *map, int count, double tol, int diff)
+{
+  int block_count = (count + SAT_BLOCK - 1) / SAT_BLOCK;
+  int type_max = (int)imColorMax(sizeof(T) == 1? IM_BYTE: IM_USHORT);
+
+  /* differences are integers, so diff <= tol is the same as diff <= floor(tol) */
+  int use_tol = tol >= 0;
+  T itol = (T)(tol > type_max? type_max: (use_tol? (int)tol: 0));
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+  for (int b = 0; b < block_count; b++)
+  {
+    int i = b * SAT_BLOCK;
+    int n = (count - i < SAT_BLOCK)? count - i: SAT_BLOCK;
+    const T* a = map1 + i;
+    const T* m = map2 + i;
+    T* d = map + i;
+    int j = 0;
+
+#ifdef IM_USE_SSE2
+    const int step = 16 / sizeof(T);
+    __m128i vtol = iSatSet1(itol);
+    __m128i zero = _mm_setzero_si128();
+    __m128i use_mask = use_tol? _mm_cmpeq_epi8(zero, zero): zero;
+
+    for (; j + step <= n; j += step)
+    {
+      __m128i va = _mm_loadu_si128((const __m128i*)(a + j));
+      __m128i vm = _mm_loadu_si128((const __m128i*)(m + j));
+      __m128i vdiff, vbg;
+
+      if (sizeof(T) == 1)
+      {
+        vdiff = _mm_or_si128(_mm_subs_epu8(va, vm), _mm_subs_epu8(vm, va));
+        vbg = _mm_cmpeq_epi8(_mm_subs_epu8(vdiff, vtol), zero);  /* diff <= tol */
+      }
+      else
+      {
+        vdiff = _mm_or_si128(_mm_subs_epu16(va, vm), _mm_subs_epu16(vm, va));
+        vbg = _mm_cmpeq_epi16(_mm_subs_epu16(vdiff, vtol), zero);
+      }
+
+      vbg = _mm_and_si128(vbg, use_mask);
+      _mm_storeu_si128((__m128i*)(d + j), _mm_andnot_si128(vbg, diff? vdiff: va));
+    }
+#endif
+
+    for (; j < n; j++)
+    {
+      int v1 = a[j], v2 = m[j];
+      int vdiff = v1 > v2? v1 - v2: v2 - v1;
+      if (use_tol && vdiff <= (int)itol)
+        d[j] = 0;
+      else
+        d[j] = (T)(diff? vdiff: v1);
+    }
+  }
+}
+
 
 template <class T>
 static inline T backsub_op(const T& v1, const T& v2, const double& tol, int use_diff)
@@ -38,6 +315,9 @@ static inline T backsub_op(const T& v1, const T& v2, const double& tol, int use_
 template <class T>
 static void DoBackSub(T *map1, T *map2, T *map, int count, double tol, int diff)
 {
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
   for (int i = 0; i < count; i++)
     map[i] = backsub_op(map1[i], map2[i], tol, diff);
 }
@@ -51,10 +331,10 @@ void imProcessBackSub(const imImage* src_image1, imImage* src_image2, imImage* d
     switch (src_image1->data_type)
     {
     case IM_BYTE:
-      DoBackSub((imbyte*)src_image1->data[i], (imbyte*)src_image2->data[i], (imbyte*)dst_image->data[i], count, tol, diff);
+      DoBackSubSat((imbyte*)src_image1->data[i], (imbyte*)src_image2->data[i], (imbyte*)dst_image->data[i], count, tol, diff);
       break;
     case IM_USHORT:
-      DoBackSub((imushort*)src_image1->data[i], (imushort*)src_image2->data[i], (imushort*)dst_image->data[i], count, tol, diff);
+      DoBackSubSat((imushort*)src_image1->data[i], (imushort*)src_image2->data[i], (imushort*)dst_image->data[i], count, tol, diff);
       break;
     case IM_INT:
       DoBackSub((int*)src_image1->data[i], (int*)src_image2->data[i], (int*)dst_image->data[i], count, tol, diff);
@@ -145,6 +425,9 @@ static void DoBinaryOpByte(imbyte *map1, imbyte *map2, imbyte *map, int count, i
 {
   int i;
 
+  if (DoSatBinaryOpByte(map1, map2, map, count, op))
+    return;
+
   switch(op)
   {
   case IM_BIN_ADD:
@@ -206,6 +489,44 @@ static void DoBinaryOpByte(imbyte *map1, imbyte *map2, imbyte *map, int count, i
   }
 }
 
+static inline imushort crop_ushort(double v)
+{
+  return (imushort)(v < 0? 0: v > 65535? 65535: v);
+}
+
+static void DoBinaryOpUShort(imushort *map1, imushort *map2, imushort *map, int count, int op)
+{
+  int i;
+
+  if (DoSatBinaryOpUShort(map1, map2, map, count, op))
+    return;
+
+  switch(op)
+  {
+  case IM_BIN_MUL:
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+    for (i = 0; i < count; i++)
+      map[i] = crop_ushort(mul_op((double)map1[i], (double)map2[i]));
+    break;
+  case IM_BIN_DIV:
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+    for (i = 0; i < count; i++)
+      map[i] = (imushort)div_op((int)map1[i], (int)map2[i]);
+    break;
+  case IM_BIN_POW:
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+    for (i = 0; i < count; i++)
+      map[i] = crop_ushort(pow_op((double)map1[i], (double)map2[i]));
+    break;
+  }
+}
+
 template <class T>
 static void DoBinaryOpCpxReal(imComplex<T> *map1, T *map2, imComplex<T> *map, int count, int op)
 {
@@ -314,7 +635,7 @@ void imProcessArithmeticOp(const imImage* src_image1, const imImage* src_image2,
     else if (dst_image->data_type == IM_SHORT)
       DoBinaryOp((imushort*)src_image1->data[0], (imushort*)src_image2->data[0], (short*)dst_image->data[0], count, op);
     else
-      DoBinaryOp((imushort*)src_image1->data[0], (imushort*)src_image2->data[0], (imushort*)dst_image->data[0], count, op);
+      DoBinaryOpUShort((imushort*)src_image1->data[0], (imushort*)src_image2->data[0], (imushort*)dst_image->data[0], count, op);
     break;
   case IM_INT:
     if (dst_image->data_type == IM_DOUBLE)
@@ -373,6 +694,74 @@ static void DoBlendConst(T *map1, T *map2, T *map, int count, double alpha)
     map[i] = blend_op(map1[i], map2[i], alpha);
 }
 
+/* Integer blends use fixed point weights and are rounded to the nearest integer */
+
+static void iBlendConstByteLine(const imbyte *map1, const imbyte *map2, imbyte *map, int count, int w1)
+{
+  int w2 = 256 - w1;
+  int i = 0;
+
+#ifdef IM_USE_SSE2
+  __m128i zero = _mm_setzero_si128();
+  __m128i vw1 = _mm_set1_epi16((short)w1);
+  __m128i vw2 = _mm_set1_epi16((short)w2);
+  __m128i round = _mm_set1_epi16(128);
+
+  for (; i + 16 <= count; i += 16)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i*)(map1 + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(map2 + i));
+
+    /* a*w1 + b*w2 + 128 <= 255*256 + 128, fits in 16 bits unsigned */
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), vw1), _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), vw2));
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), vw1), _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), vw2));
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 8);
+
+    _mm_storeu_si128((__m128i*)(map + i), _mm_packus_epi16(lo, hi));
+  }
+#endif
+
+  for (; i < count; i++)
+    map[i] = (imbyte)((map1[i]*w1 + map2[i]*w2 + 128) >> 8);
+}
+
+static void DoBlendConstByte(const imbyte *map1, const imbyte *map2, imbyte *map, int count, double alpha)
+{
+  int block_count = (count + SAT_BLOCK - 1) / SAT_BLOCK;
+  int w1 = imRound(alpha * 256);
+  if (w1 < 0) w1 = 0;
+  if (w1 > 256) w1 = 256;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+  for (int b = 0; b < block_count; b++)
+  {
+    int i = b * SAT_BLOCK;
+    int n = (count - i < SAT_BLOCK)? count - i: SAT_BLOCK;
+    iBlendConstByteLine(map1 + i, map2 + i, map + i, n, w1);
+  }
+}
+
+static void DoBlendConstUShort(const imushort *map1, const imushort *map2, imushort *map, int count, double alpha)
+{
+  int w1 = imRound(alpha * 65536);
+  if (w1 < 0) w1 = 0;
+  if (w1 > 65536) w1 = 65536;
+  unsigned int uw1 = (unsigned int)w1;
+  unsigned int uw2 = 65536 - uw1;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+  for (int i = 0; i < count; i++)
+  {
+    /* a*w1 + b*w2 + 32768 <= 65535*65536 + 32768, fits in 32 bits unsigned */
+    map[i] = (imushort)((map1[i]*uw1 + map2[i]*uw2 + 32768) >> 16);
+  }
+}
+
 void imProcessBlendConst(const imImage* src_image1, const imImage* src_image2, imImage* dst_image, double alpha)
 {
   int count = src_image1->count*src_image1->depth;
@@ -380,13 +769,13 @@ void imProcessBlendConst(const imImage* src_image1, const imImage* src_image2, i
   switch(src_image1->data_type)
   {
   case IM_BYTE:
-    DoBlendConst((imbyte*)src_image1->data[0], (imbyte*)src_image2->data[0], (imbyte*)dst_image->data[0], count, alpha);
+    DoBlendConstByte((imbyte*)src_image1->data[0], (imbyte*)src_image2->data[0], (imbyte*)dst_image->data[0], count, alpha);
     break;
   case IM_SHORT:
     DoBlendConst((short*)src_image1->data[0], (short*)src_image2->data[0], (short*)dst_image->data[0], count, alpha);
     break;
   case IM_USHORT:
-    DoBlendConst((imushort*)src_image1->data[0], (imushort*)src_image2->data[0], (imushort*)dst_image->data[0], count, alpha);
+    DoBlendConstUShort((imushort*)src_image1->data[0], (imushort*)src_image2->data[0], (imushort*)dst_image->data[0], count, alpha);
     break;
   case IM_INT:
     DoBlendConst((int*)src_image1->data[0], (int*)src_image2->data[0], (int*)dst_image->data[0], count, alpha);
@@ -419,6 +808,78 @@ static void DoBlend(T *map1, T *map2, TA *alpha, T *map, int count, int alpha_co
   }
 }
 
+static void iBlendByteLine(const imbyte *map1, const imbyte *map2, const imbyte *alpha, imbyte *map, int count)
+{
+  int i = 0;
+
+#ifdef IM_USE_SSE2
+  __m128i zero = _mm_setzero_si128();
+  __m128i vmax = _mm_set1_epi16(255);
+  __m128i round = _mm_set1_epi16(127);
+  __m128i one = _mm_set1_epi16(1);
+
+  for (; i + 16 <= count; i += 16)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i*)(map1 + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(map2 + i));
+    __m128i al = _mm_loadu_si128((const __m128i*)(alpha + i));
+    __m128i r[2];
+
+    for (int h = 0; h < 2; h++)
+    {
+      __m128i a16 = h? _mm_unpackhi_epi8(a, zero): _mm_unpacklo_epi8(a, zero);
+      __m128i b16 = h? _mm_unpackhi_epi8(b, zero): _mm_unpacklo_epi8(b, zero);
+      __m128i al16 = h? _mm_unpackhi_epi8(al, zero): _mm_unpacklo_epi8(al, zero);
+
+      /* x = a*alpha + b*(255-alpha) + 127 <= 255*255 + 127, fits in 16 bits unsigned */
+      __m128i x = _mm_add_epi16(_mm_mullo_epi16(a16, al16), _mm_mullo_epi16(b16, _mm_sub_epi16(vmax, al16)));
+      x = _mm_add_epi16(x, round);
+
+      /* x/255 = (x + 1 + (x >> 8)) >> 8, exact for this range */
+      r[h] = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, one), _mm_srli_epi16(x, 8)), 8);
+    }
+
+    _mm_storeu_si128((__m128i*)(map + i), _mm_packus_epi16(r[0], r[1]));
+  }
+#endif
+
+  for (; i < count; i++)
+    map[i] = (imbyte)((map1[i]*alpha[i] + map2[i]*(255 - alpha[i]) + 127) / 255);
+}
+
+static void DoBlendByte(const imbyte *map1, const imbyte *map2, const imbyte *alpha, imbyte *map, int count, int alpha_count)
+{
+  /* the alpha plane is used for all the color planes */
+  int plane_count = count / alpha_count;
+  int block_count = (alpha_count + SAT_BLOCK - 1) / SAT_BLOCK;
+  int total_count = plane_count * block_count;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+  for (int t = 0; t < total_count; t++)
+  {
+    int offset = (t / block_count) * alpha_count;
+    int i = (t % block_count) * SAT_BLOCK;
+    int n = (alpha_count - i < SAT_BLOCK)? alpha_count - i: SAT_BLOCK;
+    iBlendByteLine(map1 + offset + i, map2 + offset + i, alpha + i, map + offset + i, n);
+  }
+}
+
+static void DoBlendUShort(const imushort *map1, const imushort *map2, const imushort *alpha, imushort *map, int count, int alpha_count)
+{
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+  for (int i = 0; i < count; i++)
+  {
+    unsigned int al = alpha[i % alpha_count];
+
+    /* a*alpha + b*(65535-alpha) + 32767 <= 65535*65535 + 32767, fits in 32 bits unsigned */
+    map[i] = (imushort)((map1[i]*al + map2[i]*(65535 - al) + 32767) / 65535);
+  }
+}
+
 void imProcessBlend(const imImage* src_image1, const imImage* src_image2, const imImage* alpha, imImage* dst_image)
 {
   int count = src_image1->count*src_image1->depth;
@@ -427,13 +888,13 @@ void imProcessBlend(const imImage* src_image1, const imImage* src_image2, const
   switch(src_image1->data_type)
   {
   case IM_BYTE:
-    DoBlend((imbyte*)src_image1->data[0], (imbyte*)src_image2->data[0], (imbyte*)alpha->data[0], (imbyte*)dst_image->data[0], count, alpha->count, type_max);
+    DoBlendByte((imbyte*)src_image1->data[0], (imbyte*)src_image2->data[0], (imbyte*)alpha->data[0], (imbyte*)dst_image->data[0], count, alpha->count);
     break;
   case IM_SHORT:
     DoBlend((short*)src_image1->data[0], (short*)src_image2->data[0], (short*)alpha->data[0], (short*)dst_image->data[0], count, alpha->count, type_max);
     break;
   case IM_USHORT:
-    DoBlend((imushort*)src_image1->data[0], (imushort*)src_image2->data[0], (imushort*)alpha->data[0], (imushort*)dst_image->data[0], count, alpha->count, type_max);
+    DoBlendUShort((imushort*)src_image1->data[0], (imushort*)src_image2->data[0], (imushort*)alpha->data[0], (imushort*)dst_image->data[0], count, alpha->count);
     break;
   case IM_INT:
     DoBlend((int*)src_image1->data[0], (int*)src_image2->data[0], (int*)alpha->data[0], (int*)dst_image->data[0], count, alpha->count, type_max);
@@ -812,6 +1273,75 @@ static void DoBinaryConstOpByte(T1 *map1, int value, imbyte *map, int count, int
   }
 }
 
+static void DoBinaryConstOpUShort(imushort *map1, int value, imushort *map, int count, int op)
+{
+  int i;
+
+  if (value >= 0 && value <= 65535 &&
+      DoSatBinaryConstOpUShort(map1, (imushort)value, map, count, op))
+    return;
+
+  switch(op)
+  {
+  case IM_BIN_ADD:
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+    for (i = 0; i < count; i++)
+      map[i] = crop_ushort(add_op((double)map1[i], (double)value));
+    break;
+  case IM_BIN_SUB:
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+    for (i = 0; i < count; i++)
+      map[i] = crop_ushort(sub_op((double)map1[i], (double)value));
+    break;
+  case IM_BIN_MUL:
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+    for (i = 0; i < count; i++)
+      map[i] = crop_ushort(mul_op((double)map1[i], (double)value));
+    break;
+  case IM_BIN_DIV:
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+    for (i = 0; i < count; i++)
+      map[i] = crop_ushort((double)div_op((int)map1[i], value));
+    break;
+  case IM_BIN_DIFF:
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+    for (i = 0; i < count; i++)
+      map[i] = crop_ushort(diff_op((double)map1[i], (double)value));
+    break;
+  case IM_BIN_MIN:
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+    for (i = 0; i < count; i++)
+      map[i] = crop_ushort(min_op((double)map1[i], (double)value));
+    break;
+  case IM_BIN_MAX:
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+    for (i = 0; i < count; i++)
+      map[i] = crop_ushort(max_op((double)map1[i], (double)value));
+    break;
+  case IM_BIN_POW:
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+    for (i = 0; i < count; i++)
+      map[i] = crop_ushort(pow_op((double)map1[i], (double)value));
+    break;
+  }
+}
+
 void imProcessArithmeticConstOp(const imImage* src_image1, double value, imImage* dst_image, int op)
 {
   int count = src_image1->count*src_image1->depth;  /* do NOT include alpha here */
@@ -829,7 +1359,8 @@ void imProcessArithmeticConstOp(const imImage* src_image1, double value, imImage
       DoBinaryConstOp((imbyte*)src_image1->data[0], (imushort)value, (imushort*)dst_image->data[0], count, op);
     else if (dst_image->data_type == IM_INT)
       DoBinaryConstOp((imbyte*)src_image1->data[0], (int)value, (int*)dst_image->data[0], count, op);
-    else
+    else if ((int)value < 0 || (int)value > 255 ||
+             !DoSatBinaryConstOpByte((imbyte*)src_image1->data[0], (imbyte)value, (imbyte*)dst_image->data[0], count, op))
       DoBinaryConstOpByte((imbyte*)src_image1->data[0], (int)value, (imbyte*)dst_image->data[0], count, op);
     break;
   case IM_SHORT:
@@ -858,7 +1389,7 @@ void imProcessArithmeticConstOp(const imImage* src_image1, double value, imImage
     else if (dst_image->data_type == IM_BYTE)
       DoBinaryConstOpByte((imushort*)src_image1->data[0], (int)value, (imbyte*)dst_image->data[0], count, op);
     else
-      DoBinaryConstOp((imushort*)src_image1->data[0], (int)value, (imushort*)dst_image->data[0], count, op);
+      DoBinaryConstOpUShort((imushort*)src_image1->data[0], (int)value, (imushort*)dst_image->data[0], count, op);
     break;
   case IM_INT:
     if (dst_image->data_type == IM_DOUBLE)
@@ -960,148 +1491,6 @@ void imProcessMultipleStdDev(const imImage** src_image_list, int src_image_count
   imImageDestroy(aux_image);
 }
 
-static int compare_imFloat(const void *elem1, const void *elem2)
-{
-  double* v1 = (double*)elem1;
-  double* v2 = (double*)elem2;
-
-  if (*v1 < *v2)
-    return -1;
-
-  if (*v1 > *v2)
-    return 1;
-
-  return 0;
-}
-
-static int imMultiMedianFunc(const double* src_value, double *dst_value, double* params, void* userdata, int x, int y, int d, int src_count)
-{
-  (void)params;
-  (void)userdata;
-  (void)x;
-  (void)y;
-  (void)d;
-
-  qsort((double*)src_value, src_count, sizeof(double), compare_imFloat);
-  *dst_value = src_value[src_count / 2];
-
-  return 1;
-}
-
-int imProcessMultipleMedian(const imImage** src_image_list, int src_image_count, imImage* dst_image)
-{
-  return imProcessMultiPointOp(src_image_list, src_image_count, dst_image, imMultiMedianFunc, NULL, NULL, "MultipleMedian");
-}
-
-template <class DT>
-static double AutoCovCalc(int width, int height, DT *src_map, DT *mean_map, int x, int y, int count)
-{
-  double value = 0;
-  int Ny = height - y;
-  int Nx = width - x;
-  int offset, offset1, line_offset, line_offset1;
-
-  for (int i = 0; i < Ny; i++)
-  {
-    line_offset = width*i;
-    line_offset1 = width*(i + y);
-
-    for (int j = 0; j < Nx; j++)
-    {
-      offset = line_offset + j;
-      offset1 = line_offset1 + (j + x);
-      value += double(src_map[offset] - mean_map[offset]) * 
-               double(src_map[offset1] - mean_map[offset1]);
-    }
-  }
-
-  return value/(double)count;
-}
-
-template <class ST, class DT> 
-static int doAutoCov(int width, int height, ST *src_map, ST *mean_map, DT *dst_map, int counter)
-{
-  int count = width*height;
-  IM_INT_PROCESSING;
-
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
-#endif
-  for (int y = 0; y < height; y++)
-  {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
-
-    int line_offset = y*width;
-    for (int x = 0; x < width; x++)
-    {
-      dst_map[line_offset + x] = (DT)AutoCovCalc(width, height, src_map, mean_map, x, y, count);
-    }
-
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
-  }
-
-  return processing;
-}
-
-int imProcessAutoCovariance(const imImage* src_image, const imImage* mean_image, imImage* dst_image)
-{
-  int ret = 0;
-
-  int counter = imProcessCounterBegin("AutoConvariance");
-  imCounterTotal(counter, src_image->depth*src_image->height, "Processing...");
-
-  for (int i = 0; i < src_image->depth; i++)
-  {
-    switch(src_image->data_type)
-    {
-    case IM_BYTE:
-      if (dst_image->data_type == IM_FLOAT)
-        ret = doAutoCov(src_image->width, src_image->height, (imbyte*)src_image->data[i], (imbyte*)mean_image->data[i], (float*)dst_image->data[i], counter);
-      else
-        ret = doAutoCov(src_image->width, src_image->height, (imbyte*)src_image->data[i], (imbyte*)mean_image->data[i], (double*)dst_image->data[i], counter);
-      break;
-    case IM_SHORT:
-      if (dst_image->data_type == IM_FLOAT)
-        ret = doAutoCov(src_image->width, src_image->height, (short*)src_image->data[i], (short*)mean_image->data[i], (float*)dst_image->data[i], counter);
-      else
-        ret = doAutoCov(src_image->width, src_image->height, (short*)src_image->data[i], (short*)mean_image->data[i], (double*)dst_image->data[i], counter);
-      break;
-    case IM_USHORT:
-      if (dst_image->data_type == IM_FLOAT)
-        ret = doAutoCov(src_image->width, src_image->height, (imushort*)src_image->data[i], (imushort*)mean_image->data[i], (float*)dst_image->data[i], counter);
-      else
-        ret = doAutoCov(src_image->width, src_image->height, (imushort*)src_image->data[i], (imushort*)mean_image->data[i], (double*)dst_image->data[i], counter);
-      break;
-    case IM_INT:
-      if (dst_image->data_type == IM_FLOAT)
-        ret = doAutoCov(src_image->width, src_image->height, (int*)src_image->data[i], (int*)mean_image->data[i], (float*)dst_image->data[i], counter);
-      else
-        ret = doAutoCov(src_image->width, src_image->height, (int*)src_image->data[i], (int*)mean_image->data[i], (double*)dst_image->data[i], counter);
-      break;
-    case IM_FLOAT:
-      ret = doAutoCov(src_image->width, src_image->height, (float*)src_image->data[i], (float*)mean_image->data[i], (float*)dst_image->data[i], counter);
-      break;
-    case IM_DOUBLE:
-      ret = doAutoCov(src_image->width, src_image->height, (double*)src_image->data[i], (double*)mean_image->data[i], (double*)dst_image->data[i], counter);
-      break;
-    }
-
-    if (!ret)
-      break;
-  }
-
-  imProcessCounterEnd(counter);
-
-  return ret;
-}
-
 void imProcessMultiplyConj(const imImage* src_image1, const imImage* src_image2, imImage* dst_image)
 {
   int total_count = src_image1->count*src_image1->depth;
@@ -14,42 +14,18 @@
 #include <stdlib.h>
 #include <memory.h>
 
-/* Scale floating point magnitudes to 8 bits */
-static double MAG_SCALE;
-
 /* Biggest possible filter mask */
 #define MAX_MASK_SIZE 100
 
+/* Lines processed by each parallel band, the halo lines are computed by both neighbor bands */
+#define CANNY_BAND_HEIGHT 128
+
 
 static inline double norm(double x, double y)
 {
   return sqrt (x*x + y*y);
 }
 
-static float ** f2d (int nr, int nc)
-{
-  float **x, *y;
-  int i;
-
-  x = (float **)calloc ( nr, sizeof (float *) );
-  if (!x)
-    return NULL;
-
-  y = (float *)calloc ( nr*nc, sizeof (float) );
-  if (!y)
-  {
-    free(x);
-    return NULL;
-  }
-
-  for (i=0; i<nr; i++)
-  {  
-    x[i] = y + i*nc;
-  }
-
-  return x;
-}
-
 /*      Gaussian        */
 static inline double gauss(double x, double sigma)
 {
@@ -70,270 +46,562 @@ static double dGauss(double x, double sigma)
   return -x * gauss(x, sigma);
 }
 
-static int seperable_convolution(const imImage* im, double *gau, int width, float **smx, float **smy, int counter)
+static inline int wrap(int i, int n)
 {
-  unsigned char* im_data = (unsigned char*)im->data[0];
-  int nr = im->height;
-  int nc = im->width;
+  i %= n;
+  return i < 0? i + n: i;
+}
 
-  IM_INT_PROCESSING;
+/* Per call parameters, shared by all bands */
+struct iCannyParam
+{
+  const imbyte* src_data;
+  int nr, nc;
+  int width;   /* mask size */
+  double gau[MAX_MASK_SIZE], dgau[MAX_MASK_SIZE];
+  double mag_scale;  /* scale floating point magnitudes to 8 bits */
+  int low_thres, high_thres, hysteresis;
+};
+
+/* Per band state. 
+   The image smoothed in Y is kept in a ring of 2*width-1 lines, 
+   the image smoothed in X is used only for the current line. 
+   Lines use logical indices, outside the image they wrap around like the convolution. */
+struct iCannyBand
+{
+  float* smy;       /* ring of ring_size lines */
+  int ring_size;
+  int smy_next;     /* next logical line to be smoothed in Y */
+  float* smx;       /* one line */
+  double* acc;      /* one line */
+};
+
+static int iCannyBandInit(iCannyBand* band, const iCannyParam* param, int first_line)
+{
+  int nc = param->nc;
+  band->ring_size = 2*param->width - 1;
+  band->smy = (float*)malloc(band->ring_size*nc*sizeof(float));
+  band->smx = (float*)malloc(nc*sizeof(float));
+  band->acc = (double*)malloc(nc*sizeof(double));
+  band->smy_next = first_line - (param->width - 1);
+  return band->smy && band->smx && band->acc;
+}
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(nr))
-#endif
-  for (int i=0; i<nr; i++)
+static void iCannyBandRelease(iCannyBand* band)
+{
+  free(band->smy);
+  free(band->smx);
+  free(band->acc);
+}
+
+static void iCannySmoothY(const iCannyParam* param, iCannyBand* band, int r)
+{
+  const imbyte* im_data = param->src_data;
+  int nr = param->nr, nc = param->nc;
+  const double* gau = param->gau;
+  double* acc = band->acc;
+  int i = wrap(r, nr);
+  int j;
+
+  const imbyte* line = im_data + i*nc;
+  for (j = 0; j < nc; j++)
+    acc[j] = gau[0] * line[j];
+
+  /* k in the outer loop to access lines sequentially, 
+     each pixel still accumulates in the same order */
+  for (int k = 1; k < param->width; k++)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
+    const imbyte* line1 = im_data + wrap(i+k, nr)*nc;
+    const imbyte* line2 = im_data + wrap(i-k, nr)*nc;
+    for (j = 0; j < nc; j++)
+      acc[j] += gau[k]*line1[j] + gau[k]*line2[j];
+  }
+
+  float* smy = band->smy + wrap(r, band->ring_size)*nc;
+  for (j = 0; j < nc; j++)
+    smy[j] = (float)acc[j];
+}
+
+/* computes the derivatives dx and dy of the logical line r */
+static void iCannyGradientLine(const iCannyParam* param, iCannyBand* band, int r, float* dx, float* dy)
+{
+  const double* gau = param->gau;
+  const double* dgau = param->dgau;
+  int width = param->width;
+  int nr = param->nr, nc = param->nc;
+  double* acc = band->acc;
+  float* smx = band->smx;
+  int j, k;
+
+  /* smooth in Y the lines needed for the derivative */
+  while (band->smy_next <= r + width - 1)
+  {
+    iCannySmoothY(param, band, band->smy_next);
+    band->smy_next++;
+  }
+
+  /* smooth in X */
+  const imbyte* line = param->src_data + wrap(r, nr)*nc;
+  for (j = 0; j < nc; j++)
+  {
+    double x = gau[0] * line[j];
+    for (k = 1; k < width; k++)
+      x += gau[k]*line[wrap(j+k, nc)] + gau[k]*line[wrap(j-k, nc)];
+    smx[j] = (float)x;
+  }
+
+  /* derivative in X */
+  for (j = 0; j < nc; j++)
+  {
+    double x = 0.0;
+    for (k = 1; k < width; k++)
+      x += -dgau[k]*smx[wrap(j+k, nc)] + dgau[k]*smx[wrap(j-k, nc)];
+    dx[j] = (float)x;
+  }
+
+  /* derivative in Y */
+  for (j = 0; j < nc; j++)
+    acc[j] = 0.0;
+
+  for (k = 1; k < width; k++)
+  {
+    const float* smy1 = band->smy + wrap(r+k, band->ring_size)*nc;
+    const float* smy2 = band->smy + wrap(r-k, band->ring_size)*nc;
+    for (j = 0; j < nc; j++)
+      acc[j] += -dgau[k]*smy1[j] + dgau[k]*smy2[j];
+  }
+
+  for (j = 0; j < nc; j++)
+    dy[j] = (float)acc[j];
+}
+
+static inline unsigned char tobyte(double x)
+{
+  if (x > 255) return 255;
+  return (unsigned char)x;
+}
 
-    for (int j = 0; j<nc; j++)
+/* Non-maximum suppression of line i, dx and dy contain the lines i-1, i and i+1.
+   Stores the magnitude of the local maxima, and 0 elsewhere. */
+static void iCannyNonMaxLine(const iCannyParam* param, float* dx[3], float* dy[3], float* mag_line)
+{
+  int nc = param->nc;
+  float *dx0 = dx[0], *dx1 = dx[1], *dx2 = dx[2];
+  float *dy0 = dy[0], *dy1 = dy[1], *dy2 = dy[2];
+
+  mag_line[0] = 0;
+  mag_line[nc-1] = 0;
+
+  for (int j = 1; j<nc - 1; j++)
+  {
+    double xx, yy, g2, g1, g3, g4, g, xc, yc;
+
+    mag_line[j] = 0;
+
+    /* Treat the x and y derivatives as components of a vector */
+    xc = dx1[j];
+    yc = dy1[j];
+    if (fabs(xc)<0.01 && fabs(yc)<0.01) continue;
+
+    g  = norm (xc, yc);
+
+    /* Follow the gradient direction, as indicated by the direction of
+      the vector (xc, yc); retain pixels that are a local maximum. */
+
+    if (fabs(yc) > fabs(xc))
     {
-      double x = gau[0] * im_data[i*im->width + j];
-      double y = gau[0] * im_data[i*im->width + j];
+      /* The Y component is biggest, so gradient direction is basically UP/DOWN */
+      xx = fabs(xc)/fabs(yc);
+      yy = 1.0;
 
-      for (int k=1; k<width; k++)
+      g2 = norm (dx0[j], dy0[j]);
+      g4 = norm (dx2[j], dy2[j]);
+      if (xc*yc > 0.0)
       {
-        int I1 = (i+k)%nr; 
-        int I2 = (i-k+nr)%nr;
-        y += gau[k]*im_data[I1*im->width + j] + gau[k]*im_data[I2*im->width + j];
-
-        I1 = (j+k)%nc; 
-        I2 = (j-k+nc)%nc;
-        x += gau[k]*im_data[i*im->width + I1] + gau[k]*im_data[i*im->width + I2];
+        g3 = norm (dx2[j+1], dy2[j+1]);
+        g1 = norm (dx0[j-1], dy0[j-1]);
+      } 
+      else
+      {
+        g3 = norm (dx2[j-1], dy2[j-1]);
+        g1 = norm (dx0[j+1], dy0[j+1]);
       }
 
-      smx[i][j] = (float)x; 
-      smy[i][j] = (float)y;
+    } 
+    else
+    {
+      /* The X component is biggest, so gradient direction is basically LEFT/RIGHT */
+      xx = fabs(yc)/fabs(xc);
+      yy = 1.0;
+
+      g2 = norm (dx1[j+1], dy1[j+1]);
+      g4 = norm (dx1[j-1], dy1[j-1]);
+      if (xc*yc > 0.0)
+      {
+        g3 = norm (dx0[j-1], dy0[j-1]);
+        g1 = norm (dx2[j+1], dy2[j+1]);
+      }
+      else
+      {
+        g1 = norm (dx0[j+1], dy0[j+1]);
+        g3 = norm (dx2[j-1], dy2[j-1]);
+      }
     }
 
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
+    /* Compute the interpolated value of the gradient magnitude */
+    if ( (g > (xx*g1 + (yy-xx)*g2)) && (g > (xx*g3 + (yy-xx)*g4)) )
+      mag_line[j] = (float)g;
   }
-
-  return processing;
 }
 
-static int dxy_seperable_convolution(float** im, int nr, int nc, double *gau, int width, float **sm, int which, int counter)
+/* Non-maximum suppression of the lines y0 to y1-1, 1 <= y0 and y1 <= nr-1.
+   Also returns the maximum derivative of the lines band_y0 to band_y1-1, used to scale the magnitude. 
+   The convolution is computed only once, so the magnitude is kept until the scale of all the bands is known. */
+static int iCannyNonMax(const iCannyParam* param, int y0, int y1, int band_y0, int band_y1, float* mag_data, double *max_value)
 {
-  IM_INT_PROCESSING;
+  iCannyBand band;
+  int nc = param->nc;
+  int band_ok = iCannyBandInit(&band, param, y0-1);
+  float* dx_buf = (float*)malloc(6*nc*sizeof(float));
+  float *dx[3], *dy[3];
+  double max = 0;
+
+  if (!dx_buf || !band_ok)
+  {
+    free(dx_buf);
+    iCannyBandRelease(&band);
+    return 0;
+  }
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(nr))
-#endif
-  for (int i=0; i<nr; i++)
+  for (int r = y0-1; r <= y1; r++)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
+    int slot = wrap(r, 3);
+    float* dx_line = dx_buf + slot*nc;
+    float* dy_line = dx_buf + (3+slot)*nc;
+    iCannyGradientLine(param, &band, r, dx_line, dy_line);
 
-    for (int j = 0; j<nc; j++)
+    if (r >= band_y0 && r < band_y1)
     {
-      double x = 0.0;
-      for (int k=1; k<width; k++)
+      for (int j = 0; j < nc; j++)
       {
-        if (which == 0)
-        {
-          int I1 = (i+k)%nr; 
-          int I2 = (i-k+nr)%nr;
-          x += -gau[k]*im[I1][j] + gau[k]*im[I2][j];
-        }
-        else
-        {
-          int I1 = (j+k)%nc; 
-          int I2 = (j-k+nc)%nc;
-          x += -gau[k]*im[i][I1] + gau[k]*im[i][I2];
-        }
+        if (dx_line[j] > max) max = dx_line[j];
+        if (dy_line[j] > max) max = dy_line[j];
       }
-      sm[i][j] = (float)x;
-
-      if (x > MAG_SCALE)
-        MAG_SCALE = x;
     }
 
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
+    if (r >= y0+1)
+    {
+      /* lines r-2, r-1 and r */
+      for (int l = 0; l < 3; l++)
+      {
+        int l_slot = wrap(r-2+l, 3);
+        dx[l] = dx_buf + l_slot*nc;
+        dy[l] = dx_buf + (3+l_slot)*nc;
+      }
+
+      iCannyNonMaxLine(param, dx, dy, mag_data + (r-1-y0)*nc);
+    }
   }
 
-  return processing;
+  *max_value = max;
+
+  free(dx_buf);
+  iCannyBandRelease(&band);
+  return 1;
 }
 
-static inline unsigned char tobyte(double x)
+/* Converts the magnitude of the local maxima to 8 bits */
+static void iCannyScaleLine(const iCannyParam* param, const float* mag_line, imbyte* dst_line)
 {
-  if (x > 255) return 255;
-  return (unsigned char)x;
+  for (int j = 0; j < param->nc; j++)
+  {
+    imbyte mag = 0;
+    if (mag_line[j])
+      mag = tobyte(mag_line[j]*param->mag_scale);
+
+    if (param->hysteresis)
+    {
+      /* same marks used by imProcessHysteresisThreshold */
+      if (mag > param->high_thres)
+        dst_line[j] = 1;
+      else if (mag > param->low_thres)
+        dst_line[j] = 2;
+      else
+        dst_line[j] = 0;
+    }
+    else
+      dst_line[j] = mag;
+  }
 }
 
-static int nonmax_suppress(float **dx, float **dy, imImage* mag, int counter)
+/* Growable stack of pixel offsets, starts with the size of the image border 
+   and grows geometrically, like the flood fill stack in im_render.cpp. */
+struct iCannyStack
 {
-  unsigned char* mag_data = (unsigned char*)mag->data[0];
-
-  IM_INT_PROCESSING;
+  int* data;
+  int count, max_count;
+};
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(mag->height))
-#endif
-  for (int i=1; i<mag->height-1; i++)
+static inline int iCannyStackPush(iCannyStack* stack, int offset)
+{
+  if (stack->count == stack->max_count)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
+    int* data = (int*)realloc(stack->data, 2 * stack->max_count * sizeof(int));
+    if (!data)
+      return 0;
 
-    for (int j = 1; j<mag->width - 1; j++)
-    {
-      double xx, yy, g2, g1, g3, g4, g, xc, yc;
+    stack->data = data;
+    stack->max_count *= 2;
+  }
 
-      /* Treat the x and y derivatives as components of a vector */
-      xc = dx[i][j];
-      yc = dy[i][j];
-      if (fabs(xc)<0.01 && fabs(yc)<0.01) continue;
+  stack->data[stack->count++] = offset;
+  return 1;
+}
 
-      g  = norm (xc, yc);
+/* Replaces the "2"s connected to "1"s by "1"s, and the remaining by "0"s. 
+   Same result as the iterative propagation in imProcessHysteresisThreshold, 
+   but each edge is traced from its first "1" using a stack, so each pixel is visited only once. 
+   Traced pixels are marked with "3" until the end. */
+static int iCannyHysteresis(imbyte* map, int width, int height)
+{
+  int count = width*height;
+  iCannyStack stack;
+  stack.count = 0;
+  stack.max_count = 2*(width + height);
+  stack.data = (int*)malloc(stack.max_count*sizeof(int));
+  if (!stack.data)
+    return 0;
 
-      /* Follow the gradient direction, as indicated by the direction of
-        the vector (xc, yc); retain pixels that are a local maximum. */
+  for (int i = 0; i < count; i++)
+  {
+    if (map[i] != 1)
+      continue;
 
-      if (fabs(yc) > fabs(xc))
-      {
-        /* The Y component is biggest, so gradient direction is basically UP/DOWN */
-        xx = fabs(xc)/fabs(yc);
-        yy = 1.0;
+    map[i] = 3;
+    if (!iCannyStackPush(&stack, i))
+    {
+      free(stack.data);
+      return 0;
+    }
 
-        g2 = norm (dx[i-1][j], dy[i-1][j]);
-        g4 = norm (dx[i+1][j], dy[i+1][j]);
-        if (xc*yc > 0.0)
-        {
-          g3 = norm (dx[i+1][j+1], dy[i+1][j+1]);
-          g1 = norm (dx[i-1][j-1], dy[i-1][j-1]);
-        } 
-        else
-        {
-          g3 = norm (dx[i+1][j-1], dy[i+1][j-1]);
-          g1 = norm (dx[i-1][j+1], dy[i-1][j+1]);
-        }
+    while (stack.count > 0)
+    {
+      int offset = stack.data[--stack.count];
+      int x = offset % width;
+      int y = offset / width;
 
-      } 
-      else
+      for (int dy = -1; dy <= 1; dy++)
       {
-        /* The X component is biggest, so gradient direction is basically LEFT/RIGHT */
-        xx = fabs(yc)/fabs(xc);
-        yy = 1.0;
+        int ny = y + dy;
+        if (ny < 1 || ny >= height-1)  /* borders are never marked */
+          continue;
 
-        g2 = norm (dx[i][j+1], dy[i][j+1]);
-        g4 = norm (dx[i][j-1], dy[i][j-1]);
-        if (xc*yc > 0.0)
-        {
-          g3 = norm (dx[i-1][j-1], dy[i-1][j-1]);
-          g1 = norm (dx[i+1][j+1], dy[i+1][j+1]);
-        }
-        else
+        for (int dx = -1; dx <= 1; dx++)
         {
-          g1 = norm (dx[i-1][j+1], dy[i-1][j+1]);
-          g3 = norm (dx[i+1][j-1], dy[i+1][j-1]);
+          int nx = x + dx;
+          if (nx < 1 || nx >= width-1)
+            continue;
+
+          int n_offset = ny*width + nx;
+          if (map[n_offset] == 1 || map[n_offset] == 2)
+          {
+            map[n_offset] = 3;
+            if (!iCannyStackPush(&stack, n_offset))
+            {
+              free(stack.data);
+              return 0;
+            }
+          }
         }
       }
-
-      /* Compute the interpolated value of the gradient magnitude */
-      if ( (g > (xx*g1 + (yy-xx)*g2)) && (g > (xx*g3 + (yy-xx)*g4)) )
-      {
-        mag_data[i*mag->width + j] = tobyte(g*MAG_SCALE);
-      } 
     }
+  }
 
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
+  for (int i = 0; i < count; i++)
+  {
+    if (map[i] == 3)
+      map[i] = 1;
+    else if (map[i] == 2)
+      map[i] = 0;
   }
 
-  return processing;
+  free(stack.data);
+  return 1;
 }
 
-int imProcessCanny(const imImage* src_image, imImage* dst_image, double stddev)
+static void iCannyInit(iCannyParam* param, const imImage* src_image, double stddev)
 {
-  int width = 1;
-  float **smx, **smy;
-  float **dx, **dy;
-  int i;
-  double gau[MAX_MASK_SIZE], dgau[MAX_MASK_SIZE];
-
-  int counter = imCounterBegin("Canny");
-
-  imCounterTotal(counter, 3 * src_image->height + dst_image->height - 2, "Processing...");
+  param->src_data = (const imbyte*)src_image->data[0];
+  param->nr = src_image->height;
+  param->nc = src_image->width;
+  param->mag_scale = 0;
+  param->hysteresis = 0;
+  param->low_thres = 0;
+  param->high_thres = 0;
 
   /* Create a Gaussian and a derivative of Gaussian filter mask */
-  for (i = 0; i<MAX_MASK_SIZE; i++)
+  param->width = 1;
+  for (int i = 0; i<MAX_MASK_SIZE; i++)
   {
-    gau[i] = meanGauss((double)i, stddev);
-    if (gau[i] < 0.005)
+    param->gau[i] = meanGauss((double)i, stddev);
+    if (param->gau[i] < 0.005)
     {
-      width = i;
+      param->width = i;
       break;
     }
-    dgau[i] = dGauss((double)i, stddev);
+    param->dgau[i] = dGauss((double)i, stddev);
   }
+}
+
+static int iCannyProcess(iCannyParam* param, imImage* dst_image, const char* name)
+{
+  int nr = param->nr;
+  int nc = param->nc;
+  int band_count = (nr + CANNY_BAND_HEIGHT - 1) / CANNY_BAND_HEIGHT;
+  int ok = 1;
 
-  smx = f2d(src_image->height, src_image->width);
-  smy = f2d(src_image->height, src_image->width);
+  int counter = imProcessCounterBegin(name);
+  imCounterTotal(counter, 2*band_count, "Processing...");
 
-  /* Convolution of source src_image with a Gaussian in X and Y directions  */
-  if (!seperable_convolution(src_image, gau, width, smx, smy, counter))
+  double* band_max = (double*)calloc(band_count, sizeof(double));
+  float** band_mag = (float**)calloc(band_count, sizeof(float*));
+  if (!band_max || !band_mag)
   {
-    free(smx[0]); free(smx);
-    imCounterEnd(counter);
+    free(band_max);
+    free(band_mag);
+    imProcessCounterEnd(counter);
     return 0;
   }
 
-  MAG_SCALE = 0;
+  IM_INT_PROCESSING;
 
-  /* Now convolve smoothed data with a derivative */
-  dx = f2d(src_image->height, src_image->width);
-  if (!dxy_seperable_convolution(smx, src_image->height, src_image->width, dgau, width, dx, 1, counter))
+  /* Non-maximum suppression - edge pixels should be a local max, 
+     and the maximum derivative, to obtain the magnitude scale */
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(nr)) reduction(&&:ok)
+#endif
+  for (int b = 0; b < band_count; b++)
   {
-    free(dx[0]); free(dx);
-    free(smx[0]); free(smx);
-    imCounterEnd(counter);
-    return 0;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    int band_y0 = b*CANNY_BAND_HEIGHT;
+    int band_y1 = band_y0 + CANNY_BAND_HEIGHT < nr? band_y0 + CANNY_BAND_HEIGHT: nr;
+
+    /* first and last lines are not processed */
+    int y0 = band_y0 < 1? 1: band_y0;
+    int y1 = band_y1 > nr-1? nr-1: band_y1;
+
+    if (y0 < y1)
+    {
+      band_mag[b] = (float*)malloc((y1-y0)*nc*sizeof(float));
+      ok = ok && band_mag[b] && iCannyNonMax(param, y0, y1, band_y0, band_y1, band_mag[b], &band_max[b]);
+    }
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
   }
-  free(smx[0]); free(smx);
 
-  dy = f2d(src_image->height, src_image->width);
-  if (!dxy_seperable_convolution(smy, src_image->height, src_image->width, dgau, width, dy, 0, counter))
+  if (processing && ok)
   {
-    free(dx[0]); free(dx);
-    free(dy[0]); free(dy);
-    free(smy[0]); free(smy);
-    imCounterEnd(counter);
-    return 0;
+    double max = 0;
+    for (int b = 0; b < band_count; b++)
+    {
+      if (band_max[b] > max)
+        max = band_max[b];
+    }
+
+    if (max)
+      param->mag_scale = 255.0 / (1.4142*max);
+
+    imbyte* mag_data = (imbyte*)dst_image->data[0];
+
+    memset(mag_data, 0, nc);
+    memset(mag_data + (nr-1)*nc, 0, nc);
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(nr))
+#endif
+    for (int b = 0; b < band_count; b++)
+    {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+      IM_BEGIN_PROCESSING;
+
+      int y0 = b*CANNY_BAND_HEIGHT;
+      int y1 = y0 + CANNY_BAND_HEIGHT < nr? y0 + CANNY_BAND_HEIGHT: nr;
+      if (y0 < 1) y0 = 1;
+      if (y1 > nr-1) y1 = nr-1;
+
+      for (int y = y0; y < y1; y++)
+        iCannyScaleLine(param, band_mag[b] + (y-y0)*nc, mag_data + y*nc);
+
+      IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+      IM_END_PROCESSING;
+    }
   }
-  free(smy[0]); free(smy);
 
-  if (MAG_SCALE)
-    MAG_SCALE = 255.0 / (1.4142*MAG_SCALE);
+  for (int b = 0; b < band_count; b++)
+    free(band_mag[b]);
+  free(band_mag);
+  free(band_max);
+
+  if (processing && ok && param->hysteresis)
+    ok = iCannyHysteresis((imbyte*)dst_image->data[0], nc, nr);
 
-  /* Non-maximum suppression - edge pixels should be a local max */
-  if (!nonmax_suppress(dx, dy, dst_image, counter))
+  imProcessCounterEnd(counter);
+  return processing && ok;
+}
+
+int imProcessCanny(const imImage* src_image, imImage* dst_image, double stddev)
+{
+  iCannyParam param;
+  imImage* src_copy = NULL;
+
+  /* lines are read by several bands while the target is written */
+  if (src_image->data[0] == dst_image->data[0])
   {
-    free(dx[0]); free(dx);
-    free(dy[0]); free(dy);
-    imCounterEnd(counter);
-    return 0;
+    src_image = src_copy = imImageDuplicate(src_image);
+    if (!src_copy)
+      return 0;
   }
 
-  free(dx[0]); free(dx);
-  free(dy[0]); free(dy);
+  iCannyInit(&param, src_image, stddev);
 
-  imCounterEnd(counter);
-  return 1;
+  int ret = iCannyProcess(&param, dst_image, "Canny");
+
+  if (src_copy) imImageDestroy(src_copy);
+  return ret;
 }
 
+int imProcessCannyHysteresis(const imImage* src_image, imImage* dst_image, double stddev, int low_thres, int high_thres)
+{
+  iCannyParam param;
+  imImage* src_copy = NULL;
+
+  if (src_image->data[0] == dst_image->data[0])
+  {
+    src_image = src_copy = imImageDuplicate(src_image);
+    if (!src_copy)
+      return 0;
+  }
+
+  iCannyInit(&param, src_image, stddev);
+  param.hysteresis = 1;
+  param.low_thres = low_thres;
+  param.high_thres = high_thres;
+
+  int ret = iCannyProcess(&param, dst_image, "CannyHysteresis");
+
+  if (src_copy) imImageDestroy(src_copy);
+  return ret;
+}
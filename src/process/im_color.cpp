@@ -12,6 +12,7 @@
 
 #include "im_process_counter.h"
 #include "im_process_pnt.h"
+#include "im_process_hsi.h"
 
 #include <stdlib.h>
 #include <memory.h>
@@ -24,7 +25,6 @@ static void DoPseudoColor(T* src_data, imbyte** dst_data, int count)
     *green = dst_data[1],
     *blue = dst_data[2];
   T min, max;
-  unsigned char r, g, b;
 
   imMinMaxType(src_data, count, min, max);
 
@@ -33,6 +33,7 @@ static void DoPseudoColor(T* src_data, imbyte** dst_data, int count)
 #endif
   for (int i = 0; i < count; i++)
   {
+    unsigned char r, g, b;
     double norm = (double)(src_data[i] - min) / (double)(max - min);  // now 0 <= norm <= 1
 
     imColorHSI2RGBbyte(norm * 360, 1.0, norm, &r, &g, &b);
@@ -115,91 +116,142 @@ void imProcessSplitYChroma(const imImage* src_image, imImage* y_image, imImage*
 }
 
 template <class T>
-static void DoSplitHSIReal(T** data, T* hue, T* saturation, T* intensity, int count)
+static void DoSplitHSIReal(T** data, T* hue, T* saturation, T* intensity, int count, int fast)
 {
   T *red = data[0],
       *green=data[1],
        *blue=data[2];
-  double h, s, i;
 
 #ifdef _OPENMP
 #pragma omp parallel for if (IM_OMP_MINCOUNT(count))
 #endif
   for (int ii = 0; ii < count; ii++)
   {
-    imColorRGB2HSI(red[ii], green[ii], blue[ii], &h, &s, &i);
+    if (fast)
+    {
+      float h, s, i;
+      iFastRGB2HSI((float)red[ii], (float)green[ii], (float)blue[ii], &h, &s, &i);
 
-    hue[ii] = (T)h;
-    saturation[ii] = (T)s;
-    intensity[ii] = (T)i;
+      hue[ii] = (T)h;
+      saturation[ii] = (T)s;
+      intensity[ii] = (T)i;
+    }
+    else
+    {
+      double h, s, i;
+      imColorRGB2HSI(red[ii], green[ii], blue[ii], &h, &s, &i);
+
+      hue[ii] = (T)h;
+      saturation[ii] = (T)s;
+      intensity[ii] = (T)i;
+    }
   }
 }
 
 template <class T>
-static void DoSplitHSIByte(imbyte** data, T* hue, T* saturation, T* intensity, int count)
+static void DoSplitHSIByte(imbyte** data, T* hue, T* saturation, T* intensity, int count, int fast)
 {
   imbyte *red=data[0],
        *green=data[1],
         *blue=data[2];
-  double h, s, i;
+
+  /* same normalization of imColorRGB2HSIbyte */
+  float norm[256];
+  for (int v = 0; v < 256; v++)
+    norm[v] = (float)imColorReconstruct((imbyte)v, (imbyte)0, (imbyte)255);
 
 #ifdef _OPENMP
 #pragma omp parallel for if (IM_OMP_MINCOUNT(count))
 #endif
   for (int ii = 0; ii < count; ii++)
   {
-    imColorRGB2HSIbyte(red[ii], green[ii], blue[ii], &h, &s, &i);
+    if (fast)
+    {
+      float h, s, i;
+      iFastRGB2HSI(norm[red[ii]], norm[green[ii]], norm[blue[ii]], &h, &s, &i);
 
-    hue[ii] = (T)h;
-    saturation[ii] = (T)s;
-    intensity[ii] = (T)i;
+      hue[ii] = (T)h;
+      saturation[ii] = (T)s;
+      intensity[ii] = (T)i;
+    }
+    else
+    {
+      double h, s, i;
+      imColorRGB2HSIbyte(red[ii], green[ii], blue[ii], &h, &s, &i);
+
+      hue[ii] = (T)h;
+      saturation[ii] = (T)s;
+      intensity[ii] = (T)i;
+    }
   }
 }
 
-void imProcessSplitHSI(const imImage* src_image, imImage* dst_image1, imImage* dst_image2, imImage* dst_image3)
+static void iSplitHSI(const imImage* src_image, imImage* dst_image1, imImage* dst_image2, imImage* dst_image3, int fast)
 {
   switch(src_image->data_type)
   {
   case IM_BYTE:
     if (dst_image1->data_type == IM_FLOAT)
-      DoSplitHSIByte((imbyte**)src_image->data, (float*)dst_image1->data[0], (float*)dst_image2->data[0], (float*)dst_image3->data[0], src_image->count);
+      DoSplitHSIByte((imbyte**)src_image->data, (float*)dst_image1->data[0], (float*)dst_image2->data[0], (float*)dst_image3->data[0], src_image->count, fast);
     else
-      DoSplitHSIByte((imbyte**)src_image->data, (double*)dst_image1->data[0], (double*)dst_image2->data[0], (double*)dst_image3->data[0], src_image->count);
+      DoSplitHSIByte((imbyte**)src_image->data, (double*)dst_image1->data[0], (double*)dst_image2->data[0], (double*)dst_image3->data[0], src_image->count, fast);
     break;
   case IM_FLOAT:                                                                                                                               
-    DoSplitHSIReal((float**)src_image->data, (float*)dst_image1->data[0], (float*)dst_image2->data[0], (float*)dst_image3->data[0], src_image->count);
+    DoSplitHSIReal((float**)src_image->data, (float*)dst_image1->data[0], (float*)dst_image2->data[0], (float*)dst_image3->data[0], src_image->count, fast);
     break;                                                                                
   case IM_DOUBLE:
-    DoSplitHSIReal((double**)src_image->data, (double*)dst_image1->data[0], (double*)dst_image2->data[0], (double*)dst_image3->data[0], src_image->count);
+    DoSplitHSIReal((double**)src_image->data, (double*)dst_image1->data[0], (double*)dst_image2->data[0], (double*)dst_image3->data[0], src_image->count, fast);
     break;
   }
 
   imImageSetPalette(dst_image1, imPaletteHues(), 256);
 }
 
+void imProcessSplitHSI(const imImage* src_image, imImage* dst_image1, imImage* dst_image2, imImage* dst_image3)
+{
+  iSplitHSI(src_image, dst_image1, dst_image2, dst_image3, 0);
+}
+
+void imProcessSplitHSIFast(const imImage* src_image, imImage* dst_image1, imImage* dst_image2, imImage* dst_image3)
+{
+  iSplitHSI(src_image, dst_image1, dst_image2, dst_image3, 1);
+}
+
 template <class T>
-static void DoMergeHSIReal(T** data, T* hue, T* saturation, T* intensity, int count)
+static void DoMergeHSIReal(T** data, T* hue, T* saturation, T* intensity, int count, int fast)
 {
   T *red = data[0],
       *green=data[1],
        *blue=data[2];
-  double R, G, B;
 
 #ifdef _OPENMP
 #pragma omp parallel for if (IM_OMP_MINCOUNT(count))
 #endif
   for (int i = 0; i < count; i++)
   {
-    imColorHSI2RGB(hue[i], saturation[i], intensity[i], &R, &G, &B);
+    if (fast)
+    {
+      float R, G, B;
+      iFastHSI2RGB((float)hue[i], (float)saturation[i], (float)intensity[i], &R, &G, &B);
+
+      red[i] = (T)R;
+      green[i] = (T)G;
+      blue[i] = (T)B;
+    }
+    else
+    {
+      double R, G, B;
+      imColorHSI2RGB(hue[i], saturation[i], intensity[i], &R, &G, &B);
 
-    red[i] = (T)R;
-    green[i] = (T)G;
-    blue[i] = (T)B;
+      red[i] = (T)R;
+      green[i] = (T)G;
+      blue[i] = (T)B;
+    }
   }
 }
 
 template <class T>
-static void DoMergeHSIByte(imbyte** data, T* hue, T* saturation, T* intensity, int count)
+static void DoMergeHSIByte(imbyte** data, T* hue, T* saturation, T* intensity, int count, int fast)
 {
   imbyte *red=data[0],
        *green=data[1],
@@ -210,29 +262,50 @@ static void DoMergeHSIByte(imbyte** data, T* hue, T* saturation, T* intensity, i
 #endif
   for (int i = 0; i < count; i++)
   {
-    imColorHSI2RGBbyte(hue[i], saturation[i], intensity[i], &red[i], &green[i], &blue[i]);
+    if (fast)
+    {
+      float R, G, B;
+      iFastHSI2RGB((float)hue[i], (float)saturation[i], (float)intensity[i], &R, &G, &B);
+
+      /* quantize in double, in float imRound(-0.5+tiny) can round to -1 */
+      red[i] = imColorQuantize((double)R, (imbyte)0, (imbyte)255);
+      green[i] = imColorQuantize((double)G, (imbyte)0, (imbyte)255);
+      blue[i] = imColorQuantize((double)B, (imbyte)0, (imbyte)255);
+    }
+    else
+      imColorHSI2RGBbyte(hue[i], saturation[i], intensity[i], &red[i], &green[i], &blue[i]);
   }
 }
 
-void imProcessMergeHSI(const imImage* src_image1, const imImage* src_image2, const imImage* src_image3, imImage* dst_image)
+static void iMergeHSI(const imImage* src_image1, const imImage* src_image2, const imImage* src_image3, imImage* dst_image, int fast)
 {
   switch(dst_image->data_type)
   {
   case IM_BYTE:
     if (src_image1->data_type == IM_FLOAT)
-      DoMergeHSIByte((imbyte**)dst_image->data, (float*)src_image1->data[0], (float*)src_image2->data[0], (float*)src_image3->data[0], dst_image->count);
+      DoMergeHSIByte((imbyte**)dst_image->data, (float*)src_image1->data[0], (float*)src_image2->data[0], (float*)src_image3->data[0], dst_image->count, fast);
     else
-      DoMergeHSIByte((imbyte**)dst_image->data, (double*)src_image1->data[0], (double*)src_image2->data[0], (double*)src_image3->data[0], dst_image->count);
+      DoMergeHSIByte((imbyte**)dst_image->data, (double*)src_image1->data[0], (double*)src_image2->data[0], (double*)src_image3->data[0], dst_image->count, fast);
     break;                                                                                                                                    
   case IM_FLOAT:                                                                                                                               
-    DoMergeHSIReal((float**)dst_image->data, (float*)src_image1->data[0], (float*)src_image2->data[0], (float*)src_image3->data[0], dst_image->count);
+    DoMergeHSIReal((float**)dst_image->data, (float*)src_image1->data[0], (float*)src_image2->data[0], (float*)src_image3->data[0], dst_image->count, fast);
     break;                                                                                
   case IM_DOUBLE:
-    DoMergeHSIReal((double**)dst_image->data, (double*)src_image1->data[0], (double*)src_image2->data[0], (double*)src_image3->data[0], dst_image->count);
+    DoMergeHSIReal((double**)dst_image->data, (double*)src_image1->data[0], (double*)src_image2->data[0], (double*)src_image3->data[0], dst_image->count, fast);
     break;
   }
 }
 
+void imProcessMergeHSI(const imImage* src_image1, const imImage* src_image2, const imImage* src_image3, imImage* dst_image)
+{
+  iMergeHSI(src_image1, src_image2, src_image3, dst_image, 0);
+}
+
+void imProcessMergeHSIFast(const imImage* src_image1, const imImage* src_image2, const imImage* src_image3, imImage* dst_image)
+{
+  iMergeHSI(src_image1, src_image2, src_image3, dst_image, 1);
+}
+
 void imProcessSplitComponents(const imImage* src_image, imImage** dst_image)
 {
   memcpy(dst_image[0]->data[0], src_image->data[0], src_image->plane_size);
@@ -605,8 +678,111 @@ static double iColorNormHue(double H)
   return H;
 }
 
+/* Fast hue of a block of pixels, hue is scale invariant so no normalization is necessary */
 template <class T>
-static void DoSelectHue(T** src_data, T** dst_data, int count, double hue_start, double hue_end)
+static inline void iFastHueBlock(const T* red, const T* green, const T* blue, float* hue, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    float v = (float)red[i] - ((float)green[i] + (float)blue[i]) * 0.5f;
+    float u = ((float)green[i] - (float)blue[i]) * (IM_HSI_SQRT3 / 2.0f);
+
+    if (u == 0 && v == 0)
+      hue[i] = 360.0f;
+    else
+      hue[i] = iFastHue(u, v);
+  }
+}
+
+#ifdef IM_USE_SSE2
+static inline void iFastHueBlock4(__m128 r, __m128 g, __m128 b, float* hue)
+{
+  __m128 v = _mm_sub_ps(r, _mm_mul_ps(_mm_add_ps(g, b), _mm_set1_ps(0.5f)));
+  __m128 u = _mm_mul_ps(_mm_sub_ps(g, b), _mm_set1_ps(IM_HSI_SQRT3 / 2.0f));
+  _mm_storeu_ps(hue, iFastHue4(u, v));
+}
+
+static inline void iFastHueBlock(const imbyte* red, const imbyte* green, const imbyte* blue, float* hue, int count)
+{
+  int i = 0;
+  const __m128i zero = _mm_setzero_si128();
+
+  for (; i + 4 <= count; i += 4)
+  {
+    int r4, g4, b4;
+    memcpy(&r4, red + i, 4);
+    memcpy(&g4, green + i, 4);
+    memcpy(&b4, blue + i, 4);
+
+    __m128 r = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(r4), zero), zero));
+    __m128 g = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(g4), zero), zero));
+    __m128 b = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(b4), zero), zero));
+
+    iFastHueBlock4(r, g, b, hue + i);
+  }
+
+  iFastHueBlock<imbyte>(red + i, green + i, blue + i, hue + i, count - i);
+}
+
+static inline void iFastHueBlock(const float* red, const float* green, const float* blue, float* hue, int count)
+{
+  int i = 0;
+
+  for (; i + 4 <= count; i += 4)
+    iFastHueBlock4(_mm_loadu_ps(red + i), _mm_loadu_ps(green + i), _mm_loadu_ps(blue + i), hue + i);
+
+  iFastHueBlock<float>(red + i, green + i, blue + i, hue + i, count - i);
+}
+#endif
+
+#define IM_HUE_BLOCK 256
+
+template <class T>
+static void DoSelectHueFast(T** src_data, T** dst_data, int count, double hue_start, double hue_end, int interval360, T min)
+{
+  T *dst_red = dst_data[0],
+    *dst_green = dst_data[1],
+    *dst_blue = dst_data[2];
+  T *src_red = src_data[0],
+    *src_green = src_data[1],
+    *src_blue = src_data[2];
+  int block_count = (count + IM_HUE_BLOCK - 1) / IM_HUE_BLOCK;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+  for (int k = 0; k < block_count; k++)
+  {
+    float hue[IM_HUE_BLOCK];
+    int offset = k * IM_HUE_BLOCK;
+    int size = (offset + IM_HUE_BLOCK < count)? IM_HUE_BLOCK: count - offset;
+
+    iFastHueBlock(src_red + offset, src_green + offset, src_blue + offset, hue, size);
+
+    for (int j = 0; j < size; j++)
+    {
+      int i = offset + j;
+      double H = hue[j];
+
+      if ((!interval360 && (H < hue_start || H > hue_end)) ||
+          (interval360 && (H < hue_start && H > hue_end)))
+      {
+        dst_red[i] = (T)min;
+        dst_green[i] = (T)min;
+        dst_blue[i] = (T)min;
+      }
+      else
+      {
+        dst_red[i] = src_red[i];
+        dst_green[i] = src_green[i];
+        dst_blue[i] = src_blue[i];
+      }
+    }
+  }
+}
+
+template <class T>
+static void DoSelectHue(T** src_data, T** dst_data, int count, double hue_start, double hue_end, int fast)
 {
   T *dst_red = dst_data[0],
     *dst_green = dst_data[1],
@@ -615,8 +791,6 @@ static void DoSelectHue(T** src_data, T** dst_data, int count, double hue_start,
     *src_green = src_data[1],
     *src_blue = src_data[2];
   T min, max;
-  double r, g, b;
-  double H, S, I;
 
   imMinMaxType(src_data[0], count * 3, min, max);
 
@@ -626,11 +800,20 @@ static void DoSelectHue(T** src_data, T** dst_data, int count, double hue_start,
   if (hue_start > hue_end)
     interval360 = 1;
 
+  if (fast)
+  {
+    DoSelectHueFast(src_data, dst_data, count, hue_start, hue_end, interval360, min);
+    return;
+  }
+
 #ifdef _OPENMP
 #pragma omp parallel for if (IM_OMP_MINCOUNT(count))
 #endif
   for (int i = 0; i < count; i++)
   {
+    double r, g, b;
+    double H, S, I;
+
     r = (double)(src_red[i] - min) / (double)(max - min);  // now 0 <= norm <= 1
     g = (double)(src_green[i] - min) / (double)(max - min);  // now 0 <= norm <= 1
     b = (double)(src_blue[i] - min) / (double)(max - min);  // now 0 <= norm <= 1
@@ -653,24 +836,34 @@ static void DoSelectHue(T** src_data, T** dst_data, int count, double hue_start,
   }
 }
 
-void imProcessSelectHue(const imImage* src_image, imImage* dst_image, double hue_start, double hue_end)
+static void iSelectHue(const imImage* src_image, imImage* dst_image, double hue_start, double hue_end, int fast)
 {
   switch (src_image->data_type)
   {
   case IM_BYTE:
-    DoSelectHue((imbyte**)src_image->data, (imbyte**)dst_image->data, src_image->count, hue_start, hue_end);
+    DoSelectHue((imbyte**)src_image->data, (imbyte**)dst_image->data, src_image->count, hue_start, hue_end, fast);
     break;
   case IM_SHORT:
-    DoSelectHue((short**)src_image->data, (short**)dst_image->data, src_image->count, hue_start, hue_end);
+    DoSelectHue((short**)src_image->data, (short**)dst_image->data, src_image->count, hue_start, hue_end, fast);
     break;
   case IM_USHORT:
-    DoSelectHue((imushort**)src_image->data, (imushort**)dst_image->data, src_image->count, hue_start, hue_end);
+    DoSelectHue((imushort**)src_image->data, (imushort**)dst_image->data, src_image->count, hue_start, hue_end, fast);
     break;
   case IM_FLOAT:
-    DoSelectHue((float**)src_image->data, (float**)dst_image->data, src_image->count, hue_start, hue_end);
+    DoSelectHue((float**)src_image->data, (float**)dst_image->data, src_image->count, hue_start, hue_end, fast);
     break;
   case IM_DOUBLE:
-    DoSelectHue((double**)src_image->data, (double**)dst_image->data, src_image->count, hue_start, hue_end);
+    DoSelectHue((double**)src_image->data, (double**)dst_image->data, src_image->count, hue_start, hue_end, fast);
     break;
   }
 }
+
+void imProcessSelectHue(const imImage* src_image, imImage* dst_image, double hue_start, double hue_end)
+{
+  iSelectHue(src_image, dst_image, hue_start, hue_end, 0);
+}
+
+void imProcessSelectHueFast(const imImage* src_image, imImage* dst_image, double hue_start, double hue_end)
+{
+  iSelectHue(src_image, dst_image, hue_start, hue_end, 1);
+}
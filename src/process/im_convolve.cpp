@@ -847,7 +847,7 @@ int imProcessConvolve(const imImage* src_image, imImage* dst_image, const imImag
 
 int imProcessConvolveRep(const imImage* src_image, imImage* dst_image, const imImage *kernel, int ntimes)
 {
-  imImage *AuxImage = imImageClone(dst_image);
+  imImage *AuxImage = imProcessImagePoolClone(dst_image);
   if (!AuxImage)
     return 0;
 
@@ -871,7 +871,7 @@ int imProcessConvolveRep(const imImage* src_image, imImage* dst_image, const imI
     if (!DoConvolveStep(image1, image2, kernel, counter))
     {
       if (dkernel) imImageDestroy(dkernel);
-      imImageDestroy(AuxImage);
+      imProcessImagePoolRelease(AuxImage);
       imProcessCounterEnd(counter);
       return 0;
     }
@@ -894,7 +894,7 @@ int imProcessConvolveRep(const imImage* src_image, imImage* dst_image, const imI
 
   if (dkernel) imImageDestroy(dkernel);
 
-  imImageDestroy(AuxImage);
+  imProcessImagePoolRelease(AuxImage);
 
   imProcessCounterEnd(counter);
 
@@ -1579,7 +1579,7 @@ int imProcessLapOfGaussianConvolve(const imImage* src_image, imImage* dst_image,
   if (src_image->data_type == IM_BYTE ||  // Unsigned types
       src_image->data_type == IM_USHORT)
   {
-    imImage* aux_image = imImageClone(dst_image);
+    imImage* aux_image = imProcessImagePoolClone(dst_image);
     if (!aux_image)
     {
       imImageDestroy(kernel);
@@ -1589,7 +1589,7 @@ int imProcessLapOfGaussianConvolve(const imImage* src_image, imImage* dst_image,
 
     imProcessUnArithmeticOp(src_image, aux_image, IM_UN_EQL);  // Convert to IM_INT
     ret = imProcessConvolve(aux_image, dst_image, kernel);
-    imImageDestroy(aux_image);
+    imProcessImagePoolRelease(aux_image);
   }
   else
     ret = imProcessConvolve(src_image, dst_image, kernel);
@@ -1604,11 +1604,11 @@ int imProcessDiffOfGaussianConvolve(const imImage* src_image, imImage* dst_image
 {
   int counter = imProcessCounterBegin("DiffOfGaussianConvolve");
 
-  imImage* aux_image1 = imImageClone(src_image);
-  imImage* aux_image2 = imImageClone(src_image);
+  imImage* aux_image1 = imProcessImagePoolClone(src_image);
+  imImage* aux_image2 = imProcessImagePoolClone(src_image);
   if (!aux_image1 || !aux_image2)
   {
-    if (aux_image1) imImageDestroy(aux_image1);
+    if (aux_image1) imProcessImagePoolRelease(aux_image1);
     imProcessCounterEnd(counter);
     return 0;
   }
@@ -1628,8 +1628,8 @@ int imProcessDiffOfGaussianConvolve(const imImage* src_image, imImage* dst_image
   {
     if (kernel1) imImageDestroy(kernel1);
     if (kernel2) imImageDestroy(kernel2);
-    imImageDestroy(aux_image1);
-    imImageDestroy(aux_image2);
+    imProcessImagePoolRelease(aux_image1);
+    imProcessImagePoolRelease(aux_image2);
     imProcessCounterEnd(counter);
     return 0;
   }
@@ -1645,8 +1645,8 @@ int imProcessDiffOfGaussianConvolve(const imImage* src_image, imImage* dst_image
   {
     imImageDestroy(kernel1);
     imImageDestroy(kernel2);
-    imImageDestroy(aux_image1);
-    imImageDestroy(aux_image2);
+    imProcessImagePoolRelease(aux_image1);
+    imProcessImagePoolRelease(aux_image2);
     imProcessCounterEnd(counter);
     return 0;
   }
@@ -1655,8 +1655,8 @@ int imProcessDiffOfGaussianConvolve(const imImage* src_image, imImage* dst_image
 
   imImageDestroy(kernel1);
   imImageDestroy(kernel2);
-  imImageDestroy(aux_image1);
-  imImageDestroy(aux_image2);
+  imProcessImagePoolRelease(aux_image1);
+  imProcessImagePoolRelease(aux_image2);
 
   imProcessCounterEnd(counter);
   return 1;
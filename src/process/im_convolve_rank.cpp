@@ -356,6 +356,143 @@ int imProcessRangeConvolve(const imImage* src_image, imImage* dst_image, int ks)
   return ret;
 }
 
+/* Window offsets of the rank convolution: from -k/2 to k/2, one less at the end when k is even */
+static inline void iRankWindow(int k, int &first, int &last)
+{
+  first = -(k/2);
+  last = k/2;
+  if (k%2==0) last--;
+}
+
+template <int MAX, class T> 
+static inline T iExtreme(T a, T b)
+{
+  if (MAX)
+    return a > b? a: b;
+  else
+    return a < b? a: b;
+}
+
+#define IM_EXTREME_LANES 16
+
+/* Running minimum (MAX=0) or maximum (MAX=1) along n samples for the windows [i+first, i+first+k-1], 
+   clipped at the borders (padded with the neutral value). Samples are step apart and have "lanes" contiguous elements, 
+   so columns are processed in groups with contiguous memory access.
+   Uses the van Herk/Gil-Werman algorithm: 3 comparisons per sample regardless of the window size.
+   Buffers g and h must have (n+2*k)*lanes elements. In-place is allowed. */
+template <int MAX, class T> 
+static void iRunningExtreme(const T* src, T* dst, int step, int lanes, int n, int first, int k, T* g, T* h, T neutral)
+{
+  int m = n + k - 1;
+
+  for (int j = 0; j < m + k; j++)
+  {
+    int i = j + first;
+    T* gj = g + j*lanes;
+
+    if (i < 0 || i >= n)
+    {
+      for (int l = 0; l < lanes; l++)
+        gj[l] = neutral;
+    }
+    else
+    {
+      const T* s = src + (size_t)i*step;
+      for (int l = 0; l < lanes; l++)
+        gj[l] = s[l];
+    }
+  }
+
+  /* in each block of k samples g is the prefix extreme and h is the suffix extreme */
+  for (int b0 = 0; b0 < m; b0 += k)
+  {
+    int b1 = b0 + k - 1;
+
+    for (int l = 0; l < lanes; l++)
+      h[b1*lanes + l] = g[b1*lanes + l];
+
+    for (int j = b1 - 1; j >= b0; j--)
+    {
+      for (int l = 0; l < lanes; l++)
+        h[j*lanes + l] = iExtreme<MAX>(g[j*lanes + l], h[(j + 1)*lanes + l]);
+    }
+
+    for (int j = b0 + 1; j <= b1; j++)
+    {
+      for (int l = 0; l < lanes; l++)
+        g[j*lanes + l] = iExtreme<MAX>(g[(j - 1)*lanes + l], g[j*lanes + l]);
+    }
+  }
+
+  for (int i = 0; i < n; i++)
+  {
+    T* d = dst + (size_t)i*step;
+    const T* hi = h + i*lanes;
+    const T* gi = g + (i + k - 1)*lanes;
+
+    for (int l = 0; l < lanes; l++)
+      d[l] = iExtreme<MAX>(hi[l], gi[l]);
+  }
+}
+
+/* Local minimum or maximum in a kw x kh window, the same as the rank convolution with a min or max function. 
+   Separable, a horizontal pass from map to dst_map and a vertical pass in-place. */
+template <int MAX, class T> 
+static int DoLocalExtreme(const T* map, T* dst_map, int width, int height, int kw, int kh, T neutral, int counter)
+{
+  int kw1, kw2, kh1, kh2;
+  iRankWindow(kw, kw1, kw2);
+  iRankWindow(kh, kh1, kh2);
+
+  int tcount = IM_MAX_THREADS;
+  int buf_size = ((width > height? width: height) + 2*(kw > kh? kw: kh)) * IM_EXTREME_LANES;
+  T* buffer = (T*)malloc(2*buf_size*tcount*sizeof(T));
+  if (!buffer)
+    return 0;
+
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
+#endif
+  for (int y = 0; y < height; y++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    T* buf = buffer + 2*buf_size*IM_THREAD_NUM;
+    size_t offset = (size_t)y*width;
+    iRunningExtreme<MAX>(map + offset, dst_map + offset, 1, 1, width, kw1, kw, buf, buf + buf_size, neutral);
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  if (processing)
+  {
+    int groups = (width + IM_EXTREME_LANES - 1) / IM_EXTREME_LANES;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
+#endif
+    for (int c = 0; c < groups; c++)
+    {
+      T* buf = buffer + 2*buf_size*IM_THREAD_NUM;
+      int x = c*IM_EXTREME_LANES;
+      int lanes = x + IM_EXTREME_LANES < width? IM_EXTREME_LANES: width - x;
+      iRunningExtreme<MAX>(dst_map + x, dst_map + x, width, lanes, height, kh1, kh, buf, buf + buf_size, neutral);
+    }
+  }
+
+  free(buffer);
+  return processing;
+}
+
 /*
 Local variable threshold by the method of Bernsen.
 
@@ -379,214 +516,293 @@ Image processing lab, Department of Informatics
 University of Oslo
 */
 
-static int thresAux = 0;
-
-static imbyte contrast_thres_op_byte(imbyte* value, int count, int center)
+template <class T> 
+static void DoRangeContrastThreshold(const T* map, const T* min_map, const T* max_map, imbyte* dst_map, int count, int min_range)
 {
-  int c, t;
-  imbyte v = value[center], min, max;
-
-  imMinMax(value, count, min, max);
-
-  c = max-min;
-
-  if (c < thresAux) 
-    return 0;
-  else
-  { 
-    t = ((int)max + (int)min) / 2;
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+  for (int i = 0; i < count; i++)
+  {
+    int min = (int)min_map[i], max = (int)max_map[i];
 
-    if (v >= t)
-      return 1;
+    if (max - min < min_range) 
+      dst_map[i] = 0;
     else
-      return 0;
+    { 
+      int t = (max + min) / 2;
+      dst_map[i] = (int)map[i] >= t? 1: 0;
+    }
   }
 }
 
-static imushort contrast_thres_op_ushort(imushort* value, int count, int center)
+template <class T> 
+static int DoRangeContrast(const T* map, T* min_map, T* max_map, imbyte* dst_map, int width, int height, int ks, int min_range, T type_min, T type_max, int counter)
 {
-  int c, t;
-  imushort v = value[center], min, max;
-
-  imMinMax(value, count, min, max);
-
-  c = max-min;
-
-  if (c < thresAux) 
+  if (!DoLocalExtreme<0>(map, min_map, width, height, ks, ks, type_max, counter))
+    return 0;
+  if (!DoLocalExtreme<1>(map, max_map, width, height, ks, ks, type_min, counter))
     return 0;
-  else
-  { 
-    t = ((int)max + (int)min) / 2;
 
-    if (v >= t)
-      return 1;
-    else
-      return 0;
-  }
+  DoRangeContrastThreshold(map, min_map, max_map, dst_map, width*height, min_range);
+  return 1;
 }
 
-static short contrast_thres_op_short(short* value, int count, int center)
+int imProcessRangeContrastThreshold(const imImage* src_image, imImage* dst_image, int ks, int min_range)
 {
-  int c, t;
-  short v = value[center], min, max;
+  imImage* min_image = imProcessImagePoolClone(src_image);
+  imImage* max_image = imProcessImagePoolClone(src_image);
+  if (!min_image || !max_image)
+  {
+    if (min_image) imProcessImagePoolRelease(min_image);
+    if (max_image) imProcessImagePoolRelease(max_image);
+    return 0;
+  }
 
-  imMinMax(value, count, min, max);
+  int ret = 0;
+  int counter = imProcessCounterBegin("RangeContrastThreshold");
+  imCounterTotal(counter, 2*src_image->height, "Processing...");
+
+  switch(src_image->data_type)
+  {
+  case IM_BYTE:
+    ret = DoRangeContrast((imbyte*)src_image->data[0], (imbyte*)min_image->data[0], (imbyte*)max_image->data[0], (imbyte*)dst_image->data[0], 
+                          src_image->width, src_image->height, ks, min_range, (imbyte)0, (imbyte)255, counter);
+    break;                                                                                
+  case IM_SHORT:                                                                           
+    ret = DoRangeContrast((short*)src_image->data[0], (short*)min_image->data[0], (short*)max_image->data[0], (imbyte*)dst_image->data[0], 
+                          src_image->width, src_image->height, ks, min_range, (short)-32768, (short)32767, counter);
+    break;                                                                                
+  case IM_USHORT:                                                                           
+    ret = DoRangeContrast((imushort*)src_image->data[0], (imushort*)min_image->data[0], (imushort*)max_image->data[0], (imbyte*)dst_image->data[0], 
+                          src_image->width, src_image->height, ks, min_range, (imushort)0, (imushort)65535, counter);
+    break;                                                                                
+  case IM_INT:                                                                           
+    ret = DoRangeContrast((int*)src_image->data[0], (int*)min_image->data[0], (int*)max_image->data[0], (imbyte*)dst_image->data[0], 
+                          src_image->width, src_image->height, ks, min_range, (int)(-2147483647 - 1), (int)2147483647, counter);
+    break;                                                                                
+  }
 
-  c = max-min;
+  imProcessCounterEnd(counter);
 
-  if (c < thresAux) 
-    return 0;
-  else
-  { 
-    t = ((int)max + (int)min) / 2;
+  imProcessImagePoolRelease(min_image);
+  imProcessImagePoolRelease(max_image);
+
+  return ret;
+}
 
-    if (v >= t)
-      return 1;
+template <class T> 
+static void DoLocalMaxThreshold(const T* map, const T* max_map, imbyte* dst_map, int count, int min_thres)
+{
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+  for (int i = 0; i < count; i++)
+  {
+    if ((int)map[i] < min_thres || map[i] < max_map[i]) 
+      dst_map[i] = 0;
     else
-      return 0;
+      dst_map[i] = 1;
   }
 }
 
-static int contrast_thres_op_int(int* value, int count, int center)
+template <class T> 
+static int DoLocalMax(const T* map, T* max_map, imbyte* dst_map, int width, int height, int ks, int min_thres, T type_min, int counter)
 {
-  int c, t;
-  int v = value[center], min, max;
-
-  imMinMax(value, count, min, max);
-
-  c = max-min;
-
-  if (c < thresAux) 
+  if (!DoLocalExtreme<1>(map, max_map, width, height, ks, ks, type_min, counter))
     return 0;
-  else
-  { 
-    t = ((int)max + (int)min) / 2;
 
-    if (v >= t)
-      return 1;
-    else
-      return 0;
-  }
+  DoLocalMaxThreshold(map, max_map, dst_map, width*height, min_thres);
+  return 1;
 }
 
-int imProcessRangeContrastThreshold(const imImage* src_image, imImage* dst_image, int ks, int min_range)
+int imProcessLocalMaxThreshold(const imImage* src_image, imImage* dst_image, int ks, int min_thres)
 {
-  int ret = 0;
-  int counter = imProcessCounterBegin("RangeContrastThreshold");
-  imCounterTotal(counter, src_image->depth*src_image->height, "Processing...");
+  imImage* max_image = imProcessImagePoolClone(src_image);
+  if (!max_image)
+    return 0;
 
-  thresAux = min_range;
+  int ret = 0;
+  int counter = imProcessCounterBegin("LocalMaxThreshold");
+  imCounterTotal(counter, src_image->height, "Processing...");
 
   switch(src_image->data_type)
   {
   case IM_BYTE:
-    ret = DoConvolveRankFunc((imbyte*)src_image->data[0], (imbyte*)dst_image->data[0], 
-                             src_image->width, src_image->height, ks, ks, contrast_thres_op_byte, counter);
+    ret = DoLocalMax((imbyte*)src_image->data[0], (imbyte*)max_image->data[0], (imbyte*)dst_image->data[0], 
+                     src_image->width, src_image->height, ks, min_thres, (imbyte)0, counter);
     break;                                                                                
   case IM_SHORT:                                                                           
-    ret = DoConvolveRankFunc((short*)src_image->data[0], (imbyte*)dst_image->data[0], 
-                             src_image->width, src_image->height, ks, ks, contrast_thres_op_short, counter);
+    ret = DoLocalMax((short*)src_image->data[0], (short*)max_image->data[0], (imbyte*)dst_image->data[0], 
+                     src_image->width, src_image->height, ks, min_thres, (short)-32768, counter);
     break;                                                                                
   case IM_USHORT:                                                                           
-    ret = DoConvolveRankFunc((imushort*)src_image->data[0], (imbyte*)dst_image->data[0], 
-                             src_image->width, src_image->height, ks, ks, contrast_thres_op_ushort, counter);
+    ret = DoLocalMax((imushort*)src_image->data[0], (imushort*)max_image->data[0], (imbyte*)dst_image->data[0], 
+                     src_image->width, src_image->height, ks, min_thres, (imushort)0, counter);
     break;                                                                                
   case IM_INT:                                                                           
-    ret = DoConvolveRankFunc((int*)src_image->data[0], (imbyte*)dst_image->data[0], 
-                             src_image->width, src_image->height, ks, ks, contrast_thres_op_int, counter);
+    ret = DoLocalMax((int*)src_image->data[0], (int*)max_image->data[0], (imbyte*)dst_image->data[0], 
+                     src_image->width, src_image->height, ks, min_thres, (int)(-2147483647 - 1), counter);
     break;                                                                                
   }
 
   imProcessCounterEnd(counter);
 
+  imProcessImagePoolRelease(max_image);
+
   return ret;
 }
 
-static imbyte max_thres_op_byte(imbyte* value, int count, int center)
+/* Local mean and variance of a kw x kh window clipped at the borders.
+   The window sums come from column sums, updated when the window moves down, 
+   and from their prefix sums along the line (one line of an integral image),
+   so the cost per pixel does not depend on the window size.
+   Lines are processed in bands, one band for each thread. 
+   A is the accumulator type, 64 bits integer for the small integer types (exact sums), or double. */
+template <class T, class A, class F> 
+static int DoLocalThreshold(const T* map, imbyte* dst_map, int width, int height, int kw, int kh, F& func, int counter)
 {
-  imbyte v = value[center], min, max;
-
-  if (v < thresAux) 
-    return 0;
+  int kw1, kw2, kh1, kh2;
+  iRankWindow(kw, kw1, kw2);
+  iRankWindow(kh, kh1, kh2);
 
-  imMinMax(value, count, min, max);
+  int band_count = IM_OMP_MINHEIGHT(height)? IM_MAX_THREADS: 1;
+  if (band_count > height) band_count = height;
+  int band_height = (height + band_count - 1) / band_count;
 
-  if (v < max)
+  int buf_size = 4*width + 2;
+  A* buffer = (A*)malloc((size_t)buf_size*band_count*sizeof(A));
+  if (!buffer)
     return 0;
 
-  return 1;
-}
+  IM_INT_PROCESSING;
 
-static short max_thres_op_short(short* value, int count, int center)
-{
-  short v = value[center], min, max;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) if (band_count > 1)
+#endif
+  for (int band = 0; band < band_count; band++)
+  {
+    int y0 = band*band_height;
+    int y1 = y0 + band_height < height? y0 + band_height: height;
 
-  if (v < thresAux) 
-    return 0;
+    A* col_sum = buffer + (size_t)band*buf_size;
+    A* col_sum2 = col_sum + width;
+    A* line_sum = col_sum2 + width;        /* width+1 */
+    A* line_sum2 = line_sum + width + 1;   /* width+1 */
 
-  imMinMax(value, count, min, max);
+    memset(col_sum, 0, 2*width*sizeof(A));
 
-  if (v < max)
-    return 0;
+    int r0 = y0 + kh1 < 0? 0: y0 + kh1;
+    int r1 = y0 + kh2 > height - 1? height - 1: y0 + kh2;
+    for (int r = r0; r <= r1; r++)
+    {
+      const T* line = map + (size_t)r*width;
+      for (int x = 0; x < width; x++)
+      {
+        A v = (A)line[x];
+        col_sum[x] += v;
+        col_sum2[x] += v*v;
+      }
+    }
 
-  return 1;
-}
+    for (int y = y0; y < y1; y++)
+    {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+      IM_BEGIN_PROCESSING;
 
-static imushort max_thres_op_ushort(imushort* value, int count, int center)
-{
-  imushort v = value[center], min, max;
+      if (y > y0)
+      {
+        int r_in = y + kh2;
+        int r_out = y - 1 + kh1;
 
-  if (v < thresAux) 
-    return 0;
+        if (r_in < height)
+        {
+          const T* line = map + (size_t)r_in*width;
+          for (int x = 0; x < width; x++)
+          {
+            A v = (A)line[x];
+            col_sum[x] += v;
+            col_sum2[x] += v*v;
+          }
+        }
 
-  imMinMax(value, count, min, max);
+        if (r_out >= 0)
+        {
+          const T* line = map + (size_t)r_out*width;
+          for (int x = 0; x < width; x++)
+          {
+            A v = (A)line[x];
+            col_sum[x] -= v;
+            col_sum2[x] -= v*v;
+          }
+        }
+      }
 
-  if (v < max)
-    return 0;
+      line_sum[0] = 0;
+      line_sum2[0] = 0;
+      for (int x = 0; x < width; x++)
+      {
+        line_sum[x + 1] = line_sum[x] + col_sum[x];
+        line_sum2[x + 1] = line_sum2[x] + col_sum2[x];
+      }
 
-  return 1;
-}
+      int rows = (y + kh2 > height - 1? height - 1: y + kh2) - (y + kh1 < 0? 0: y + kh1) + 1;
+      const T* line = map + (size_t)y*width;
+      imbyte* dst_line = dst_map + (size_t)y*width;
 
-static int max_thres_op_int(int* value, int count, int center)
-{
-  int v = value[center], min, max;
+      for (int x = 0; x < width; x++)
+      {
+        int x0 = x + kw1 < 0? 0: x + kw1;
+        int x1 = x + kw2 > width - 1? width - 1: x + kw2;
+        double n = (double)(rows*(x1 - x0 + 1));
 
-  if (v < thresAux) 
-    return 0;
+        double mean = (double)(line_sum[x1 + 1] - line_sum[x0]) / n;
+        double var = (double)(line_sum2[x1 + 1] - line_sum2[x0]) / n - mean*mean;
+        if (var < 0) var = 0;
 
-  imMinMax(value, count, min, max);
+        dst_line[x] = func((double)line[x], mean, var);
+      }
 
-  if (v < max)
-    return 0;
+      IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+      IM_END_PROCESSING;
+    }
+  }
 
-  return 1;
+  free(buffer);
+  return processing;
 }
 
-int imProcessLocalMaxThreshold(const imImage* src_image, imImage* dst_image, int ks, int min_thres)
+template <class F> 
+static int DoLocalThresholdImage(const imImage* src_image, imImage* dst_image, int ks, F& func, const char* name)
 {
   int ret = 0;
-  int counter = imProcessCounterBegin("LocalMaxThreshold");
-  imCounterTotal(counter, src_image->depth*src_image->height, "Processing...");
-
-  thresAux = min_thres;
+  int counter = imProcessCounterBegin(name);
+  imCounterTotal(counter, src_image->height, "Processing...");
 
   switch(src_image->data_type)
   {
   case IM_BYTE:
-    ret = DoConvolveRankFunc((imbyte*)src_image->data[0], (imbyte*)dst_image->data[0], 
-                             src_image->width, src_image->height, ks, ks, max_thres_op_byte, counter);
+    ret = DoLocalThreshold<imbyte, long long>((imbyte*)src_image->data[0], (imbyte*)dst_image->data[0], src_image->width, src_image->height, ks, ks, func, counter);
     break;                                                                                
   case IM_SHORT:                                                                           
-    ret = DoConvolveRankFunc((short*)src_image->data[0], (imbyte*)dst_image->data[0], 
-                             src_image->width, src_image->height, ks, ks, max_thres_op_short, counter);
+    ret = DoLocalThreshold<short, long long>((short*)src_image->data[0], (imbyte*)dst_image->data[0], src_image->width, src_image->height, ks, ks, func, counter);
     break;                                                                                
   case IM_USHORT:                                                                           
-    ret = DoConvolveRankFunc((imushort*)src_image->data[0], (imbyte*)dst_image->data[0], 
-                             src_image->width, src_image->height, ks, ks, max_thres_op_ushort, counter);
+    ret = DoLocalThreshold<imushort, long long>((imushort*)src_image->data[0], (imbyte*)dst_image->data[0], src_image->width, src_image->height, ks, ks, func, counter);
     break;                                                                                
   case IM_INT:                                                                           
-    ret = DoConvolveRankFunc((int*)src_image->data[0], (imbyte*)dst_image->data[0], 
-                             src_image->width, src_image->height, ks, ks, max_thres_op_int, counter);
+    ret = DoLocalThreshold<int, double>((int*)src_image->data[0], (imbyte*)dst_image->data[0], src_image->width, src_image->height, ks, ks, func, counter);
+    break;                                                                                
+  case IM_FLOAT:                                                                           
+    ret = DoLocalThreshold<float, double>((float*)src_image->data[0], (imbyte*)dst_image->data[0], src_image->width, src_image->height, ks, ks, func, counter);
+    break;                                                                                
+  case IM_DOUBLE:                                                                           
+    ret = DoLocalThreshold<double, double>((double*)src_image->data[0], (imbyte*)dst_image->data[0], src_image->width, src_image->height, ks, ks, func, counter);
     break;                                                                                
   }
 
@@ -595,6 +811,58 @@ int imProcessLocalMaxThreshold(const imImage* src_image, imImage* dst_image, int
   return ret;
 }
 
+struct iNiblackThres
+{
+  double k;
+
+  inline imbyte operator()(double v, double mean, double var)
+  {
+    return v > mean + k*sqrt(var)? 1: 0;
+  }
+};
+
+int imProcessNiblackThreshold(const imImage* src_image, imImage* dst_image, int ks, double k)
+{
+  iNiblackThres func;
+  func.k = k;
+  return DoLocalThresholdImage(src_image, dst_image, ks, func, "NiblackThreshold");
+}
+
+struct iSauvolaThres
+{
+  double k, range;
+
+  inline imbyte operator()(double v, double mean, double var)
+  {
+    return v > mean*(1.0 + k*(sqrt(var)/range - 1.0))? 1: 0;
+  }
+};
+
+int imProcessSauvolaThreshold(const imImage* src_image, imImage* dst_image, int ks, double k, double range)
+{
+  iSauvolaThres func;
+  func.k = k;
+  func.range = range;
+  return DoLocalThresholdImage(src_image, dst_image, ks, func, "SauvolaThreshold");
+}
+
+struct iBradleyThres
+{
+  double factor;
+
+  inline imbyte operator()(double v, double mean, double)
+  {
+    return v > mean*factor? 1: 0;
+  }
+};
+
+int imProcessBradleyThreshold(const imImage* src_image, imImage* dst_image, int ks, double percent)
+{
+  iBradleyThres func;
+  func.factor = 1.0 - percent/100.0;
+  return DoLocalThresholdImage(src_image, dst_image, ks, func, "BradleyThreshold");
+}
+
 static imbyte rank_closest_op_byte(imbyte* value, int count, int center)
 {
   imbyte v = value[center];
@@ -0,0 +1,833 @@
+/** \file
+ * \brief Auto Covariance and Normalized Cross Correlation
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+
+#include <im.h>
+#include <im_util.h>
+#include <im_math.h>
+
+#include "im_process_counter.h"
+#include "im_process_pnt.h"
+
+#include <stdlib.h>
+#include <memory.h>
+#include <math.h>
+
+
+/* The FFT of im_fft.cpp depends on the FFTW library (im_fftw),
+   so here we use a simple radix-2 FFT that is enough for zero padded correlations. */
+
+struct iFFTPlan
+{
+  int n;
+  int* rev;       /* bit reversal permutation */
+  double* wr;     /* cos(2*pi*k/n), k < n/2 */
+  double* wi;     /* -sin(2*pi*k/n), k < n/2 */
+};
+
+/* Number of columns transformed together,
+   so the column gather and scatter use whole cache lines. */
+#define FFT_COL_BLOCK 8
+
+/* The FFT is used when the direct computation costs more than
+   FFT_COST_FACTOR*N*log2(N) multiply-adds, N is the padded size. */
+#define FFT_COST_FACTOR 8
+
+static int iFFTSize(int n)
+{
+  int size = 1;
+  while (size < n)
+    size <<= 1;
+  return size;
+}
+
+static int iFFTUse(double direct_ops, int P, int Q)
+{
+  double N = (double)P*(double)Q;
+  return direct_ops > FFT_COST_FACTOR * N * (log(N) / log(2.0));
+}
+
+static void iFFTPlanDestroy(iFFTPlan* plan)
+{
+  if (!plan)
+    return;
+
+  free(plan->rev);
+  free(plan->wr);
+  free(plan->wi);
+  free(plan);
+}
+
+static iFFTPlan* iFFTPlanCreate(int n)
+{
+  iFFTPlan* plan = (iFFTPlan*)malloc(sizeof(iFFTPlan));
+  if (!plan)
+    return NULL;
+
+  plan->n = n;
+  plan->rev = (int*)malloc(n*sizeof(int));
+  plan->wr = (double*)malloc((n/2 + 1)*sizeof(double));
+  plan->wi = (double*)malloc((n/2 + 1)*sizeof(double));
+
+  if (!plan->rev || !plan->wr || !plan->wi)
+  {
+    iFFTPlanDestroy(plan);
+    return NULL;
+  }
+
+  int bits = 0;
+  while ((1 << bits) < n)
+    bits++;
+
+  for (int i = 0; i < n; i++)
+  {
+    int r = 0;
+    for (int b = 0; b < bits; b++)
+    {
+      if (i & (1 << b))
+        r |= 1 << (bits - 1 - b);
+    }
+    plan->rev[i] = r;
+  }
+
+  for (int k = 0; k < n/2; k++)
+  {
+    double a = (2.0 * 3.14159265358979323846 * k) / n;
+    plan->wr[k] = cos(a);
+    plan->wi[k] = -sin(a);
+  }
+
+  return plan;
+}
+
+/* In-place unnormalized transform of n complex values stored in re and im. */
+static void iFFTExecute(const iFFTPlan* plan, double* re, double* im, int inverse)
+{
+  int n = plan->n;
+
+  for (int i = 0; i < n; i++)
+  {
+    int r = plan->rev[i];
+    if (r > i)
+    {
+      double t = re[i]; re[i] = re[r]; re[r] = t;
+      t = im[i]; im[i] = im[r]; im[r] = t;
+    }
+  }
+
+  double sign = inverse? -1: 1;
+
+  for (int len = 2; len <= n; len <<= 1)
+  {
+    int half = len/2;
+    int step = n/len;
+
+    for (int i = 0; i < n; i += len)
+    {
+      double *re_a = re + i, *im_a = im + i;
+      double *re_b = re_a + half, *im_b = im_a + half;
+
+      for (int k = 0; k < half; k++)
+      {
+        double wr = plan->wr[k*step];
+        double wi = sign * plan->wi[k*step];
+
+        double tr = re_b[k]*wr - im_b[k]*wi;
+        double ti = re_b[k]*wi + im_b[k]*wr;
+
+        re_b[k] = re_a[k] - tr;
+        im_b[k] = im_a[k] - ti;
+        re_a[k] += tr;
+        im_a[k] += ti;
+      }
+    }
+  }
+}
+
+/* Transforms the lines [0,line_count) of a P x Q complex buffer. */
+static int iFFTLines(const iFFTPlan* plan, double* re, double* im, int line_count, int inverse, int counter)
+{
+  int P = plan->n;
+
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(line_count*P))
+#endif
+  for (int y = 0; y < line_count; y++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    iFFTExecute(plan, re + (size_t)y*P, im + (size_t)y*P, inverse);
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  return processing;
+}
+
+static int iFFTColumnBlockCount(int P)
+{
+  return (P + FFT_COL_BLOCK - 1) / FFT_COL_BLOCK;
+}
+
+/* Transforms all the P columns of a P x Q complex buffer. */
+static int iFFTColumns(const iFFTPlan* plan, double* re, double* im, int P, int inverse, int counter)
+{
+  int Q = plan->n;
+  int block_count = iFFTColumnBlockCount(P);
+  int thread_count = IM_OMP_MINCOUNT(P*Q)? IM_MAX_THREADS: 1;
+  double* thread_buffer = (double*)malloc((size_t)thread_count * 2 * FFT_COL_BLOCK * Q * sizeof(double));
+  if (!thread_buffer)
+    return 0;
+
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(P*Q))
+#endif
+  for (int b = 0; b < block_count; b++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    double* col_re = thread_buffer + (size_t)IM_THREAD_NUM * 2 * FFT_COL_BLOCK * Q;
+    double* col_im = col_re + FFT_COL_BLOCK * Q;
+    int x0 = b * FFT_COL_BLOCK;
+    int cols = P - x0 < FFT_COL_BLOCK? P - x0: FFT_COL_BLOCK;
+
+    for (int y = 0; y < Q; y++)
+    {
+      const double* line_re = re + (size_t)y*P + x0;
+      const double* line_im = im + (size_t)y*P + x0;
+      for (int c = 0; c < cols; c++)
+      {
+        col_re[c*Q + y] = line_re[c];
+        col_im[c*Q + y] = line_im[c];
+      }
+    }
+
+    for (int c = 0; c < cols; c++)
+      iFFTExecute(plan, col_re + c*Q, col_im + c*Q, inverse);
+
+    for (int y = 0; y < Q; y++)
+    {
+      double* line_re = re + (size_t)y*P + x0;
+      double* line_im = im + (size_t)y*P + x0;
+      for (int c = 0; c < cols; c++)
+      {
+        line_re[c] = col_re[c*Q + y];
+        line_im[c] = col_im[c*Q + y];
+      }
+    }
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  free(thread_buffer);
+  return processing;
+}
+
+template <class T>
+static void iLoadLine(const T* map, double* line, int count)
+{
+  for (int i = 0; i < count; i++)
+    line[i] = (double)map[i];
+}
+
+/* Loads count samples of a real image plane starting at offset. */
+static void iLoadImageLine(const imImage* image, int plane, int offset, int count, double* line)
+{
+  switch (image->data_type)
+  {
+  case IM_BYTE:
+    iLoadLine((const imbyte*)image->data[plane] + offset, line, count);
+    break;
+  case IM_SHORT:
+    iLoadLine((const short*)image->data[plane] + offset, line, count);
+    break;
+  case IM_USHORT:
+    iLoadLine((const imushort*)image->data[plane] + offset, line, count);
+    break;
+  case IM_INT:
+    iLoadLine((const int*)image->data[plane] + offset, line, count);
+    break;
+  case IM_FLOAT:
+    iLoadLine((const float*)image->data[plane] + offset, line, count);
+    break;
+  case IM_DOUBLE:
+    iLoadLine((const double*)image->data[plane] + offset, line, count);
+    break;
+  }
+}
+
+/* Target is IM_FLOAT or IM_DOUBLE */
+static void iStoreImageLine(imImage* image, int plane, int offset, int count, const double* line, double scale)
+{
+  if (image->data_type == IM_FLOAT)
+  {
+    float* map = (float*)image->data[plane] + offset;
+    for (int i = 0; i < count; i++)
+      map[i] = (float)(line[i] * scale);
+  }
+  else
+  {
+    double* map = (double*)image->data[plane] + offset;
+    for (int i = 0; i < count; i++)
+      map[i] = line[i] * scale;
+  }
+}
+
+/*****************************************************************************************/
+/* Auto Covariance                                                                       */
+/*****************************************************************************************/
+
+template <class DT>
+static double AutoCovCalc(int width, int height, DT *src_map, DT *mean_map, int x, int y, int count)
+{
+  double value = 0;
+  int Ny = height - y;
+  int Nx = width - x;
+  int offset, offset1, line_offset, line_offset1;
+
+  for (int i = 0; i < Ny; i++)
+  {
+    line_offset = width*i;
+    line_offset1 = width*(i + y);
+
+    for (int j = 0; j < Nx; j++)
+    {
+      offset = line_offset + j;
+      offset1 = line_offset1 + (j + x);
+      value += double(src_map[offset] - mean_map[offset]) *
+               double(src_map[offset1] - mean_map[offset1]);
+    }
+  }
+
+  return value/(double)count;
+}
+
+template <class ST, class DT>
+static int doAutoCov(int width, int height, ST *src_map, ST *mean_map, DT *dst_map, int dst_width, int dst_height, int counter)
+{
+  int count = width*height;
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
+#endif
+  for (int y = 0; y < dst_height; y++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    int line_offset = y*dst_width;
+    for (int x = 0; x < dst_width; x++)
+    {
+      dst_map[line_offset + x] = (DT)AutoCovCalc(width, height, src_map, mean_map, x, y, count);
+    }
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  return processing;
+}
+
+template <class ST>
+static int doAutoCovDirect(const imImage* src_image, const imImage* mean_image, imImage* dst_image, int plane, int counter)
+{
+  ST* src_map = (ST*)src_image->data[plane];
+  ST* mean_map = (ST*)mean_image->data[plane];
+
+  if (dst_image->data_type == IM_FLOAT)
+    return doAutoCov(src_image->width, src_image->height, src_map, mean_map, (float*)dst_image->data[plane], dst_image->width, dst_image->height, counter);
+  else
+    return doAutoCov(src_image->width, src_image->height, src_map, mean_map, (double*)dst_image->data[plane], dst_image->width, dst_image->height, counter);
+}
+
+/* Wiener-Khinchin: the auto correlation is the inverse transform of the power spectrum.
+   The zero padding avoids the circular wrap around for the computed lags. */
+static int doAutoCovFFT(const imImage* src_image, const imImage* mean_image, imImage* dst_image, int plane,
+                        const iFFTPlan* plan_x, const iFFTPlan* plan_y, double* re, double* im, int counter)
+{
+  int width = src_image->width;
+  int height = src_image->height;
+  int P = plan_x->n;
+  int Q = plan_y->n;
+  size_t size = (size_t)P*Q;
+
+  memset(re, 0, size*sizeof(double));
+  memset(im, 0, size*sizeof(double));
+
+  double* mean_line = im;  /* im is zero after the lines are loaded */
+  for (int y = 0; y < height; y++)
+  {
+    double* line = re + (size_t)y*P;
+    iLoadImageLine(src_image, plane, y*width, width, line);
+    iLoadImageLine(mean_image, plane, y*width, width, mean_line);
+    for (int x = 0; x < width; x++)
+      line[x] -= mean_line[x];
+  }
+  memset(mean_line, 0, width*sizeof(double));
+
+  if (!iFFTLines(plan_x, re, im, height, 0, counter))
+    return 0;
+  if (!iFFTColumns(plan_y, re, im, P, 0, counter))
+    return 0;
+
+  for (size_t i = 0; i < size; i++)
+  {
+    re[i] = re[i]*re[i] + im[i]*im[i];
+    im[i] = 0;
+  }
+
+  if (!iFFTColumns(plan_y, re, im, P, 1, counter))
+    return 0;
+  if (!iFFTLines(plan_x, re, im, dst_image->height, 1, counter))
+    return 0;
+
+  double scale = 1.0 / ((double)size * (double)width * (double)height);
+  for (int y = 0; y < dst_image->height; y++)
+    iStoreImageLine(dst_image, plane, y*dst_image->width, dst_image->width, re + (size_t)y*P, scale);
+
+  return 1;
+}
+
+int imProcessAutoCovariance(const imImage* src_image, const imImage* mean_image, imImage* dst_image)
+{
+  int ret = 0;
+
+  /* lags are limited to the source size */
+  if (dst_image->width > src_image->width || dst_image->height > src_image->height)
+    return 0;
+
+  int width = src_image->width;
+  int height = src_image->height;
+  int lag_width = dst_image->width;
+  int lag_height = dst_image->height;
+
+  int P = iFFTSize(width + lag_width - 1);
+  int Q = iFFTSize(height + lag_height - 1);
+
+  /* the direct method computes width*height multiply-adds at most for each lag */
+  double direct_ops = (double)lag_width * (double)lag_height * (double)width * (double)height;
+  int use_fft = iFFTUse(direct_ops, P, Q);
+
+  int counter = imProcessCounterBegin("AutoConvariance");
+  if (use_fft)
+    imCounterTotal(counter, src_image->depth*(height + 2*iFFTColumnBlockCount(P) + lag_height), "Processing...");
+  else
+    imCounterTotal(counter, src_image->depth*lag_height, "Processing...");
+
+  iFFTPlan *plan_x = NULL, *plan_y = NULL;
+  double *re = NULL, *im = NULL;
+  if (use_fft)
+  {
+    plan_x = iFFTPlanCreate(P);
+    plan_y = iFFTPlanCreate(Q);
+    re = (double*)malloc((size_t)P*Q*sizeof(double));
+    im = (double*)malloc((size_t)P*Q*sizeof(double));
+
+    if (!re || !im || !plan_x || !plan_y)
+    {
+      if (re) free(re);
+      if (im) free(im);
+      iFFTPlanDestroy(plan_x);
+      iFFTPlanDestroy(plan_y);
+      use_fft = 0;
+      imCounterTotal(counter, src_image->depth*lag_height, "Processing...");
+    }
+  }
+
+  for (int i = 0; i < src_image->depth; i++)
+  {
+    if (use_fft)
+      ret = doAutoCovFFT(src_image, mean_image, dst_image, i, plan_x, plan_y, re, im, counter);
+    else
+    {
+      switch(src_image->data_type)
+      {
+      case IM_BYTE:
+        ret = doAutoCovDirect<imbyte>(src_image, mean_image, dst_image, i, counter);
+        break;
+      case IM_SHORT:
+        ret = doAutoCovDirect<short>(src_image, mean_image, dst_image, i, counter);
+        break;
+      case IM_USHORT:
+        ret = doAutoCovDirect<imushort>(src_image, mean_image, dst_image, i, counter);
+        break;
+      case IM_INT:
+        ret = doAutoCovDirect<int>(src_image, mean_image, dst_image, i, counter);
+        break;
+      case IM_FLOAT:
+        ret = doAutoCovDirect<float>(src_image, mean_image, dst_image, i, counter);
+        break;
+      case IM_DOUBLE:
+        ret = doAutoCovDirect<double>(src_image, mean_image, dst_image, i, counter);
+        break;
+      }
+    }
+
+    if (!ret)
+      break;
+  }
+
+  if (use_fft)
+  {
+    free(re);
+    free(im);
+    iFFTPlanDestroy(plan_x);
+    iFFTPlanDestroy(plan_y);
+  }
+
+  imProcessCounterEnd(counter);
+
+  return ret;
+}
+
+/*****************************************************************************************/
+/* Normalized Cross Correlation                                                          */
+/*****************************************************************************************/
+
+/* Loads a plane as double, subtracting its mean. Returns the sum of squares of the result. */
+static double iLoadPlaneZeroMean(const imImage* image, int plane, double* map)
+{
+  double mean = 0;
+  int count = image->count;
+
+  iLoadImageLine(image, plane, 0, count, map);
+
+  for (int i = 0; i < count; i++)
+    mean += map[i];
+  mean /= count;
+
+  double sum2 = 0;
+  for (int i = 0; i < count; i++)
+  {
+    map[i] -= mean;
+    sum2 += map[i]*map[i];
+  }
+
+  return sum2;
+}
+
+/* Sums of the values and of their squares in a window, for all the valid template positions.
+   The results are stored at the window top-left corner. Returns zero if failed to allocate memory. */
+static int iWindowSums(const double* map, int width, int height, int win_width, int win_height, double* sum, double* sum2)
+{
+  int valid_width = width - win_width + 1;
+  int valid_height = height - win_height + 1;
+  int iw = width + 1;
+
+  /* integral images with an extra zero line and column */
+  double* isum = (double*)calloc((size_t)iw*(height + 1), sizeof(double));
+  double* isum2 = (double*)calloc((size_t)iw*(height + 1), sizeof(double));
+  if (!isum || !isum2)
+  {
+    if (isum) free(isum);
+    if (isum2) free(isum2);
+    return 0;
+  }
+
+  for (int y = 0; y < height; y++)
+  {
+    const double* line = map + (size_t)y*width;
+    double* is = isum + (size_t)(y+1)*iw + 1;
+    double* is2 = isum2 + (size_t)(y+1)*iw + 1;
+    double s = 0, s2 = 0;
+
+    for (int x = 0; x < width; x++)
+    {
+      s += line[x];
+      s2 += line[x]*line[x];
+      is[x] = is[x - iw] + s;
+      is2[x] = is2[x - iw] + s2;
+    }
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(valid_height))
+#endif
+  for (int y = 0; y < valid_height; y++)
+  {
+    const double* t = isum + (size_t)y*iw;
+    const double* b = isum + (size_t)(y + win_height)*iw;
+    const double* t2 = isum2 + (size_t)y*iw;
+    const double* b2 = isum2 + (size_t)(y + win_height)*iw;
+    double* s = sum + (size_t)y*valid_width;
+    double* s2 = sum2 + (size_t)y*valid_width;
+
+    for (int x = 0; x < valid_width; x++)
+    {
+      s[x] = b[x + win_width] - b[x] - t[x + win_width] + t[x];
+      s2[x] = b2[x + win_width] - b2[x] - t2[x + win_width] + t2[x];
+    }
+  }
+
+  free(isum);
+  free(isum2);
+  return 1;
+}
+
+/* Correlation of the zero mean template with the image at all the valid positions.
+   The results are stored at the window top-left corner. */
+static int iCorrelationDirect(const double* map, int width, int height, const double* templ, int templ_width, int templ_height, double* corr, int counter)
+{
+  int valid_width = width - templ_width + 1;
+  int valid_height = height - templ_height + 1;
+
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(valid_height*valid_width*templ_width))
+#endif
+  for (int y = 0; y < valid_height; y++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    double* corr_line = corr + (size_t)y*valid_width;
+    memset(corr_line, 0, valid_width*sizeof(double));
+
+    for (int j = 0; j < templ_height; j++)
+    {
+      const double* line = map + (size_t)(y + j)*width;
+      const double* templ_line = templ + (size_t)j*templ_width;
+
+      for (int x = 0; x < valid_width; x++)
+      {
+        const double* w = line + x;
+        double value = 0;
+        for (int i = 0; i < templ_width; i++)
+          value += w[i] * templ_line[i];
+        corr_line[x] += value;
+      }
+    }
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  return processing;
+}
+
+/* The image is loaded in the real part and the template in the imaginary part,
+   so a single forward transform is necessary.
+   Then the spectrum of each one is separated using the hermitian symmetry of real signals. */
+static int iCorrelationFFT(const double* map, int width, int height, const double* templ, int templ_width, int templ_height, double* corr,
+                           const iFFTPlan* plan_x, const iFFTPlan* plan_y, double* re, double* im, int counter)
+{
+  int valid_width = width - templ_width + 1;
+  int valid_height = height - templ_height + 1;
+  int P = plan_x->n;
+  int Q = plan_y->n;
+  size_t size = (size_t)P*Q;
+
+  memset(re, 0, size*sizeof(double));
+  memset(im, 0, size*sizeof(double));
+
+  for (int y = 0; y < height; y++)
+    memcpy(re + (size_t)y*P, map + (size_t)y*width, width*sizeof(double));
+  for (int y = 0; y < templ_height; y++)
+    memcpy(im + (size_t)y*P, templ + (size_t)y*templ_width, templ_width*sizeof(double));
+
+  if (!iFFTLines(plan_x, re, im, height, 0, counter))
+    return 0;
+  if (!iFFTColumns(plan_y, re, im, P, 0, counter))
+    return 0;
+
+  /* Z = F + iT, so F = (Z(k) + conj(Z(-k)))/2 and conj(T) = i*conj(Z(k) - conj(Z(-k)))/2.
+     The product F*conj(T) at k and at -k depends on both Z(k) and Z(-k). */
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(P*Q))
+#endif
+  for (int v = 0; v <= Q/2; v++)
+  {
+    int nv = (Q - v) % Q;
+    for (int u = 0; u < P; u++)
+    {
+      int nu = (P - u) % P;
+      size_t k = (size_t)v*P + u;
+      size_t nk = (size_t)nv*P + nu;
+
+      /* each pair is processed once */
+      if (nk < k)
+        continue;
+
+      double z1r = re[k], z1i = im[k];
+      double z2r = re[nk], z2i = -im[nk];   /* conj(Z(-k)) */
+
+      /* at k */
+      double fr = (z1r + z2r)/2, fi = (z1i + z2i)/2;
+      double tr = (z1i - z2i)/2, ti = (z1r - z2r)/2;   /* conj(T) = i*conj(Z1 - Z2)/2 */
+      double gr = fr*tr - fi*ti;
+      double gi = fr*ti + fi*tr;
+
+      /* at -k the values are the conjugates of the ones at k, because F and T are hermitian */
+      re[k] = gr; im[k] = gi;
+      if (nk != k)
+      {
+        /* G(-k) = F(-k)*conj(T(-k)) = conj(F(k))*T(k) */
+        re[nk] = fr*tr - fi*ti;
+        im[nk] = -(fr*ti + fi*tr);
+      }
+    }
+  }
+
+  if (!iFFTColumns(plan_y, re, im, P, 1, counter))
+    return 0;
+  if (!iFFTLines(plan_x, re, im, valid_height, 1, counter))
+    return 0;
+
+  double scale = 1.0 / (double)size;
+  for (int y = 0; y < valid_height; y++)
+  {
+    const double* line = re + (size_t)y*P;
+    double* corr_line = corr + (size_t)y*valid_width;
+    for (int x = 0; x < valid_width; x++)
+      corr_line[x] = line[x] * scale;
+  }
+
+  return 1;
+}
+
+int imProcessNormalizedCrossCorrelation(const imImage* src_image, const imImage* templ_image, imImage* dst_image)
+{
+  int width = src_image->width;
+  int height = src_image->height;
+  int templ_width = templ_image->width;
+  int templ_height = templ_image->height;
+  int valid_width = width - templ_width + 1;
+  int valid_height = height - templ_height + 1;
+  int templ_cx = templ_width/2;
+  int templ_cy = templ_height/2;
+  int templ_count = templ_width*templ_height;
+
+  for (int d = 0; d < dst_image->depth; d++)
+    memset(dst_image->data[d], 0, dst_image->plane_size);
+
+  if (valid_width <= 0 || valid_height <= 0)
+    return 1;
+
+  int P = iFFTSize(width);
+  int Q = iFFTSize(height);
+  double direct_ops = (double)valid_width * (double)valid_height * (double)templ_count;
+  int use_fft = iFFTUse(direct_ops, P, Q);
+
+  int counter = imProcessCounterBegin("NormalizedCrossCorrelation");
+  if (use_fft)
+    imCounterTotal(counter, src_image->depth*(height + 2*iFFTColumnBlockCount(P) + valid_height), "Processing...");
+  else
+    imCounterTotal(counter, src_image->depth*valid_height, "Processing...");
+
+  size_t valid_count = (size_t)valid_width*valid_height;
+  double* map = (double*)malloc(src_image->count*sizeof(double));
+  double* templ = (double*)malloc(templ_count*sizeof(double));
+  double* corr = (double*)malloc(valid_count*sizeof(double));
+  double* sum = (double*)malloc(valid_count*sizeof(double));
+  double* sum2 = (double*)malloc(valid_count*sizeof(double));
+  double* line = (double*)malloc(width*sizeof(double));
+
+  iFFTPlan *plan_x = NULL, *plan_y = NULL;
+  double *re = NULL, *im = NULL;
+  if (use_fft)
+  {
+    plan_x = iFFTPlanCreate(P);
+    plan_y = iFFTPlanCreate(Q);
+    re = (double*)malloc((size_t)P*Q*sizeof(double));
+    im = (double*)malloc((size_t)P*Q*sizeof(double));
+  }
+
+  int ret = 1;
+  if (!map || !templ || !corr || !sum || !sum2 || !line || (use_fft && (!re || !im || !plan_x || !plan_y)))
+    ret = 0;
+
+  for (int d = 0; d < src_image->depth && ret; d++)
+  {
+    iLoadPlaneZeroMean(src_image, d, map);
+    double templ_sum2 = iLoadPlaneZeroMean(templ_image, d, templ);
+
+    if (use_fft)
+      ret = iCorrelationFFT(map, width, height, templ, templ_width, templ_height, corr, plan_x, plan_y, re, im, counter);
+    else
+      ret = iCorrelationDirect(map, width, height, templ, templ_width, templ_height, corr, counter);
+    if (!ret)
+      break;
+
+    /* since the template has zero mean, the mean of the window does not change the correlation,
+       only the window variance is necessary */
+    ret = iWindowSums(map, width, height, templ_width, templ_height, sum, sum2);
+    if (!ret)
+      break;
+
+    for (int y = 0; y < valid_height; y++)
+    {
+      const double* corr_line = corr + (size_t)y*valid_width;
+      const double* s = sum + (size_t)y*valid_width;
+      const double* s2 = sum2 + (size_t)y*valid_width;
+
+      for (int x = 0; x < valid_width; x++)
+      {
+        double var = s2[x] - (s[x]*s[x])/templ_count;
+        double den = var * templ_sum2;
+
+        /* constant window or template, within the precision of the sums */
+        if (var <= 1e-12 * s2[x] || den <= 0)
+          line[x] = 0;
+        else
+        {
+          double value = corr_line[x] / sqrt(den);
+          line[x] = value > 1? 1: value < -1? -1: value;
+        }
+      }
+
+      iStoreImageLine(dst_image, d, (y + templ_cy)*width + templ_cx, valid_width, line, 1.0);
+    }
+  }
+
+  if (map) free(map);
+  if (templ) free(templ);
+  if (corr) free(corr);
+  if (sum) free(sum);
+  if (sum2) free(sum2);
+  if (line) free(line);
+
+  if (use_fft)
+  {
+    if (re) free(re);
+    if (im) free(im);
+    iFFTPlanDestroy(plan_x);
+    iFFTPlanDestroy(plan_y);
+  }
+
+  imProcessCounterEnd(counter);
+
+  return ret;
+}
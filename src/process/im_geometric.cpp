@@ -15,6 +15,11 @@
 #include <stdlib.h>
 #include <memory.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IM_USE_SSE2
+#endif
+
 
 static inline void imRect2Polar(double x, double y, double *radius, double *theta)
 {
@@ -153,116 +158,213 @@ static int Radial(int width, int height, DT *src_map, DT *dst_map,
   return processing;
 }
 
-//*******************************************************************************************
-//rotate_invtransf
-//   shift the center to the origin of the target image
-//   rotates centrered in the origin
-//   shift the origin back to the center of the original image
-//*******************************************************************************************
+/********************************************************************************/
+/* Warp engine
+ *   For each target pixel the source coordinates are computed by an inverse transform.
+ *   Coordinates are stepped incrementally along each line of a tile, 
+ *   and tiles of the target image are processed in parallel. 
+ *   All planes are interpolated with the same coordinates.
+ */
 
-inline void rotate_invtransf(int x, int y, double *xl, double *yl, double cos0, double sin0, double dcx, double dcy, double scx, double scy)
-{
-  double xr = x+0.5 - dcx;
-  double yr = y+0.5 - dcy;
-  *xl = double(xr * cos0 - yr * sin0 + scx);
-  *yl = double(xr * sin0 + yr * cos0 + scy);
-}
+#define WARP_TILE 64
 
-template <class DT, class DTU> 
-static int RotateCenter(int src_width, int src_height, DT *src_map, 
-                        int dst_width, int dst_height, DT *dst_map, 
-                        double cos0, double sin0, int counter, DTU Dummy, int order)
-{
-  double dcx = double(dst_width/2.0);
-  double dcy = double(dst_height/2.0);
-  double scx = double(src_width/2.0);
-  double scy = double(src_height/2.0);
+enum { WARP_AFFINE, WARP_PERSPECTIVE, WARP_REMAP };
 
-  IM_INT_PROCESSING;
+struct iWarpTransform
+{
+  int type;
+  double m[9];  /* target (x,y) to source, pixel centers at integer coordinates */
+  const float *map_x, *map_y;
+  int map_width;
+};
+
+/* returns the source coordinates of count pixels of line y starting at x, 
+   in the interpolation functions convention (pixel centers at +0.5) */
+static void iWarpLineCoords(const iWarpTransform* transf, int x, int y, int count, double* xl, double* yl)
+{
+  const double* m = transf->m;
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(dst_height))
-#endif
-  for (int y = 0; y < dst_height; y++)
+  if (transf->type == WARP_AFFINE)
   {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_BEGIN_PROCESSING;
+    double sx = m[0]*x + m[1]*y + m[2] + 0.5;
+    double sy = m[3]*x + m[4]*y + m[5] + 0.5;
 
-    int line_offset = y*dst_width;
+    for (int i = 0; i < count; i++)
+    {
+      xl[i] = sx;
+      yl[i] = sy;
+      sx += m[0];
+      sy += m[3];
+    }
+  }
+  else if (transf->type == WARP_PERSPECTIVE)
+  {
+    double sx = m[0]*x + m[1]*y + m[2];
+    double sy = m[3]*x + m[4]*y + m[5];
+    double sw = m[6]*x + m[7]*y + m[8];
 
-    for (int x = 0; x < dst_width; x++)
+    for (int i = 0; i < count; i++)
     {
-      double xl, yl;
-      rotate_invtransf(x, y, &xl, &yl, cos0, sin0, dcx, dcy, scx, scy);
-                   
-      // if inside the original image broad area
-      if (xl > 0.0 && yl > 0.0 && xl < src_width && yl < src_height)
+      if (sw != 0)
       {
-        if (order == 1)
-          dst_map[line_offset+x] = imBilinearInterpolation(src_width, src_height, src_map, xl, yl);
-        else if (order == 3)
-          dst_map[line_offset+x] = imBicubicInterpolation(src_width, src_height, src_map, xl, yl, Dummy);
-        else
-          dst_map[line_offset+x] = imZeroOrderInterpolation(src_width, src_height, src_map, xl, yl);
+        xl[i] = sx / sw + 0.5;
+        yl[i] = sy / sw + 0.5;
       }
+      else
+        xl[i] = yl[i] = -1;  /* outside */
+
+      sx += m[0];
+      sy += m[3];
+      sw += m[6];
     }
+  }
+  else
+  {
+    const float* map_x = transf->map_x + y*transf->map_width + x;
+    const float* map_y = transf->map_y + y*transf->map_width + x;
 
-    IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-    IM_END_PROCESSING;
+    for (int i = 0; i < count; i++)
+    {
+      xl[i] = map_x[i] + 0.5;
+      yl[i] = map_y[i] + 0.5;
+    }
   }
+}
 
-  return processing;
+/* Same as imBilinearInterpolation, but with fixed point weights and rounding, for integer data. 
+   TA is the accumulator type, it must hold max_value*2^(2*BITS). */
+template <class T, class TA, int BITS>
+static inline T iWarpBilinearFixed(int width, int height, const T *map, double xl, double yl)
+{
+  const int one = 1 << BITS;
+  int x0, y0, x1, y1, t, u;
+
+  if (xl < 0.5)
+  {
+    x1 = x0 = 0; 
+    t = 0;
+  }
+  else if (xl >= width-0.5)
+  {
+    x1 = x0 = width-1;
+    t = 0;
+  }
+  else
+  {
+    double xs = xl-0.5;
+    x0 = (int)xs;
+    x1 = x0+1;
+    t = (int)((xs - x0)*one + 0.5);
+  }
+
+  if (yl < 0.5)
+  {
+    y1 = y0 = 0; 
+    u = 0;
+  }
+  else if (yl >= height-0.5)
+  {
+    y1 = y0 = height-1;
+    u = 0;
+  }
+  else
+  {
+    double ys = yl-0.5;
+    y0 = (int)ys;
+    y1 = y0+1;
+    u = (int)((ys - y0)*one + 0.5);
+  }
+
+  const T* line0 = map + y0*width;
+  const T* line1 = map + y1*width;
+
+  TA low  = (TA)line0[x0]*(one - t) + (TA)line0[x1]*t;
+  TA high = (TA)line1[x0]*(one - t) + (TA)line1[x1]*t;
+  TA value = low*(one - u) + high*u;
+
+  return (T)((value + ((TA)1 << (2*BITS - 1))) >> (2*BITS));
 }
 
-template <class DT, class DTU> 
-static int Rotate(int src_width, int src_height, DT *src_map, 
-                  int dst_width, int dst_height, DT *dst_map, 
-                  double cos0, double sin0, int ref_x, int ref_y, int to_origin, 
-                  int counter, DTU Dummy, int order)
+template <class T>
+static inline T iWarpBilinear(int width, int height, const T *map, double xl, double yl)
 {
-  double sx = double(ref_x);
-  double sy = double(ref_y);
-  double dx = sx;
-  double dy = sy;
-  if (to_origin)
+  return imBilinearInterpolation(width, height, (T*)map, xl, yl);
+}
+
+static inline imbyte iWarpBilinear(int width, int height, const imbyte *map, double xl, double yl)
+{
+  return iWarpBilinearFixed<imbyte, int, 11>(width, height, map, xl, yl);
+}
+
+static inline short iWarpBilinear(int width, int height, const short *map, double xl, double yl)
+{
+  return iWarpBilinearFixed<short, long long, 15>(width, height, map, xl, yl);
+}
+
+static inline imushort iWarpBilinear(int width, int height, const imushort *map, double xl, double yl)
+{
+  return iWarpBilinearFixed<imushort, long long, 15>(width, height, map, xl, yl);
+}
+
+static inline int iWarpBilinear(int width, int height, const int *map, double xl, double yl)
+{
+  return iWarpBilinearFixed<int, long long, 15>(width, height, map, xl, yl);
+}
+
+template <class T, class TU>
+static void iWarpLine(int src_width, int src_height, const T *src_map, T *dst_line, int count, 
+                      const double* xl, const double* yl, int order, TU Dummy)
+{
+  for (int i = 0; i < count; i++)
   {
-    dx = 0;
-    dy = 0;
+    // if inside the original image broad area
+    if (xl[i] > 0.0 && yl[i] > 0.0 && xl[i] < src_width && yl[i] < src_height)
+    {
+      if (order == 1)
+        dst_line[i] = iWarpBilinear(src_width, src_height, src_map, xl[i], yl[i]);
+      else if (order == 3)
+        dst_line[i] = imBicubicInterpolation(src_width, src_height, (T*)src_map, xl[i], yl[i], Dummy);
+      else
+        dst_line[i] = imZeroOrderInterpolation(src_width, src_height, (T*)src_map, xl[i], yl[i]);
+    }
   }
+}
+
+template <class T, class TU> 
+static int DoWarp(int src_width, int src_height, T **src_map, 
+                  int dst_width, int dst_height, T **dst_map, int depth,
+                  const iWarpTransform* transf, int counter, TU Dummy, int order)
+{
+  int tiles_x = (dst_width + WARP_TILE - 1) / WARP_TILE;
+  int tiles_y = (dst_height + WARP_TILE - 1) / WARP_TILE;
 
   IM_INT_PROCESSING;
 
 #ifdef _OPENMP
 #pragma omp parallel for if (IM_OMP_MINHEIGHT(dst_height))
 #endif
-  for (int y = 0; y < dst_height; y++)
+  for (int ty = 0; ty < tiles_y; ty++)
   {
 #ifdef _OPENMP
 #pragma omp flush (processing)
 #endif
     IM_BEGIN_PROCESSING;
 
-    int line_offset = y*dst_width;
+    double xl[WARP_TILE], yl[WARP_TILE];
+    int y0 = ty * WARP_TILE;
+    int y1 = y0 + WARP_TILE < dst_height? y0 + WARP_TILE: dst_height;
 
-    for (int x = 0; x < dst_width; x++)
+    for (int tx = 0; tx < tiles_x; tx++)
     {
-      double xl, yl;
-      rotate_invtransf(x, y, &xl, &yl, cos0, sin0, dx, dy, sx, sy);
-                   
-      // if inside the original image broad area
-      if (xl > 0.0 && yl > 0.0 && xl < src_width && yl < src_height)
+      int x0 = tx * WARP_TILE;
+      int count = x0 + WARP_TILE < dst_width? WARP_TILE: dst_width - x0;
+
+      for (int y = y0; y < y1; y++)
       {
-        if (order == 1)
-          dst_map[line_offset+x] = imBilinearInterpolation(src_width, src_height, src_map, xl, yl);
-        else if (order == 3)
-          dst_map[line_offset+x] = imBicubicInterpolation(src_width, src_height, src_map, xl, yl, Dummy);
-        else
-          dst_map[line_offset+x] = imZeroOrderInterpolation(src_width, src_height, src_map, xl, yl);
+        iWarpLineCoords(transf, x0, y, count, xl, yl);
+
+        for (int d = 0; d < depth; d++)
+          iWarpLine(src_width, src_height, (const T*)src_map[d], dst_map[d] + y*dst_width + x0, count, xl, yl, order, Dummy);
       }
     }
 
@@ -276,71 +378,103 @@ static int Rotate(int src_width, int src_height, DT *src_map,
   return processing;
 }
 
+static int iWarpImage(const char* name, const imImage* src_image, imImage* dst_image, const iWarpTransform* transf, int order)
+{
+  int ret = 0;
+
+  int counter = imProcessCounterBegin(name);
+  imCounterTotal(counter, (dst_image->height + WARP_TILE - 1) / WARP_TILE, "Processing...");  /* tiles of the target image */
+
+  int src_depth = src_image->has_alpha && dst_image->has_alpha? src_image->depth+1: src_image->depth;
+  int src_width = src_image->width, src_height = src_image->height;
+  int dst_width = dst_image->width, dst_height = dst_image->height;
+
+  if (src_image->color_space == IM_MAP)
+    order = 0;
+
+  switch(src_image->data_type)
+  {
+  case IM_BYTE:
+    ret = DoWarp(src_width, src_height, (imbyte**)src_image->data, dst_width, dst_height, (imbyte**)dst_image->data, src_depth, transf, counter, double(0), order);
+    break;
+  case IM_SHORT:
+    ret = DoWarp(src_width, src_height, (short**)src_image->data, dst_width, dst_height, (short**)dst_image->data, src_depth, transf, counter, double(0), order);
+    break;
+  case IM_USHORT:
+    ret = DoWarp(src_width, src_height, (imushort**)src_image->data, dst_width, dst_height, (imushort**)dst_image->data, src_depth, transf, counter, double(0), order);
+    break;
+  case IM_INT:
+    ret = DoWarp(src_width, src_height, (int**)src_image->data, dst_width, dst_height, (int**)dst_image->data, src_depth, transf, counter, double(0), order);
+    break;
+  case IM_FLOAT:
+    ret = DoWarp(src_width, src_height, (float**)src_image->data, dst_width, dst_height, (float**)dst_image->data, src_depth, transf, counter, double(0), order);
+    break;
+  case IM_CFLOAT:
+    ret = DoWarp(src_width, src_height, (imcfloat**)src_image->data, dst_width, dst_height, (imcfloat**)dst_image->data, src_depth, transf, counter, imcfloat(0,0), order);
+    break;
+  case IM_DOUBLE:
+    ret = DoWarp(src_width, src_height, (double**)src_image->data, dst_width, dst_height, (double**)dst_image->data, src_depth, transf, counter, double(0), order);
+    break;
+  case IM_CDOUBLE:
+    ret = DoWarp(src_width, src_height, (imcdouble**)src_image->data, dst_width, dst_height, (imcdouble**)dst_image->data, src_depth, transf, counter, imcdouble(0,0), order);
+    break;
+  }
+
+  imProcessCounterEnd(counter);
+
+  return ret;
+}
+
 
 /********************************************************************************/
 
 
 template <class DT> 
-static int Rotate90(int src_width, 
-                   int src_height, 
+static int Rotate180(int width, 
+                   int height, 
                    DT *src_map, 
                    DT *dst_map, 
-                   int dir, 
                    int counter)
 {
   IM_INT_PROCESSING;
 
+  if (src_map == dst_map) // check of in-place operation
+  {
+    int half_height = (height+1)/2;
+
 #ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINHEIGHT(src_height))
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
 #endif
-  for(int y = 0; y < src_height; y++)
-  {
+    for(int y = 0; y < half_height; y++)
+    {
 #ifdef _OPENMP
 #pragma omp flush (processing)
 #endif
-    IM_BEGIN_PROCESSING;
-
-    int yd, xd;
-
-    // dir = clockwise (1) or counter clockwise (-1).
-    // dst_width  = src_height
-    // dst_height = src_width
-
-    if (dir == 1)  
-      xd = y;
-    else
-      xd = src_height-1 - y;
+      IM_BEGIN_PROCESSING;
 
-    int line_offset = y*src_width;
+      DT* line = dst_map + y*width;
+      DT* line_d = dst_map + (height - 1 - y)*width;
 
-    for(int x = 0; x < src_width; x++)
-    {
-      if (dir == 1)
-        yd = src_width-1 - x;
-      else
-        yd = x;
+      // the middle line swaps only with itself
+      int count = (line == line_d)? width/2: width;
 
-      dst_map[yd*src_height + xd] = src_map[line_offset + x];
-    }        
+      for(int x = 0; x < count; x++)
+      {
+        int xd = width-1 - x;
+        DT temp_value = line_d[xd];
+        line_d[xd] = line[x];
+        line[x] = temp_value;
+      }
 
-    IM_COUNT_PROCESSING;
+      IM_COUNT_PROCESSING;
 #ifdef _OPENMP
 #pragma omp flush (processing)
 #endif
-    IM_END_PROCESSING;
-  }
-
-  return processing;
-}
+      IM_END_PROCESSING;
+    }
 
-template <class DT> 
-static int Rotate180(int width, 
-                   int height, 
-                   DT *src_map, 
-                   DT *dst_map, 
-                   int counter)
-{
-  IM_INT_PROCESSING;
+    return processing;
+  }
 
 #ifdef _OPENMP
 #pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
@@ -456,10 +590,12 @@ static int Flip(int width,
 
   if (src_map == dst_map) // check of in-place operation
   {
-    DT* temp_line = (DT*)malloc(width*sizeof(DT));
     int half_height = height/2;
 
-    // Can NOT run in parallel
+    // each pair of lines is swapped independently, line by line in small blocks
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
+#endif
     for(int y = 0 ; y < half_height; y++)
     {
 #ifdef _OPENMP
@@ -467,10 +603,17 @@ static int Flip(int width,
 #endif
       IM_BEGIN_PROCESSING;
 
+      DT temp_block[256];
       int yd = height - 1 - y;
-      memcpy(temp_line, dst_map + yd*width, width*sizeof(DT));
-      memcpy(dst_map + yd*width, src_map + y*width, width*sizeof(DT));
-      memcpy(src_map + y*width, temp_line, width*sizeof(DT));
+      DT* line = dst_map + y*width;
+      DT* line_d = dst_map + yd*width;
+      for (int x = 0; x < width; x += 256)
+      {
+        int size = (x + 256 < width? 256: width - x)*sizeof(DT);
+        memcpy(temp_block, line_d + x, size);
+        memcpy(line_d + x, line + x, size);
+        memcpy(line + x, temp_block, size);
+      }
 
       IM_COUNT_PROCESSING;
 #ifdef _OPENMP
@@ -478,8 +621,6 @@ static int Flip(int width,
 #endif
       IM_END_PROCESSING;
     }
-
-    free(temp_line);
   }
   else
   {
@@ -507,6 +648,255 @@ static int Flip(int width,
   return processing;
 }
 
+/* Transposes tiles of the image, so both source and target stay in cache. 
+   Rotation direction is obtained using negative strides. */
+
+#define TRANSP_TILE 64
+
+/* dst[j*dst_stride + i] = src[i*src_stride + j], for i < height and j < width */
+template <class DT> 
+static inline void iTransposeBlock(const DT* src, int src_stride, DT* dst, int dst_stride, int width, int height)
+{
+  for (int i = 0; i < height; i++)
+  {
+    const DT* src_line = src + i*src_stride;
+    for (int j = 0; j < width; j++)
+      dst[j*dst_stride + i] = src_line[j];
+  }
+}
+
+#ifdef IM_USE_SSE2
+static inline void iTranspose8x8(const imbyte* src, int src_stride, imbyte* dst, int dst_stride)
+{
+  __m128i r0 = _mm_loadl_epi64((const __m128i*)(src));
+  __m128i r1 = _mm_loadl_epi64((const __m128i*)(src + src_stride));
+  __m128i r2 = _mm_loadl_epi64((const __m128i*)(src + 2*src_stride));
+  __m128i r3 = _mm_loadl_epi64((const __m128i*)(src + 3*src_stride));
+  __m128i r4 = _mm_loadl_epi64((const __m128i*)(src + 4*src_stride));
+  __m128i r5 = _mm_loadl_epi64((const __m128i*)(src + 5*src_stride));
+  __m128i r6 = _mm_loadl_epi64((const __m128i*)(src + 6*src_stride));
+  __m128i r7 = _mm_loadl_epi64((const __m128i*)(src + 7*src_stride));
+
+  __m128i t0 = _mm_unpacklo_epi8(r0, r1);
+  __m128i t1 = _mm_unpacklo_epi8(r2, r3);
+  __m128i t2 = _mm_unpacklo_epi8(r4, r5);
+  __m128i t3 = _mm_unpacklo_epi8(r6, r7);
+
+  __m128i u0 = _mm_unpacklo_epi16(t0, t1);
+  __m128i u1 = _mm_unpackhi_epi16(t0, t1);
+  __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+  __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+
+  __m128i c01 = _mm_unpacklo_epi32(u0, u2);
+  __m128i c23 = _mm_unpackhi_epi32(u0, u2);
+  __m128i c45 = _mm_unpacklo_epi32(u1, u3);
+  __m128i c67 = _mm_unpackhi_epi32(u1, u3);
+
+  _mm_storel_epi64((__m128i*)(dst), c01);
+  _mm_storel_epi64((__m128i*)(dst + dst_stride), _mm_srli_si128(c01, 8));
+  _mm_storel_epi64((__m128i*)(dst + 2*dst_stride), c23);
+  _mm_storel_epi64((__m128i*)(dst + 3*dst_stride), _mm_srli_si128(c23, 8));
+  _mm_storel_epi64((__m128i*)(dst + 4*dst_stride), c45);
+  _mm_storel_epi64((__m128i*)(dst + 5*dst_stride), _mm_srli_si128(c45, 8));
+  _mm_storel_epi64((__m128i*)(dst + 6*dst_stride), c67);
+  _mm_storel_epi64((__m128i*)(dst + 7*dst_stride), _mm_srli_si128(c67, 8));
+}
+
+static inline void iTranspose8x8(const imushort* src, int src_stride, imushort* dst, int dst_stride)
+{
+  __m128i r0 = _mm_loadu_si128((const __m128i*)(src));
+  __m128i r1 = _mm_loadu_si128((const __m128i*)(src + src_stride));
+  __m128i r2 = _mm_loadu_si128((const __m128i*)(src + 2*src_stride));
+  __m128i r3 = _mm_loadu_si128((const __m128i*)(src + 3*src_stride));
+  __m128i r4 = _mm_loadu_si128((const __m128i*)(src + 4*src_stride));
+  __m128i r5 = _mm_loadu_si128((const __m128i*)(src + 5*src_stride));
+  __m128i r6 = _mm_loadu_si128((const __m128i*)(src + 6*src_stride));
+  __m128i r7 = _mm_loadu_si128((const __m128i*)(src + 7*src_stride));
+
+  __m128i t0 = _mm_unpacklo_epi16(r0, r1);
+  __m128i t1 = _mm_unpackhi_epi16(r0, r1);
+  __m128i t2 = _mm_unpacklo_epi16(r2, r3);
+  __m128i t3 = _mm_unpackhi_epi16(r2, r3);
+  __m128i t4 = _mm_unpacklo_epi16(r4, r5);
+  __m128i t5 = _mm_unpackhi_epi16(r4, r5);
+  __m128i t6 = _mm_unpacklo_epi16(r6, r7);
+  __m128i t7 = _mm_unpackhi_epi16(r6, r7);
+
+  __m128i u0 = _mm_unpacklo_epi32(t0, t2);
+  __m128i u1 = _mm_unpackhi_epi32(t0, t2);
+  __m128i u2 = _mm_unpacklo_epi32(t1, t3);
+  __m128i u3 = _mm_unpackhi_epi32(t1, t3);
+  __m128i u4 = _mm_unpacklo_epi32(t4, t6);
+  __m128i u5 = _mm_unpackhi_epi32(t4, t6);
+  __m128i u6 = _mm_unpacklo_epi32(t5, t7);
+  __m128i u7 = _mm_unpackhi_epi32(t5, t7);
+
+  _mm_storeu_si128((__m128i*)(dst), _mm_unpacklo_epi64(u0, u4));
+  _mm_storeu_si128((__m128i*)(dst + dst_stride), _mm_unpackhi_epi64(u0, u4));
+  _mm_storeu_si128((__m128i*)(dst + 2*dst_stride), _mm_unpacklo_epi64(u1, u5));
+  _mm_storeu_si128((__m128i*)(dst + 3*dst_stride), _mm_unpackhi_epi64(u1, u5));
+  _mm_storeu_si128((__m128i*)(dst + 4*dst_stride), _mm_unpacklo_epi64(u2, u6));
+  _mm_storeu_si128((__m128i*)(dst + 5*dst_stride), _mm_unpackhi_epi64(u2, u6));
+  _mm_storeu_si128((__m128i*)(dst + 6*dst_stride), _mm_unpacklo_epi64(u3, u7));
+  _mm_storeu_si128((__m128i*)(dst + 7*dst_stride), _mm_unpackhi_epi64(u3, u7));
+}
+
+template <class DT> 
+static inline void iTransposeBlock8x8(const DT* src, int src_stride, DT* dst, int dst_stride, int width, int height)
+{
+  int width8 = width & ~7;
+  int height8 = height & ~7;
+
+  for (int i = 0; i < height8; i += 8)
+  {
+    for (int j = 0; j < width8; j += 8)
+      iTranspose8x8(src + i*src_stride + j, src_stride, dst + j*dst_stride + i, dst_stride);
+  }
+
+  if (width8 < width)
+    iTransposeBlock(src + width8, src_stride, dst + width8*dst_stride, dst_stride, width - width8, height);
+  if (height8 < height)
+    iTransposeBlock(src + height8*src_stride, src_stride, dst + height8, dst_stride, width8, height - height8);
+}
+
+static inline void iTransposeBlock(const imbyte* src, int src_stride, imbyte* dst, int dst_stride, int width, int height)
+{
+  iTransposeBlock8x8(src, src_stride, dst, dst_stride, width, height);
+}
+
+static inline void iTransposeBlock(const imushort* src, int src_stride, imushort* dst, int dst_stride, int width, int height)
+{
+  iTransposeBlock8x8(src, src_stride, dst, dst_stride, width, height);
+}
+
+static inline void iTransposeBlock(const short* src, int src_stride, short* dst, int dst_stride, int width, int height)
+{
+  iTransposeBlock8x8((const imushort*)src, src_stride, (imushort*)dst, dst_stride, width, height);
+}
+#endif
+
+/* in-place transpose of a square image */
+template <class DT> 
+static int TransposeSquare(int size, DT *map, int counter)
+{
+  int tiles = (size + TRANSP_TILE - 1) / TRANSP_TILE;
+
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(size))
+#endif
+  for (int ty = 0; ty < tiles; ty++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    int y0 = ty*TRANSP_TILE;
+    int y1 = y0 + TRANSP_TILE < size? y0 + TRANSP_TILE: size;
+
+    /* swap tile (ty,tx) with tile (tx,ty), only the upper triangle */
+    for (int tx = ty; tx < tiles; tx++)
+    {
+      int x0 = tx*TRANSP_TILE;
+      int x1 = x0 + TRANSP_TILE < size? x0 + TRANSP_TILE: size;
+
+      for (int y = y0; y < y1; y++)
+      {
+        for (int x = (tx == ty)? y+1: x0; x < x1; x++)
+        {
+          DT temp_value = map[y*size + x];
+          map[y*size + x] = map[x*size + y];
+          map[x*size + y] = temp_value;
+        }
+      }
+    }
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  return processing;
+}
+
+template <class DT> 
+static int Rotate90(int src_width, 
+                   int src_height, 
+                   DT *src_map, 
+                   DT *dst_map, 
+                   int dir, 
+                   int counter)
+{
+  if (src_map == dst_map) // in-place operation, only for square images
+  {
+    if (!TransposeSquare(src_width, dst_map, counter))
+      return 0;
+
+    // clockwise = transpose + flip, counter clockwise = transpose + mirror
+    if (dir == 1)
+      return Flip(src_width, src_height, dst_map, dst_map, counter);
+    else
+      return Mirror(src_width, src_height, dst_map, dst_map, counter);
+  }
+
+  int tiles_x = (src_width + TRANSP_TILE - 1) / TRANSP_TILE;
+  int tiles_y = (src_height + TRANSP_TILE - 1) / TRANSP_TILE;
+
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(src_height))
+#endif
+  for(int ty = 0; ty < tiles_y; ty++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    int y0 = ty*TRANSP_TILE;
+    int tile_height = y0 + TRANSP_TILE < src_height? TRANSP_TILE: src_height - y0;
+
+    for (int tx = 0; tx < tiles_x; tx++)
+    {
+      int x0 = tx*TRANSP_TILE;
+      int tile_width = x0 + TRANSP_TILE < src_width? TRANSP_TILE: src_width - x0;
+
+      // dir = clockwise (1) or counter clockwise (-1).
+      // dst_width  = src_height
+      // dst_height = src_width
+
+      if (dir == 1)
+      {
+        // dst(y, src_width-1 - x) = src(x, y)
+        iTransposeBlock(src_map + y0*src_width + x0, src_width,
+                        dst_map + (src_width-1 - x0)*src_height + y0, -src_height, 
+                        tile_width, tile_height);
+      }
+      else
+      {
+        // dst(src_height-1 - y, x) = src(x, y), source lines are read bottom up
+        int y1 = y0 + tile_height-1;
+        iTransposeBlock(src_map + y1*src_width + x0, -src_width,
+                        dst_map + x0*src_height + (src_height-1 - y1), src_height, 
+                        tile_width, tile_height);
+      }
+    }
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  return processing;
+}
+
 template <class DT> 
 static int InterlaceSplit(int width, 
                    int height, 
@@ -553,7 +943,10 @@ int imProcessRotate90(const imImage* src_image, imImage* dst_image, int dir)
 
   int src_depth = src_image->has_alpha && dst_image->has_alpha ? src_image->depth + 1 : src_image->depth;
   int counter = imProcessCounterBegin("Rotate90");
-  imCounterTotal(counter, src_depth*src_image->height, "Processing...");  /* size of the source image */
+  if (src_image->data[0] == dst_image->data[0])  /* in-place, transpose tiles + flip or mirror lines */
+    imCounterTotal(counter, src_depth*((src_image->height + TRANSP_TILE - 1) / TRANSP_TILE + (dir == 1? src_image->height/2: src_image->height)), "Processing...");
+  else
+    imCounterTotal(counter, src_depth*((src_image->height + TRANSP_TILE - 1) / TRANSP_TILE), "Processing...");  /* tiles of the source image */
 
   for (int i = 0; i < src_depth; i++)
   {
@@ -600,7 +993,10 @@ int imProcessRotate180(const imImage* src_image, imImage* dst_image)
 
   int ret = 0;
   int counter = imProcessCounterBegin("Rotate180");
-  imCounterTotal(counter, src_depth*src_image->height, "Processing...");
+  if (src_image->data[0] == dst_image->data[0])
+    imCounterTotal(counter, src_depth*((src_image->height+1)/2), "Processing...");
+  else
+    imCounterTotal(counter, src_depth*src_image->height, "Processing...");
 
   for (int i = 0; i < src_depth; i++)
   {
@@ -774,112 +1170,83 @@ void imProcessCalcRotateSize(int width, int height, int *new_width, int *new_hei
   *new_height = (int)(ymax - ymin + 2.0);
 }
 
+/* Rotation centered in (dcx,dcy) in the target and (scx,scy) in the source,
+   in the interpolation convention (pixel centers at +0.5) */
+static void iWarpRotateTransform(iWarpTransform* transf, double cos0, double sin0, double dcx, double dcy, double scx, double scy)
+{
+  transf->type = WARP_AFFINE;
+  transf->m[0] = cos0;
+  transf->m[1] = -sin0;
+  transf->m[2] = (0.5-dcx)*cos0 - (0.5-dcy)*sin0 + scx - 0.5;
+  transf->m[3] = sin0;
+  transf->m[4] = cos0;
+  transf->m[5] = (0.5-dcx)*sin0 + (0.5-dcy)*cos0 + scy - 0.5;
+}
+
 int imProcessRotate(const imImage* src_image, imImage* dst_image, double cos0, double sin0, int order)
 {
-  int ret = 0;
+  iWarpTransform transf;
+  iWarpRotateTransform(&transf, cos0, sin0, 
+                       double(dst_image->width/2.0), double(dst_image->height/2.0),
+                       double(src_image->width/2.0), double(src_image->height/2.0));
 
-  int counter = imProcessCounterBegin("Rotate");
-  int src_depth = src_image->has_alpha && dst_image->has_alpha? src_image->depth+1: src_image->depth;
-  imCounterTotal(counter, src_depth*dst_image->height, "Processing...");  /* size of the target image */
+  return iWarpImage("Rotate", src_image, dst_image, &transf, order);
+}
 
-  if (src_image->color_space == IM_MAP)
+int imProcessRotateRef(const imImage* src_image, imImage* dst_image, double cos0, double sin0, int x, int y, int to_origin, int order)
+{
+  double sx = double(x);
+  double sy = double(y);
+  double dx = sx;
+  double dy = sy;
+  if (to_origin)
   {
-    ret = RotateCenter(src_image->width, src_image->height, (imbyte*)src_image->data[0], dst_image->width, dst_image->height, (imbyte*)dst_image->data[0], cos0, sin0, counter, double(0), 0);
+    dx = 0;
+    dy = 0;
   }
-  else
-  {
-    for (int i = 0; i < src_depth; i++)
-    {
-      switch(src_image->data_type)
-      {
-      case IM_BYTE:
-        ret = RotateCenter(src_image->width, src_image->height, (imbyte*)src_image->data[i], dst_image->width, dst_image->height, (imbyte*)dst_image->data[i], cos0, sin0, counter, double(0), order);
-        break;
-      case IM_SHORT:
-        ret = RotateCenter(src_image->width, src_image->height, (short*)src_image->data[i], dst_image->width, dst_image->height, (short*)dst_image->data[i], cos0, sin0, counter, double(0), order);
-        break;
-      case IM_USHORT:
-        ret = RotateCenter(src_image->width, src_image->height, (imushort*)src_image->data[i], dst_image->width, dst_image->height, (imushort*)dst_image->data[i], cos0, sin0, counter, double(0), order);
-        break;
-      case IM_INT:
-        ret = RotateCenter(src_image->width, src_image->height, (int*)src_image->data[i], dst_image->width, dst_image->height, (int*)dst_image->data[i], cos0, sin0, counter, double(0), order);
-        break;
-      case IM_FLOAT:
-        ret = RotateCenter(src_image->width, src_image->height, (float*)src_image->data[i], dst_image->width, dst_image->height, (float*)dst_image->data[i], cos0, sin0, counter, double(0), order);
-        break;
-      case IM_CFLOAT:
-        ret = RotateCenter(src_image->width, src_image->height, (imcfloat*)src_image->data[i], dst_image->width, dst_image->height, (imcfloat*)dst_image->data[i], cos0, sin0, counter, imcfloat(0,0), order);
-        break;
-      case IM_DOUBLE:
-        ret = RotateCenter(src_image->width, src_image->height, (double*)src_image->data[i], dst_image->width, dst_image->height, (double*)dst_image->data[i], cos0, sin0, counter, double(0), order);
-        break;
-      case IM_CDOUBLE:
-        ret = RotateCenter(src_image->width, src_image->height, (imcdouble*)src_image->data[i], dst_image->width, dst_image->height, (imcdouble*)dst_image->data[i], cos0, sin0, counter, imcdouble(0, 0), order);
-        break;
-      }
-
-      if (!ret)
-        break;
-    }
-   }
 
-  imProcessCounterEnd(counter);
+  iWarpTransform transf;
+  iWarpRotateTransform(&transf, cos0, sin0, dx, dy, sx, sy);
 
-  return ret;
+  return iWarpImage("RotateRef", src_image, dst_image, &transf, order);
 }
 
-int imProcessRotateRef(const imImage* src_image, imImage* dst_image, double cos0, double sin0, int x, int y, int to_origin, int order)
+int imProcessWarpAffine(const imImage* src_image, imImage* dst_image, const double* matrix, int order)
 {
-  int ret = 0;
+  iWarpTransform transf;
+  transf.type = WARP_AFFINE;
+  for (int i = 0; i < 6; i++)
+    transf.m[i] = matrix[i];
 
-  int counter = imProcessCounterBegin("RotateRef");
-  int src_depth = src_image->has_alpha && dst_image->has_alpha? src_image->depth+1: src_image->depth;
-  imCounterTotal(counter, src_depth*dst_image->height, "Processing...");  /* size of the target image */
-
-  if (src_image->color_space == IM_MAP)
-  {
-    ret = Rotate(src_image->width, src_image->height, (imbyte*)src_image->data[0], dst_image->width, dst_image->height, (imbyte*)dst_image->data[0], cos0, sin0, x, y, to_origin, counter, double(0), 0);
-  }
-  else
-  {
-    for (int i = 0; i < src_depth; i++)
-    {
-      switch(src_image->data_type)
-      {
-      case IM_BYTE:
-        ret = Rotate(src_image->width, src_image->height, (imbyte*)src_image->data[i], dst_image->width, dst_image->height, (imbyte*)dst_image->data[i], cos0, sin0, x, y, to_origin, counter, double(0), order);
-        break;
-      case IM_SHORT:
-        ret = Rotate(src_image->width, src_image->height, (short*)src_image->data[i], dst_image->width, dst_image->height, (short*)dst_image->data[i], cos0, sin0, x, y, to_origin, counter, double(0), order);
-        break;
-      case IM_USHORT:
-        ret = Rotate(src_image->width, src_image->height, (imushort*)src_image->data[i], dst_image->width, dst_image->height, (imushort*)dst_image->data[i], cos0, sin0, x, y, to_origin, counter, double(0), order);
-        break;
-      case IM_INT:
-        ret = Rotate(src_image->width, src_image->height, (int*)src_image->data[i], dst_image->width, dst_image->height, (int*)dst_image->data[i], cos0, sin0, x, y, to_origin, counter, double(0), order);
-        break;
-      case IM_FLOAT:
-        ret = Rotate(src_image->width, src_image->height, (float*)src_image->data[i], dst_image->width, dst_image->height, (float*)dst_image->data[i], cos0, sin0, x, y, to_origin, counter, double(0), order);
-        break;
-      case IM_CFLOAT:
-        ret = Rotate(src_image->width, src_image->height, (imcfloat*)src_image->data[i], dst_image->width, dst_image->height, (imcfloat*)dst_image->data[i], cos0, sin0, x, y, to_origin, counter, imcfloat(0,0), order);
-        break;
-      case IM_DOUBLE:
-        ret = Rotate(src_image->width, src_image->height, (double*)src_image->data[i], dst_image->width, dst_image->height, (double*)dst_image->data[i], cos0, sin0, x, y, to_origin, counter, double(0), order);
-        break;
-      case IM_CDOUBLE:
-        ret = Rotate(src_image->width, src_image->height, (imcdouble*)src_image->data[i], dst_image->width, dst_image->height, (imcdouble*)dst_image->data[i], cos0, sin0, x, y, to_origin, counter, imcdouble(0, 0), order);
-        break;
-      }
+  return iWarpImage("WarpAffine", src_image, dst_image, &transf, order);
+}
 
-      if (!ret)
-        break;
-    }
-   }
+int imProcessWarpPerspective(const imImage* src_image, imImage* dst_image, const double* matrix, int order)
+{
+  iWarpTransform transf;
+  transf.type = WARP_PERSPECTIVE;
+  for (int i = 0; i < 9; i++)
+    transf.m[i] = matrix[i];
 
-  imProcessCounterEnd(counter);
+  return iWarpImage("WarpPerspective", src_image, dst_image, &transf, order);
+}
 
-  return ret;
+int imProcessRemap(const imImage* src_image, const imImage* map_x_image, const imImage* map_y_image, imImage* dst_image, int order)
+{
+  /* the maps are read at the target coordinates */
+  if (map_x_image->color_space != IM_GRAY || map_x_image->data_type != IM_FLOAT ||
+      map_y_image->color_space != IM_GRAY || map_y_image->data_type != IM_FLOAT ||
+      !imImageMatchSize(map_x_image, dst_image) ||
+      !imImageMatchSize(map_y_image, dst_image))
+    return 0;
+
+  iWarpTransform transf;
+  transf.type = WARP_REMAP;
+  transf.map_x = (const float*)map_x_image->data[0];
+  transf.map_y = (const float*)map_y_image->data[0];
+  transf.map_width = map_x_image->width;
+
+  return iWarpImage("Remap", src_image, dst_image, &transf, order);
 }
 
 int imProcessMirror(const imImage* src_image, imImage* dst_image)
@@ -937,7 +1304,10 @@ int imProcessFlip(const imImage* src_image, imImage* dst_image)
 
   int ret = 0;
   int counter = imProcessCounterBegin("Flip");
-  imCounterTotal(counter, src_depth*src_image->height, "Processing...");
+  if (src_image->data[0] == dst_image->data[0])
+    imCounterTotal(counter, src_depth*(src_image->height/2), "Processing...");
+  else
+    imCounterTotal(counter, src_depth*src_image->height, "Processing...");
 
   for (i = 0; i < src_depth; i++)
   {
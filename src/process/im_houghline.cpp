@@ -12,6 +12,7 @@
 
 #include "im_process_glo.h"
 #include "im_process_counter.h"
+#include "im_process_atomic.h"
 
 #include <stdlib.h>
 #include <memory.h>
@@ -21,8 +22,6 @@
 #define M_PI    3.14159265358979323846
 #endif
 
-static double *costab=NULL, *sintab=NULL;
-
 static int hgAbs(int x)
 {
   return x < 0? -x: x;
@@ -140,25 +139,144 @@ ________________________________________________________________
   Author:		Tor Lnnestad, BLAB, Ifi, UiO
 */
 
-static void init_sin_cos_table(int thetamax)
+/* rho is computed in fixed point, 16 bits of fraction */
+#define HOUGH_FX_SHIFT 16
+#define HOUGH_FX_ONE   (1 << HOUGH_FX_SHIFT)
+#define HOUGH_FX_HALF  (1 << (HOUGH_FX_SHIFT-1))
+
+typedef struct _houghTable
+{
+  int thetamax;
+  double *costab, *sintab;
+  int *costab_fx, *sintab_fx;
+  struct _houghTable* next;
+} houghTable;
+
+static void houghTableInit(houghTable* table, int thetamax)
 {
   int theta;
 
-  costab = (double*)malloc(thetamax*sizeof(double));
-  sintab = (double*)malloc(thetamax*sizeof(double));
+  table->thetamax = thetamax;
+  table->costab = (double*)malloc(thetamax*sizeof(double));
+  table->sintab = (double*)malloc(thetamax*sizeof(double));
+  table->costab_fx = (int*)malloc(thetamax*sizeof(int));
+  table->sintab_fx = (int*)malloc(thetamax*sizeof(int));
 
   for (theta = 0; theta < thetamax; theta++)
   {
     double th = (M_PI * theta) / (double)thetamax;
-    costab[theta] = cos(th);
-    sintab[theta] = sin(th);
+    table->costab[theta] = cos(th);
+    table->sintab[theta] = sin(th);
+    table->costab_fx[theta] = imRound(table->costab[theta] * HOUGH_FX_ONE);
+    table->sintab_fx[theta] = imRound(table->sintab[theta] * HOUGH_FX_ONE);
   }
 }
 
-static int houghLine(const imImage* input, imImage* output, int counter)
+static void houghTableRelease(houghTable* table)
 {
-  int ixsize, iysize, ixhalf, iyhalf, thetamax, x, y, rho, theta, rhomax;
+  free(table->costab);
+  free(table->sintab);
+  free(table->costab_fx);
+  free(table->sintab_fx);
+}
+
+/* tables already computed, one for each thetamax */
+static houghTable* volatile houghTableList = NULL;
+
+static houghTable* houghTableFind(houghTable* table, int thetamax)
+{
+  while (table && table->thetamax != thetamax)
+    table = table->next;
+  return table;
+}
+
+static const houghTable* houghTableGet(int thetamax)
+{
+  /* Each table is computed only once and pushed in the list with an atomic compare and swap. 
+     Tables are never removed, so the list is read without locks. 
+     If two threads build the same table at the same time only the first one is kept. */
+  houghTable* head = (houghTable*)imAtomicLoadPointer((void* volatile*)&houghTableList);
+  houghTable* table = houghTableFind(head, thetamax);
+  if (table)
+    return table;
+
+  table = (houghTable*)malloc(sizeof(houghTable));
+  houghTableInit(table, thetamax);
+
+  for (;;)
+  {
+    table->next = head;
+    houghTable* old_head = (houghTable*)imAtomicCompareSwapPointer((void* volatile*)&houghTableList, head, table);
+    if (old_head == head)
+      return table;
+
+    /* the list changed, another thread may have added the same table */
+    houghTable* other_table = houghTableFind(old_head, thetamax);
+    if (other_table)
+    {
+      houghTableRelease(table);
+      free(table);
+      return other_table;
+    }
+
+    head = old_head;
+  }
+}
+
+static inline int houghRho(const houghTable* table, int theta, int dx, int dy)
+{
+  /* same as imRound((dx*cos + dy*sin)), but in fixed point */
+  long long v = (long long)dx*table->costab_fx[theta] + (long long)dy*table->sintab_fx[theta];
+  if (v < 0)
+    return -(int)((-v + HOUGH_FX_HALF) >> HOUGH_FX_SHIFT);
+  else
+    return (int)((v + HOUGH_FX_HALF) >> HOUGH_FX_SHIFT);
+}
+
+static inline void houghVote(int* map, const houghTable* table, int rhomax, int dx, int dy, int theta_start, int theta_end)
+{
+  int thetamax = table->thetamax;
+
+  for (int t = theta_start; t <= theta_end; t++)
+  {
+    int theta = t;
+    if (theta < 0) theta += thetamax;  /* window around the normal wraps around */
+    else if (theta >= thetamax) theta -= thetamax;
+
+    int rho = houghRho(table, theta, dx, dy);
+    if (rho > rhomax) continue;
+    if (rho < -rhomax) continue;
+    map[(rho+rhomax)*thetamax + theta]++;
+  }
+}
+
+/* Normal of the edge at (x,y) from a Sobel operator, in theta units. Returns -1 if there is no gradient. */
+static int houghGradientTheta(const imbyte* map, int width, int height, int x, int y, int thetamax)
+{
+  int x0 = x > 0? x-1: x, x1 = x < width-1? x+1: x;
+  const imbyte* line0 = map + (y > 0? y-1: y)*width;
+  const imbyte* line1 = map + y*width;
+  const imbyte* line2 = map + (y < height-1? y+1: y)*width;
+
+  int gx = (line0[x1] + 2*line1[x1] + line2[x1]) - (line0[x0] + 2*line1[x0] + line2[x0]);
+  int gy = (line2[x0] + 2*line2[x] + line2[x1]) - (line0[x0] + 2*line0[x] + line0[x1]);
+
+  if (gx == 0 && gy == 0)
+    return -1;
+
+  double th = atan2((double)gy, (double)gx);
+  if (th < 0) th += M_PI;
+
+  int theta = imRound((th * thetamax) / M_PI);
+  if (theta >= thetamax) theta -= thetamax;
+  return theta;
+}
+
+static int houghLine(const imImage* input, imImage* output, const imImage* gray, int theta_delta, int counter)
+{
+  int ixsize, iysize, ixhalf, iyhalf, thetamax, rhomax;
   imbyte *input_map = (imbyte*)input->data[0];
+  imbyte *gray_map = gray? (imbyte*)gray->data[0]: input_map;
   int *output_map = (int*)output->data[0];
 
   ixsize = input->width;
@@ -169,31 +287,50 @@ static int houghLine(const imImage* input, imImage* output, int counter)
   thetamax = output->width;   /* theta max = 180 */
   rhomax = output->height/2;  /* rho shift to 0, -rmax <= r <= +rmax */
 
-  init_sin_cos_table(thetamax);
+  const houghTable* table = houghTableGet(thetamax);
+
+  /* each thread accumulates in its own map, the first thread uses the output directly. 
+     The maps are added at the end, so the result does not depend on the number of threads. */
+  int tcount = 1;
+#ifdef _OPENMP
+  if (IM_OMP_MINCOUNT(input->count))
+    tcount = IM_MAX_THREADS;
+#endif
+  int *thread_maps = NULL;
+  if (tcount > 1)
+  {
+    thread_maps = (int*)calloc((size_t)(tcount-1)*output->count, sizeof(int));
+    if (!thread_maps)
+      tcount = 1;
+  }
 
   IM_INT_PROCESSING;
 
 #ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(input->count))
+#pragma omp parallel for if (tcount > 1) num_threads(tcount)
 #endif
-  for (y=0; y < iysize; y++)
+  for (int y=0; y < iysize; y++)
   {
 #ifdef _OPENMP
 #pragma omp flush (processing)
 #endif
     IM_BEGIN_PROCESSING;
 
-    for (x = 0; x < ixsize; x++)
+    int thread_num = IM_THREAD_NUM;
+    int* map = thread_num == 0? output_map: thread_maps + (size_t)(thread_num-1)*output->count;
+
+    for (int x = 0; x < ixsize; x++)
     {
       if (input_map[y*ixsize + x])
       {
-        for (theta=0; theta < thetamax; theta++)
-        {
-          rho = imRound((x-ixhalf)*costab[theta] + (y-iyhalf)*sintab[theta]);
-          if (rho > rhomax) continue;
-          if (rho < -rhomax) continue;
-          output_map[(rho+rhomax)*thetamax + theta]++;
-	      }
+        int theta = -1;
+        if (theta_delta >= 0 && 2*theta_delta+1 < thetamax)
+          theta = houghGradientTheta(gray_map, ixsize, iysize, x, y, thetamax);
+
+        if (theta < 0)
+          houghVote(map, table, rhomax, x-ixhalf, y-iyhalf, 0, thetamax-1);
+        else
+          houghVote(map, table, rhomax, x-ixhalf, y-iyhalf, theta-theta_delta, theta+theta_delta);
       }
     }
 
@@ -204,6 +341,24 @@ static int houghLine(const imImage* input, imImage* output, int counter)
     IM_END_PROCESSING;
   }
 
+  if (thread_maps)
+  {
+    int count = output->count;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(count))
+#endif
+    for (int i = 0; i < count; i++)
+    {
+      int sum = output_map[i];
+      for (int t = 0; t < tcount-1; t++)
+        sum += thread_maps[(size_t)t*count + i];
+      output_map[i] = sum;
+    }
+
+    free(thread_maps);
+  }
+
   return processing;
 }
 
@@ -266,7 +421,7 @@ static listnode* findMaxima(const imImage* hough_points, int *line_count, const
 
 #define SWAPINT(a, b) {int t = a; a = b; b = t; }
 
-static void drawLine(imImage* image, int theta, int rho)
+static void drawLine(imImage* image, const houghTable* table, int theta, int rho)
 {
   int xsize, ysize, xstart, xstop, ystart, ystop, xhalf, yhalf;
   double a, b;
@@ -297,8 +452,8 @@ static void drawLine(imImage* image, int theta, int rho)
     return;
   }
 
-  a = -costab[theta]/sintab[theta];
-  b = (rho + xhalf*costab[theta] + yhalf*sintab[theta])/sintab[theta];
+  a = -table->costab[theta]/table->sintab[theta];
+  b = (rho + xhalf*table->costab[theta] + yhalf*table->sintab[theta])/table->sintab[theta];
 
   {
     int x[2];
@@ -382,10 +537,19 @@ int imProcessHoughLines(const imImage* src_image, imImage *dst_image)
   int counter = imProcessCounterBegin("HoughLines");
   imCounterTotal(counter, src_image->height, "Processing...");
 
-  int ret = houghLine(src_image, dst_image, counter);
+  int ret = houghLine(src_image, dst_image, NULL, -1, counter);
+
+  imProcessCounterEnd(counter);
+
+  return ret;
+}
+
+int imProcessHoughLinesGradient(const imImage* src_image, const imImage* gray_image, imImage *dst_image, int theta_delta)
+{
+  int counter = imProcessCounterBegin("HoughLinesGradient");
+  imCounterTotal(counter, src_image->height, "Processing...");
 
-  free(costab); costab = NULL;
-  free(sintab); sintab = NULL;
+  int ret = houghLine(src_image, dst_image, gray_image, theta_delta, counter);
 
   imProcessCounterEnd(counter);
 
@@ -394,11 +558,13 @@ int imProcessHoughLines(const imImage* src_image, imImage *dst_image)
 
 static void DrawPoints(imImage *image, listnode* maxima)
 {
+  const houghTable* table = houghTableGet(180);
+
   listnode* cur_node;
   while (maxima)
   {
     cur_node = maxima;
-    drawLine(image, cur_node->pt.theta, cur_node->pt.rho);
+    drawLine(image, table, cur_node->pt.theta, cur_node->pt.rho);
     maxima = cur_node->next;
     free(cur_node);
   }
@@ -433,13 +599,8 @@ int imProcessHoughLinesDraw(const imImage* src_image, const imImage *hough, cons
 
   ReplaceColor(dst_image);
 
-  init_sin_cos_table(180);
-
   DrawPoints(dst_image, maxima);
 
-  free(costab); costab = NULL;
-  free(sintab); sintab = NULL;
-
   return line_count;
 }
 
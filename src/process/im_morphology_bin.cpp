@@ -158,31 +158,31 @@ int imProcessBinMorphDilate(const imImage* src_image, imImage* dst_image, int ke
 
 int imProcessBinMorphOpen(const imImage* src_image, imImage* dst_image, int kernel_size, int iter)
 {
-  imImage*temp = imImageClone(src_image);
+  imImage* temp = imProcessImagePoolClone(src_image);
   if (!temp)
     return 0;
 
   if (!imProcessBinMorphErode(src_image, temp, kernel_size, iter)) 
-    {imImageDestroy(temp); return 0;}
+    {imProcessImagePoolRelease(temp); return 0;}
   if (!imProcessBinMorphDilate(temp, dst_image, kernel_size, iter)) 
-    {imImageDestroy(temp); return 0;}
+    {imProcessImagePoolRelease(temp); return 0;}
 
-  imImageDestroy(temp);
+  imProcessImagePoolRelease(temp);
   return 1;
 }
 
 int imProcessBinMorphClose(const imImage* src_image, imImage* dst_image, int kernel_size, int iter)
 {
-  imImage*temp = imImageClone(src_image);
+  imImage* temp = imProcessImagePoolClone(src_image);
   if (!temp)
     return 0;
 
   if (!imProcessBinMorphDilate(src_image, temp, kernel_size, iter)) 
-    {imImageDestroy(temp); return 0;}
+    {imProcessImagePoolRelease(temp); return 0;}
   if (!imProcessBinMorphErode(temp, dst_image, kernel_size, iter)) 
-    {imImageDestroy(temp); return 0;}
+    {imProcessImagePoolRelease(temp); return 0;}
 
-  imImageDestroy(temp);
+  imProcessImagePoolRelease(temp);
   return 1;
 }
 
@@ -190,31 +190,31 @@ int imProcessGrayMorphDilate(const imImage* src_image, imImage* dst_image, int k
 
 int imProcessGrayMorphOpen(const imImage* src_image, imImage* dst_image, int kernel_size)
 {
-  imImage*temp = imImageClone(src_image);
+  imImage* temp = imProcessImagePoolClone(src_image);
   if (!temp)
     return 0;
 
   if (!imProcessGrayMorphErode(src_image, temp, kernel_size)) 
-    {imImageDestroy(temp); return 0;}
+    {imProcessImagePoolRelease(temp); return 0;}
   if (!imProcessGrayMorphDilate(temp, dst_image, kernel_size)) 
-    {imImageDestroy(temp); return 0;}
+    {imProcessImagePoolRelease(temp); return 0;}
 
-  imImageDestroy(temp);
+  imProcessImagePoolRelease(temp);
   return 1;
 }
 
 int imProcessGrayMorphClose(const imImage* src_image, imImage* dst_image, int kernel_size)
 {
-  imImage*temp = imImageClone(src_image);
+  imImage* temp = imProcessImagePoolClone(src_image);
   if (!temp)
     return 0;
 
   if (!imProcessGrayMorphDilate(src_image, temp, kernel_size)) 
-    {imImageDestroy(temp); return 0;}
+    {imProcessImagePoolRelease(temp); return 0;}
   if (!imProcessGrayMorphErode(temp, dst_image, kernel_size)) 
-    {imImageDestroy(temp); return 0;}
+    {imProcessImagePoolRelease(temp); return 0;}
 
-  imImageDestroy(temp);
+  imProcessImagePoolRelease(temp);
   return 1;
 }
 
@@ -236,18 +236,18 @@ int imProcessGrayMorphWell(const imImage* src_image, imImage* dst_image, int ker
 
 int imProcessGrayMorphGradient(const imImage* src_image, imImage* dst_image, int kernel_size)
 {
-  imImage*temp = imImageClone(src_image);
+  imImage* temp = imProcessImagePoolClone(src_image);
   if (!temp)
     return 0;
 
   if (!imProcessGrayMorphDilate(src_image, temp, kernel_size)) 
-    {imImageDestroy(temp); return 0;}
+    {imProcessImagePoolRelease(temp); return 0;}
   if (!imProcessGrayMorphErode(src_image, dst_image, kernel_size)) 
-    {imImageDestroy(temp); return 0;}
+    {imProcessImagePoolRelease(temp); return 0;}
 
   imProcessArithmeticOp(temp, dst_image, dst_image, IM_BIN_DIFF);
 
-  imImageDestroy(temp);
+  imProcessImagePoolRelease(temp);
   return 1;
 }
 
@@ -0,0 +1,786 @@
+/** \file
+ * \brief Fused Point Operations Pipeline
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+
+#include <im.h>
+#include <im_util.h>
+#include <im_math.h>
+
+#include "im_process_counter.h"
+#include "im_process_pnt.h"
+#include "im_math_op.h"
+
+#include <stdlib.h>
+#include <memory.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IM_USE_SSE2
+#endif
+
+
+/* Number of samples processed at once by each thread.
+   The values buffer (double) and the operand buffer fit in the L1/L2 cache. */
+#define PIPE_BLOCK 2048
+
+enum iPipelineStepType {
+  PIPE_ARITHMETIC,
+  PIPE_ARITHMETIC_CONST,
+  PIPE_UNARITHMETIC,
+  PIPE_TONEGAMUT,
+  PIPE_THRESHOLD,
+  PIPE_BITWISE,
+  PIPE_BITWISE_NOT,
+  PIPE_CONVERT
+};
+
+struct iPipelineStep
+{
+  int type,
+      op,
+      data_type;        /* integer type of bitwise operations, or target of conversion */
+  const imImage* image; /* second operand */
+  double value;         /* constant operand, or threshold level */
+  double params[6];     /* tone gamut parameters, without min and max */
+  int has_minmax;
+  double min, max;
+};
+
+struct _imProcessPipeline
+{
+  const imImage* src_image;
+  int data_type;        /* data type of the values after the last step */
+  int step_count,
+      step_max;
+  iPipelineStep* steps;
+  int error;
+};
+
+
+imProcessPipeline* imProcessPipelineCreate(const imImage* src_image)
+{
+  imProcessPipeline* pipeline = new imProcessPipeline;
+  pipeline->src_image = src_image;
+  pipeline->data_type = src_image->data_type;
+  pipeline->step_count = 0;
+  pipeline->step_max = 0;
+  pipeline->steps = NULL;
+  pipeline->error = (src_image->data_type >= IM_CFLOAT)? 1: 0;
+  return pipeline;
+}
+
+void imProcessPipelineDestroy(imProcessPipeline* pipeline)
+{
+  if (pipeline->steps) free(pipeline->steps);
+  delete pipeline;
+}
+
+static iPipelineStep* iPipelineAddStep(imProcessPipeline* pipeline, int type, int op)
+{
+  if (pipeline->step_count == pipeline->step_max)
+  {
+    int step_max = pipeline->step_max + 8;
+    iPipelineStep* steps = (iPipelineStep*)realloc(pipeline->steps, step_max * sizeof(iPipelineStep));
+    if (!steps)
+    {
+      pipeline->error = 1;
+      return NULL;
+    }
+
+    pipeline->steps = steps;
+    pipeline->step_max = step_max;
+  }
+
+  iPipelineStep* step = pipeline->steps + pipeline->step_count;
+  memset(step, 0, sizeof(iPipelineStep));
+  step->type = type;
+  step->op = op;
+  step->data_type = pipeline->data_type;
+  pipeline->step_count++;
+  return step;
+}
+
+static int iPipelineMatchImage(imProcessPipeline* pipeline, const imImage* image)
+{
+  if (!imImageMatchSize(pipeline->src_image, image) ||
+      image->depth != pipeline->src_image->depth ||
+      image->has_alpha != pipeline->src_image->has_alpha ||
+      image->data_type >= IM_CFLOAT)
+  {
+    pipeline->error = 1;
+    return 0;
+  }
+  return 1;
+}
+
+void imProcessPipelineArithmeticOp(imProcessPipeline* pipeline, const imImage* src_image2, int op)
+{
+  if (!iPipelineMatchImage(pipeline, src_image2))
+    return;
+
+  iPipelineStep* step = iPipelineAddStep(pipeline, PIPE_ARITHMETIC, op);
+  if (step)
+    step->image = src_image2;
+}
+
+void imProcessPipelineArithmeticConstOp(imProcessPipeline* pipeline, double src_const, int op)
+{
+  iPipelineStep* step = iPipelineAddStep(pipeline, PIPE_ARITHMETIC_CONST, op);
+  if (step)
+    step->value = src_const;
+}
+
+void imProcessPipelineUnArithmeticOp(imProcessPipeline* pipeline, int op)
+{
+  if (op == IM_UN_CONJ || op == IM_UN_CPXNORM)
+  {
+    pipeline->error = 1;
+    return;
+  }
+
+  iPipelineAddStep(pipeline, PIPE_UNARITHMETIC, op);
+}
+
+void imProcessPipelineToneGamut(imProcessPipeline* pipeline, int op, double* params)
+{
+  /* the min-max is computed from the source image, 
+     so without IM_GAMUT_MINMAX it is valid only for the first step */
+  if (!(op & IM_GAMUT_MINMAX) && pipeline->step_count > 0)
+  {
+    pipeline->error = 1;
+    return;
+  }
+
+  iPipelineStep* step = iPipelineAddStep(pipeline, PIPE_TONEGAMUT, op & 0x00FF);
+  if (!step)
+    return;
+
+  if (op & IM_GAMUT_MINMAX)
+  {
+    step->has_minmax = 1;
+    step->min = params[0];
+    step->max = params[1];
+    params += 2;
+  }
+
+  /* at most 3 extra parameters are used by the tone gamut operations */
+  if (params)
+  {
+    int count = 0;
+    switch (op & 0x00FF)
+    {
+    case IM_GAMUT_POW:
+    case IM_GAMUT_LOG:
+    case IM_GAMUT_EXP:
+    case IM_GAMUT_SOLARIZE:
+      count = 1;
+      break;
+    case IM_GAMUT_EXPAND:
+    case IM_GAMUT_CROP:
+    case IM_GAMUT_BRIGHTCONT:
+      count = 2;
+      break;
+    case IM_GAMUT_SLICE:
+      count = 3;
+      break;
+    }
+
+    for (int i = 0; i < count; i++)
+      step->params[i] = params[i];
+  }
+
+  if ((op & 0x00FF) == IM_GAMUT_NORMALIZE)
+    pipeline->data_type = IM_FLOAT;
+}
+
+void imProcessPipelineThreshold(imProcessPipeline* pipeline, double level, int value)
+{
+  iPipelineStep* step = iPipelineAddStep(pipeline, PIPE_THRESHOLD, value);
+  if (step)
+    step->value = level;
+}
+
+void imProcessPipelineBitwiseOp(imProcessPipeline* pipeline, const imImage* src_image2, int op)
+{
+  if (pipeline->data_type >= IM_FLOAT || src_image2->data_type >= IM_FLOAT || 
+      !iPipelineMatchImage(pipeline, src_image2))
+  {
+    pipeline->error = 1;
+    return;
+  }
+
+  iPipelineStep* step = iPipelineAddStep(pipeline, PIPE_BITWISE, op);
+  if (step)
+    step->image = src_image2;
+}
+
+void imProcessPipelineBitwiseNot(imProcessPipeline* pipeline)
+{
+  if (pipeline->data_type >= IM_FLOAT)
+  {
+    pipeline->error = 1;
+    return;
+  }
+
+  iPipelineAddStep(pipeline, PIPE_BITWISE_NOT, 0);
+}
+
+void imProcessPipelineConvertDataType(imProcessPipeline* pipeline, int data_type)
+{
+  if (data_type >= IM_CFLOAT)
+  {
+    pipeline->error = 1;
+    return;
+  }
+
+  iPipelineStep* step = iPipelineAddStep(pipeline, PIPE_CONVERT, 0);
+  if (step)
+  {
+    step->data_type = data_type;
+    pipeline->data_type = data_type;
+  }
+}
+
+
+/*********************************************************************************/
+
+
+template <class T>
+static inline void iPipelineLoad(const T* map, double* values, int count)
+{
+  for (int i = 0; i < count; i++)
+    values[i] = (double)map[i];
+}
+
+static void iPipelineLoadImage(const imImage* image, size_t offset, double* values, int count)
+{
+  switch (image->data_type)
+  {
+  case IM_BYTE:
+    iPipelineLoad((const imbyte*)image->data[0] + offset, values, count);
+    break;
+  case IM_SHORT:
+    iPipelineLoad((const short*)image->data[0] + offset, values, count);
+    break;
+  case IM_USHORT:
+    iPipelineLoad((const imushort*)image->data[0] + offset, values, count);
+    break;
+  case IM_INT:
+    iPipelineLoad((const int*)image->data[0] + offset, values, count);
+    break;
+  case IM_FLOAT:
+    iPipelineLoad((const float*)image->data[0] + offset, values, count);
+    break;
+  case IM_DOUBLE:
+    iPipelineLoad((const double*)image->data[0] + offset, values, count);
+    break;
+  }
+}
+
+template <class T>
+static void iPipelineMinMax(const T* map, int count, double& min, double& max)
+{
+  T tmin, tmax;
+  imMinMaxType(map, count, tmin, tmax);
+  min = (double)tmin;
+  max = (double)tmax;
+}
+
+/* Same min-max used by imProcessToneGamut */
+static void iPipelineImageMinMax(const imImage* image, double& min, double& max)
+{
+  int count = image->count*image->depth;
+
+  switch (image->data_type)
+  {
+  case IM_BYTE:
+    iPipelineMinMax((const imbyte*)image->data[0], count, min, max);
+    break;
+  case IM_SHORT:
+    iPipelineMinMax((const short*)image->data[0], count, min, max);
+    break;
+  case IM_USHORT:
+    iPipelineMinMax((const imushort*)image->data[0], count, min, max);
+    break;
+  case IM_INT:
+    iPipelineMinMax((const int*)image->data[0], count, min, max);
+    break;
+  case IM_FLOAT:
+    iPipelineMinMax((const float*)image->data[0], count, min, max);
+    break;
+  case IM_DOUBLE:
+    iPipelineMinMax((const double*)image->data[0], count, min, max);
+    break;
+  }
+}
+
+/* Crop without branches, the values are unpredictable after several operations */
+static inline double iPipelineCrop(double v, double min, double max)
+{
+#ifdef IM_USE_SSE2
+  return _mm_cvtsd_f64(_mm_min_sd(_mm_max_sd(_mm_set_sd(v), _mm_set_sd(min)), _mm_set_sd(max)));
+#else
+  v = v < min? min: v;
+  return v > max? max: v;
+#endif
+}
+
+/* v <= level? 0: value, without branches */
+static inline double iPipelineThreshold(double v, double level, double value)
+{
+#ifdef IM_USE_SSE2
+  __m128d mask = _mm_cmpgt_sd(_mm_set_sd(v), _mm_set_sd(level));
+  return _mm_cvtsd_f64(_mm_and_pd(mask, _mm_set_sd(value)));
+#else
+  return v <= level? 0: value;
+#endif
+}
+
+/* Round and crop for integer types, just assign for real types */
+template <class T>
+static inline void iPipelineStoreInt(const double* values, T* map, int count, double min, double max)
+{
+  if (min >= 0)
+  {
+    for (int i = 0; i < count; i++)
+      map[i] = (T)(int)(iPipelineCrop(values[i], min, max) + 0.5);
+  }
+  else
+  {
+    for (int i = 0; i < count; i++)
+      map[i] = (T)imRound(iPipelineCrop(values[i], min, max));
+  }
+}
+
+template <class T>
+static inline void iPipelineStoreReal(const double* values, T* map, int count)
+{
+  for (int i = 0; i < count; i++)
+    map[i] = (T)values[i];
+}
+
+static void iPipelineStoreImage(imImage* image, size_t offset, const double* values, int count)
+{
+  switch (image->data_type)
+  {
+  case IM_BYTE:
+    iPipelineStoreInt(values, (imbyte*)image->data[0] + offset, count, 0, 255);
+    break;
+  case IM_SHORT:
+    iPipelineStoreInt(values, (short*)image->data[0] + offset, count, -32768, 32767);
+    break;
+  case IM_USHORT:
+    iPipelineStoreInt(values, (imushort*)image->data[0] + offset, count, 0, 65535);
+    break;
+  case IM_INT:
+    iPipelineStoreInt(values, (int*)image->data[0] + offset, count, -2147483647.0, 2147483647.0);
+    break;
+  case IM_FLOAT:
+    iPipelineStoreReal(values, (float*)image->data[0] + offset, count);
+    break;
+  case IM_DOUBLE:
+    iPipelineStoreReal(values, (double*)image->data[0] + offset, count);
+    break;
+  }
+}
+
+static void iPipelineConvert(double* values, int count, int data_type)
+{
+  double min = 0, max = 0;
+
+  switch (data_type)
+  {
+  case IM_BYTE:   min = 0;      max = 255;   break;
+  case IM_SHORT:  min = -32768; max = 32767; break;
+  case IM_USHORT: min = 0;      max = 65535; break;
+  case IM_INT:    min = -2147483647.0; max = 2147483647.0; break;
+  case IM_FLOAT:
+    for (int i = 0; i < count; i++)
+      values[i] = (double)(float)values[i];
+    return;
+  case IM_DOUBLE:
+    return;
+  }
+
+  for (int i = 0; i < count; i++)
+    values[i] = (double)imRound(iPipelineCrop(values[i], min, max));
+}
+
+/* wraps the value as a cast to the integer type would do */
+static inline double iPipelineBitCast(int v, int data_type)
+{
+  switch (data_type)
+  {
+  case IM_BYTE:   return (double)(imbyte)v;
+  case IM_SHORT:  return (double)(short)v;
+  case IM_USHORT: return (double)(imushort)v;
+  default:        return (double)v;
+  }
+}
+
+static void iPipelineBitwise(double* values, const double* operand, int count, int op, int data_type)
+{
+  int i;
+  switch (op)
+  {
+  case IM_BIT_AND:
+    for (i = 0; i < count; i++)
+      values[i] = iPipelineBitCast((int)values[i] & (int)operand[i], data_type);
+    break;
+  case IM_BIT_OR:
+    for (i = 0; i < count; i++)
+      values[i] = iPipelineBitCast((int)values[i] | (int)operand[i], data_type);
+    break;
+  case IM_BIT_XOR:
+    /* same as imProcessBitwiseOp, that always implemented IM_BIT_XOR as ~(a | b) */
+    for (i = 0; i < count; i++)
+      values[i] = iPipelineBitCast(~((int)values[i] | (int)operand[i]), data_type);
+    break;
+  }
+}
+
+static void iPipelineBinary(double* values, const double* operand, int count, int op)
+{
+  int i;
+  switch (op)
+  {
+  case IM_BIN_ADD:
+    for (i = 0; i < count; i++)
+      values[i] = add_op(values[i], operand[i]);
+    break;
+  case IM_BIN_SUB:
+    for (i = 0; i < count; i++)
+      values[i] = sub_op(values[i], operand[i]);
+    break;
+  case IM_BIN_MUL:
+    for (i = 0; i < count; i++)
+      values[i] = mul_op(values[i], operand[i]);
+    break;
+  case IM_BIN_DIV:
+    for (i = 0; i < count; i++)
+      values[i] = div_op(values[i], operand[i]);
+    break;
+  case IM_BIN_DIFF:
+    for (i = 0; i < count; i++)
+      values[i] = diff_op(values[i], operand[i]);
+    break;
+  case IM_BIN_POW:
+    for (i = 0; i < count; i++)
+      values[i] = pow_op(values[i], operand[i]);
+    break;
+  case IM_BIN_MIN:
+    for (i = 0; i < count; i++)
+      values[i] = min_op(values[i], operand[i]);
+    break;
+  case IM_BIN_MAX:
+    for (i = 0; i < count; i++)
+      values[i] = max_op(values[i], operand[i]);
+    break;
+  }
+}
+
+static void iPipelineBinaryConst(double* values, double value, int count, int op)
+{
+  int i;
+  switch (op)
+  {
+  case IM_BIN_ADD:
+    for (i = 0; i < count; i++)
+      values[i] = add_op(values[i], value);
+    break;
+  case IM_BIN_SUB:
+    for (i = 0; i < count; i++)
+      values[i] = sub_op(values[i], value);
+    break;
+  case IM_BIN_MUL:
+    for (i = 0; i < count; i++)
+      values[i] = mul_op(values[i], value);
+    break;
+  case IM_BIN_DIV:
+    for (i = 0; i < count; i++)
+      values[i] = div_op(values[i], value);
+    break;
+  case IM_BIN_DIFF:
+    for (i = 0; i < count; i++)
+      values[i] = diff_op(values[i], value);
+    break;
+  case IM_BIN_POW:
+    for (i = 0; i < count; i++)
+      values[i] = pow_op(values[i], value);
+    break;
+  case IM_BIN_MIN:
+    for (i = 0; i < count; i++)
+      values[i] = min_op(values[i], value);
+    break;
+  case IM_BIN_MAX:
+    for (i = 0; i < count; i++)
+      values[i] = max_op(values[i], value);
+    break;
+  }
+}
+
+static void iPipelineUnary(double* values, int count, int op)
+{
+  int i;
+  switch (op)
+  {
+  case IM_UN_ABS:
+    for (i = 0; i < count; i++)
+      values[i] = abs_op(values[i]);
+    break;
+  case IM_UN_LESS:
+    for (i = 0; i < count; i++)
+      values[i] = less_op(values[i]);
+    break;
+  case IM_UN_INV:
+    for (i = 0; i < count; i++)
+      values[i] = inv_op(values[i]);
+    break;
+  case IM_UN_SQR:
+    for (i = 0; i < count; i++)
+      values[i] = sqr_op(values[i]);
+    break;
+  case IM_UN_SQRT:
+    for (i = 0; i < count; i++)
+      values[i] = sqrt_op(values[i]);
+    break;
+  case IM_UN_LOG:
+    for (i = 0; i < count; i++)
+      values[i] = log_op(values[i]);
+    break;
+  case IM_UN_EXP:
+    for (i = 0; i < count; i++)
+      values[i] = exp_op(values[i]);
+    break;
+  case IM_UN_SIN:
+    for (i = 0; i < count; i++)
+      values[i] = sin_op(values[i]);
+    break;
+  case IM_UN_COS:
+    for (i = 0; i < count; i++)
+      values[i] = cos_op(values[i]);
+    break;
+  case IM_UN_POSITIVES:
+    for (i = 0; i < count; i++)
+      values[i] = values[i] > 0? values[i]: 0;
+    break;
+  case IM_UN_NEGATIVES:
+    for (i = 0; i < count; i++)
+      values[i] = values[i] > 0? 0: values[i];
+    break;
+  }
+}
+
+/* Same formulas of imProcessToneGamut,
+   but computed in double precision without intermediate conversions */
+static void iPipelineToneGamut(double* values, int count, const iPipelineStep* step)
+{
+  int i;
+  double min = step->min, max = step->max, range = max - min;
+  double start = step->params[0], end = step->params[1];
+
+  if (step->op == IM_GAMUT_SLICE || step->op == IM_GAMUT_CROP || step->op == IM_GAMUT_EXPAND)
+  {
+    if (start > end) { double tmp = end; end = start; start = tmp; }
+    if (end > max) end = max;
+    if (start < min) start = min;
+  }
+
+  switch (step->op)
+  {
+  case IM_GAMUT_NORMALIZE:
+    if (min >= 0 && max <= 1)  // Already normalized
+      break;
+    for (i = 0; i < count; i++)
+      values[i] = (values[i] - min) / range;
+    break;
+  case IM_GAMUT_INVERT:
+    for (i = 0; i < count; i++)
+      values[i] = max - (values[i] - min);
+    break;
+  case IM_GAMUT_ZEROSTART:
+    for (i = 0; i < count; i++)
+      values[i] = values[i] - min;
+    break;
+  case IM_GAMUT_SOLARIZE:
+    {
+      double level = ((100 - step->params[0]) * range) / 100.0 + min;
+      double A = (level - min) / (level - max);
+      double B = (level * range) / (max - level);
+      for (i = 0; i < count; i++)
+        values[i] = values[i] > level? values[i] * A + B: values[i];
+      break;
+    }
+  case IM_GAMUT_POW:
+    {
+      double gamma = step->params[0];
+      for (i = 0; i < count; i++)
+        values[i] = pow((values[i] - min) / range, gamma) * range + min;
+      break;
+    }
+  case IM_GAMUT_LOG:
+    {
+      double K = step->params[0];
+      double norm = log(K + 1);
+      for (i = 0; i < count; i++)
+        values[i] = (log(K * (values[i] - min) / range + 1) / norm) * range + min;
+      break;
+    }
+  case IM_GAMUT_EXP:
+    {
+      double K = step->params[0];
+      double norm = exp(K) - 1;
+      for (i = 0; i < count; i++)
+        values[i] = ((exp(K * (values[i] - min) / range) - 1) / norm) * range + min;
+      break;
+    }
+  case IM_GAMUT_SLICE:
+    {
+      int bin = (int)step->params[2];
+      for (i = 0; i < count; i++)
+      {
+        if (values[i] < start || values[i] > end)
+          values[i] = min;
+        else if (bin)
+          values[i] = max;
+      }
+      break;
+    }
+  case IM_GAMUT_CROP:
+    for (i = 0; i < count; i++)
+      values[i] = iPipelineCrop(values[i], start, end);
+    break;
+  case IM_GAMUT_EXPAND:
+    {
+      double norm = range / (end - start);
+      for (i = 0; i < count; i++)
+        values[i] = iPipelineCrop((values[i] - start) * norm + min, min, max);
+      break;
+    }
+  case IM_GAMUT_BRIGHTCONT:
+    {
+      double bs = (step->params[0] * range) / 100.0;
+      double a = tan((45 + step->params[1] * 0.449999) / 57.2957795);
+      double b = bs + range * (1.0 - a) / 2.0;
+      for (i = 0; i < count; i++)
+        values[i] = iPipelineCrop(values[i] * a + b, min, max);
+      break;
+    }
+  }
+}
+
+static void iPipelineBlock(const imProcessPipeline* pipeline, imImage* dst_image, size_t offset, int count, double* values, double* operand)
+{
+  iPipelineLoadImage(pipeline->src_image, offset, values, count);
+
+  for (int s = 0; s < pipeline->step_count; s++)
+  {
+    const iPipelineStep* step = pipeline->steps + s;
+
+    switch (step->type)
+    {
+    case PIPE_ARITHMETIC:
+      iPipelineLoadImage(step->image, offset, operand, count);
+      iPipelineBinary(values, operand, count, step->op);
+      break;
+    case PIPE_ARITHMETIC_CONST:
+      iPipelineBinaryConst(values, step->value, count, step->op);
+      break;
+    case PIPE_UNARITHMETIC:
+      iPipelineUnary(values, count, step->op);
+      break;
+    case PIPE_TONEGAMUT:
+      iPipelineToneGamut(values, count, step);
+      break;
+    case PIPE_THRESHOLD:
+      {
+        double level = step->value, value = (double)step->op;
+        for (int i = 0; i < count; i++)
+          values[i] = iPipelineThreshold(values[i], level, value);
+        break;
+      }
+    case PIPE_BITWISE:
+      iPipelineLoadImage(step->image, offset, operand, count);
+      iPipelineBitwise(values, operand, count, step->op, step->data_type);
+      break;
+    case PIPE_BITWISE_NOT:
+      for (int i = 0; i < count; i++)
+        values[i] = iPipelineBitCast(~(int)values[i], step->data_type);
+      break;
+    case PIPE_CONVERT:
+      iPipelineConvert(values, count, step->data_type);
+      break;
+    }
+  }
+
+  iPipelineStoreImage(dst_image, offset, values, count);
+}
+
+int imProcessPipelineExecute(imProcessPipeline* pipeline, imImage* dst_image)
+{
+  const imImage* src_image = pipeline->src_image;
+
+  if (pipeline->error ||
+      !imImageMatchSize(src_image, dst_image) ||
+      src_image->depth != dst_image->depth ||
+      dst_image->data_type >= IM_CFLOAT)
+    return 0;
+
+  /* tone gamut without given min-max is the first step, it uses the min-max of the source image */
+  double src_min = 0, src_max = 0;
+  int src_minmax = 0;
+  for (int s = 0; s < pipeline->step_count; s++)
+  {
+    iPipelineStep* step = pipeline->steps + s;
+    if (step->type == PIPE_TONEGAMUT && !step->has_minmax)
+    {
+      if (!src_minmax)
+      {
+        iPipelineImageMinMax(src_image, src_min, src_max);
+        src_minmax = 1;
+      }
+
+      step->min = src_min;
+      step->max = src_max;
+    }
+  }
+
+  int depth = src_image->has_alpha && dst_image->has_alpha? src_image->depth+1: src_image->depth;
+  size_t total = (size_t)src_image->count * depth;
+  int block_count = (int)((total + PIPE_BLOCK - 1) / PIPE_BLOCK);
+
+  int counter = imProcessCounterBegin("Pipeline");
+  imCounterTotal(counter, block_count, "Processing...");
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT((int)total))
+#endif
+  for (int b = 0; b < block_count; b++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    double values[PIPE_BLOCK], operand[PIPE_BLOCK];
+    size_t offset = (size_t)b * PIPE_BLOCK;
+    int count = (offset + PIPE_BLOCK > total)? (int)(total - offset): PIPE_BLOCK;
+
+    iPipelineBlock(pipeline, dst_image, offset, count, values, operand);
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  imProcessCounterEnd(counter);
+
+  return processing;
+}
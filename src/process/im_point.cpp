@@ -36,8 +36,8 @@ static int DoUnaryPointOp(T1 *src_map, T2 *dst_map, int width, int height, int d
     IM_BEGIN_PROCESSING; 
     
     double dst_value;
-    int d = i%count;
-    int y = (i - d*count)%width;
+    int d = i/count;
+    int y = (i - d*count)/width;
     int x = i - d*count - y*width;
 
     if (func((double)src_map[i], &dst_value, params, userdata, x, y, d))
@@ -157,6 +157,141 @@ int imProcessUnaryPointOp(const imImage* src_image, imImage* dst_image, imUnaryP
   return ret;
 }
 
+template <class T1, class T2> 
+static int DoUnaryPointLutApply(const T1 *src_map, T2 *dst_map, int width, int height, const T2* lut, const imbyte* lut_set, int all_set, int counter)
+{
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
+#endif
+  for(int y = 0; y < height; y++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING; 
+
+    int offset = y * width;
+    const T1* src_line = src_map + offset;
+    T2* dst_line = dst_map + offset;
+
+    if (all_set)
+    {
+      /* plain gather, no branches */
+      for(int x = 0; x < width; x++)
+        dst_line[x] = lut[src_line[x]];
+    }
+    else
+    {
+      for(int x = 0; x < width; x++)
+      {
+        T1 v = src_line[x];
+        if (lut_set[v])
+          dst_line[x] = lut[v];
+      }
+    }
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  return processing;
+}
+
+template <class T2> 
+static int iUnaryPointLutBuild(T2* lut, imbyte* lut_set, int lut_size, int d, imUnaryPointOpFunc func, double* params, void* userdata)
+{
+  int all_set = 1;
+
+  /* called sequentially, so the function does not need to be thread safe */
+  for(int v = 0; v < lut_size; v++)
+  {
+    double dst_value;
+    if (func((double)v, &dst_value, params, userdata, -1, -1, d))
+    {
+      lut[v] = (T2)dst_value;
+      lut_set[v] = 1;
+    }
+    else
+    {
+      lut[v] = 0;
+      lut_set[v] = 0;
+      all_set = 0;
+    }
+  }
+
+  return all_set;
+}
+
+template <class T1, class T2> 
+static int DoUnaryPointLutOp(T1 **src_map, T2 **dst_map, int width, int height, int depth, int lut_size, imUnaryPointOpFunc func, double* params, void* userdata, int counter)
+{
+  T2* lut = new T2 [lut_size];
+  imbyte* lut_set = new imbyte [lut_size];
+  int ret = IM_PROCESS_OK;
+
+  for(int d = 0; d < depth && ret; d++)
+  {
+    int all_set = iUnaryPointLutBuild(lut, lut_set, lut_size, d, func, params, userdata);
+    ret = DoUnaryPointLutApply(src_map[d], dst_map[d], width, height, lut, lut_set, all_set, counter);
+  }
+
+  delete [] lut;
+  delete [] lut_set;
+
+  return ret;
+}
+
+template <class T1> 
+static int DoUnaryPointLutOpSrc(T1 **src_map, imImage* dst_image, int depth, int lut_size, imUnaryPointOpFunc func, double* params, void* userdata, int counter)
+{
+  int width = dst_image->width;
+  int height = dst_image->height;
+
+  switch(dst_image->data_type)
+  {
+  case IM_BYTE:
+    return DoUnaryPointLutOp(src_map, (imbyte**)dst_image->data, width, height, depth, lut_size, func, params, userdata, counter);
+  case IM_SHORT:
+    return DoUnaryPointLutOp(src_map, (short**)dst_image->data, width, height, depth, lut_size, func, params, userdata, counter);
+  case IM_USHORT:
+    return DoUnaryPointLutOp(src_map, (imushort**)dst_image->data, width, height, depth, lut_size, func, params, userdata, counter);
+  case IM_INT:
+    return DoUnaryPointLutOp(src_map, (int**)dst_image->data, width, height, depth, lut_size, func, params, userdata, counter);
+  case IM_FLOAT:
+    return DoUnaryPointLutOp(src_map, (float**)dst_image->data, width, height, depth, lut_size, func, params, userdata, counter);
+  case IM_DOUBLE:
+    return DoUnaryPointLutOp(src_map, (double**)dst_image->data, width, height, depth, lut_size, func, params, userdata, counter);
+  }
+
+  return IM_PROCESS_OK;
+}
+
+int imProcessUnaryPointLutOp(const imImage* src_image, imImage* dst_image, imUnaryPointOpFunc func, double* params, void* userdata, const char* op_name)
+{
+  if (src_image->data_type != IM_BYTE && src_image->data_type != IM_USHORT)
+    return imProcessUnaryPointOp(src_image, dst_image, func, params, userdata, op_name);
+
+  int ret = 0;
+  int depth = src_image->has_alpha? src_image->depth+1: src_image->depth;
+
+  int counter = imProcessCounterBegin(op_name? op_name: "UnaryPointLutOp");
+  imCounterTotal(counter, depth*src_image->height, "Processing...");
+
+  if (src_image->data_type == IM_BYTE)
+    ret = DoUnaryPointLutOpSrc((imbyte**)src_image->data, dst_image, depth, 256, func, params, userdata, counter);
+  else
+    ret = DoUnaryPointLutOpSrc((imushort**)src_image->data, dst_image, depth, 65536, func, params, userdata, counter);
+
+  imProcessCounterEnd(counter);
+
+  return ret;
+}
+
 template <class T1, class T2> 
 static int DoUnaryPointColorOp(T1 **src_map, T2 **dst_map, int width, int height, int src_depth, int dst_depth, imUnaryPointColorOpFunc func, double* params, void* userdata, int counter)
 {
@@ -173,7 +308,7 @@ static int DoUnaryPointColorOp(T1 **src_map, T2 **dst_map, int width, int height
 #endif
     IM_BEGIN_PROCESSING; 
     
-    int y = i%width;
+    int y = i/width;
     int x = i - y*width;
 
     int d;
@@ -304,6 +439,131 @@ int imProcessUnaryPointColorOp(const imImage* src_image, imImage* dst_image, imU
   return ret;
 }
 
+template <class T1, class T2> 
+static int DoUnaryPointColorLutOp(T1 *src_map, T2 **dst_map, int width, int height, int dst_depth, int lut_size, imUnaryPointColorOpFunc func, double* params, void* userdata, int counter)
+{
+  T2* lut = new T2 [lut_size*dst_depth];
+  imbyte* lut_set = new imbyte [lut_size];
+  int all_set = 1;
+  IM_INT_PROCESSING;
+
+  /* called sequentially, so the function does not need to be thread safe */
+  for(int v = 0; v < lut_size; v++)
+  {
+    double src_value = (double)v;
+    double dst_value[IM_MAXDEPTH];
+
+    if (func(&src_value, dst_value, params, userdata, -1, -1))
+    {
+      for(int d = 0; d < dst_depth; d++)
+        lut[d*lut_size + v] = (T2)dst_value[d];
+      lut_set[v] = 1;
+    }
+    else
+    {
+      for(int d = 0; d < dst_depth; d++)
+        lut[d*lut_size + v] = 0;
+      lut_set[v] = 0;
+      all_set = 0;
+    }
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
+#endif
+  for(int y = 0; y < height; y++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING; 
+
+    int offset = y * width;
+    const T1* src_line = src_map + offset;
+
+    for(int d = 0; d < dst_depth; d++)
+    {
+      const T2* lut_d = lut + d*lut_size;
+      T2* dst_line = dst_map[d] + offset;
+
+      if (all_set)
+      {
+        for(int x = 0; x < width; x++)
+          dst_line[x] = lut_d[src_line[x]];
+      }
+      else
+      {
+        for(int x = 0; x < width; x++)
+        {
+          T1 v = src_line[x];
+          if (lut_set[v])
+            dst_line[x] = lut_d[v];
+        }
+      }
+    }
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  delete [] lut;
+  delete [] lut_set;
+
+  return processing;
+}
+
+template <class T1> 
+static int DoUnaryPointColorLutOpSrc(T1 *src_map, imImage* dst_image, int dst_depth, int lut_size, imUnaryPointColorOpFunc func, double* params, void* userdata, int counter)
+{
+  int width = dst_image->width;
+  int height = dst_image->height;
+
+  switch(dst_image->data_type)
+  {
+  case IM_BYTE:
+    return DoUnaryPointColorLutOp(src_map, (imbyte**)dst_image->data, width, height, dst_depth, lut_size, func, params, userdata, counter);
+  case IM_SHORT:
+    return DoUnaryPointColorLutOp(src_map, (short**)dst_image->data, width, height, dst_depth, lut_size, func, params, userdata, counter);
+  case IM_USHORT:
+    return DoUnaryPointColorLutOp(src_map, (imushort**)dst_image->data, width, height, dst_depth, lut_size, func, params, userdata, counter);
+  case IM_INT:
+    return DoUnaryPointColorLutOp(src_map, (int**)dst_image->data, width, height, dst_depth, lut_size, func, params, userdata, counter);
+  case IM_FLOAT:
+    return DoUnaryPointColorLutOp(src_map, (float**)dst_image->data, width, height, dst_depth, lut_size, func, params, userdata, counter);
+  case IM_DOUBLE:
+    return DoUnaryPointColorLutOp(src_map, (double**)dst_image->data, width, height, dst_depth, lut_size, func, params, userdata, counter);
+  }
+
+  return IM_PROCESS_OK;
+}
+
+int imProcessUnaryPointColorLutOp(const imImage* src_image, imImage* dst_image, imUnaryPointColorOpFunc func, double* params, void* userdata, const char* op_name)
+{
+  int src_depth = src_image->has_alpha && dst_image->has_alpha? src_image->depth+1: src_image->depth;
+
+  /* a table is feasible only when there is a single source plane */
+  if (src_depth != 1 || (src_image->data_type != IM_BYTE && src_image->data_type != IM_USHORT))
+    return imProcessUnaryPointColorOp(src_image, dst_image, func, params, userdata, op_name);
+
+  int ret = 0;
+  int dst_depth = dst_image->has_alpha? dst_image->depth+1: dst_image->depth;
+
+  int counter = imProcessCounterBegin(op_name? op_name: "UnaryPointColorLutOp");
+  imCounterTotal(counter, src_image->height, "Processing...");
+
+  if (src_image->data_type == IM_BYTE)
+    ret = DoUnaryPointColorLutOpSrc((imbyte*)src_image->data[0], dst_image, dst_depth, 256, func, params, userdata, counter);
+  else
+    ret = DoUnaryPointColorLutOpSrc((imushort*)src_image->data[0], dst_image, dst_depth, 65536, func, params, userdata, counter);
+
+  imProcessCounterEnd(counter);
+
+  return ret;
+}
+
 template <class T1, class T2> 
 static int DoMultiPointOp(T1 **src_map, T2 *dst_map, int width, int height, int depth, int src_count, imMultiPointOpFunc func, double* params, void* userdata, int counter)
 {
@@ -324,8 +584,8 @@ static int DoMultiPointOp(T1 **src_map, T2 *dst_map, int width, int height, int
     IM_BEGIN_PROCESSING; 
     
     double dst_value;
-    int d = i%count;
-    int y = (i - d*count)%width;
+    int d = i/count;
+    int y = (i - d*count)/width;
     int x = i - d*count - y*width;
     int toffset = IM_THREAD_NUM*src_count;
 
@@ -475,7 +735,7 @@ static int DoMultiPointColorOp(T1 ***src_map, T2 **dst_map, int width, int heigh
     IM_BEGIN_PROCESSING; 
     
     double dst_value[IM_MAXDEPTH];
-    int y = i%width;
+    int y = i/width;
     int x = i - y*width;
     int toffset = IM_THREAD_NUM*(src_count*src_depth);
 
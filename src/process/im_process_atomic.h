@@ -0,0 +1,75 @@
+/** \file
+ * \brief Atomic Operations
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+#ifndef __IM_PROCESS_ATOMIC_H
+#define __IM_PROCESS_ATOMIC_H
+
+#include <stdlib.h>
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+
+/* Minimal atomic operations used to publish shared state without locks.
+   Function local static initialization is not thread safe in all compilers (VC 2013 for instance),
+   so shared tables and pools are created on first use and published with a compare and swap.
+   All operations are full memory barriers. */
+
+/* Stores new_value in *ptr if *ptr is equal to old_value. Returns the previous value of *ptr. */
+static inline void* imAtomicCompareSwapPointer(void* volatile* ptr, void* old_value, void* new_value)
+{
+#ifdef WIN32
+  return InterlockedCompareExchangePointer((PVOID volatile*)ptr, new_value, old_value);
+#else
+  return __sync_val_compare_and_swap(ptr, old_value, new_value);
+#endif
+}
+
+/* Returns *ptr, reads done after it will not see older values. */
+static inline void* imAtomicLoadPointer(void* volatile* ptr)
+{
+  return imAtomicCompareSwapPointer(ptr, NULL, NULL);
+}
+
+/* Stores new_value in *ptr if *ptr is equal to old_value. Returns the previous value of *ptr. */
+static inline long long imAtomicCompareSwap64(volatile long long* ptr, long long old_value, long long new_value)
+{
+#ifdef WIN32
+  return InterlockedCompareExchange64((LONGLONG volatile*)ptr, new_value, old_value);
+#else
+  return __sync_val_compare_and_swap(ptr, old_value, new_value);
+#endif
+}
+
+/* Adds value to *ptr. Returns the previous value of *ptr. */
+static inline long long imAtomicExchangeAdd64(volatile long long* ptr, long long value)
+{
+#ifdef WIN32
+  return InterlockedExchangeAdd64((LONGLONG volatile*)ptr, value);
+#else
+  return __sync_fetch_and_add(ptr, value);
+#endif
+}
+
+/* Returns *ptr. */
+static inline long long imAtomicLoad64(volatile long long* ptr)
+{
+  return imAtomicExchangeAdd64(ptr, 0);
+}
+
+/* Stores value in *ptr. */
+static inline void imAtomicStore64(volatile long long* ptr, long long value)
+{
+#ifdef WIN32
+  InterlockedExchange64((LONGLONG volatile*)ptr, value);
+#else
+  __sync_lock_test_and_set(ptr, value);
+  __sync_synchronize();
+#endif
+}
+
+#endif
@@ -5,6 +5,8 @@
  */
 
 #include "im_process_counter.h"
+#include "im_process_glo.h"
+#include "im_process_atomic.h"
 
 #include <stdlib.h>
 #include <memory.h>
@@ -31,6 +33,47 @@ int imProcessOpenMPSetNumThreads(int count)
 #endif
 }
 
+static imImagePool* volatile iProcessPool = NULL;
+
+static imImagePool* iProcessGetImagePool(void)
+{
+  imImagePool* pool = (imImagePool*)imAtomicLoadPointer((void* volatile*)&iProcessPool);
+  if (!pool)
+  {
+    /* If two threads create the pool at the same time only the first one is kept. */
+    pool = imImagePoolCreate(0, 0);
+
+    imImagePool* old_pool = (imImagePool*)imAtomicCompareSwapPointer((void* volatile*)&iProcessPool, NULL, pool);
+
+    if (old_pool)
+    {
+      imImagePoolDestroy(pool);
+      pool = old_pool;
+    }
+  }
+
+  return pool;
+}
+
+imImagePool* imProcessImagePool(void)
+{
+  return iProcessGetImagePool();
+}
+
+imImage* imProcessImagePoolClone(const imImage* image)
+{
+  int color_mode = image->color_space;
+  if (image->has_alpha)
+    color_mode |= IM_ALPHA;
+
+  return imImagePoolAcquire(iProcessGetImagePool(), image->width, image->height, color_mode, image->data_type);
+}
+
+void imProcessImagePoolRelease(imImage* image)
+{
+  imImagePoolRelease(iProcessGetImagePool(), image);
+}
+
 #ifdef _OPENMP
 
 int imCounterBegin_OMP(const char* title)
@@ -7,7 +7,9 @@
 #ifndef __IM_PROCESSING_COUNTER_H
 #define __IM_PROCESSING_COUNTER_H
 
+#include <im.h>
 #include <im_counter.h>
+#include <im_image.h>
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -30,6 +32,11 @@ extern int im_process_mincount;
 int imProcessOpenMPSetMinCount(int min_count);
 int imProcessOpenMPSetNumThreads(int count);
 
+/* Temporary images from the internal image pool.
+   The returned image has the same size and type of the given image, but contents are undefined. */
+imImage* imProcessImagePoolClone(const imImage* image);
+void imProcessImagePoolRelease(imImage* image);
+
 #define IM_INT_PROCESSING     int processing = IM_PROCESS_OK;
 
 #ifdef _OPENMP
@@ -0,0 +1,135 @@
+/** \file
+ * \brief Wavefront Error Diffusion
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+#ifndef __IM_PROCESS_DITHER_H
+#define __IM_PROCESS_DITHER_H
+
+#include "im_process_counter.h"
+
+#include <stdlib.h>
+#include <memory.h>
+
+
+/* Floyd-Steinberg error diffusion with a raster scan,
+   processed in parallel as a wavefront when OpenMP is enabled.
+
+   A pixel receives error from the previous pixel in its line and
+   from 3 pixels in the previous line (x-1, x and x+1).
+   So line y can process column x after line y-1 processed column x+1.
+   Lines are distributed in round robin to the threads, each line waits
+   for the previous one to be ahead before each block of pixels,
+   and publishes its own progress after each block.
+   The number of threads is limited to the number of processors.
+   The result is the same of the sequential scan.
+
+   Errors are stored multiplied by 16 in two lines, with one extra column at each side.
+   Line y reads the errors of line y%2 and writes the errors of line (y+1)%2.
+
+   quantize(v, &dst) must store the quantized value of v at dst,
+   and return the value it represents, so the error is v minus that value.
+   Returns zero if the counter aborted or if failed to allocate memory. */
+
+#define IM_DITHER_BLOCK 64
+
+template <class Q>
+static int imDitherDiffusion(const imbyte* src_map, imbyte* dst_map, int width, int height, Q& quantize, int counter)
+{
+  int line_size = width + 2;
+  int* errors = (int*)malloc((2 * line_size + height) * sizeof(int));
+  if (!errors)
+    return 0;
+
+  volatile int* progress = errors + 2 * line_size;
+  for (int i = 0; i < height; i++)
+    progress[i] = 0;
+
+  memset(errors, 0, line_size * sizeof(int));
+
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+  /* waiting threads spin, so each one needs its own processor */
+  int thread_count = IM_MAX_THREADS;
+  if (thread_count > omp_get_num_procs())
+    thread_count = omp_get_num_procs();
+
+#pragma omp parallel for schedule(static, 1) num_threads(thread_count) if (thread_count > 1 && IM_OMP_MINHEIGHT(height))
+#endif
+  for (int y = 0; y < height; y++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    const imbyte* src_line = src_map + (size_t)y * width;
+    imbyte* dst_line = dst_map + (size_t)y * width;
+    int* cur_err = errors + (y & 1) * line_size + 1;
+    int* next_err = errors + ((y + 1) & 1) * line_size + 1;
+    int carry = 0;
+
+    for (int x0 = 0; x0 < width; x0 += IM_DITHER_BLOCK)
+    {
+      int x1 = x0 + IM_DITHER_BLOCK < width? x0 + IM_DITHER_BLOCK: width;
+
+      if (y > 0)
+      {
+        /* the last pixel of the block needs x1 of the previous line */
+        int need = x1 < width? x1 + 1: width;
+        while (progress[y - 1] < need)
+        {
+#ifdef _OPENMP
+#pragma omp flush
+#endif
+        }
+#ifdef _OPENMP
+#pragma omp flush
+#endif
+      }
+
+      /* the next errors line was already read by the previous line at this point */
+      if (x0 == 0)
+        next_err[-1] = next_err[0] = 0;
+
+      for (int x = x0; x < x1; x++)
+      {
+        int v = src_line[x] + ((cur_err[x] + carry + 8) >> 4);
+        if (v < 0) v = 0;
+        else if (v > 255) v = 255;
+
+        int err = v - quantize(v, dst_line + x);
+
+        /* Floyd-Steinberg weights: 7 ahead, 3 behind below, 5 below, 1 ahead below */
+        carry = 7 * err;
+        next_err[x - 1] += 3 * err;
+        next_err[x] += 5 * err;
+        next_err[x + 1] = err;
+      }
+
+#ifdef _OPENMP
+#pragma omp flush
+#endif
+      progress[y] = x1;
+    }
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+
+#ifdef _OPENMP
+    /* when aborted the next lines must not wait for this one */
+    progress[y] = width;
+#pragma omp flush
+#endif
+  }
+
+  free(errors);
+  return processing;
+}
+
+#endif
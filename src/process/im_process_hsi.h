@@ -0,0 +1,233 @@
+/** \file
+ * \brief Fast HSI Conversion
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+#ifndef __IM_PROCESS_HSI_H
+#define __IM_PROCESS_HSI_H
+
+#include <im_colorhsi.h>
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IM_USE_SSE2
+#endif
+
+
+/* The *Fast HSI functions use the same HSI definition of im_colorhsi.h, computed in single precision.
+   Trigonometric functions are replaced by polynomials:
+     atan2 - odd polynomial of degree 9 on [0,1] (Abramowitz-Stegun 4.4.49), error < 1e-5 rad
+     sin, cos - Taylor polynomial of degree 9 on [-pi/2,pi/2], error < 4e-6
+   Saturation is scaled using u,v directly, without the sin and cos of the hue.
+   Compared to the exact functions, hue error is less than 0.001 degrees,
+   saturation and intensity errors are less than 1e-5. */
+
+#define IM_HSI_PI     3.14159265358979f
+#define IM_HSI_SQRT3  1.73205080757f
+
+static inline float iFastAtanPoly(float a)
+{
+  /* a in [0,1] */
+  float s = a*a;
+  return a*(0.9998660f + s*(-0.3302995f + s*(0.1801410f + s*(-0.0851330f + s*0.0208351f))));
+}
+
+/* returns degrees in [0,360) */
+static inline float iFastHue(float u, float v)
+{
+  float au = u < 0? -u: u;
+  float av = v < 0? -v: v;
+  float r;
+
+  if (au > av)
+    r = IM_HSI_PI/2 - iFastAtanPoly(av / au);
+  else
+    r = iFastAtanPoly(au / av);
+
+  if (v < 0) r = IM_HSI_PI - r;
+
+  r *= 180.0f / IM_HSI_PI;
+
+  if (u < 0) r = 360.0f - r;
+  if (r >= 360.0f) r = 0;  /* u = -0 */
+
+  return r;
+}
+
+static inline float iFastSinPoly(float x)
+{
+  /* x in [-pi/2,pi/2] */
+  float s = x*x;
+  return x*(1.0f + s*(-1.6666667e-1f + s*(8.3333333e-3f + s*(-1.9841270e-4f + s*2.7557319e-6f))));
+}
+
+/* h in degrees [0,360) */
+static inline void iFastCosSin(float h, float *cosH, float *sinH)
+{
+  /* sin(h) = sin(180-h), reduced to [-90,90] */
+  float hs = h > 270.0f? h - 360.0f: h > 90.0f? 180.0f - h: h;
+  /* cos(h) = sin(90-h) */
+  float hc = h < 180.0f? 90.0f - h: h - 270.0f;
+
+  *sinH = iFastSinPoly(hs * (IM_HSI_PI / 180.0f));
+  *cosH = iFastSinPoly(hc * (IM_HSI_PI / 180.0f));
+}
+
+/* Same as imColorRGB2HSI, with S/Smax computed from u,v.
+   Since cosH=v/S and sinH=u/S, S/Smax is one of |hx|/I or |hx|/(1-I) where hx are u,v combinations. */
+static inline void iFastRGB2HSI(float r, float g, float b, float *h, float *s, float *i)
+{
+  float v = r - (g + b) * 0.5f;
+  float u = (g - b) * (IM_HSI_SQRT3 / 2.0f);
+  float I = (r + g + b) / 3.0f;
+
+  *i = I;
+
+  if (u == 0 && v == 0)
+  {
+    *h = 360.0f;  /* by definition */
+    *s = 0;
+    return;
+  }
+
+  float H = iFastHue(u, v);
+  *h = H;
+
+  if (I <= 0 || I >= 1)
+  {
+    *s = 0;  /* by definition */
+    return;
+  }
+
+  float hr = (2.0f * v) / 3.0f;
+  float hg = (-v + u*IM_HSI_SQRT3) / 3.0f;
+  float hb = (-v - u*IM_HSI_SQRT3) / 3.0f;
+  float S;
+
+  /* bottom faces */
+  float h0 = H < 120.0f? hb: H < 240.0f? hr: hg;
+  /* top faces */
+  float h1 = (H < 60.0f || H > 300.0f)? hr: H < 180.0f? hg: hb;
+
+  if (I <= 1.0f/3.0f)
+    S = fabsf(h0) / I;
+  else if (I >= 2.0f/3.0f)
+    S = fabsf(h1) / (1.0f - I);
+  else
+  {
+    float imax = fabsf(h0 / (h0 - h1));
+    if (I < imax)
+      S = fabsf(h0) / I;
+    else
+      S = fabsf(h1) / (1.0f - I);
+  }
+
+  if (S > 1.0f)
+    S = 1.0f;
+
+  *s = S;
+}
+
+/* Same as imColorHSI2RGB */
+static inline void iFastHSI2RGB(float H, float S, float I, float *r, float *g, float *b)
+{
+  float cosH, sinH, v, u, R, G, B;
+
+  if (I < 0.0f) I = 0.0f;
+  else if (I > 1.0f) I = 1.0f;
+
+  if (S < 0) S = 0.0f;
+  else if (S > 1.0f) S = 1.0f;
+
+  if (S == 0.0f || I == 1.0f || I == 0.0f || H == 360.0f)
+  {
+    *r = I;
+    *g = I;
+    *b = I;
+    return;
+  }
+
+  if (H < 0 || H >= 360.0f)
+  {
+    H = fmodf(H, 360.0f);
+    if (H < 0) H += 360.0f;
+  }
+
+  iFastCosSin(H, &cosH, &sinH);
+
+  /* must scale S from 0-1 to 0-Smax */
+  S *= (float)imColorHSI_Smax(H * (IM_HSI_PI / 180.0f), cosH, sinH, I);
+  if (S > 1.0f)
+    S = 1.0f;
+
+  v = S * cosH;
+  u = S * sinH;
+
+  R = I + (2.0f * v) / 3.0f;
+  G = I - (v - u*IM_HSI_SQRT3) / 3.0f;
+  B = I - (v + u*IM_HSI_SQRT3) / 3.0f;
+
+  /* fix round errors */
+  *r = R < 0.0f? 0.0f: R > 1.0f? 1.0f: R;
+  *g = G < 0.0f? 0.0f: G > 1.0f? 1.0f: G;
+  *b = B < 0.0f? 0.0f: B > 1.0f? 1.0f: B;
+}
+
+static inline void iFastShiftHSI(float &h, float &s, float &i, float h_shift, float s_shift, float i_shift)
+{
+  h += h_shift; // in degrees
+  s += s_shift;
+  if (s < 0) s = 0;
+  if (s > 1) s = 1;
+  i += i_shift;
+  if (i < 0) i = 0;
+  if (i > 1) i = 1;
+}
+
+#ifdef IM_USE_SSE2
+/* iFastHue for 4 values, 360 where u=v=0 */
+static inline __m128 iFastHue4(__m128 u, __m128 v)
+{
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  const __m128 zero = _mm_setzero_ps();
+
+  __m128 au = _mm_andnot_ps(sign, u);
+  __m128 av = _mm_andnot_ps(sign, v);
+  __m128 swap = _mm_cmpgt_ps(au, av);
+  __m128 num = _mm_or_ps(_mm_and_ps(swap, av), _mm_andnot_ps(swap, au));
+  __m128 den = _mm_or_ps(_mm_and_ps(swap, au), _mm_andnot_ps(swap, av));
+  __m128 null = _mm_cmpeq_ps(den, zero);   /* u=v=0 */
+
+  __m128 a = _mm_div_ps(num, _mm_or_ps(den, _mm_and_ps(null, _mm_set1_ps(1.0f))));
+  __m128 s = _mm_mul_ps(a, a);
+  __m128 r = _mm_set1_ps(0.0208351f);
+  r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.0851330f));
+  r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.1801410f));
+  r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.3302995f));
+  r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.9998660f));
+  r = _mm_mul_ps(r, a);
+
+  __m128 r90 = _mm_sub_ps(_mm_set1_ps(IM_HSI_PI/2), r);
+  r = _mm_or_ps(_mm_and_ps(swap, r90), _mm_andnot_ps(swap, r));
+
+  __m128 vneg = _mm_cmplt_ps(v, zero);
+  __m128 r180 = _mm_sub_ps(_mm_set1_ps(IM_HSI_PI), r);
+  r = _mm_or_ps(_mm_and_ps(vneg, r180), _mm_andnot_ps(vneg, r));
+
+  r = _mm_mul_ps(r, _mm_set1_ps(180.0f / IM_HSI_PI));
+
+  __m128 uneg = _mm_cmplt_ps(u, zero);
+  __m128 r360 = _mm_sub_ps(_mm_set1_ps(360.0f), r);
+  r = _mm_or_ps(_mm_and_ps(uneg, r360), _mm_andnot_ps(uneg, r));
+
+  __m128 full = _mm_cmpge_ps(r, _mm_set1_ps(360.0f));
+  r = _mm_andnot_ps(full, r);
+
+  return _mm_or_ps(_mm_and_ps(null, _mm_set1_ps(360.0f)), _mm_andnot_ps(null, r));
+}
+#endif
+
+#endif
@@ -12,6 +12,7 @@
 #include <im_convert.h>
 
 #include "im_process_counter.h"
+#include "im_process_dither.h"
 #include "im_process_pnt.h"
 #include "im_process_ana.h"
 
@@ -19,6 +20,90 @@
 #include <memory.h>
 
 
+struct iUniformQuantize
+{
+  int weight, accumulate;
+
+  /* nearest of the 6 levels of the uniform palette: 0, 51, 102, 153, 204, 255 */
+  inline int operator()(int v, imbyte* dst)
+  {
+    int level = (v + 25) / 51;
+
+    if (accumulate)
+      *dst = (imbyte)(*dst + weight*level);
+    else
+      *dst = (imbyte)(weight*level);
+
+    return 51*level;
+  }
+};
+
+static int iQuantizeRGBUniformDiffusion(const imImage* src_image, imImage* dst_image)
+{
+  /* the uniform palette is separable, so each channel is diffused independently 
+     and its level is accumulated in the index: 36*red + 6*green + blue */
+  static const int weight[3] = {36, 6, 1};
+
+  for (int i = 0; i < 3; i++)
+  {
+    iUniformQuantize quantize;
+    quantize.weight = weight[i];
+    quantize.accumulate = i > 0;
+
+    if (!imDitherDiffusion((imbyte*)src_image->data[i], (imbyte*)dst_image->data[0], src_image->width, src_image->height, quantize, -1))
+      return 0;
+  }
+
+  return 1;
+}
+
+static int iQuantizeRGBUniformBlueNoise(const imImage* src_image, imImage* dst_image)
+{
+  int size;
+  const int* matrix = imPaletteDitherMatrix(IM_PALETTE_DITHER_BLUENOISE, &size);
+  if (!matrix)
+    return 0;
+
+  /* the matrix ranks are converted to the same range of the remainder of the division by 51 */
+  int count = size*size;
+  imbyte* thres = (imbyte*)malloc(count);
+  if (!thres)
+    return 0;
+
+  for (int i = 0; i < count; i++)
+    thres[i] = (imbyte)((matrix[i] * 51) / count);
+
+  imbyte *dst_map=(imbyte*)dst_image->data[0], 
+         *red_map=(imbyte*)src_image->data[0],
+         *green_map=(imbyte*)src_image->data[1],
+         *blue_map=(imbyte*)src_image->data[2];
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(src_image->height))
+#endif
+  for (int y = 0; y < src_image->height; y++)
+  {
+    size_t line_offset = (size_t)y*src_image->width;
+    const imbyte* thres_line = thres + (y & (size - 1))*size;
+
+    for (int x = 0; x < src_image->width; x++)
+    {
+      size_t offset = line_offset+x;
+      int t = thres_line[x & (size - 1)];
+      int r = red_map[offset], g = green_map[offset], b = blue_map[offset];
+
+      int lr = r / 51 + (r % 51 > t? 1: 0);
+      int lg = g / 51 + (g % 51 > t? 1: 0);
+      int lb = b / 51 + (b % 51 > t? 1: 0);
+
+      dst_map[offset] = (imbyte)(36*lr + 6*lg + lb);
+    }
+  }
+
+  free(thres);
+  return 1;
+}
+
 void imProcessQuantizeRGBUniform(const imImage* src_image, imImage* dst_image, int dither)
 {
   imbyte *dst_map=(imbyte*)dst_image->data[0], 
@@ -28,6 +113,14 @@ void imProcessQuantizeRGBUniform(const imImage* src_image, imImage* dst_image, i
 
   imImageSetPalette(dst_image, imPaletteUniform(), 256);
 
+  if (dither == IM_PALETTE_DITHER_DIFFUSION && iQuantizeRGBUniformDiffusion(src_image, dst_image))
+    return;
+
+  if (dither == IM_PALETTE_DITHER_BLUENOISE && iQuantizeRGBUniformBlueNoise(src_image, dst_image))
+    return;
+
+  /* the ordered dither is also used when the other options failed to allocate memory */
+
 #ifdef _OPENMP
 #pragma omp parallel for if (IM_OMP_MINHEIGHT(src_image->height))
 #endif
@@ -50,6 +143,66 @@ void imProcessQuantizeRGBMedianCut(const imImage* image, imImage* NewImage)
   imConvertRGB2Map(image->width, image->height, (imbyte*)image->data[0], (imbyte*)image->data[1], (imbyte*)image->data[2], (imbyte*)NewImage->data[0], NewImage->palette, &NewImage->palette_count);
 }
 
+/* Lines mapped at once, a multiple of the ordered dither matrices size, 
+   so each band starts at the first line of the matrices */
+#define QUANTIZE_BAND_HEIGHT 64
+
+int imProcessQuantizeRGBPalette(const imImage* src_image, imImage* dst_image, int dither)
+{
+  imPaletteIndex* pindex = imPaletteIndexCreate(dst_image->palette, dst_image->palette_count);
+  if (!pindex)
+    return 0;
+
+  const imbyte *red = (const imbyte*)src_image->data[0], 
+               *green = (const imbyte*)src_image->data[1], 
+               *blue = (const imbyte*)src_image->data[2];
+  imbyte* map = (imbyte*)dst_image->data[0];
+  int width = src_image->width;
+  int height = src_image->height;
+
+  /* error diffusion depends on the previous lines */
+  if (dither == IM_PALETTE_DITHER_DIFFUSION)
+  {
+    int ret = imPaletteIndexMap(pindex, width, height, red, green, blue, map, dither);
+    imPaletteIndexDestroy(pindex);
+    return ret;
+  }
+
+  int band_count = (height + QUANTIZE_BAND_HEIGHT - 1) / QUANTIZE_BAND_HEIGHT;
+
+  int counter = imProcessCounterBegin("QuantizeRGBPalette");
+  imCounterTotal(counter, band_count, "Processing...");
+
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
+#endif
+  for (int b = 0; b < band_count; b++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    int y0 = b * QUANTIZE_BAND_HEIGHT;
+    int band_height = (y0 + QUANTIZE_BAND_HEIGHT < height)? QUANTIZE_BAND_HEIGHT: height - y0;
+    size_t offset = (size_t)y0 * width;
+
+    imPaletteIndexMap(pindex, width, band_height, red + offset, green + offset, blue + offset, map + offset, dither);
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  imProcessCounterEnd(counter);
+  imPaletteIndexDestroy(pindex);
+  return processing;
+}
+
 void imProcessQuantizeGrayUniform(const imImage* src_image, imImage* dst_image, int grays)
 {
   int i;
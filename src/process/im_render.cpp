@@ -13,6 +13,7 @@
 
 #include "im_process_counter.h"
 #include "im_process_pnt.h"
+#include "im_process_atomic.h"
 
 #include <stdlib.h>
 #include <memory.h>
@@ -181,177 +182,484 @@ int imProcessRenderOp(imImage* image, imRenderFunc render_func, const char* rend
   return ret;
 }
 
-static void rand_seed(void)
+/* The internal render functions use kernels instead of imRenderFunc.
+   A kernel is a functor inlined in the loop, so there is no function call for each pixel,
+   and any value that depends only on x or only on y is computed once in a table. */
+
+template <class T, class K> 
+static int DoRenderKernel(T *map, int width, int height, int d, K& kernel, int counter, int plus)
 {
-  static int first = 1;
-  if (first)
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
+#endif
+  for(int y = 0; y < height; y++)
   {
-    srand((unsigned)time(NULL));
-    first = 0;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    T* line = map + (size_t)y * width;
+
+    if (plus)
+    {
+      for(int x = 0; x < width; x++)
+      {
+        double value = (double)line[x] + kernel(x, y, d);
+        if (sizeof(T) == sizeof(imbyte))
+          line[x] = (T)IM_BYTECROP(value);
+        else
+          line[x] = (T)value;
+      }
+    }
+    else
+    {
+      for(int x = 0; x < width; x++)
+        line[x] = (T)kernel(x, y, d);
+    }
+  
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
   }
+
+  return processing;
 }
 
-static double do_add_specklenoise(int, int, int, int *cond, double* param)
+template <class K> 
+static int iRenderKernel(imImage* image, K& kernel, const char* render_name, int plus)
 {
-  double rnd = double(rand()) / RAND_MAX;
-  if (rnd < param[1])
+  int ret = 0;
+
+  int counter = imProcessCounterBegin(render_name);
+  imCounterTotal(counter, image->depth*image->height, "Rendering...");
+
+  for (int d = 0; d < image->depth; d++)
   {
-    *cond = 1;
-    return (rand() * param[0]) / RAND_MAX;
+    switch(image->data_type)
+    {
+    case IM_BYTE:
+      ret = DoRenderKernel((imbyte*)image->data[d], image->width, image->height, d, kernel, counter, plus);
+      break;                                                                                
+    case IM_SHORT:                                                                           
+      ret = DoRenderKernel((short*)image->data[d], image->width, image->height, d, kernel, counter, plus);
+      break;                                                                                
+    case IM_USHORT:                                                                           
+      ret = DoRenderKernel((imushort*)image->data[d], image->width, image->height, d, kernel, counter, plus);
+      break;                                                                                
+    case IM_INT:                                                                           
+      ret = DoRenderKernel((int*)image->data[d], image->width, image->height, d, kernel, counter, plus);
+      break;                                                                                
+    case IM_FLOAT:                                                                           
+      ret = DoRenderKernel((float*)image->data[d], image->width, image->height, d, kernel, counter, plus);
+      break;                                                                                
+    case IM_DOUBLE:
+      ret = DoRenderKernel((double*)image->data[d], image->width, image->height, d, kernel, counter, plus);
+      break;
+    }
+
+    if (!ret) 
+      break;
   }
-  else
+
+  imProcessCounterEnd(counter);
+
+  return ret;
+}
+
+/* Conditional kernel, kernel(x, y, d, value) returns if the value must be rendered. */
+template <class T, class K> 
+static int DoRenderCondKernel(T *map, int width, int height, int d, K& kernel, int counter)
+{
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
+#endif
+  for(int y = 0; y < height; y++)
   {
-    *cond = 0;
-    return 0;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    T* line = map + (size_t)y * width;
+
+    for(int x = 0; x < width; x++)
+    {
+      double value;
+      if (kernel(x, y, d, value)) 
+        line[x] = (T)value;
+    }
+  
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  return processing;
+}
+
+template <class K> 
+static int iRenderCondKernel(imImage* image, K& kernel, const char* render_name)
+{
+  int ret = 0;
+
+  int counter = imProcessCounterBegin(render_name);
+  imCounterTotal(counter, image->depth*image->height, "Rendering...");
+
+  for (int d = 0; d < image->depth; d++)
+  {
+    switch(image->data_type)
+    {
+    case IM_BYTE:
+      ret = DoRenderCondKernel((imbyte*)image->data[d], image->width, image->height, d, kernel, counter);
+      break;                                                                                
+    case IM_SHORT:                                                                           
+      ret = DoRenderCondKernel((short*)image->data[d], image->width, image->height, d, kernel, counter);
+      break;                                                                                
+    case IM_USHORT:                                                                           
+      ret = DoRenderCondKernel((imushort*)image->data[d], image->width, image->height, d, kernel, counter);
+      break;                                                                                
+    case IM_INT:                                                                           
+      ret = DoRenderCondKernel((int*)image->data[d], image->width, image->height, d, kernel, counter);
+      break;                                                                                
+    case IM_FLOAT:                                                                           
+      ret = DoRenderCondKernel((float*)image->data[d], image->width, image->height, d, kernel, counter);
+      break;                                                                                
+    case IM_DOUBLE:
+      ret = DoRenderCondKernel((double*)image->data[d], image->width, image->height, d, kernel, counter);
+      break;
+    }
+
+    if (!ret) 
+      break;
   }
+
+  imProcessCounterEnd(counter);
+
+  return ret;
+}
+
+
+/*******************************************************************************************************/
+
+
+/* Counter based random numbers.
+   Each pixel starts its own generator from a hash of the stream key and the pixel index,
+   so the result depends only on the seed and not on the order the pixels are processed,
+   and it is the same for any number of threads.
+   Each render call uses a new stream key, derived from the seed and a call counter. */
+
+/* seed in the high 32 bits and call counter in the low 32 bits,
+   incremented atomically so renders in several threads always get different streams */
+static volatile long long iRandomState = 0;
+static volatile int iRandomSeedSet = 0;
+
+/* SplitMix64 */
+static inline unsigned long long iRandomHash(unsigned long long z)
+{
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
 }
 
+#define IM_RANDOM_GOLDEN 0x9E3779B97F4A7C15ULL
+
+void imProcessRenderRandomSeed(unsigned int seed)
+{
+  long long state = (long long)((unsigned long long)seed << 32);
+
+  imAtomicStore64(&iRandomState, state);
+
+  iRandomSeedSet = 1;
+}
+
+static unsigned long long iRandomStreamKey(void)
+{
+  if (!iRandomSeedSet)
+  {
+    /* seed from the current time, only if no render used the state yet */
+    long long time_state = (long long)((unsigned long long)(unsigned int)time(NULL) << 32);
+
+    imAtomicCompareSwap64(&iRandomState, 0, time_state);
+
+    iRandomSeedSet = 1;
+  }
+
+  long long state = imAtomicExchangeAdd64(&iRandomState, 1);
+
+  return iRandomHash((unsigned long long)state + IM_RANDOM_GOLDEN);
+}
+
+struct iRandomGenerator
+{
+  unsigned long long state;
+
+  inline iRandomGenerator(unsigned long long key, size_t index) 
+  { 
+    state = iRandomHash(key + (unsigned long long)index * IM_RANDOM_GOLDEN); 
+  }
+
+  inline unsigned long long Next()
+  {
+    state += IM_RANDOM_GOLDEN;
+    return iRandomHash(state);
+  }
+
+  /* [0,1] */
+  inline double Uniform()
+  {
+    return (double)(Next() >> 11) * (1.0 / 9007199254740991.0);  /* 2^53 - 1 */
+  }
+};
+
+/* base class for the noise kernels, each plane uses a different part of the stream */
+struct iRenderNoise
+{
+  unsigned long long key;
+  size_t width, plane_size;
+
+  inline iRenderNoise(const imImage* image)
+  {
+    key = iRandomStreamKey();
+    width = image->width;
+    plane_size = (size_t)image->width * image->height;
+  }
+
+  inline size_t Index(int x, int y, int d) const { return d * plane_size + y * width + x; }
+};
+
+struct iRenderSpeckleNoise: public iRenderNoise
+{
+  double max, percent;
+
+  inline iRenderSpeckleNoise(const imImage* image, double _max, double _percent)
+    : iRenderNoise(image), max(_max), percent(_percent) {}
+
+  inline int operator()(int x, int y, int d, double& value) const
+  {
+    iRandomGenerator rnd(key, Index(x, y, d));
+    if (rnd.Uniform() < percent)
+    {
+      value = rnd.Uniform() * max;
+      return 1;
+    }
+    else
+      return 0;
+  }
+};
+
 int imProcessRenderAddSpeckleNoise(const imImage* src_image, imImage* dst_image, double percent)
 {
-  double param[2];
-  param[0] = (double)imColorMax(src_image->data_type);
-  param[1] = percent / 100.0;
-  rand_seed();
   imImageCopyData(src_image, dst_image);
-  return imProcessRenderCondOp(dst_image, do_add_specklenoise, "RenderAddSpeckleNoise", param);
+  iRenderSpeckleNoise kernel(dst_image, (double)imColorMax(src_image->data_type), percent / 100.0);
+  return iRenderCondKernel(dst_image, kernel, "RenderAddSpeckleNoise");
 }
 
-static double do_add_gaussiannoise(int, int, int, double* param)
+struct iRenderGaussianNoise: public iRenderNoise
 {
-  double rnd, x1, x2;
-    
-  do
+  double mean, stddev;
+
+  inline iRenderGaussianNoise(const imImage* image, double _mean, double _stddev)
+    : iRenderNoise(image), mean(_mean), stddev(_stddev) {}
+
+  inline double operator()(int x, int y, int d) const
   {
-    x1 = double(rand()) / RAND_MAX;  /* [0,1]  */
-    x2 = double(rand()) / RAND_MAX;  /* [0,1]  */
-    x1 = 2*x1 - 1;                   /* [-1,1] */
-    x2 = 2*x2 - 1;                   /* [-1,1] */
-    rnd = x1*x1 + x2*x2;
-  } while( rnd >= 1 || rnd == 0);
+    iRandomGenerator rnd(key, Index(x, y, d));
+    double rnd2, x1, x2;
 
-  rnd = (double)sqrt(-2 * log(rnd) / rnd) * x1;
-  return rnd * param[1] + param[0];
-}
+    /* Marsaglia polar method */
+    do
+    {
+      x1 = 2*rnd.Uniform() - 1;   /* [-1,1] */
+      x2 = 2*rnd.Uniform() - 1;   /* [-1,1] */
+      rnd2 = x1*x1 + x2*x2;
+    } while( rnd2 >= 1 || rnd2 == 0);
+
+    rnd2 = sqrt(-2 * log(rnd2) / rnd2) * x1;
+    return rnd2 * stddev + mean;
+  }
+};
 
 int imProcessRenderAddGaussianNoise(const imImage* src_image, imImage* dst_image, double mean, double stddev)
 {
-  double param[2];
-  param[0] = mean;
-  param[1] = stddev;
-  rand_seed();
   imImageCopyData(src_image, dst_image);
-  return imProcessRenderOp(dst_image, do_add_gaussiannoise, "RenderAddGaussianNoise", param, 1);
+  iRenderGaussianNoise kernel(dst_image, mean, stddev);
+  return iRenderKernel(dst_image, kernel, "RenderAddGaussianNoise", 1);
 }
    
-static double do_add_uniformnoise(int, int, int, double* param)
+struct iRenderUniformNoise: public iRenderNoise
 {
-  double rnd = double(rand()) / RAND_MAX;
-  rnd = 2*rnd - 1;                          /* [-1,1] */
-  return 1.7320508 * rnd * param[1] + param[0];
-}
+  double mean, range;
+
+  inline iRenderUniformNoise(const imImage* image, double _mean, double _range)
+    : iRenderNoise(image), mean(_mean), range(_range) {}
+
+  inline double operator()(int x, int y, int d) const
+  {
+    iRandomGenerator rnd(key, Index(x, y, d));
+    return (2*rnd.Uniform() - 1) * range + mean;   /* [-1,1] */
+  }
+};
 
 int imProcessRenderAddUniformNoise(const imImage* src_image, imImage* dst_image, double mean, double stddev)
 {
-  double param[2];
-  param[0] = mean;
-  param[1] = stddev;
-  rand_seed();
   imImageCopyData(src_image, dst_image);
-  return imProcessRenderOp(dst_image, do_add_uniformnoise, "RenderAddUniformNoise", param, 1);
+  iRenderUniformNoise kernel(dst_image, mean, 1.7320508 * stddev);  /* sqrt(3) */
+  return iRenderKernel(dst_image, kernel, "RenderAddUniformNoise", 1);
 }
-   
-static double do_const(int, int, int d, double* param)
+
+struct iRenderRandomNoise: public iRenderNoise
 {
-  return param[d];
-}
+  double max;
 
-int imProcessRenderConstant(imImage* image, double* value)
+  inline iRenderRandomNoise(const imImage* image, double _max)
+    : iRenderNoise(image), max(_max) {}
+
+  inline double operator()(int x, int y, int d) const
+  {
+    iRandomGenerator rnd(key, Index(x, y, d));
+    return rnd.Uniform() * max;
+  }
+};
+
+int imProcessRenderRandomNoise(imImage* image)
 {
-  return imProcessRenderOp(image, do_const, "RenderConstant", value, 0);
+  iRenderRandomNoise kernel(image, (double)imColorMax(image->data_type));
+  return iRenderKernel(image, kernel, "RenderRandomNoise", 0);
 }
+   
+
+/*******************************************************************************************************/
+
 
-static double do_noise(int, int, int, double* param)
+struct iRenderConstant
 {
-  return (rand() * param[0]) / RAND_MAX;
-}
+  const double* value;
+  inline double operator()(int, int, int d) const { return value[d]; }
+};
 
-int imProcessRenderRandomNoise(imImage* image)
+int imProcessRenderConstant(imImage* image, double* value)
 {
-  static double param[1];
-  param[0] = (double)imColorMax(image->data_type);
-  rand_seed();
-  return imProcessRenderOp(image, do_noise, "RenderRandomNoise", param, 0);
+  iRenderConstant kernel;
+  kernel.value = value;
+  return iRenderKernel(image, kernel, "RenderConstant", 0);
 }
 
-static double do_cosine(int x, int y, int, double* param)
+/* Separable kernels, value = (xtab[x]*ytab[y] + offset)*scale,
+   or (xtab[x]*ytab[y])*(r2 - offset)*scale for the Laplacian of Gaussian. */
+struct iRenderSeparable
 {
-  return (cos(param[1]*(x-param[3])) * cos(param[2]*(y-param[4])) + param[5]) * param[0];
-}
+  double* xtab;
+  double* ytab;
+  double scale, offset;
+
+  inline iRenderSeparable(int width, int height)
+  {
+    xtab = (double*)malloc((width + height) * sizeof(double));
+    ytab = xtab? xtab + width: NULL;
+  }
+
+  inline ~iRenderSeparable()
+  {
+    free(xtab);
+  }
+
+  inline double operator()(int x, int y, int) const
+  {
+    return (xtab[x] * ytab[y] + offset) * scale;
+  }
+};
 
 int imProcessRenderCosine(imImage* image, double xperiod, double yperiod)
 {
-  double param[6];
-  param[0] = (double)imColorMax(image->data_type);
+  double scale = (double)imColorMax(image->data_type);
+  double xfreq = 0, yfreq = 0;
+  double xc = image->width/2.0;
+  double yc = image->height/2.0;
 
-  if (xperiod == 0.0) param[1] = 0.0;
-  else param[1] = 2.0 * M_PI / xperiod;
+  if (xperiod != 0.0) xfreq = 2.0 * M_PI / xperiod;
+  if (yperiod != 0.0) yfreq = 2.0 * M_PI / yperiod;
 
-  if (yperiod == 0.0) param[2] = 0.0;
-  else param[2] = 2.0 * M_PI / yperiod;
+  iRenderSeparable kernel(image->width, image->height);
+  if (!kernel.xtab)
+    return 0;
 
-  param[3] = image->width/2.0;
-  param[4] = image->height/2.0;
+  for (int x = 0; x < image->width; x++)
+    kernel.xtab[x] = cos(xfreq*(x - xc));
+  for (int y = 0; y < image->height; y++)
+    kernel.ytab[y] = cos(yfreq*(y - yc));
 
   if (image->data_type < IM_FLOAT)
-    param[0] = param[0] / 2.0;
-
-  if (image->data_type == IM_BYTE)
-    param[5] = 1.0;
-  else
-    param[5] = 0.0;
+    scale = scale / 2.0;
 
-  return imProcessRenderOp(image, do_cosine, "RenderCosine", param, 0);
-}
+  kernel.scale = scale;
+  kernel.offset = (image->data_type == IM_BYTE)? 1.0: 0.0;
 
-static double do_gaussian(int x, int y, int, double* param)
-{
-  int xd = x - (int)param[2];
-  int yd = y - (int)param[3];
-  xd *= xd;
-  yd *= yd;
-  return double(exp((xd + yd)*param[1])*param[0]);
+  return iRenderKernel(image, kernel, "RenderCosine", 0);
 }
 
 int imProcessRenderGaussian(imImage* image, double stddev)
 {
-  double param[4];
-  param[0] = (double)imColorMax(image->data_type);
-  param[1] = -1.0 / (2.0 * stddev * stddev);
-  param[2] = image->width/2.0;
-  param[3] = image->height/2.0;
-  return imProcessRenderOp(image, do_gaussian, "RenderGaussian", param, 0);
+  double factor = -1.0 / (2.0 * stddev * stddev);
+  int xc = (int)(image->width/2.0);
+  int yc = (int)(image->height/2.0);
+
+  /* exp((xd^2 + yd^2)*f) = exp(xd^2*f)*exp(yd^2*f) */
+  iRenderSeparable kernel(image->width, image->height);
+  if (!kernel.xtab)
+    return 0;
+
+  for (int x = 0; x < image->width; x++)
+    kernel.xtab[x] = exp((x - xc)*(x - xc)*factor);
+  for (int y = 0; y < image->height; y++)
+    kernel.ytab[y] = exp((y - yc)*(y - yc)*factor);
+
+  kernel.scale = (double)imColorMax(image->data_type);
+  kernel.offset = 0;
+
+  return iRenderKernel(image, kernel, "RenderGaussian", 0);
 }
 
-static double do_lapgauss(int x, int y, int, double* param)
+struct iRenderLapOfGaussian: public iRenderSeparable
 {
-  int xd = x - (int)param[2];
-  int yd = y - (int)param[3];
-  xd *= xd;
-  yd *= yd;
-  xd += yd;
-  return (xd - param[4])*exp(xd*param[1])*param[0];
-}
+  int xc, yc;
+
+  inline iRenderLapOfGaussian(int width, int height)
+    : iRenderSeparable(width, height), xc((int)(width/2.0)), yc((int)(height/2.0)) {}
+
+  inline double operator()(int x, int y, int) const
+  {
+    int xd = x - xc;
+    int yd = y - yc;
+    return ((xd*xd + yd*yd) - offset) * (xtab[x] * ytab[y]) * scale;
+  }
+};
 
 int imProcessRenderLapOfGaussian(imImage* image, double stddev)
 {
-  double param[5];
-  param[0] = (double)imColorMax(image->data_type);
-  param[1] = -1.0 / (2.0 * stddev * stddev);
-  param[2] = image->width/2.0;
-  param[3] = image->height/2.0;
-  param[4] = 2.0 * stddev * stddev;
-  param[0] /= param[4];
-  return imProcessRenderOp(image, do_lapgauss, "RenderLapOfGaussian", param, 0);
+  double factor = -1.0 / (2.0 * stddev * stddev);
+
+  iRenderLapOfGaussian kernel(image->width, image->height);
+  if (!kernel.xtab)
+    return 0;
+
+  for (int x = 0; x < image->width; x++)
+    kernel.xtab[x] = exp((x - kernel.xc)*(x - kernel.xc)*factor);
+  for (int y = 0; y < image->height; y++)
+    kernel.ytab[y] = exp((y - kernel.yc)*(y - kernel.yc)*factor);
+
+  kernel.offset = 2.0 * stddev * stddev;
+  kernel.scale = (double)imColorMax(image->data_type) / kernel.offset;
+
+  return iRenderKernel(image, kernel, "RenderLapOfGaussian", 0);
 }
 
 static inline double sinc(double x)
@@ -362,89 +670,96 @@ static inline double sinc(double x)
     return sin(x)/x;
 }
 
-static double do_sinc(int x, int y, int, double* param)
-{
-  return (sinc((x - param[3])*param[1])*sinc((y - param[4])*param[2]) + param[5])*param[0];
-}
-
 int imProcessRenderSinc(imImage* image, double xperiod, double yperiod)
 {
-  double param[6];
-  param[0] = (double)imColorMax(image->data_type);
+  double scale = (double)imColorMax(image->data_type);
+  double xfreq = 0, yfreq = 0;
+  double xc = image->width/2.0;
+  double yc = image->height/2.0;
 
-  if (xperiod == 0.0) param[1] = 0.0;
-  else param[1] = 2.0 * M_PI / xperiod;
+  if (xperiod != 0.0) xfreq = 2.0 * M_PI / xperiod;
+  if (yperiod != 0.0) yfreq = 2.0 * M_PI / yperiod;
 
-  if (yperiod == 0.0) param[2] = 0.0;
-  else param[2] = 2.0 * M_PI / yperiod;
+  iRenderSeparable kernel(image->width, image->height);
+  if (!kernel.xtab)
+    return 0;
 
-  param[3] = image->width/2.0;
-  param[4] = image->height/2.0;
+  for (int x = 0; x < image->width; x++)
+    kernel.xtab[x] = sinc((x - xc)*xfreq);
+  for (int y = 0; y < image->height; y++)
+    kernel.ytab[y] = sinc((y - yc)*yfreq);
 
   if (image->data_type < IM_FLOAT)
-    param[0] = param[0] / 1.3;
+    scale = scale / 1.3;
 
-  if (image->data_type == IM_BYTE)
-    param[5] = 0.3;
-  else
-    param[5] = 0.0;
+  kernel.scale = scale;
+  kernel.offset = (image->data_type == IM_BYTE)? 0.3: 0.0;
 
-  return imProcessRenderOp(image, do_sinc, "RenderSinc", param, 0);
+  return iRenderKernel(image, kernel, "RenderSinc", 0);
 }
 
-static double do_box(int x, int y, int, double* param)
+/* base class for the kernels centered in the image */
+struct iRenderCentered
 {
-  int xr = x - (int)param[3];
-  int yr = y - (int)param[4];
-  if (xr < -(int)param[1] || xr > (int)param[1] ||
-      yr < -(int)param[2] || yr > (int)param[2])
-    return 0;
-  else
-    return param[0];
-}
+  double value;
+  int xc, yc;
+
+  inline iRenderCentered(const imImage* image)
+  {
+    value = (double)imColorMax(image->data_type);
+    xc = (int)(image->width/2.0);
+    yc = (int)(image->height/2.0);
+  }
+};
+
+struct iRenderBox: public iRenderCentered
+{
+  int half_width, half_height;
+
+  inline iRenderBox(const imImage* image, int width, int height)
+    : iRenderCentered(image), half_width((int)(width/2.0)), half_height((int)(height/2.0)) {}
+
+  inline double operator()(int x, int y, int) const
+  {
+    int xr = x - xc;
+    int yr = y - yc;
+    if (xr < -half_width || xr > half_width ||
+        yr < -half_height || yr > half_height)
+      return 0;
+    else
+      return value;
+  }
+};
 
 int imProcessRenderBox(imImage* image, int width, int height)
 {
-  double param[5];
-  param[0] = (double)imColorMax(image->data_type);
-  param[1] = width/2.0;
-  param[2] = height/2.0;
-  param[3] = image->width/2.0;
-  param[4] = image->height/2.0;
-  return imProcessRenderOp(image, do_box, "RenderBox", param, 0);
+  iRenderBox kernel(image, width, height);
+  return iRenderKernel(image, kernel, "RenderBox", 0);
 }
 
-static double do_ramp(int x, int y, int, double* param)
+struct iRenderRamp
 {
-  if (param[3])
-  {
-    if (y < param[1])
-      return 0;
-    if (y > param[2])
-      return 0;
+  double factor, start, end;
+  int dir;
 
-    return (y-param[1])*param[0];
-  }
-  else
+  inline double operator()(int x, int y, int) const
   {
-    if (x < param[1])
-      return 0;
-    if (x > param[2])
+    double t = dir? (double)y: (double)x;
+    if (t < start || t > end)
       return 0;
 
-    return (x-param[1])*param[0];
+    return (t - start)*factor;
   }
-}
+};
 
 int imProcessRenderRamp(imImage* image, int start, int end, int dir)
 {
-  double param[4];
-  param[0] = (double)imColorMax(image->data_type);
-  param[1] = (double)start;
-  param[2] = (double)end;
-  param[3] = (double)dir;
-  param[0] /= double(end-start);
-  return imProcessRenderOp(image, do_ramp, "RenderRamp", param, 0);
+  iRenderRamp kernel;
+  kernel.factor = (double)imColorMax(image->data_type) / double(end-start);
+  kernel.start = (double)start;
+  kernel.end = (double)end;
+  kernel.dir = dir;
+  return iRenderKernel(image, kernel, "RenderRamp", 0);
 }
 
 static inline int Tent(int t, int T)
@@ -455,138 +770,155 @@ static inline int Tent(int t, int T)
     return (T - t);
 }
 
-static double do_tent(int x, int y, int, double* param)
+struct iRenderTent: public iRenderBox
 {
-  int xr = x - (int)param[3];
-  int yr = y - (int)param[4];
-  if (xr < -(int)param[1] || xr > (int)param[1] ||
-      yr < -(int)param[2] || yr > (int)param[2])
-    return 0;
-  else
-    return Tent(xr, (int)param[1]) * Tent(yr, (int)param[2]) * param[0];
-}
+  inline iRenderTent(const imImage* image, int width, int height)
+    : iRenderBox(image, width, height) 
+  {
+    value /= (width/2.0)*(height/2.0);
+  }
+
+  inline double operator()(int x, int y, int) const
+  {
+    int xr = x - xc;
+    int yr = y - yc;
+    if (xr < -half_width || xr > half_width ||
+        yr < -half_height || yr > half_height)
+      return 0;
+    else
+      return Tent(xr, half_width) * Tent(yr, half_height) * value;
+  }
+};
 
 int imProcessRenderTent(imImage* image, int width, int height)
 {
-  double param[5];
-  param[0] = (double)imColorMax(image->data_type);
-  param[1] = width/2.0;
-  param[2] = height/2.0;
-  param[0] /= param[1]*param[2];
-  param[3] = image->width/2.0;
-  param[4] = image->height/2.0;
-  return imProcessRenderOp(image, do_tent, "RenderTent", param, 0);
+  iRenderTent kernel(image, width, height);
+  return iRenderKernel(image, kernel, "RenderTent", 0);
 }
 
-static double do_cone(int x, int y, int, double* param)
+struct iRenderCone: public iRenderCentered
 {
-  int xr = x - (int)param[2];
-  int yr = y - (int)param[3];
-  int radius = imRound(sqrt((double)(xr*xr + yr*yr)));
-  if (radius > (int)param[1])
-    return 0;
-  else
-    return ((int)param[1] - radius)*param[0];
-}
+  int radius;
+
+  inline iRenderCone(const imImage* image, int _radius)
+    : iRenderCentered(image), radius(_radius) 
+  {
+    value /= (double)radius;
+  }
+
+  inline double operator()(int x, int y, int) const
+  {
+    int xr = x - xc;
+    int yr = y - yc;
+    int r = imRound(sqrt((double)(xr*xr + yr*yr)));
+    if (r > radius)
+      return 0;
+    else
+      return (radius - r)*value;
+  }
+};
 
 int imProcessRenderCone(imImage* image, int radius)
 {
-  double param[4];
-  param[0] = (double)imColorMax(image->data_type);
-  param[1] = (double)radius;
-  param[0] /= param[1];
-  param[2] = image->width/2.0;
-  param[3] = image->height/2.0;
-  return imProcessRenderOp(image, do_cone, "RenderCone", param, 0);
+  iRenderCone kernel(image, radius);
+  return iRenderKernel(image, kernel, "RenderCone", 0);
 }
 
-static double do_wheel(int x, int y, int, double* param)
+struct iRenderWheel: public iRenderCentered
 {
-  int xr = x - (int)param[3];
-  int yr = y - (int)param[4];
-  int radius = imRound(sqrt((double)(xr*xr + yr*yr)));
-  if (radius < (int)param[1] || radius > (int)param[2])
-    return 0;
-  else
-    return param[0];
-}
+  int int_radius, ext_radius;
+
+  inline iRenderWheel(const imImage* image, int _int_radius, int _ext_radius)
+    : iRenderCentered(image), int_radius(_int_radius), ext_radius(_ext_radius) {}
+
+  inline double operator()(int x, int y, int) const
+  {
+    int xr = x - xc;
+    int yr = y - yc;
+    int r = imRound(sqrt((double)(xr*xr + yr*yr)));
+    if (r < int_radius || r > ext_radius)
+      return 0;
+    else
+      return value;
+  }
+};
 
 int imProcessRenderWheel(imImage* image, int int_radius, int ext_radius)
 {
-  double param[5];
-  param[0] = (double)imColorMax(image->data_type);
-  param[1] = (double)int_radius;
-  param[2] = (double)ext_radius;
-  param[3] = image->width/2.0;
-  param[4] = image->height/2.0;
-  return imProcessRenderOp(image, do_wheel, "RenderWheel", param, 0);
+  iRenderWheel kernel(image, int_radius, ext_radius);
+  return iRenderKernel(image, kernel, "RenderWheel", 0);
 }
 
-static double do_grid(int x, int y, int, double* param)
+struct iRenderGrid: public iRenderCentered
 {
-  int xr = x - (int)param[3];
-  int yr = y - (int)param[4];
-  if (xr % (int)param[1] == 0 && yr % (int)param[2] == 0)
-    return param[0];
-  else
-    return 0;
-}
+  int x_space, y_space;
+
+  inline iRenderGrid(const imImage* image, int _x_space, int _y_space)
+    : iRenderCentered(image), x_space(_x_space), y_space(_y_space) {}
+
+  inline double operator()(int x, int y, int) const
+  {
+    if ((x - xc) % x_space == 0 && (y - yc) % y_space == 0)
+      return value;
+    else
+      return 0;
+  }
+};
 
 int imProcessRenderGrid(imImage* image, int x_space, int y_space)
 {
-  double param[5];
-  param[0] = (double)imColorMax(image->data_type);
-  param[1] = (double)x_space;
-  param[2] = (double)y_space;
-  param[3] = image->width/2.0;
-  param[4] = image->height/2.0;
-  return imProcessRenderOp(image, do_grid, "RenderGrid", param, 0);
-}
-
-static double do_chessboard(int x, int y, int, double* param)
-{
-  int xr = x - (int)param[3];
-  int yr = y - (int)param[4];
-  int xp = xr % (int)param[1];
-  int yp = yr % (int)param[2];
-  int xc = (int)param[1]/2;
-  int yc = (int)param[2]/2;
-  if (xr < 0) xc = -xc;
-  if (yr < 0) yc = -yc;
-  if ((xp < xc && yp < yc) ||
-      (xp > xc && yp > yc))
-    return param[0];
-  else
-    return 0;
+  iRenderGrid kernel(image, x_space, y_space);
+  return iRenderKernel(image, kernel, "RenderGrid", 0);
 }
 
+struct iRenderChessboard: public iRenderGrid
+{
+  inline iRenderChessboard(const imImage* image, int _x_space, int _y_space)
+    : iRenderGrid(image, _x_space*2, _y_space*2) {}
+
+  inline double operator()(int x, int y, int) const
+  {
+    int xr = x - xc;
+    int yr = y - yc;
+    int xp = xr % x_space;
+    int yp = yr % y_space;
+    int xh = x_space/2;
+    int yh = y_space/2;
+    if (xr < 0) xh = -xh;
+    if (yr < 0) yh = -yh;
+    if ((xp < xh && yp < yh) ||
+        (xp > xh && yp > yh))
+      return value;
+    else
+      return 0;
+  }
+};
+
 int imProcessRenderChessboard(imImage* image, int x_space, int y_space)
 {
-  double param[5];
-  param[0] = (double)imColorMax(image->data_type);
-  param[1] = (double)x_space*2;
-  param[2] = (double)y_space*2;
-  param[3] = image->width/2.0;
-  param[4] = image->height/2.0;
-  return imProcessRenderOp(image, do_chessboard, "RenderChessboard", param, 0);
+  iRenderChessboard kernel(image, x_space, y_space);
+  return iRenderKernel(image, kernel, "RenderChessboard", 0);
 }
 
 
 /*******************************************************************************************************/
 
 
+/* Stack of seeds for the scanline flood fill, one seed for each run of pixels in a neighbor line. 
+   Starts with a capacity proportional to the image perimeter, usually enough for the whole fill, 
+   and grows geometrically. The same stack is reused for all the seeds of a batch. */
 struct xyStackArray
 {
   int* xy_data;
   int max_count, count;
 };
 
-static inline xyStackArray* xyStackArrayCreate()
+static inline xyStackArray* xyStackArrayCreate(int width, int height)
 {
   xyStackArray* stack = new xyStackArray;
 
   stack->count = 0;
-  stack->max_count = 1000;  /* 500 points */
+  stack->max_count = 4 * (width + height);  /* 2*(w+h) points */
   stack->xy_data = (int*)malloc(stack->max_count * sizeof(int));
 
   return stack;
@@ -603,17 +935,22 @@ static inline int xyStackArrayHasData(xyStackArray* stack)
   return stack->count;
 }
 
-static inline void xyStackArrayPush(xyStackArray* stack, int x, int y)
+static inline int xyStackArrayPush(xyStackArray* stack, int x, int y)
 {
   if (stack->count + 2 > stack->max_count)
   {
-    stack->max_count += 1000;  /* +500 points */
-    stack->xy_data = (int*)realloc(stack->xy_data, stack->max_count * sizeof(int));
+    int* xy_data = (int*)realloc(stack->xy_data, 2 * stack->max_count * sizeof(int));
+    if (!xy_data)
+      return 0;
+
+    stack->xy_data = xy_data;
+    stack->max_count *= 2;
   }
 
   stack->xy_data[stack->count+0] = x;
   stack->xy_data[stack->count+1] = y;
   stack->count += 2;
+  return 1;
 }
 
 static inline void xyStackArrayPop(xyStackArray* stack, int &x, int &y)
@@ -623,214 +960,310 @@ static inline void xyStackArrayPop(xyStackArray* stack, int &x, int &y)
   y = stack->xy_data[stack->count + 1];
 }
 
+/* Pixel access for the flood fill.
+   Inside(offset) returns if the pixel must be filled: not the replace color and similar to the target. 
+   Similar means a distance less than tolerance. */
 template <class T>
-static inline int color_is_similar(const T* target_color, const T& r, const T& g, const T& b, const T& tol)
+struct iFloodFillGray
 {
-  T sqr_dist = (T)sqrt_op((target_color[0] - r)*(target_color[0] - r) + (target_color[1] - g)*(target_color[1] - g) + (target_color[2] - b)*(target_color[2] - b));
-  if (sqr_dist < tol)
-    return 1;
-  else
-    return 0;
-}
+  T* map;
+  T replace, target;
+  double tol;
 
-template <class T>
-static inline int gray_is_similar(const T& target, const T& map, const T& tol)
-{
-  T dist = (T)abs_op(target - map);
-  if (dist < tol)
-    return 1;
-  else
-    return 0;
-}
+  inline void Init(size_t offset) { target = map[offset]; }
+  inline int IsReplace(size_t offset) const { return map[offset] == replace; }
+  inline void Fill(size_t offset) { map[offset] = replace; }
 
-template <class T>
-static inline int color_equal(const T* color, const T& r, const T& g, const T& b)
-{
-  if (color[0] == r && color[1] == g && color[2] == b)
-    return 1;
-  else
-    return 0;
-}
+  inline int Inside(size_t offset) const
+  {
+    T v = map[offset];
+    if (v == replace)
+      return 0;
+    double dist = (double)v - (double)target;
+    return dist < tol && -dist < tol;
+  }
+};
 
 template <class T>
-static inline void color_init(T* color, const T& r, const T& g, const T& b)
+struct iFloodFillRGB
 {
-  color[0] = r;
-  color[1] = g;
-  color[2] = b;
-}
+  T *r, *g, *b;
+  T replace[3], target[3];
+  double tol2;
 
-template <class T>
-static inline void color_copy(const T* color, T& r, T& g, T& b)
-{
-  r = color[0];
-  g = color[1];
-  b = color[2];
-}
+  inline void Init(size_t offset) { target[0] = r[offset]; target[1] = g[offset]; target[2] = b[offset]; }
+  inline int IsReplace(size_t offset) const { return r[offset] == replace[0] && g[offset] == replace[1] && b[offset] == replace[2]; }
+  inline void Fill(size_t offset) { r[offset] = replace[0]; g[offset] = replace[1]; b[offset] = replace[2]; }
 
-template <class T>
-static inline void fill_color(xyStackArray* stack, const T* replace_color, const T* target_color, T* r, T* g, T* b, int width, int x, int y, T tol)
-{
-  int offset = y * width + x;
-  if (!color_equal(replace_color, r[offset], g[offset], b[offset]) && color_is_similar(target_color, r[offset], g[offset], b[offset], tol))
+  inline int Inside(size_t offset) const
   {
-    xyStackArrayPush(stack, x, y);
-    color_copy(replace_color, r[offset], g[offset], b[offset]);
+    if (IsReplace(offset))
+      return 0;
+    double d0 = (double)r[offset] - (double)target[0];
+    double d1 = (double)g[offset] - (double)target[1];
+    double d2 = (double)b[offset] - (double)target[2];
+    return d0*d0 + d1*d1 + d2*d2 < tol2;
   }
-}
+};
 
+/* CIE L*a*b* with L from 0 to 100, the distance is the CIE76 delta E.
+   imColorXYZ2Lab returns L in [0,1], and a and b divided by 200.
+   linear is a table with the linear value of each integer value. */
 template <class T>
-static inline void fill_gray(xyStackArray* stack, const T replace, const T target, T* map, int width, int x, int y, T tol)
+static inline void iFloodFillLab(T r, T g, T b, const double* linear, double* lab)
 {
-  int offset = y * width + x;
-  if (replace != map[offset] && gray_is_similar(target, map[offset], tol))
-  {
-    xyStackArrayPush(stack, x, y);
-    map[offset] = replace;
-  }
+  double c0 = linear[(size_t)r];
+  double c1 = linear[(size_t)g];
+  double c2 = linear[(size_t)b];
+
+  imColorRGB2XYZ(c0, c1, c2, c0, c1, c2);
+  imColorXYZ2Lab(c0, c1, c2, c0, c1, c2);
+
+  lab[0] = 100 * c0;
+  lab[1] = 200 * c1;
+  lab[2] = 200 * c2;
 }
 
 template <class T>
-static void DoRenderFloodFillRGB(T** data, int width, int height, int start_x, int start_y, double* replace_data, double tolerance)
+struct iFloodFillRGBLab
 {
-  T *r = data[0], *g = data[1], *b = data[2];
-  int offset, x, y;
-  T target_color[3];
-  T replace_color[3];
-  T tol = (T)tolerance;
+  T *r, *g, *b;
+  T replace[3];
+  double target[3];
+  double tol2;
+  const double* linear;
 
-  replace_color[0] = (T)replace_data[0];
-  replace_color[1] = (T)replace_data[1];
-  replace_color[2] = (T)replace_data[2];
+  inline void Init(size_t offset) { iFloodFillLab(r[offset], g[offset], b[offset], linear, target); }
+  inline int IsReplace(size_t offset) const { return r[offset] == replace[0] && g[offset] == replace[1] && b[offset] == replace[2]; }
+  inline void Fill(size_t offset) { r[offset] = replace[0]; g[offset] = replace[1]; b[offset] = replace[2]; }
 
-  offset = start_y * width + start_x;
-  if (color_equal(replace_color, r[offset], g[offset], b[offset]))
-    return;
+  inline int Inside(size_t offset) const
+  {
+    if (IsReplace(offset))
+      return 0;
+    double lab[3];
+    iFloodFillLab(r[offset], g[offset], b[offset], linear, lab);
+    double d0 = lab[0] - target[0];
+    double d1 = lab[1] - target[1];
+    double d2 = lab[2] - target[2];
+    return d0*d0 + d1*d1 + d2*d2 < tol2;
+  }
+};
 
-  color_init(target_color, r[offset], g[offset], b[offset]);
+/* Fills the run of inside pixels that contains x, 
+   then pushes one seed for each run of inside pixels in the lines above and below. */
+template <class P>
+static int iFloodFillSpan(P& pixel, int width, int height, int x, int y, xyStackArray* stack, imFloodFillResult* result)
+{
+  size_t line = (size_t)y * width;
+  int xl = x, xr = x;
 
-  /* very simple 4 neighbors stack based flood fill */
+  while (xl > 0 && pixel.Inside(line + xl - 1))
+    xl--;
+  while (xr < width - 1 && pixel.Inside(line + xr + 1))
+    xr++;
 
-  xyStackArray* stack = xyStackArrayCreate();
+  for (int i = xl; i <= xr; i++)
+    pixel.Fill(line + i);
 
-  /* a color in the xy_stack is always similar to the target color,
-  and it was already replaced */
-  xyStackArrayPush(stack, start_x, start_y);
-  color_copy(replace_color, r[offset], g[offset], b[offset]);
+  result->area += xr - xl + 1;
+  if (xl < result->xmin) result->xmin = xl;
+  if (xr > result->xmax) result->xmax = xr;
+  if (y < result->ymin) result->ymin = y;
+  if (y > result->ymax) result->ymax = y;
 
-  while (xyStackArrayHasData(stack))
+  for (int ny = y - 1; ny <= y + 1; ny += 2)
   {
-    xyStackArrayPop(stack, x, y);
+    if (ny < 0 || ny >= height)
+      continue;
 
-    /* right */
-    if (x < width - 1)
-      fill_color(stack, replace_color, target_color, r, g, b, width, x + 1, y, tol);
+    size_t nline = (size_t)ny * width;
+    int in_run = 0;
 
-    /* left */
-    if (x > 0)
-      fill_color(stack, replace_color, target_color, r, g, b, width, x - 1, y, tol);
-
-    /* top */
-    if (y < height - 1)
-      fill_color(stack, replace_color, target_color, r, g, b, width, x, y + 1, tol);
-
-    /* bottom */
-    if (y > 0)
-      fill_color(stack, replace_color, target_color, r, g, b, width, x, y - 1, tol);
+    for (int i = xl; i <= xr; i++)
+    {
+      if (pixel.Inside(nline + i))
+      {
+        if (!in_run)
+        {
+          if (!xyStackArrayPush(stack, i, ny))
+            return 0;
+          in_run = 1;
+        }
+      }
+      else
+        in_run = 0;
+    }
   }
 
-  xyStackArrayDestroy(stack);
+  return 1;
 }
 
-template <class T>
-static void DoRenderFloodFillGray(T** data, int width, int height, int start_x, int start_y, double* replace_data, double tolerance)
+/* Scanline 4 neighbors flood fill. 
+   Fills the same pixels of a 4 neighbors pixel by pixel flood fill, 
+   but the stack stores only one seed for each run of pixels, 
+   and each pixel is tested a few times only. */
+template <class P>
+static int DoFloodFill(P& pixel, int width, int height, int start_x, int start_y, xyStackArray* stack, imFloodFillResult* result)
 {
-  T* map = data[0];
-  int offset, x, y;
-  T target;
-  T replace;
-  T tol = (T)tolerance;
+  result->area = 0;
+  result->xmin = width;
+  result->ymin = height;
+  result->xmax = -1;
+  result->ymax = -1;
 
-  replace = (T)replace_data[0];
+  if (start_x < 0 || start_x >= width || start_y < 0 || start_y >= height)
+    return 1;
+
+  size_t offset = (size_t)start_y * width + start_x;
+  if (pixel.IsReplace(offset))
+    return 1;
 
-  offset = start_y * width + start_x;
-  if (replace == map[offset])
-    return;
+  pixel.Init(offset);
 
-  target = map[offset];
+  /* the seed is always filled, even when tolerance is zero */
+  stack->count = 0;
+  int ret = iFloodFillSpan(pixel, width, height, start_x, start_y, stack, result);
 
-  /* very simple 4 neighbors stack based flood fill */
+  while (ret && xyStackArrayHasData(stack))
+  {
+    int x, y;
+    xyStackArrayPop(stack, x, y);
 
-  xyStackArray* stack = xyStackArrayCreate();
+    /* it may have been filled after it was pushed */
+    if (pixel.Inside((size_t)y * width + x))
+      ret = iFloodFillSpan(pixel, width, height, x, y, stack, result);
+  }
 
-  /* a color in the xy_stack is always similar to the target color,
-  and it was already replaced */
-  xyStackArrayPush(stack, start_x, start_y);
-  map[offset] = replace;
+  return ret;
+}
 
-  while (xyStackArrayHasData(stack))
+template <class P>
+static int DoFloodFillSeeds(P& pixel, int width, int height, int seed_count, const int* seed_x, const int* seed_y, imFloodFillResult* results)
+{
+  xyStackArray* stack = xyStackArrayCreate(width, height);
+  if (!stack->xy_data)
   {
-    xyStackArrayPop(stack, x, y);
+    xyStackArrayDestroy(stack);
+    return -1;
+  }
 
-    /* right */
-    if (x < width - 1)
-      fill_gray(stack, replace, target, map, width, x + 1, y, tol);
+  int total_area = 0;
 
-    /* left */
-    if (x > 0)
-      fill_gray(stack, replace, target, map, width, x - 1, y, tol);
+  for (int i = 0; i < seed_count; i++)
+  {
+    imFloodFillResult result;
+    if (!DoFloodFill(pixel, width, height, seed_x[i], seed_y[i], stack, &result))
+    {
+      total_area = -1;
+      break;
+    }
 
-    /* top */
-    if (y < height - 1)
-      fill_gray(stack, replace, target, map, width, x, y + 1, tol);
+    if (result.area == 0)
+      result.xmin = result.ymin = result.xmax = result.ymax = 0;
 
-    /* bottom */
-    if (y > 0)
-      fill_gray(stack, replace, target, map, width, x, y - 1, tol);
+    total_area += result.area;
+    if (results)
+      results[i] = result;
   }
 
   xyStackArrayDestroy(stack);
+  return total_area;
 }
 
-void imProcessRenderFloodFill(imImage* image, int start_x, int start_y, double* replace_color, double tolerance)
+template <class T>
+static int DoRenderFloodFillRGB(T** data, int width, int height, int seed_count, const int* seed_x, const int* seed_y, double* replace_data, double tolerance, int tol_space, double type_max, imFloodFillResult* results)
 {
+  if (tol_space == IM_LAB)
+  {
+    iFloodFillRGBLab<T> pixel;
+    pixel.r = data[0]; pixel.g = data[1]; pixel.b = data[2];
+    pixel.replace[0] = (T)replace_data[0];
+    pixel.replace[1] = (T)replace_data[1];
+    pixel.replace[2] = (T)replace_data[2];
+    pixel.tol2 = tolerance > 0? tolerance*tolerance: 0;
+
+    /* linearization table, type_max is 255 or 65535 */
+    int linear_count = (int)type_max + 1;
+    double* linear = (double*)malloc(linear_count * sizeof(double));
+    if (!linear)
+      return -1;
+    for (int i = 0; i < linear_count; i++)
+      linear[i] = imColorTransfer2Linear((double)i / type_max);
+    pixel.linear = linear;
+
+    int ret = DoFloodFillSeeds(pixel, width, height, seed_count, seed_x, seed_y, results);
+    free(linear);
+    return ret;
+  }
+  else
+  {
+    iFloodFillRGB<T> pixel;
+    pixel.r = data[0]; pixel.g = data[1]; pixel.b = data[2];
+    pixel.replace[0] = (T)replace_data[0];
+    pixel.replace[1] = (T)replace_data[1];
+    pixel.replace[2] = (T)replace_data[2];
+    pixel.tol2 = tolerance > 0? tolerance*tolerance: 0;
+    return DoFloodFillSeeds(pixel, width, height, seed_count, seed_x, seed_y, results);
+  }
+}
+
+template <class T>
+static int DoRenderFloodFillGray(T** data, int width, int height, int seed_count, const int* seed_x, const int* seed_y, double* replace_data, double tolerance, imFloodFillResult* results)
+{
+  iFloodFillGray<T> pixel;
+  pixel.map = data[0];
+  pixel.replace = (T)replace_data[0];
+  pixel.tol = tolerance;
+  return DoFloodFillSeeds(pixel, width, height, seed_count, seed_x, seed_y, results);
+}
+
+int imProcessRenderFloodFillSeeds(imImage* image, int seed_count, const int* seed_x, const int* seed_y, double* replace_color, double tolerance, int tol_space, imFloodFillResult* results)
+{
+  int rgb = image->color_space == IM_RGB;
+
+  /* the L*a*b* distance uses the natural range of the unsigned integer types */
+  if (tol_space == IM_LAB && image->data_type != IM_BYTE && image->data_type != IM_USHORT)
+    tol_space = IM_RGB;
+
   switch (image->data_type)
   {
   case IM_BYTE:
-    if (image->color_space == IM_RGB)
-      DoRenderFloodFillRGB((imbyte**)image->data, image->width, image->height, start_x, start_y, replace_color, tolerance);
+    if (rgb)
+      return DoRenderFloodFillRGB((imbyte**)image->data, image->width, image->height, seed_count, seed_x, seed_y, replace_color, tolerance, tol_space, 255.0, results);
     else
-      DoRenderFloodFillGray((imbyte**)image->data, image->width, image->height, start_x, start_y, replace_color, tolerance);
-    break;
+      return DoRenderFloodFillGray((imbyte**)image->data, image->width, image->height, seed_count, seed_x, seed_y, replace_color, tolerance, results);
   case IM_SHORT:
-    if (image->color_space == IM_RGB)
-      DoRenderFloodFillRGB((short**)image->data, image->width, image->height, start_x, start_y, replace_color, tolerance);
+    if (rgb)
+      return DoRenderFloodFillRGB((short**)image->data, image->width, image->height, seed_count, seed_x, seed_y, replace_color, tolerance, tol_space, 0, results);
     else
-      DoRenderFloodFillGray((short**)image->data, image->width, image->height, start_x, start_y, replace_color, tolerance);
-    break;
+      return DoRenderFloodFillGray((short**)image->data, image->width, image->height, seed_count, seed_x, seed_y, replace_color, tolerance, results);
   case IM_USHORT:
-    if (image->color_space == IM_RGB)
-      DoRenderFloodFillRGB((imushort**)image->data, image->width, image->height, start_x, start_y, replace_color, tolerance);
+    if (rgb)
+      return DoRenderFloodFillRGB((imushort**)image->data, image->width, image->height, seed_count, seed_x, seed_y, replace_color, tolerance, tol_space, 65535.0, results);
     else
-      DoRenderFloodFillGray((imushort**)image->data, image->width, image->height, start_x, start_y, replace_color, tolerance);
-    break;
+      return DoRenderFloodFillGray((imushort**)image->data, image->width, image->height, seed_count, seed_x, seed_y, replace_color, tolerance, results);
   case IM_INT:
-    if (image->color_space == IM_RGB)
-      DoRenderFloodFillRGB((int**)image->data, image->width, image->height, start_x, start_y, replace_color, tolerance);
+    if (rgb)
+      return DoRenderFloodFillRGB((int**)image->data, image->width, image->height, seed_count, seed_x, seed_y, replace_color, tolerance, tol_space, 0, results);
     else
-      DoRenderFloodFillGray((int**)image->data, image->width, image->height, start_x, start_y, replace_color, tolerance);
-    break;
+      return DoRenderFloodFillGray((int**)image->data, image->width, image->height, seed_count, seed_x, seed_y, replace_color, tolerance, results);
   case IM_FLOAT:
-    if (image->color_space == IM_RGB)
-      DoRenderFloodFillRGB((float**)image->data, image->width, image->height, start_x, start_y, replace_color, tolerance);
+    if (rgb)
+      return DoRenderFloodFillRGB((float**)image->data, image->width, image->height, seed_count, seed_x, seed_y, replace_color, tolerance, tol_space, 0, results);
     else
-      DoRenderFloodFillGray((float**)image->data, image->width, image->height, start_x, start_y, replace_color, tolerance);
-    break;
+      return DoRenderFloodFillGray((float**)image->data, image->width, image->height, seed_count, seed_x, seed_y, replace_color, tolerance, results);
   case IM_DOUBLE:
-    if (image->color_space == IM_RGB)
-      DoRenderFloodFillRGB((double**)image->data, image->width, image->height, start_x, start_y, replace_color, tolerance);
+    if (rgb)
+      return DoRenderFloodFillRGB((double**)image->data, image->width, image->height, seed_count, seed_x, seed_y, replace_color, tolerance, tol_space, 0, results);
     else
-      DoRenderFloodFillGray((double**)image->data, image->width, image->height, start_x, start_y, replace_color, tolerance);
-    break;
+      return DoRenderFloodFillGray((double**)image->data, image->width, image->height, seed_count, seed_x, seed_y, replace_color, tolerance, results);
   }
+
+  return 0;
+}
+
+void imProcessRenderFloodFill(imImage* image, int start_x, int start_y, double* replace_color, double tolerance)
+{
+  imProcessRenderFloodFillSeeds(image, 1, &start_x, &start_y, replace_color, tolerance, IM_RGB, NULL);
 }
@@ -0,0 +1,665 @@
+/** \file
+ * \brief Image Stack Statistics
+ *
+ * See Copyright Notice in im_lib.h
+ */
+
+
+#include <im.h>
+#include <im_util.h>
+#include <im_math.h>
+#include <im_color.h>
+
+#include "im_process_counter.h"
+#include "im_process_pnt.h"
+
+#include <stdlib.h>
+#include <memory.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IM_USE_SSE2
+#endif
+
+
+/* Number of consecutive pixels of a plane in a block.
+   The samples of all the frames for a block are stored together,
+   so each block is processed while it is in the cache. */
+#define STACK_BLOCK 64
+
+struct _imProcessStack
+{
+  int width, height,
+      depth,
+      data_type;
+  int count,           /* pixels in a plane */
+      block_count;     /* blocks in a plane */
+  int frame_count,
+      max_frames;
+  double* mean;        /* running mean, depth*count, NULL when only the samples are kept */
+  double* m2;          /* running sum of squared differences from the mean (Welford) */
+  imbyte* samples;     /* [plane][block][frame][STACK_BLOCK], NULL when max_frames is 0 */
+  size_t block_size;   /* bytes of all the frames of a block */
+};
+
+static inline int iStackBlockPixels(const imProcessStack* stack, int b)
+{
+  int offset = b * STACK_BLOCK;
+  return stack->count - offset < STACK_BLOCK? stack->count - offset: STACK_BLOCK;
+}
+
+/* running_stats=0 keeps only the samples, used when only ranks are computed */
+static imProcessStack* iStackCreate(int width, int height, int color_space, int data_type, int max_frames, int running_stats)
+{
+  if (data_type >= IM_CFLOAT || width <= 0 || height <= 0 || max_frames < 0)
+    return NULL;
+
+  imProcessStack* stack = new imProcessStack;
+  stack->width = width;
+  stack->height = height;
+  stack->depth = imColorModeDepth(color_space);
+  stack->data_type = data_type;
+  stack->count = width*height;
+  stack->block_count = (stack->count + STACK_BLOCK - 1) / STACK_BLOCK;
+  stack->frame_count = 0;
+  stack->max_frames = max_frames;
+  stack->block_size = (size_t)max_frames * STACK_BLOCK * imDataTypeSize(data_type);
+  stack->samples = NULL;
+  stack->mean = NULL;
+  stack->m2 = NULL;
+
+  if (running_stats)
+  {
+    size_t total_count = (size_t)stack->depth * stack->count;
+    stack->mean = (double*)calloc(total_count, sizeof(double));
+    stack->m2 = (double*)calloc(total_count, sizeof(double));
+  }
+
+  if (max_frames)
+    stack->samples = (imbyte*)calloc((size_t)stack->depth * stack->block_count, stack->block_size);
+
+  if ((running_stats && (!stack->mean || !stack->m2)) || (max_frames && !stack->samples))
+  {
+    imProcessStackDestroy(stack);
+    return NULL;
+  }
+
+  return stack;
+}
+
+imProcessStack* imProcessStackCreate(int width, int height, int color_space, int data_type, int max_frames)
+{
+  return iStackCreate(width, height, color_space, data_type, max_frames, 1);
+}
+
+void imProcessStackDestroy(imProcessStack* stack)
+{
+  if (stack->mean) free(stack->mean);
+  if (stack->m2) free(stack->m2);
+  if (stack->samples) free(stack->samples);
+  delete stack;
+}
+
+int imProcessStackFrameCount(const imProcessStack* stack)
+{
+  return stack->frame_count;
+}
+
+static int iStackMatchImage(const imProcessStack* stack, const imImage* image, int data_type)
+{
+  return image->width == stack->width && image->height == stack->height &&
+         image->depth == stack->depth &&
+         (data_type == -1? image->data_type < IM_CFLOAT: image->data_type == data_type);
+}
+
+template <class T>
+static void iStackAddBlock(imProcessStack* stack, const T* map, int plane, int b)
+{
+  int offset = b * STACK_BLOCK;
+  int np = iStackBlockPixels(stack, b);
+  map += offset;
+
+  if (stack->mean)
+  {
+    size_t plane_offset = (size_t)plane * stack->count + offset;
+    double* mean = stack->mean + plane_offset;
+    double* m2 = stack->m2 + plane_offset;
+    double inv_n = 1.0 / stack->frame_count;
+
+    for (int p = 0; p < np; p++)
+    {
+      double x = (double)map[p];
+      double delta = x - mean[p];
+      mean[p] += delta * inv_n;
+      m2[p] += delta * (x - mean[p]);
+    }
+  }
+
+  if (stack->samples)
+  {
+    T* block = (T*)(stack->samples + ((size_t)plane * stack->block_count + b) * stack->block_size);
+    memcpy(block + (size_t)(stack->frame_count - 1) * STACK_BLOCK, map, np * sizeof(T));
+  }
+}
+
+template <class T>
+static void iStackAdd(imProcessStack* stack, const imImage* image)
+{
+  int total = stack->depth * stack->block_count;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(stack->count))
+#endif
+  for (int i = 0; i < total; i++)
+  {
+    int plane = i / stack->block_count;
+    int b = i % stack->block_count;
+    iStackAddBlock(stack, (const T*)image->data[plane], plane, b);
+  }
+}
+
+int imProcessStackAdd(imProcessStack* stack, const imImage* image)
+{
+  if (!iStackMatchImage(stack, image, stack->data_type))
+    return 0;
+
+  if (stack->samples && stack->frame_count == stack->max_frames)
+    return 0;
+
+  stack->frame_count++;
+
+  switch (stack->data_type)
+  {
+  case IM_BYTE:
+    iStackAdd<imbyte>(stack, image);
+    break;
+  case IM_SHORT:
+    iStackAdd<short>(stack, image);
+    break;
+  case IM_USHORT:
+    iStackAdd<imushort>(stack, image);
+    break;
+  case IM_INT:
+    iStackAdd<int>(stack, image);
+    break;
+  case IM_FLOAT:
+    iStackAdd<float>(stack, image);
+    break;
+  case IM_DOUBLE:
+    iStackAdd<double>(stack, image);
+    break;
+  }
+
+  return 1;
+}
+
+/* Round and crop for integer types, just assign for real types */
+template <class T>
+static inline void iStackStoreInt(const double* values, T* map, int count, double min, double max)
+{
+  for (int i = 0; i < count; i++)
+  {
+    double v = values[i];
+    v = v < min? min: v > max? max: v;
+    map[i] = (T)imRound(v);
+  }
+}
+
+template <class T>
+static inline void iStackStoreReal(const double* values, T* map, int count)
+{
+  for (int i = 0; i < count; i++)
+    map[i] = (T)values[i];
+}
+
+static void iStackStoreImage(imImage* image, int plane, int offset, const double* values, int count)
+{
+  switch (image->data_type)
+  {
+  case IM_BYTE:
+    iStackStoreInt(values, (imbyte*)image->data[plane] + offset, count, 0, 255);
+    break;
+  case IM_SHORT:
+    iStackStoreInt(values, (short*)image->data[plane] + offset, count, -32768, 32767);
+    break;
+  case IM_USHORT:
+    iStackStoreInt(values, (imushort*)image->data[plane] + offset, count, 0, 65535);
+    break;
+  case IM_INT:
+    iStackStoreInt(values, (int*)image->data[plane] + offset, count, -2147483647.0, 2147483647.0);
+    break;
+  case IM_FLOAT:
+    iStackStoreReal(values, (float*)image->data[plane] + offset, count);
+    break;
+  case IM_DOUBLE:
+    iStackStoreReal(values, (double*)image->data[plane] + offset, count);
+    break;
+  }
+}
+
+int imProcessStackMean(const imProcessStack* stack, imImage* dst_image)
+{
+  if (!stack->frame_count || !stack->mean || !iStackMatchImage(stack, dst_image, -1))
+    return 0;
+
+  for (int d = 0; d < stack->depth; d++)
+    iStackStoreImage(dst_image, d, 0, stack->mean + (size_t)d * stack->count, stack->count);
+
+  return 1;
+}
+
+int imProcessStackStdDev(const imProcessStack* stack, imImage* dst_image)
+{
+  if (!stack->frame_count || !stack->m2 || !iStackMatchImage(stack, dst_image, -1))
+    return 0;
+
+  double inv_n = 1.0 / stack->frame_count;
+  int total = stack->depth * stack->block_count;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(stack->count))
+#endif
+  for (int i = 0; i < total; i++)
+  {
+    int plane = i / stack->block_count;
+    int offset = (i % stack->block_count) * STACK_BLOCK;
+    int np = iStackBlockPixels(stack, i % stack->block_count);
+    const double* m2 = stack->m2 + (size_t)plane * stack->count + offset;
+    double values[STACK_BLOCK];
+
+    for (int p = 0; p < np; p++)
+      values[p] = sqrt(m2[p] * inv_n);
+
+    iStackStoreImage(dst_image, plane, offset, values, np);
+  }
+
+  return 1;
+}
+
+/* Selects the k-th smallest value, partially reordering the array. */
+template <class T>
+static T iStackSelect(T* v, int n, int k)
+{
+  int l = 0, r = n - 1;
+
+  while (r > l)
+  {
+    /* median of three as pivot */
+    int m = l + (r - l) / 2;
+    T t;
+    if (v[m] < v[l]) { t = v[m]; v[m] = v[l]; v[l] = t; }
+    if (v[r] < v[l]) { t = v[r]; v[r] = v[l]; v[l] = t; }
+    if (v[r] < v[m]) { t = v[r]; v[r] = v[m]; v[m] = t; }
+    T pivot = v[m];
+
+    int i = l, j = r;
+    while (i <= j)
+    {
+      while (v[i] < pivot) i++;
+      while (pivot < v[j]) j--;
+      if (i <= j)
+      {
+        t = v[i]; v[i] = v[j]; v[j] = t;
+        i++; j--;
+      }
+    }
+
+    if (k <= j)
+      r = j;
+    else if (k >= i)
+      l = i;
+    else
+      return v[k];
+  }
+
+  return v[k];
+}
+
+/* Selects the k-th smallest value of all the pixels in a block at once,
+   deciding one bit of the result at a time from the most significant.
+   This is a histogram median that does not need a histogram for each pixel. */
+template <class T>
+static void iStackRadixSelect(const T* block, int frames, int rank, int bits, double* values)
+{
+  unsigned int value[STACK_BLOCK], cand[STACK_BLOCK];
+  int less[STACK_BLOCK];
+
+  for (int p = 0; p < STACK_BLOCK; p++)
+    value[p] = 0;
+
+  for (int b = bits - 1; b >= 0; b--)
+  {
+    for (int p = 0; p < STACK_BLOCK; p++)
+    {
+      cand[p] = value[p] | (1u << b);
+      less[p] = 0;
+    }
+
+    for (int k = 0; k < frames; k++)
+    {
+      const T* s = block + (size_t)k * STACK_BLOCK;
+      for (int p = 0; p < STACK_BLOCK; p++)
+        less[p] += (unsigned int)s[p] < cand[p];
+    }
+
+    /* there are at most rank values smaller than the candidate */
+    for (int p = 0; p < STACK_BLOCK; p++)
+    {
+      if (less[p] <= rank)
+        value[p] = cand[p];
+    }
+  }
+
+  for (int p = 0; p < STACK_BLOCK; p++)
+    values[p] = (double)value[p];
+}
+
+#ifdef IM_USE_SSE2
+/* Same as iStackRadixSelect for imbyte, counting 16 pixels at once. Requires frames < 32768. */
+static void iStackRadixSelectByte(const imbyte* block, int frames, int rank, double* values)
+{
+  const __m128i bias = _mm_set1_epi8((char)0x80);
+  const __m128i rank16 = _mm_set1_epi16((short)rank);
+  __m128i value[STACK_BLOCK/16], less[STACK_BLOCK/8];
+  int q;
+
+  for (q = 0; q < STACK_BLOCK/16; q++)
+    value[q] = _mm_setzero_si128();
+
+  for (int b = 7; b >= 0; b--)
+  {
+    const __m128i bit = _mm_set1_epi8((char)(1 << b));
+    __m128i cand[STACK_BLOCK/16], cand_biased[STACK_BLOCK/16];
+
+    for (q = 0; q < STACK_BLOCK/16; q++)
+    {
+      cand[q] = _mm_or_si128(value[q], bit);
+      cand_biased[q] = _mm_xor_si128(cand[q], bias);  /* unsigned compare using the signed compare */
+    }
+    for (q = 0; q < STACK_BLOCK/8; q++)
+      less[q] = _mm_setzero_si128();
+
+    for (int k = 0; k < frames; k++)
+    {
+      const __m128i* s = (const __m128i*)(block + (size_t)k * STACK_BLOCK);
+      for (q = 0; q < STACK_BLOCK/16; q++)
+      {
+        __m128i lt = _mm_cmplt_epi8(_mm_xor_si128(_mm_loadu_si128(s + q), bias), cand_biased[q]);
+        less[2*q] = _mm_sub_epi16(less[2*q], _mm_unpacklo_epi8(lt, lt));
+        less[2*q+1] = _mm_sub_epi16(less[2*q+1], _mm_unpackhi_epi8(lt, lt));
+      }
+    }
+
+    for (q = 0; q < STACK_BLOCK/16; q++)
+    {
+      __m128i keep = _mm_packs_epi16(_mm_cmpgt_epi16(less[2*q], rank16), _mm_cmpgt_epi16(less[2*q+1], rank16));
+      value[q] = _mm_or_si128(_mm_and_si128(keep, value[q]), _mm_andnot_si128(keep, cand[q]));
+    }
+  }
+
+  imbyte result[STACK_BLOCK];
+  for (q = 0; q < STACK_BLOCK/16; q++)
+    _mm_storeu_si128((__m128i*)(result + 16*q), value[q]);
+
+  for (int p = 0; p < STACK_BLOCK; p++)
+    values[p] = (double)result[p];
+}
+#endif
+
+template <class T>
+static void iStackSelectBlock(const T* block, int frames, int np, int rank, T* buffer, double* values)
+{
+  for (int p = 0; p < np; p++)
+  {
+    for (int k = 0; k < frames; k++)
+      buffer[k] = block[(size_t)k * STACK_BLOCK + p];
+
+    values[p] = (double)iStackSelect(buffer, frames, rank);
+  }
+}
+
+static void iStackPercentileBlock(const imProcessStack* stack, const imbyte* block, int np, int rank, void* buffer, double* values)
+{
+  int frames = stack->frame_count;
+
+  switch (stack->data_type)
+  {
+  case IM_BYTE:
+#ifdef IM_USE_SSE2
+    if (frames < 32768)
+    {
+      iStackRadixSelectByte(block, frames, rank, values);
+      break;
+    }
+#endif
+    iStackRadixSelect((const imbyte*)block, frames, rank, 8, values);
+    break;
+  case IM_USHORT:
+    iStackRadixSelect((const imushort*)block, frames, rank, 16, values);
+    break;
+  case IM_SHORT:
+    iStackSelectBlock((const short*)block, frames, np, rank, (short*)buffer, values);
+    break;
+  case IM_INT:
+    iStackSelectBlock((const int*)block, frames, np, rank, (int*)buffer, values);
+    break;
+  case IM_FLOAT:
+    iStackSelectBlock((const float*)block, frames, np, rank, (float*)buffer, values);
+    break;
+  case IM_DOUBLE:
+    iStackSelectBlock((const double*)block, frames, np, rank, (double*)buffer, values);
+    break;
+  }
+}
+
+static int iStackRank(const imProcessStack* stack, imImage* dst_image, int rank)
+{
+  int frames = stack->frame_count;
+  int total = stack->depth * stack->block_count;
+  int thread_count = IM_OMP_MINCOUNT(stack->count)? IM_MAX_THREADS: 1;
+  size_t buffer_size = (size_t)frames * imDataTypeSize(stack->data_type);
+  imbyte* thread_buffer = (imbyte*)malloc(thread_count * buffer_size);
+  if (!thread_buffer)
+    return 0;
+
+  int counter = imProcessCounterBegin("StackRank");
+  imCounterTotal(counter, total, "Processing...");
+
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(stack->count))
+#endif
+  for (int i = 0; i < total; i++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    int plane = i / stack->block_count;
+    int b = i % stack->block_count;
+    int np = iStackBlockPixels(stack, b);
+    const imbyte* block = stack->samples + (size_t)i * stack->block_size;
+    double values[STACK_BLOCK];
+
+    iStackPercentileBlock(stack, block, np, rank, thread_buffer + IM_THREAD_NUM * buffer_size, values);
+
+    iStackStoreImage(dst_image, plane, b * STACK_BLOCK, values, np);
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  free(thread_buffer);
+  imProcessCounterEnd(counter);
+  return processing;
+}
+
+int imProcessStackPercentile(const imProcessStack* stack, imImage* dst_image, double percent)
+{
+  if (!stack->frame_count || !stack->samples || !iStackMatchImage(stack, dst_image, -1))
+    return 0;
+
+  int frames = stack->frame_count;
+  int rank = imRound((percent / 100.0) * (frames - 1));
+  if (rank < 0) rank = 0;
+  if (rank > frames - 1) rank = frames - 1;
+
+  return iStackRank(stack, dst_image, rank);
+}
+
+int imProcessStackMedian(const imProcessStack* stack, imImage* dst_image)
+{
+  if (!stack->frame_count || !stack->samples || !iStackMatchImage(stack, dst_image, -1))
+    return 0;
+
+  /* for an even number of frames this is the upper median */
+  return iStackRank(stack, dst_image, stack->frame_count / 2);
+}
+
+static void iStackMeanStdDev(const double* x, int n, double& mean, double& stddev)
+{
+  double sum = 0, sum2 = 0;
+  for (int k = 0; k < n; k++)
+    sum += x[k];
+  mean = sum / n;
+
+  for (int k = 0; k < n; k++)
+    sum2 += (x[k] - mean) * (x[k] - mean);
+  stddev = sqrt(sum2 / n);
+}
+
+template <class T>
+static double iStackSigmaClip(const T* block, int frames, int p, double kappa, int iterations, double* x)
+{
+  int n = frames;
+  for (int k = 0; k < frames; k++)
+    x[k] = (double)block[(size_t)k * STACK_BLOCK + p];
+
+  double mean, stddev;
+  iStackMeanStdDev(x, n, mean, stddev);
+
+  for (int it = 0; it < iterations; it++)
+  {
+    double limit = kappa * stddev;
+    int m = 0;
+    for (int k = 0; k < n; k++)
+    {
+      if (fabs(x[k] - mean) <= limit)
+        x[m++] = x[k];
+    }
+
+    if (m == n || m == 0)
+      break;
+
+    n = m;
+    iStackMeanStdDev(x, n, mean, stddev);
+  }
+
+  return mean;
+}
+
+template <class T>
+static void iStackSigmaClipBlock(const T* block, int frames, int np, double kappa, int iterations, double* buffer, double* values)
+{
+  for (int p = 0; p < np; p++)
+    values[p] = iStackSigmaClip(block, frames, p, kappa, iterations, buffer);
+}
+
+int imProcessStackSigmaClippedMean(const imProcessStack* stack, imImage* dst_image, double kappa, int iterations)
+{
+  if (!stack->frame_count || !stack->samples || !iStackMatchImage(stack, dst_image, -1))
+    return 0;
+
+  int frames = stack->frame_count;
+  int total = stack->depth * stack->block_count;
+  int thread_count = IM_OMP_MINCOUNT(stack->count)? IM_MAX_THREADS: 1;
+  double* thread_buffer = (double*)malloc((size_t)thread_count * frames * sizeof(double));
+  if (!thread_buffer)
+    return 0;
+
+  int counter = imProcessCounterBegin("StackSigmaClippedMean");
+  imCounterTotal(counter, total, "Processing...");
+
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(stack->count))
+#endif
+  for (int i = 0; i < total; i++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    int plane = i / stack->block_count;
+    int b = i % stack->block_count;
+    int np = iStackBlockPixels(stack, b);
+    const imbyte* block = stack->samples + (size_t)i * stack->block_size;
+    double* buffer = thread_buffer + (size_t)IM_THREAD_NUM * frames;
+    double values[STACK_BLOCK];
+
+    switch (stack->data_type)
+    {
+    case IM_BYTE:
+      iStackSigmaClipBlock((const imbyte*)block, frames, np, kappa, iterations, buffer, values);
+      break;
+    case IM_SHORT:
+      iStackSigmaClipBlock((const short*)block, frames, np, kappa, iterations, buffer, values);
+      break;
+    case IM_USHORT:
+      iStackSigmaClipBlock((const imushort*)block, frames, np, kappa, iterations, buffer, values);
+      break;
+    case IM_INT:
+      iStackSigmaClipBlock((const int*)block, frames, np, kappa, iterations, buffer, values);
+      break;
+    case IM_FLOAT:
+      iStackSigmaClipBlock((const float*)block, frames, np, kappa, iterations, buffer, values);
+      break;
+    case IM_DOUBLE:
+      iStackSigmaClipBlock((const double*)block, frames, np, kappa, iterations, buffer, values);
+      break;
+    }
+
+    iStackStoreImage(dst_image, plane, b * STACK_BLOCK, values, np);
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  free(thread_buffer);
+  imProcessCounterEnd(counter);
+  return processing;
+}
+
+int imProcessMultipleMedian(const imImage** src_image_list, int src_image_count, imImage* dst_image)
+{
+  /* the running mean and standard deviation are not necessary for the median */
+  const imImage* image1 = src_image_list[0];
+  imProcessStack* stack = iStackCreate(image1->width, image1->height, image1->color_space, image1->data_type, src_image_count, 0);
+  if (!stack)
+    return 0;
+
+  for (int i = 0; i < src_image_count; i++)
+  {
+    if (!imProcessStackAdd(stack, src_image_list[i]))
+    {
+      imProcessStackDestroy(stack);
+      return 0;
+    }
+  }
+
+  int ret = imProcessStackMedian(stack, dst_image);
+
+  imProcessStackDestroy(stack);
+  return ret;
+}
@@ -20,65 +20,192 @@
 #include <stdio.h>
 
 
+/* The histograms are accumulated in private buffers, one for each thread, 
+   and merged at the end, so no atomic operations are necessary. 
+   Small histograms use 4 banks, one for each pixel lane, 
+   this avoids the dependency between increments of the same bin in consecutive pixels. */
+
+#define HISTO_LINE 4096  /* line size used for raw data */
+
+static inline int iHistoBankCount(int hcount)
+{
+  return hcount <= 1024? 4: 1;
+}
+
 template <class T>
-static int DoCalcHisto(T* map, int size, unsigned long* histo, int hcount, int cumulative, int shift, int counter, int width)
+static inline void iHistoLine(const T* line, int count, unsigned int* bank, int hcount, int bank_count, int shift)
 {
-  memset(histo, 0, hcount * sizeof(unsigned long));
+  int i = 0;
+
+  if (bank_count == 4)
+  {
+    unsigned int* bank1 = bank + hcount;
+    unsigned int* bank2 = bank1 + hcount;
+    unsigned int* bank3 = bank2 + hcount;
+
+    for (; i + 4 <= count; i += 4)
+    {
+      bank [line[i]   + shift]++;
+      bank1[line[i+1] + shift]++;
+      bank2[line[i+2] + shift]++;
+      bank3[line[i+3] + shift]++;
+    }
+  }
+
+  for (; i < count; i++)
+    bank[line[i] + shift]++;
+}
+
+template <class T>
+struct iHistoPlane
+{
+  const T* map;
+  int size, width, hcount, shift;
+
+  void operator()(int y, unsigned int* bank, int bank_count) const
+  {
+    int offset = y * width;
+    int count = (size - offset < width)? size - offset: width;
+    iHistoLine(map + offset, count, bank, hcount, bank_count, shift);
+  }
+};
+
+template <class T>
+struct iHistoGrayRGB
+{
+  const T *r, *g, *b;
+  int width, hcount, shift;
+
+  void operator()(int y, unsigned int* bank, int bank_count) const
+  {
+    int offset = y * width;
+    int lane_mask = bank_count - 1;
+    for (int x = 0; x < width; x++)
+    {
+      int index = imColorRGB2Luma(r[offset + x], g[offset + x], b[offset + x]) + shift;
+      bank[(x & lane_mask)*hcount + index]++;
+    }
+  }
+};
+
+struct iHistoGrayMap
+{
+  const imbyte* map;
+  const imbyte* gray_map;
+  int width, hcount;
+
+  void operator()(int y, unsigned int* bank, int bank_count) const
+  {
+    int offset = y * width;
+    int lane_mask = bank_count - 1;
+    for (int x = 0; x < width; x++)
+      bank[(x & lane_mask)*hcount + gray_map[map[offset + x]]]++;
+  }
+};
+
+/* red, green and blue histograms side by side in a single histogram */
+template <class T>
+struct iHistoRGB
+{
+  const T *r, *g, *b;
+  int width, hcount, shift;   /* hcount of each channel */
+
+  void operator()(int y, unsigned int* bank, int bank_count) const
+  {
+    int offset = y * width;
+    int lane_mask = bank_count - 1;
+    int bank_size = 3 * hcount;
+    for (int x = 0; x < width; x++)
+    {
+      unsigned int* lane = bank + (x & lane_mask)*bank_size;
+      lane[r[offset + x] + shift]++;
+      lane[hcount + g[offset + x] + shift]++;
+      lane[2*hcount + b[offset + x] + shift]++;
+    }
+  }
+};
+
+static void iHistoCumulative(unsigned long* histo, int hcount)
+{
+  for (int i = 1; i < hcount; i++)
+    histo[i] += histo[i-1];
+}
+
+template <class LINE>
+static int iCalcHistoLines(const LINE& line_func, int line_count, int total_count, unsigned long* histo, int hcount, int counter)
+{
+  int bank_count = iHistoBankCount(hcount);
+  int bank_size = bank_count * hcount;
+  int thread_count = IM_OMP_MINCOUNT(total_count)? IM_MAX_THREADS: 1;
+  unsigned int* thread_banks = (unsigned int*)calloc(thread_count * bank_size, sizeof(unsigned int));
+  if (!thread_banks)
+    return 0;
 
   IM_INT_PROCESSING;
 
 #ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(size))
+#pragma omp parallel for if (IM_OMP_MINCOUNT(total_count))
 #endif
-  for (int i = 0; i < size; i++)
+  for (int y = 0; y < line_count; y++)
   {
-    if (i % width == 0)
-    {
 #ifdef _OPENMP
 #pragma omp flush (processing)
 #endif
-    }
     IM_BEGIN_PROCESSING;
 
-    int index = map[i] + shift;
-#ifdef _OPENMP
-#pragma omp atomic
-#endif
-    histo[index]++;
+    line_func(y, thread_banks + IM_THREAD_NUM * bank_size, bank_count);
 
-    if (i % width == 0)
-    {
-      IM_COUNT_PROCESSING;
+    IM_COUNT_PROCESSING;
 #ifdef _OPENMP
 #pragma omp flush (processing)
 #endif
-    }
     IM_END_PROCESSING;
   }
 
-  if (cumulative)
+  memset(histo, 0, hcount * sizeof(unsigned long));
+
+  for (int b = 0; b < thread_count * bank_count; b++)
   {
-    /* make cumulative histogram */
-    for (int i = 1; i < hcount; i++)
-      histo[i] += histo[i-1];
+    unsigned int* bank = thread_banks + b * hcount;
+    for (int i = 0; i < hcount; i++)
+      histo[i] += bank[i];
   }
 
+  free(thread_banks);
+  return processing;
+}
+
+template <class T>
+static int DoCalcHisto(T* map, int size, unsigned long* histo, int hcount, int cumulative, int shift, int counter, int width)
+{
+  iHistoPlane<T> line_func;
+  line_func.map = map;
+  line_func.size = size;
+  line_func.width = width;
+  line_func.hcount = hcount;
+  line_func.shift = shift;
+
+  int processing = iCalcHistoLines(line_func, (size + width - 1) / width, size, histo, hcount, counter);
+
+  if (cumulative)
+    iHistoCumulative(histo, hcount);  /* make cumulative histogram */
+
   return processing;
 }
 
 void imCalcByteHistogram(const imbyte* map, int size, unsigned long* histo, int cumulative)
 {
-  DoCalcHisto(map, size, histo, 256, cumulative, 0, -1, size);
+  DoCalcHisto(map, size, histo, 256, cumulative, 0, -1, HISTO_LINE);
 }
 
 void imCalcUShortHistogram(const imushort* map, int size, unsigned long* histo, int cumulative)
 {
-  DoCalcHisto(map, size, histo, 65536, cumulative, 0, -1, size);
+  DoCalcHisto(map, size, histo, 65536, cumulative, 0, -1, HISTO_LINE);
 }
 
 void imCalcShortHistogram(const short* map, int size, unsigned long* histo, int cumulative)
 {
-  DoCalcHisto(map, size, histo, 65536, cumulative, 32768, -1, size);
+  DoCalcHisto(map, size, histo, 65536, cumulative, 32768, -1, HISTO_LINE);
 }
 
 int imCalcHistogram(const imImage* src_image, unsigned long* histo, int plane, int cumulative)
@@ -104,13 +231,27 @@ int imCalcHistogram(const imImage* src_image, unsigned long* histo, int plane, i
   return ret;
 }
 
+template <class T>
+static int DoCalcGrayHistoRGB(const imImage* image, unsigned long* histo, int hcount, int shift, int counter)
+{
+  iHistoGrayRGB<T> line_func;
+  line_func.r = (const T*)image->data[0];
+  line_func.g = (const T*)image->data[1];
+  line_func.b = (const T*)image->data[2];
+  line_func.width = image->width;
+  line_func.hcount = hcount;
+  line_func.shift = shift;
+
+  return iCalcHistoLines(line_func, image->height, image->count, histo, hcount, counter);
+}
+
 int imCalcGrayHistogram(const imImage* image, unsigned long* histo, int cumulative)
 {
   int counter = imProcessCounterBegin("GrayHistogram");
 
   int hcount = imHistogramCount(image->data_type);
 
-  IM_INT_PROCESSING;
+  int processing = IM_PROCESS_OK;
 
   if (image->color_space == IM_GRAY)
   {
@@ -122,169 +263,172 @@ int imCalcGrayHistogram(const imImage* image, unsigned long* histo, int cumulati
   }
   else 
   {
-    int i;
-    memset(histo, 0, hcount * sizeof(unsigned long));
     imCounterTotal(counter, image->height, "Calculating...");
 
     if (image->color_space == IM_MAP || image->color_space == IM_BINARY)
     {
-      imbyte* map = (imbyte*)image->data[0];
       imbyte gray_map[256], r, g, b;
 
-      for (i = 0; i < image->palette_count; i++)
+      for (int i = 0; i < image->palette_count; i++)
       {
         imColorDecode(&r, &g, &b, image->palette[i]);
         gray_map[i] = imColorRGB2Luma(r, g, b);
       }
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(image->count))
-#endif
-      for (i = 0; i < image->count; i++)
-      {
-        if (i % image->width == 0)
-        {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-        }
-        IM_BEGIN_PROCESSING;
-
-        int index = gray_map[map[i]];
-#ifdef _OPENMP
-#pragma omp atomic
-#endif
-        histo[index]++;
+      iHistoGrayMap line_func;
+      line_func.map = (const imbyte*)image->data[0];
+      line_func.gray_map = gray_map;
+      line_func.width = image->width;
+      line_func.hcount = hcount;
 
-        if (i % image->width == 0)
-        {
-          IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-        }
-        IM_END_PROCESSING;
-      }
+      processing = iCalcHistoLines(line_func, image->height, image->count, histo, hcount, counter);
     }
     else   // RGB
     {
       if (image->data_type == IM_USHORT)
-      {
-        imushort* r = (imushort*)image->data[0];
-        imushort* g = (imushort*)image->data[1];
-        imushort* b = (imushort*)image->data[2];
+        processing = DoCalcGrayHistoRGB<imushort>(image, histo, hcount, 0, counter);
+      else if (image->data_type == IM_SHORT)
+        processing = DoCalcGrayHistoRGB<short>(image, histo, hcount, 32768, counter);
+      else
+        processing = DoCalcGrayHistoRGB<imbyte>(image, histo, hcount, 0, counter);
+    }
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(image->count))
-#endif
-        for (i = 0; i < image->count; i++)
-        {
-          if (i % image->width == 0)
-          {
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-          }
-          IM_BEGIN_PROCESSING;
+    if (cumulative)
+      iHistoCumulative(histo, hcount);  /* make cumulative histogram */
+  }
 
-          imushort index = imColorRGB2Luma(*r++, *g++, *b++);
-#ifdef _OPENMP
-#pragma omp atomic
-#endif
-          histo[index]++;
+  imProcessCounterEnd(counter);
+  return processing;
+}
 
-          if (i % image->width == 0)
-          {
-            IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-          }
-          IM_END_PROCESSING;
-        }
-      }
-      else if (image->data_type == IM_SHORT)
-      {
-        short* r = (short*)image->data[0];
-        short* g = (short*)image->data[1];
-        short* b = (short*)image->data[2];
+template <class T>
+static int DoCalcRGBHisto(const imImage* image, unsigned long* histo, int hcount, int shift, int counter)
+{
+  iHistoRGB<T> line_func;
+  line_func.r = (const T*)image->data[0];
+  line_func.g = (const T*)image->data[1];
+  line_func.b = (const T*)image->data[2];
+  line_func.width = image->width;
+  line_func.hcount = hcount;
+  line_func.shift = shift;
+
+  return iCalcHistoLines(line_func, image->height, image->count, histo, 3*hcount, counter);
+}
+
+int imCalcRGBHistogram(const imImage* image, unsigned long* histo, int cumulative)
+{
+  int ret = 0;
+  int hcount = imHistogramCount(image->data_type);
+  int counter = imProcessCounterBegin("RGBHistogram");
+  imCounterTotal(counter, image->height, "Calculating...");
+
+  switch (image->data_type)
+  {
+  case IM_BYTE:
+    ret = DoCalcRGBHisto<imbyte>(image, histo, hcount, 0, counter);
+    break;
+  case IM_SHORT:
+    ret = DoCalcRGBHisto<short>(image, histo, hcount, 32768, counter);
+    break;
+  case IM_USHORT:
+    ret = DoCalcRGBHisto<imushort>(image, histo, hcount, 0, counter);
+    break;
+  }
+
+  if (cumulative)
+  {
+    for (int c = 0; c < 3; c++)
+      iHistoCumulative(histo + c*hcount, hcount);
+  }
+
+  imProcessCounterEnd(counter);
+  return ret;
+}
+
+/* each band of tiles is processed by a single thread, 
+   so the tile histograms are not shared */
+template <class T>
+static int DoCalcHistoTiles(const T* map, int width, int height, int tile_width, int tile_height, unsigned long* histo, int hcount, int shift, int counter)
+{
+  int tiles_x = (width + tile_width - 1) / tile_width;
+  int tiles_y = (height + tile_height - 1) / tile_height;
+
+  memset(histo, 0, (size_t)tiles_x * tiles_y * hcount * sizeof(unsigned long));
+
+  IM_INT_PROCESSING;
 
 #ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(image->count))
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
 #endif
-        for (i = 0; i < image->count; i++)
-        {
-          if (i % image->width == 0)
-          {
+  for (int ty = 0; ty < tiles_y; ty++)
+  {
 #ifdef _OPENMP
 #pragma omp flush (processing)
 #endif
-          }
-          IM_BEGIN_PROCESSING;
+    IM_BEGIN_PROCESSING;
 
-          int index = imColorRGB2Luma(*r++, *g++, *b++) + 32768;
-#ifdef _OPENMP
-#pragma omp atomic
-#endif
-          histo[index]++;
+    int y0 = ty * tile_height;
+    int y1 = (y0 + tile_height < height)? y0 + tile_height: height;
 
-          if (i % image->width == 0)
-          {
-            IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-          }
-          IM_END_PROCESSING;
-        }
-      }
-      else
+    for (int y = y0; y < y1; y++)
+    {
+      const T* line = map + (size_t)y * width;
+
+      for (int tx = 0; tx < tiles_x; tx++)
       {
-        imbyte* r = (imbyte*)image->data[0];
-        imbyte* g = (imbyte*)image->data[1];
-        imbyte* b = (imbyte*)image->data[2];
+        unsigned long* tile_histo = histo + (size_t)(ty * tiles_x + tx) * hcount;
+        int x0 = tx * tile_width;
+        int x1 = (x0 + tile_width < width)? x0 + tile_width: width;
 
-#ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(image->count))
-#endif
-        for (i = 0; i < image->count; i++)
-        {
-          if (i % image->width == 0)
-          {
+        for (int x = x0; x < x1; x++)
+          tile_histo[line[x] + shift]++;
+      }
+    }
+
+    IM_COUNT_PROCESSING;
 #ifdef _OPENMP
 #pragma omp flush (processing)
 #endif
-          }
-          IM_BEGIN_PROCESSING;
+    IM_END_PROCESSING;
+  }
 
-          imbyte index = imColorRGB2Luma(*r++, *g++, *b++);
-#ifdef _OPENMP
-#pragma omp atomic
-#endif
-          histo[index]++;
+  return processing;
+}
 
-          if (i % image->width == 0)
-          {
-            IM_COUNT_PROCESSING;
-#ifdef _OPENMP
-#pragma omp flush (processing)
-#endif
-          }
-          IM_END_PROCESSING;
-        }
-      }
-    }
+int imCalcHistogramTiles(const imImage* image, int plane, int tile_width, int tile_height, unsigned long* histo, int cumulative)
+{
+  int ret = 0;
+  if (tile_width <= 0 || tile_height <= 0)
+    return 0;
 
-    if (cumulative)
-    {
-      /* make cumulative histogram */
-      for (i = 1; i < hcount; i++)
-        histo[i] += histo[i-1];
-    }
+  int hcount = imHistogramCount(image->data_type);
+  int tiles_x = (image->width + tile_width - 1) / tile_width;
+  int tiles_y = (image->height + tile_height - 1) / tile_height;
+
+  int counter = imProcessCounterBegin("HistogramTiles");
+  imCounterTotal(counter, tiles_y, "Calculating...");
+
+  switch (image->data_type)
+  {
+  case IM_BYTE:
+    ret = DoCalcHistoTiles((const imbyte*)image->data[plane], image->width, image->height, tile_width, tile_height, histo, hcount, 0, counter);
+    break;
+  case IM_SHORT:
+    ret = DoCalcHistoTiles((const short*)image->data[plane], image->width, image->height, tile_width, tile_height, histo, hcount, 32768, counter);
+    break;
+  case IM_USHORT:
+    ret = DoCalcHistoTiles((const imushort*)image->data[plane], image->width, image->height, tile_width, tile_height, histo, hcount, 0, counter);
+    break;
+  }
+
+  if (cumulative)
+  {
+    for (int t = 0; t < tiles_x * tiles_y; t++)
+      iHistoCumulative(histo + (size_t)t*hcount, hcount);
   }
 
   imProcessCounterEnd(counter);
-  return processing;
+  return ret;
 }
 
 static int count_map(const imImage* image, unsigned long *total_count)
@@ -364,100 +508,264 @@ int imCalcCountColors(const imImage* image, unsigned long* count)
   return ret;
 }
 
-template <class T>
-static int DoStats(T* data, int count, imStats* stats, int counter, int width)
+/* partial statistics of a set of values, 
+   mean and m2 (sum of squared differences from the mean) are combined in parallel form (Chan et al.) */
+struct iStatsAcc
+{
+  double n, mean, m2;
+  double min, max;
+  unsigned long positive, negative, zeros;
+};
+
+static void iStatsInit(iStatsAcc* acc)
+{
+  memset(acc, 0, sizeof(iStatsAcc));
+}
+
+static void iStatsCombine(iStatsAcc* acc, const iStatsAcc* part)
+{
+  if (part->n == 0)
+    return;
+
+  if (acc->n == 0)
+  {
+    *acc = *part;
+    return;
+  }
+
+  double n = acc->n + part->n;
+  double delta = part->mean - acc->mean;
+  acc->mean += (delta * part->n) / n;
+  acc->m2 += part->m2 + (delta * delta * acc->n * part->n) / n;
+  acc->n = n;
+
+  if (part->min < acc->min) acc->min = part->min;
+  if (part->max > acc->max) acc->max = part->max;
+
+  acc->positive += part->positive;
+  acc->negative += part->negative;
+  acc->zeros += part->zeros;
+}
+
+static void iStatsResult(const iStatsAcc* acc, imStats* stats)
 {
   memset(stats, 0, sizeof(imStats));
 
-  IM_INT_PROCESSING;
+  if (acc->n == 0)
+    return;
+
+  stats->max = acc->max;
+  stats->min = acc->min;
+  stats->positive = acc->positive;
+  stats->negative = acc->negative;
+  stats->zeros = acc->zeros;
+  stats->mean = acc->mean;
+  stats->stddev = acc->n > 1? sqrt(acc->m2 / (acc->n - 1.0)): 0;
+}
+
+/* The line is small enough to stay in cache, 
+   so the second loop for the squared differences does not read memory again. */
+template <class T>
+static void DoStatsLine(const T* line, const imbyte* mask, int count, iStatsAcc* acc)
+{
+  iStatsInit(acc);
+
+  int n = 0;
+  T min = 0, max = 0;
+  unsigned long positive = 0, negative = 0;
+  double sum = 0;
+
+  if (mask)
+  {
+    for (int x = 0; x < count; x++)
+    {
+      if (mask[x])
+      {
+        T v = line[x];
+        if (n == 0) min = max = v;
+        else if (v < min) min = v;
+        else if (v > max) max = v;
+        if (v > 0) positive++;
+        if (v < 0) negative++;
+        sum += (double)v;
+        n++;
+      }
+    }
+  }
+  else
+  {
+    min = max = line[0];
+    for (int x = 0; x < count; x++)
+    {
+      T v = line[x];
+      if (v < min) min = v;
+      if (v > max) max = v;
+      positive += v > 0;
+      negative += v < 0;
+      sum += (double)v;
+    }
+    n = count;
+  }
+
+  if (n == 0)
+    return;
+
+  double mean = sum / n;
+  double m2 = 0;
+
+  if (mask)
+  {
+    for (int x = 0; x < count; x++)
+    {
+      if (mask[x])
+      {
+        double d = (double)line[x] - mean;
+        m2 += d * d;
+      }
+    }
+  }
+  else
+  {
+    for (int x = 0; x < count; x++)
+    {
+      double d = (double)line[x] - mean;
+      m2 += d * d;
+    }
+  }
+
+  acc->n = n;
+  acc->mean = mean;
+  acc->m2 = m2;
+  acc->min = (double)min;
+  acc->max = (double)max;
+  acc->positive = positive;
+  acc->negative = negative;
+  acc->zeros = n - positive - negative;
+}
 
-  unsigned long positive = 0;
-  unsigned long negative = 0;
-  unsigned long zeros = 0;
-  double mean = 0;
-  double stddev = 0;
+template <class T>
+static int DoStats(T* data, int width, int height, const imbyte* mask, imStats* stats, int counter)
+{
+  iStatsAcc* lines = new iStatsAcc[height];
 
-  T min, max;
-  imMinMax(data, count, min, max);
+  IM_INT_PROCESSING;
 
 #ifdef _OPENMP
-#pragma omp parallel for if (IM_OMP_MINCOUNT(count)) \
-                         reduction (+:positive, negative, zeros, mean, stddev) 
+#pragma omp parallel for if (IM_OMP_MINCOUNT(width*height))
 #endif
-  for (int i = 0; i < count; i++)
+  for (int y = 0; y < height; y++)
   {
-    if (i % width == 0)
-    {
 #ifdef _OPENMP
 #pragma omp flush (processing)
 #endif
-    }
     IM_BEGIN_PROCESSING;
 
-    if (data[i] > 0)
-      positive++;
+    int offset = y * width;
+    DoStatsLine(data + offset, mask? mask + offset: NULL, width, &lines[y]);
 
-    if (data[i] < 0)
-      negative++;
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
 
-    if (data[i] == 0)
-      zeros++;
+  /* combine in order, so the result does not depend on the number of threads */
+  iStatsAcc acc;
+  iStatsInit(&acc);
+  for (int y = 0; y < height; y++)
+    iStatsCombine(&acc, &lines[y]);
 
-    mean += (double)data[i];
-    stddev += ((double)data[i])*((double)data[i]);
+  iStatsResult(&acc, stats);
+
+  delete[] lines;
+  return processing;
+}
+
+template <class T>
+static int DoStatsTiles(T* data, int width, int height, const imbyte* mask, int tile_width, int tile_height, imStats* stats, int depth, int counter)
+{
+  int tiles_x = (width + tile_width - 1) / tile_width;
+  int tiles_y = (height + tile_height - 1) / tile_height;
+
+  IM_INT_PROCESSING;
 
-    if (i % width == 0)
-    {
-      IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINCOUNT(width*height))
+#endif
+  for (int ty = 0; ty < tiles_y; ty++)
+  {
 #ifdef _OPENMP
 #pragma omp flush (processing)
 #endif
+    IM_BEGIN_PROCESSING;
+
+    int y0 = ty * tile_height;
+    int y1 = y0 + tile_height < height? y0 + tile_height: height;
+
+    for (int tx = 0; tx < tiles_x; tx++)
+    {
+      int x0 = tx * tile_width;
+      int tw = x0 + tile_width < width? tile_width: width - x0;
+
+      iStatsAcc acc, line_acc;
+      iStatsInit(&acc);
+
+      for (int y = y0; y < y1; y++)
+      {
+        int offset = y * width + x0;
+        DoStatsLine(data + offset, mask? mask + offset: NULL, tw, &line_acc);
+        iStatsCombine(&acc, &line_acc);
+      }
+
+      iStatsResult(&acc, &stats[(ty * tiles_x + tx) * depth]);
     }
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
     IM_END_PROCESSING;
   }
 
-  double dcount = (double)count;
-  mean /= dcount;
-  stddev = sqrt((stddev - dcount*mean*mean)/(dcount-1.0));
-
-  stats->max = max;
-  stats->min = min;
-  stats->positive = positive;
-  stats->negative = negative;
-  stats->zeros = zeros;
-  stats->mean = mean;
-  stats->stddev = stddev;
-
   return processing;
 }
 
-int imCalcImageStatistics(const imImage* image, imStats* stats)
+template <class T>
+static int DoStatsPlane(T* data, const imImage* image, const imbyte* mask, int tile_width, int tile_height, imStats* stats, int counter)
+{
+  if (tile_width > 0 && tile_height > 0)
+    return DoStatsTiles(data, image->width, image->height, mask, tile_width, tile_height, stats, image->depth, counter);
+  else
+    return DoStats(data, image->width, image->height, mask, stats, counter);
+}
+
+static int iCalcImageStatistics(const imImage* image, const imImage* mask_image, int tile_width, int tile_height, imStats* stats, int counter)
 {
   int ret = 0;
-  int counter = imProcessCounterBegin("ImageStatistics");
-  imCounterTotal(counter, image->depth*image->height, "Calculating...");
+  const imbyte* mask = mask_image? (const imbyte*)mask_image->data[0]: NULL;
 
   for (int i = 0; i < image->depth; i++)
   {
     switch(image->data_type)
     {
     case IM_BYTE:
-      ret = DoStats((imbyte*)image->data[i], image->count, &stats[i], counter, image->width);
-      break;                                                                                
-    case IM_SHORT:                                                                           
-      ret = DoStats((short*)image->data[i], image->count, &stats[i], counter, image->width);
-      break;                                                                                
-    case IM_USHORT:                                                                           
-      ret = DoStats((imushort*)image->data[i], image->count, &stats[i], counter, image->width);
-      break;                                                                                
-    case IM_INT:                                                                           
-      ret = DoStats((int*)image->data[i], image->count, &stats[i], counter, image->width);
-      break;                                                                                
-    case IM_FLOAT:                                                                           
-      ret = DoStats((float*)image->data[i], image->count, &stats[i], counter, image->width);
-      break;                                                                                
+      ret = DoStatsPlane((imbyte*)image->data[i], image, mask, tile_width, tile_height, &stats[i], counter);
+      break;
+    case IM_SHORT:
+      ret = DoStatsPlane((short*)image->data[i], image, mask, tile_width, tile_height, &stats[i], counter);
+      break;
+    case IM_USHORT:
+      ret = DoStatsPlane((imushort*)image->data[i], image, mask, tile_width, tile_height, &stats[i], counter);
+      break;
+    case IM_INT:
+      ret = DoStatsPlane((int*)image->data[i], image, mask, tile_width, tile_height, &stats[i], counter);
+      break;
+    case IM_FLOAT:
+      ret = DoStatsPlane((float*)image->data[i], image, mask, tile_width, tile_height, &stats[i], counter);
+      break;
     case IM_DOUBLE:
-      ret = DoStats((double*)image->data[i], image->count, &stats[i], counter, image->width);
+      ret = DoStatsPlane((double*)image->data[i], image, mask, tile_width, tile_height, &stats[i], counter);
       break;
     }
 
@@ -465,6 +773,41 @@ int imCalcImageStatistics(const imImage* image, imStats* stats)
       break;
   }
 
+  return ret;
+}
+
+int imCalcImageStatistics(const imImage* image, imStats* stats)
+{
+  int counter = imProcessCounterBegin("ImageStatistics");
+  imCounterTotal(counter, image->depth*image->height, "Calculating...");
+
+  int ret = iCalcImageStatistics(image, NULL, 0, 0, stats, counter);
+
+  imProcessCounterEnd(counter);
+  return ret;
+}
+
+int imCalcImageStatisticsMask(const imImage* image, const imImage* mask_image, imStats* stats)
+{
+  int counter = imProcessCounterBegin("ImageStatisticsMask");
+  imCounterTotal(counter, image->depth*image->height, "Calculating...");
+
+  int ret = iCalcImageStatistics(image, mask_image, 0, 0, stats, counter);
+
+  imProcessCounterEnd(counter);
+  return ret;
+}
+
+int imCalcImageStatisticsTiles(const imImage* image, const imImage* mask_image, int tile_width, int tile_height, imStats* stats)
+{
+  int counter = imProcessCounterBegin("ImageStatisticsTiles");
+  if (tile_width > 0 && tile_height > 0)
+    imCounterTotal(counter, image->depth*((image->height + tile_height - 1) / tile_height), "Calculating...");
+  else
+    imCounterTotal(counter, image->depth*image->height, "Calculating...");
+
+  int ret = iCalcImageStatistics(image, mask_image, tile_width, tile_height, stats, counter);
+
   imProcessCounterEnd(counter);
   return ret;
 }
@@ -485,7 +828,7 @@ int imCalcHistogramStatistics(const imImage* image, imStats* stats)
       return 0;
     }
 
-    DoStats((unsigned long*)histo, hcount, &stats[d], -1, hcount);
+    DoStats((unsigned long*)histo, hcount, 1, (imbyte*)NULL, &stats[d], -1);
   }
 
   imHistogramRelease(histo);
@@ -9,7 +9,10 @@
 #include <im_util.h>
 #include <im_math_op.h>
 
+#include <im_palette.h>
+
 #include "im_process_counter.h"
+#include "im_process_dither.h"
 #include "im_process_pnt.h"
 #include "im_process_ana.h"
 
@@ -19,6 +22,11 @@
 #include <string.h>
 #include <math.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IM_USE_SSE2
+#endif
+
 
 template <class T, class S>
 static void DoThresholdColor(T *src_data, imbyte *dst_data, int count, int depth, double* src_color, S tol)
@@ -201,18 +209,24 @@ void imProcessThreshold(const imImage* src_image, imImage* dst_image, double lev
   }
 }
 
-static int compare_int(const void *elem1, const void *elem2) 
+static inline void sort_swap(int& a, int& b)
 {
-  int* v1 = (int*)elem1;
-  int* v2 = (int*)elem2;
-
-  if (*v1 < *v2)
-    return -1;
-
-  if (*v1 > *v2)
-    return 1;
+  if (a > b)
+  {
+    int t = a;
+    a = b;
+    b = t;
+  }
+}
 
-  return 0;
+/* sorting network for 4 elements, 5 comparisons */
+static inline void sort4(int* g)
+{
+  sort_swap(g[0], g[1]);
+  sort_swap(g[2], g[3]);
+  sort_swap(g[0], g[2]);
+  sort_swap(g[1], g[3]);
+  sort_swap(g[1], g[2]);
 }
 
 static int thresUniErr(unsigned char* band, int width, int height)
@@ -250,7 +264,7 @@ static int thresUniErr(unsigned char* band, int width, int height)
       g[3] = band[offset2 + x+1];
 
       /* Sorting */
-      qsort(g, 4, sizeof(int), compare_int);
+      sort4(g);
 
       /* Accumulating */
       tab1[g[0]] += 1; 
@@ -340,6 +354,133 @@ void imProcessDiffusionErrThreshold(const imImage* src_image, imImage* dst_image
   }
 }
 
+struct iDitherThresholdQuantize
+{
+  int level, value;
+
+  inline int operator()(int v, imbyte* dst)
+  {
+    if (v > level)
+    {
+      *dst = (imbyte)value;
+      return 255;
+    }
+
+    *dst = 0;
+    return 0;
+  }
+};
+
+/* threshold matrix line repeated to at least 16 columns */
+static void do_dither_ordered_line(const imbyte* src_line, imbyte* dst_line, int width, const imbyte* thres_line, int thres_width, imbyte value)
+{
+  int x = 0;
+
+#ifdef IM_USE_SSE2
+  const __m128i sign = _mm_set1_epi8((char)0x80);
+  const __m128i ones = _mm_set1_epi8((char)value);
+
+  /* thres_width is a multiple of 16 */
+  for (; x + 16 <= width; x += 16)
+  {
+    __m128i s = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(src_line + x)), sign);
+    __m128i t = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(thres_line + (x & (thres_width - 1)))), sign);
+    _mm_storeu_si128((__m128i*)(dst_line + x), _mm_and_si128(_mm_cmpgt_epi8(s, t), ones));
+  }
+#endif
+
+  for (; x < width; x++)
+    dst_line[x] = src_line[x] > thres_line[x & (thres_width - 1)]? value: 0;
+}
+
+static int do_dither_ordered(const imbyte* src_map, imbyte* dst_map, int width, int height, int level, int dither, imbyte value, int counter)
+{
+  int size;
+  const int* matrix = imPaletteDitherMatrix(dither, &size);
+  if (!matrix)
+    return 0;
+
+  /* the matrix ranks are converted to byte thresholds centered in level,
+     each line is repeated to at least 16 columns */
+  int count = size*size;
+  int thres_width = size < 16? 16: size;
+  imbyte* thres = (imbyte*)malloc(thres_width*size);
+  if (!thres)
+    return 0;
+
+  for (int y = 0; y < size; y++)
+  {
+    for (int x = 0; x < thres_width; x++)
+    {
+      int t = ((2 * matrix[y*size + x % size] + 1) * 255) / (2 * count) + level - 128;
+      thres[y*thres_width + x] = (imbyte)(t < 0? 0: (t > 255? 255: t));
+    }
+  }
+
+  IM_INT_PROCESSING;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (IM_OMP_MINHEIGHT(height))
+#endif
+  for (int y = 0; y < height; y++)
+  {
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_BEGIN_PROCESSING;
+
+    size_t line_offset = (size_t)y * width;
+    do_dither_ordered_line(src_map + line_offset, dst_map + line_offset, width, thres + (y & (size - 1))*thres_width, thres_width, value);
+
+    IM_COUNT_PROCESSING;
+#ifdef _OPENMP
+#pragma omp flush (processing)
+#endif
+    IM_END_PROCESSING;
+  }
+
+  free(thres);
+  return processing;
+}
+
+int imProcessDitherThreshold(const imImage* src_image, imImage* dst_image, int level, int dither)
+{
+  int value = src_image->depth > 1? 255: 1;
+  int ret = 1;
+
+  if (dither != IM_PALETTE_DITHER_ORDERED && dither != IM_PALETTE_DITHER_DIFFUSION && dither != IM_PALETTE_DITHER_BLUENOISE)
+  {
+    /* no dither, a simple threshold */
+    imbyte byte_level = (imbyte)(level < 0? 0: (level > 255? 255: level));
+    for (int i = 0; i < src_image->depth; i++)
+      doThreshold((imbyte*)src_image->data[i], (imbyte*)dst_image->data[i], src_image->count, byte_level, value);
+    return ret;
+  }
+
+  int counter = imProcessCounterBegin("DitherThreshold");
+  imCounterTotal(counter, src_image->depth*src_image->height, "Processing...");
+
+  for (int i = 0; i < src_image->depth; i++)
+  {
+    if (dither == IM_PALETTE_DITHER_DIFFUSION)
+    {
+      iDitherThresholdQuantize quantize;
+      quantize.level = level;
+      quantize.value = value;
+      ret = imDitherDiffusion((imbyte*)src_image->data[i], (imbyte*)dst_image->data[i], src_image->width, src_image->height, quantize, counter);
+    }
+    else
+      ret = do_dither_ordered((imbyte*)src_image->data[i], (imbyte*)dst_image->data[i], src_image->width, src_image->height, level, dither, (imbyte)value, counter);
+
+    if (!ret)
+      break;
+  }
+
+  imProcessCounterEnd(counter);
+
+  return ret;
+}
+
 int imProcessPercentThreshold(const imImage* src_image, imImage* dst_image, double percent)
 {
   int hcount;
@@ -8,11 +8,13 @@
 #include <im.h>
 #include <im_util.h>
 #include <im_math.h>
+#include <im_color.h>
 #include <im_colorhsi.h>
 
 #include "im_process_counter.h"
 #include "im_process_pnt.h"
 #include "im_process_ana.h"
+#include "im_process_hsi.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -281,7 +283,7 @@ void imProcessToneGamut(const imImage* src_image, imImage* dst_image, int op, do
 }
 
 template <class T> 
-static void DoShiftHSI(T **map, T **new_map, int count, double h_shift, double s_shift, double i_shift)
+static void DoShiftHSI(T **map, T **new_map, int count, double h_shift, double s_shift, double i_shift, int fast)
 {
   double min, max, range;
   T tmin, tmax;
@@ -307,17 +309,30 @@ static void DoShiftHSI(T **map, T **new_map, int count, double h_shift, double s
     g = normal_op((double)map[1][j], (double)min, (double)range);
     b = normal_op((double)map[2][j], (double)min, (double)range);
 
-    imColorRGB2HSI(r, g, b, &h, &s, &i);
+    if (fast)
+    {
+      float fh, fs, fi, fr, fg, fb;
+
+      iFastRGB2HSI((float)r, (float)g, (float)b, &fh, &fs, &fi);
+      iFastShiftHSI(fh, fs, fi, (float)h_shift, (float)s_shift, (float)i_shift);
+      iFastHSI2RGB(fh, fs, fi, &fr, &fg, &fb);
+
+      r = fr; g = fg; b = fb;
+    }
+    else
+    {
+      imColorRGB2HSI(r, g, b, &h, &s, &i);
 
-    h += h_shift; // in degrees
-    s += s_shift;
-    if (s < 0) s = 0;
-    if (s > 1) s = 1;
-    i += i_shift;
-    if (i < 0) i = 0;
-    if (i > 1) i = 1;
+      h += h_shift; // in degrees
+      s += s_shift;
+      if (s < 0) s = 0;
+      if (s > 1) s = 1;
+      i += i_shift;
+      if (i < 0) i = 0;
+      if (i > 1) i = 1;
 
-    imColorHSI2RGB(h, s, i, &r, &g, &b);
+      imColorHSI2RGB(h, s, i, &r, &g, &b);
+    }
 
     // Expand to min-max
     new_map[0][j] = (T)(r*range + min);
@@ -326,8 +341,13 @@ static void DoShiftHSI(T **map, T **new_map, int count, double h_shift, double s
   }
 }
 
-static void DoShiftHSIByte(imbyte **map, imbyte **new_map, int count, double h_shift, double s_shift, double i_shift)
+static void DoShiftHSIByte(imbyte **map, imbyte **new_map, int count, double h_shift, double s_shift, double i_shift, int fast)
 {
+  /* same normalization of imColorRGB2HSIbyte */
+  float norm[256];
+  for (int v = 0; v < 256; v++)
+    norm[v] = (float)imColorReconstruct((imbyte)v, (imbyte)0, (imbyte)255);
+
 #ifdef _OPENMP
 #pragma omp parallel for if (IM_OMP_MINCOUNT(count))
 #endif
@@ -340,17 +360,32 @@ static void DoShiftHSIByte(imbyte **map, imbyte **new_map, int count, double h_s
     g = map[1][j];
     b = map[2][j];
 
-    imColorRGB2HSIbyte(r, g, b, &h, &s, &i);
+    if (fast)
+    {
+      float fh, fs, fi, fr, fg, fb;
 
-    h += h_shift; // in degrees
-    s += s_shift;
-    if (s < 0) s = 0;
-    if (s > 1) s = 1;
-    i += i_shift;
-    if (i < 0) i = 0;
-    if (i > 1) i = 1;
+      iFastRGB2HSI(norm[r], norm[g], norm[b], &fh, &fs, &fi);
+      iFastShiftHSI(fh, fs, fi, (float)h_shift, (float)s_shift, (float)i_shift);
+      iFastHSI2RGB(fh, fs, fi, &fr, &fg, &fb);
 
-    imColorHSI2RGBbyte(h, s, i, &r, &g, &b);
+      r = imColorQuantize((double)fr, (imbyte)0, (imbyte)255);
+      g = imColorQuantize((double)fg, (imbyte)0, (imbyte)255);
+      b = imColorQuantize((double)fb, (imbyte)0, (imbyte)255);
+    }
+    else
+    {
+      imColorRGB2HSIbyte(r, g, b, &h, &s, &i);
+
+      h += h_shift; // in degrees
+      s += s_shift;
+      if (s < 0) s = 0;
+      if (s > 1) s = 1;
+      i += i_shift;
+      if (i < 0) i = 0;
+      if (i > 1) i = 1;
+
+      imColorHSI2RGBbyte(h, s, i, &r, &g, &b);
+    }
 
     new_map[0][j] = r;
     new_map[1][j] = g;
@@ -358,31 +393,41 @@ static void DoShiftHSIByte(imbyte **map, imbyte **new_map, int count, double h_s
   }
 }
 
-void imProcessShiftHSI(const imImage* src_image, imImage* dst_image, double h_shift, double s_shift, double i_shift)
+static void iShiftHSI(const imImage* src_image, imImage* dst_image, double h_shift, double s_shift, double i_shift, int fast)
 {
   switch(src_image->data_type)
   {
   case IM_BYTE:
-    DoShiftHSIByte((imbyte**)src_image->data, (imbyte**)dst_image->data, src_image->count, h_shift, s_shift, i_shift);
+    DoShiftHSIByte((imbyte**)src_image->data, (imbyte**)dst_image->data, src_image->count, h_shift, s_shift, i_shift, fast);
     break;                                                                                
   case IM_SHORT:                                                                           
-    DoShiftHSI((short**)src_image->data, (short**)dst_image->data, src_image->count, h_shift, s_shift, i_shift);
+    DoShiftHSI((short**)src_image->data, (short**)dst_image->data, src_image->count, h_shift, s_shift, i_shift, fast);
     break;                                                                                
   case IM_USHORT:                                                                           
-    DoShiftHSI((imushort**)src_image->data, (imushort**)dst_image->data, src_image->count, h_shift, s_shift, i_shift);
+    DoShiftHSI((imushort**)src_image->data, (imushort**)dst_image->data, src_image->count, h_shift, s_shift, i_shift, fast);
     break;                                                                                
   case IM_INT:                                                                           
-    DoShiftHSI((int**)src_image->data, (int**)dst_image->data, src_image->count, h_shift, s_shift, i_shift);
+    DoShiftHSI((int**)src_image->data, (int**)dst_image->data, src_image->count, h_shift, s_shift, i_shift, fast);
     break;                                                                                
   case IM_FLOAT:                                                                           
-    DoShiftHSI((float**)src_image->data, (float**)dst_image->data, src_image->count, h_shift, s_shift, i_shift);
+    DoShiftHSI((float**)src_image->data, (float**)dst_image->data, src_image->count, h_shift, s_shift, i_shift, fast);
     break;                                                                                
   case IM_DOUBLE:
-    DoShiftHSI((double**)src_image->data, (double**)dst_image->data, src_image->count, h_shift, s_shift, i_shift);
+    DoShiftHSI((double**)src_image->data, (double**)dst_image->data, src_image->count, h_shift, s_shift, i_shift, fast);
     break;
   }
 }
 
+void imProcessShiftHSI(const imImage* src_image, imImage* dst_image, double h_shift, double s_shift, double i_shift)
+{
+  iShiftHSI(src_image, dst_image, h_shift, s_shift, i_shift, 0);
+}
+
+void imProcessShiftHSIFast(const imImage* src_image, imImage* dst_image, double h_shift, double s_shift, double i_shift)
+{
+  iShiftHSI(src_image, dst_image, h_shift, s_shift, i_shift, 1);
+}
+
 template <class T>
 static void DoShiftComponent(T **map, T **new_map, int count, double c0_shift, double c1_shift, double c2_shift)
 {